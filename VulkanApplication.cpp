@@ -1,9 +1,23 @@
+// Windows entry point, see main_linux.cpp for everything else
+
+#ifdef _WIN32
+
 #include "VulkanApplication.h"
 
 #include "framework.h"
+#include <shellapi.h>
 
 #include <locale>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "app.h"
+#include "benchmark.h"
+#include "config.h"
+#include "platform.h"
+#include "replay.h"
+#include "telemetry.h"
 
 #include "error.h"
 
@@ -15,6 +29,23 @@ ATOM MyRegisterClass(LPCWSTR szWindowClass);
 LRESULT CALLBACK WndProc(HWND, UINT, WPARAM, LPARAM);
 INT_PTR CALLBACK About(HWND, UINT, WPARAM, LPARAM);
 
+// command line arguments as UTF-8, without the executable path
+static std::vector<std::string> getCommandLineArgs()
+{
+    std::vector<std::string> args{};
+    int argc = 0;
+    LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+    if (argv == nullptr) return args;
+    for (int i = 1; i < argc; ++i) {
+        const int size = WideCharToMultiByte(CP_UTF8, 0, argv[i], -1, nullptr, 0, nullptr, nullptr);
+        std::string arg(static_cast<size_t>(size > 0 ? size - 1 : 0), '\0');
+        WideCharToMultiByte(CP_UTF8, 0, argv[i], -1, arg.data(), size, nullptr, nullptr);
+        args.push_back(std::move(arg));
+    }
+    LocalFree(argv);
+    return args;
+}
+
 int APIENTRY wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _In_ LPWSTR lpCmdLine, _In_ int nCmdShow)
 {
     UNREFERENCED_PARAMETER(hPrevInstance);
@@ -25,6 +56,26 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance
 
     g_hInst = hInstance;
 
+    const std::vector<std::string> args = getCommandLineArgs();
+
+    // benchmark mode renders headless and never opens a window
+    if (benchmarkRequested(args)) {
+        return runBenchmarks(args);
+    }
+    // and so does replaying a recording
+    if (replayRequested(args)) {
+        return runReplay(args);
+    }
+
+    Config config{};
+    try {
+        config = loadConfig(args);
+    }
+    catch (const Error& error) {
+        MessageBoxA(nullptr, error.what(), "Configuration Error!", MB_OK | MB_ICONERROR);
+        return 0;
+    }
+
     // Initialize global strings
     LoadStringW(hInstance, IDS_APP_TITLE, szTitle, MAX_LOADSTRING);
     LoadStringW(hInstance, IDC_VULKANAPPLICATION, szWindowClass, MAX_LOADSTRING);
@@ -36,8 +87,8 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance
     RECT windowRect{};
     windowRect.left = 0;
     windowRect.top = 0;
-    windowRect.right = 768;
-    windowRect.bottom = 768;
+    windowRect.right = static_cast<LONG>(config.window_width);
+    windowRect.bottom = static_cast<LONG>(config.window_height);
     AdjustWindowRect(&windowRect, WINDOW_STYLE, TRUE);
 
     // Perform application initialization:
@@ -52,8 +103,13 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance
 
     HACCEL hAccelTable = LoadAccelerators(hInstance, MAKEINTRESOURCE(IDC_VULKANAPPLICATION));
 
+    const std::unique_ptr<Window> window = createWin32Window(hInstance, hWnd, hAccelTable);
+
+    TelemetryExporter telemetry{};
     try {
-        initApp(hInstance, hWnd);
+        initApp(*window, config.renderer);
+        setLiveSettings(config.live);
+        if (!config.telemetry.empty()) startTelemetryExport(telemetry, config.telemetry, config.telemetry_interval_ms);
     }
     catch (const Error& error) {
         MessageBoxA(hWnd, error.what(), "Initialisation Error!", MB_OK | MB_ICONERROR);
@@ -63,17 +119,18 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance
     // creates a new game loop thread
     startGameLoop();
 
-    MSG msg{};
-    while (GetMessage(&msg, NULL, 0, 0)) {
-        if (!TranslateAccelerator(msg.hwnd, hAccelTable, &msg)) {
-            TranslateMessage(&msg);
-            DispatchMessage(&msg);
-        }
+    ConfigWatcher config_watcher{};
+    startConfigWatcher(config_watcher, config, args, [](const Config& reloaded) { setLiveSettings(reloaded.live); });
+
+    while (window->processEvents(getEventQueue())) {
     }
 
+    stopConfigWatcher(config_watcher);
+    stopTelemetryExport(telemetry);
+
     // vulkan context is destroyed just before WM_QUIT message is posted
 
-    return static_cast<int>(msg.wParam);
+    return 0;
 }
 
 ATOM MyRegisterClass(LPCWSTR szWindowClass)
@@ -126,6 +183,17 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
             endLoopAndShutdown();
             PostQuitMessage(0);
             break;
+        case WM_KEYUP:
+            if (wParam == VK_SNAPSHOT) {
+                // Print Screen saves the next frame, Shift+Print Screen starts or stops continuous capture
+                if (GetKeyState(VK_SHIFT) < 0) {
+                    requestFrameCapture(isCapturingFrames() ? 0 : CAPTURE_CONTINUOUS);
+                }
+                else {
+                    requestFrameCapture(1);
+                }
+            }
+            break;
         case WM_SIZE:
             // window resized
             break;
@@ -152,3 +220,5 @@ INT_PTR CALLBACK About(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam)
     }
     return (INT_PTR)FALSE;
 }
+
+#endif
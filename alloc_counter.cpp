@@ -0,0 +1,63 @@
+#include "alloc_counter.h"
+
+#if VULKANAPP_COUNT_ALLOCATIONS
+
+#include <cstdlib>
+
+#include <algorithm>
+#include <new>
+
+static thread_local uint64_t allocation_count = 0;
+
+uint64_t threadHeapAllocationCount() { return allocation_count; }
+
+// new[] and the nothrow versions call these two by default, and the deletes below match them
+void* operator new(size_t size)
+{
+    ++allocation_count;
+    if (size == 0) size = 1;
+    while (true) {
+        if (void* p = malloc(size)) return p;
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr) throw std::bad_alloc();
+        handler();
+    }
+}
+
+// over-aligned types, such as the cache line aligned queues
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    ++allocation_count;
+    const size_t align = static_cast<size_t>(alignment);
+    size = (std::max<size_t>(size, 1) + align - 1) & ~(align - 1); // aligned_alloc() wants a multiple of the alignment
+    while (true) {
+#ifdef _WIN32
+        if (void* p = _aligned_malloc(size, align)) return p;
+#else
+        if (void* p = aligned_alloc(align, size)) return p;
+#endif
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void operator delete(void* p) noexcept { free(p); }
+
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+#ifdef _WIN32
+void operator delete(void* p, std::align_val_t) noexcept { _aligned_free(p); }
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept { _aligned_free(p); }
+#else
+void operator delete(void* p, std::align_val_t) noexcept { free(p); }
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept { free(p); }
+#endif
+
+#else
+
+uint64_t threadHeapAllocationCount() { return 0; }
+
+#endif
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+// Replaces the global operator new to count heap allocations made by each thread, so the benchmark can fail scenes whose
+// render loop allocates once it has warmed up. On by default in debug builds, builds that set VULKANAPP_COUNT_ALLOCATIONS to 1
+// (as the CMake build and the project's release configuration do) count in every configuration.
+#ifndef VULKANAPP_COUNT_ALLOCATIONS
+#ifdef NDEBUG
+#define VULKANAPP_COUNT_ALLOCATIONS 0
+#else
+#define VULKANAPP_COUNT_ALLOCATIONS 1
+#endif
+#endif
+
+constexpr bool HEAP_ALLOCATIONS_COUNTED = VULKANAPP_COUNT_ALLOCATIONS != 0;
+
+// Always 0 if HEAP_ALLOCATIONS_COUNTED is false.
+uint64_t threadHeapAllocationCount();
@@ -5,361 +5,2541 @@
 #include <cmath>
 #include <cinttypes>
 #include <cstdint>
+#include <cstdio>
+#include <cstring>
 
 // std lib
+#include <algorithm>
 #include <array>
 #include <atomic>
+#include <future>
 #include <memory>
+#include <mutex>
+#include <span>
+#include <string>
 #include <thread>
 #include <chrono>
+#include <vector>
 
 // other libs
-#include "framework.h"
 #include "vulkan_headers.h"
 
 // project includes
+#include "alloc_counter.h"
+#include "draw_list.h"
+#include "dynamic_resolution.h"
+#include "entity_store.h"
 #include "error.h"
+#include "events.h"
+#include "frame_arena.h"
+#include "job_system.h"
+#include "mesh.h"
+#include "platform.h"
+#include "replay.h"
+#include "scene_file.h"
+#include "spatial_index.h"
+#include "telemetry.h"
+#include "vulkan_debug.h"
 #include "vulkan_device.h"
 #include "vulkan_instance.h"
 #include "vulkan_swapchain.h"
 #include "vulkan_pipeline.h"
+#include "vulkan_capture.h"
+#include "vulkan_buffer.h"
+#include "vulkan_depth_pyramid.h"
+#include "vulkan_image.h"
+#include "vulkan_memory.h"
+#include "vulkan_mesh.h"
+#include "vulkan_stream_buffer.h"
+#include "vulkan_upload.h"
+
+constexpr size_t FRAME_ARENA_SIZE = 64 * 1024;          // grows if a frame needs more
+constexpr VkDeviceSize STREAM_REGION_SIZE = 256 * 1024; // per frame in flight, grows if a frame needs more
+constexpr VkDeviceSize STAGING_SIZE = 4 * 1024 * 1024;
+constexpr VkDeviceSize DEFRAGMENT_BYTES_PER_FRAME = 4 * 1024 * 1024; // copied out of a block being emptied, so it takes several frames
+constexpr uint64_t MEMORY_BUDGET_POLL_INTERVAL = 60;                 // frames
+// What the render thread publishes through telemetry.h, registered by initRenderer()
+struct AppTelemetry {
+    TelemetryCounter* frames = nullptr;
+    TelemetryHistogram* frame_interval = nullptr;
+    TelemetryHistogram* record_cpu = nullptr;
+    TelemetryHistogram* render_gpu = nullptr;
+    TelemetryHistogram* input_latency = nullptr;
+    TelemetryGauge* draws = nullptr;
+    TelemetryGauge* batches = nullptr;
+    TelemetryGauge* pipeline_binds = nullptr;
+    TelemetryGauge* resolution_scale = nullptr;
+    TelemetryGauge* memory_allocated = nullptr;
+    TelemetryGauge* memory_used = nullptr;
+    TelemetryGauge* memory_budget = nullptr;
+    TelemetryCounter* device_lost = nullptr;
+    TelemetryCounter* surface_lost = nullptr;
+};
+
+// in the working directory, loaded at startup and saved at shutdown so the next run does not compile the same pipelines again
+constexpr const char* PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+
+// SceneLayout::Field
+constexpr float FIELD_SPACING = 0.35f;              // between cell centres
+constexpr float FIELD_INSTANCE_RADIUS = 0.14f;      // instances are scaled to fit, so neighbours never overlap while drifting
+constexpr float FIELD_DRIFT = 0.02f;                // radius of the circle each moving group drifts around
+constexpr uint32_t FIELD_GROUP_SIDE = 4;            // instances are children of group entities covering this many cells square
+constexpr uint32_t FIELD_MOVING_GROUP_INTERVAL = 8; // one group in this many moves, the rest stand still
+
+static_assert(sizeof(WorldTransform) == sizeof(DrawParams), "the entity buffer holds world transforms as they are");
+
+// everything used by one frame while it is in flight
+struct FrameData {
+    VkCommandPool cmd_pool = VK_NULL_HANDLE;
+    VkCommandBuffer cmd_buf = VK_NULL_HANDLE;
+
+    VkFence fence = VK_NULL_HANDLE; // signalled when the frame's command buffer finishes execution
+    VkSemaphore present_semaphore = VK_NULL_HANDLE;
+    VkSemaphore render_semaphore = VK_NULL_HANDLE;
+
+    FrameArena arena{FRAME_ARENA_SIZE}; // CPU side data that is only needed until the frame retires
+    Buffer meshlet_draws{};             // indirect draws written by meshlet_cull.comp, grows with the scene
+    Buffer occlusion_flags{};           // one uint32_t per meshlet draw, written by the first occlusion phase for the second
+
+    VkQueryPool timestamps = VK_NULL_HANDLE; // around the frame's rendering, VK_NULL_HANDLE if the queue cannot write timestamps
+    bool timestamps_written = false;         // by the last command buffer submitted from this frame
+};
+
+// An input event waiting for the first frame drawn after it to reach the screen
+struct LatencySample {
+    int64_t input_ns = 0;
+    uint64_t present_id = 0; // frame number + 1 of that frame
+};
+
+struct LatencyStats {
+    uint64_t count = 0;
+    double total_ms = 0.0;
+    double max_ms = 0.0;
+    int64_t last_report_ns = 0;
+};
 
 // GLOBALS
 // Should only be accessed by the rendering thread after initialisation by main thread
+// apart from the atomics and the producer side of the event queue
 struct Globals {
     VkInstance instance = VK_NULL_HANDLE;
+    VkDebugUtilsMessengerEXT debug_messenger = VK_NULL_HANDLE; // debug builds only, see vulkan_debug.h
+    const Window* window = nullptr;                            // nullptr when headless, makes a new surface after one is lost
     Device device{};
     Swapchain swapchain{};
 
-    VkCommandPool cmd_pool = VK_NULL_HANDLE;
-    VkCommandBuffer cmd_buf = VK_NULL_HANDLE;
+    // the CPU records the next frame while the GPU works on the previous ones, only the first frames_in_flight are used
+    std::array<FrameData, MAX_FRAMES_IN_FLIGHT> frames{};
+    uint32_t frames_in_flight = 2;
 
-    VkFence fence = VK_NULL_HANDLE;
-    VkSemaphore present_semaphore = VK_NULL_HANDLE;
-    VkSemaphore render_semaphore = VK_NULL_HANDLE;
+    VkDescriptorSetLayout frame_set_layout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+    VkDescriptorSet frame_set = VK_NULL_HANDLE; // written once, the stream buffer region is picked with a dynamic offset
+    Pipelines pipelines{};
+    bool extended_dynamic_state = true;
+    bool pipeline_libraries = true; // where Device::graphicsPipelineLibrary allows
+    double pipelines_create_ms = 0.0;
+    VkPipelineCache pipeline_cache = VK_NULL_HANDLE; // every pipeline is created through it, saved to PIPELINE_CACHE_PATH on shutdown
+
+    // Fast linked scene pipelines are drawn with while their optimised link runs on its own thread, the first frame after it finishes
+    // swaps the optimised ones in.
+    std::unique_ptr<std::thread> optimise_thread{};
+    std::atomic<bool> optimise_finished = false;
+    LinkedPipelines optimised_pipelines{};
+    LinkedPipelines retired_pipelines{}; // the fast linked ones, destroyed once the frames drawn with them have finished
+    uint64_t retired_frame = 0;          // the first frame drawn without them
+    double optimised_link_ms = 0.0;
+    Image depth_image{}; // reversed Z, the size of the swapchain images
+
+    // dynamic resolution
+    Image render_target{}; // the size of the swapchain images, VK_NULL_HANDLE if they cannot be blitted to
+    VkFilter upscale_filter = VK_FILTER_NEAREST;
+    DynamicResolutionSettings dynamic_resolution{};
+    ResolutionController resolution{}; // fed the GPU time of each frame as it retires
+
+    // anti-aliasing
+    AntiAliasing anti_aliasing = AntiAliasing::Off;        // as requested, currentAntiAliasing() is what is used
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT; // of the scene pipelines and the multisampled attachments
+    bool sample_shading = false;
+    Image msaa_color{}; // the scene is drawn into these with MSAA and resolved, VK_NULL_HANDLE without
+    Image msaa_depth{};
+    VkDescriptorSetLayout post_process_set_layout = VK_NULL_HANDLE;
+    VkDescriptorSet post_process_set = VK_NULL_HANDLE; // the render target
+    VkSampler post_process_sampler = VK_NULL_HANDLE;   // upscale_filter, VK_NULL_HANDLE if the render target cannot be sampled
+
+    DepthPyramid depth_pyramid{};                                    // of depth_image, built between the occlusion culling phases
+    VkSampler nearest_sampler = VK_NULL_HANDLE;                      // the depth buffer and pyramid are only read with texelFetch()
+    VkDescriptorSetLayout depth_pyramid_set_layout = VK_NULL_HANDLE; // VK_NULL_HANDLE without Device::storageImageArrayDynamicIndexing
+    VkDescriptorSet depth_pyramid_set = VK_NULL_HANDLE;
+    bool depth_pyramid_built = false; // since it was last recreated, nothing can be culled against it before then
+
+    StreamBuffer stream{}; // frame constants and per-draw parameters
+
+    Capture capture{};
+    uint64_t frame_number = 0; // frames[frame_number % frames_in_flight] is the frame being recorded
+
+    bool headless = false; // rendering into offscreen images, nothing is presented
+    VkPresentModeKHR present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+    uint32_t swapchain_images = 0; // 0 for the surface's minimum plus one
+
+    EventQueue events{}; // pushed to by the window thread, drained by the render thread once per frame
+    VkExtent2D window_extent{};
+    bool minimised = false;
+    bool swapchain_outdated = false;
+
+    // input to photon latency
+    int64_t unrendered_input_ns = 0; // timestamp of the oldest input not drawn yet, 0 if there is none
+    std::array<LatencySample, 8> latency_samples{};
+    uint32_t latency_sample_count = 0;
+    LatencyStats input_latency{};
+
+    // scene state
+    std::string scene_path{}; // the built in triangle is drawn if empty
+    GpuMesh scene_mesh{};
+    double current_time = 0.0;
+    uint32_t instance_count = 1;
+    SceneLayout layout = SceneLayout::Ring;
+    VertexPath vertex_path = VertexPath::Pulling;
+    ClusterCulling cluster_culling = ClusterCulling::MeshShader; // the best the device supports
+    bool instance_culling = true;
+    bool depth_prepass = false;
+    bool occlusion_culling = true;
 
-    VkPipeline pipeline = VK_NULL_HANDLE;
-    VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+    std::unique_ptr<JobSystem> jobs{}; // spreads scene updates over the cores
+    uint32_t worker_count = 0;         // 0 for one thread per core
+    EntityStore entities{};
+    std::vector<uint32_t> animated_entities{};   // their local transforms are set every frame by animateScene()
+    std::vector<uint32_t> renderable_entities{}; // every entity with a mesh, the draw list when nothing is culled
+    uint32_t first_instance_entity = 0;          // entities from here on are the instances
+    Buffer entity_buffer{};                      // DrawParams of every entity, only the ones that changed are uploaded each frame
+    bool upload_all_entities = true;             // set by uploadAllEntities()
+
+    // SceneLayout::Field
+    uint32_t field_side = 0;                   // instances per row
+    uint32_t field_group_side = 0;             // groups per row
+    Bvh instance_bvh{};                        // over the instances' bounds, item ids are entity ids - first_instance_entity
+    std::vector<BvhRange> visible_instances{}; // keeps its capacity between frames
+
+    DrawList draw_list{};         // rebuilt every frame
+    DrawCounters draw_counters{}; // of the last frame recorded
+    double render_gpu_ms = 0.0;   // of the last frame retired, 0 without timestamps
+
+    // the last left click, picked against instance_bvh when the next frame is recorded
+    bool pick_requested = false;
+    int32_t pick_x = 0;
+    int32_t pick_y = 0;
+
+    // Startup runs what does not depend on the swapchain or frame resources on threads of its own. The scene file is mapped while
+    // the device is created, and the pipeline cache is loaded and the first pipelines compiled while the swapchain, frame resources
+    // and meshes are. Nothing else touches what they write until their futures have been waited on.
+    std::chrono::steady_clock::time_point startup_begin{};
+    std::future<void> startup_scene{};     // maps scene_path into startup_scene_file
+    SceneFile startup_scene_file{};        // closed once the meshes have been uploaded from it
+    std::future<void> startup_pipelines{}; // creates pipeline_cache and pipelines, the first frame waits for it
+    StartupStats startup{};
+    RecoveryStats recovery{};
+    uint64_t simulated_device_lost_frame = UINT64_MAX; // drawFrame() reports the device lost at this frame number, see simulateDeviceLost()
+    AppTelemetry telemetry{};
+
+    // set by setLiveSettings() on any thread, copied into live at the start of a frame
+    LiveSettings live{};
+    LiveSettings pending_live{};
+    std::mutex live_mutex{};
+    std::atomic<bool> live_changed = false;
+
+    ReplayWriter replay{}; // open while the game loop is being recorded, only the render thread writes to it
 
     std::atomic<bool> running = true;
+    std::atomic<uint32_t> capture_frames_requested = 0; // set by the main thread
     std::unique_ptr<std::thread> loop_thread{};
 };
 
 static Globals globals;
 
-static void recordCommandBuffer(uint32_t image_index, double dt)
+static std::span<FrameData> framesInFlight() { return std::span(globals.frames.data(), globals.frames_in_flight); }
+
+// offscreen images are BGRA like most swapchains so golden images match windowed captures
+constexpr VkFormat HEADLESS_FORMAT = VK_FORMAT_B8G8R8A8_SRGB;
+constexpr uint32_t HEADLESS_IMAGE_COUNT = 2;
+
+// offscreen images are used in turn, so each frame in flight needs its own
+static uint32_t headlessImageCount() { return std::max(HEADLESS_IMAGE_COUNT, globals.frames_in_flight); }
+
+static void imageBarrier(VkCommandBuffer cmd, VkImage image, VkImageLayout old_layout, VkImageLayout new_layout, VkPipelineStageFlags2 src_stage,
+                         VkAccessFlags2 src_access, VkPipelineStageFlags2 dst_stage, VkAccessFlags2 dst_access,
+                         VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT)
 {
-    static double current_time = 0.0;
-    current_time += dt;
+    VkImageMemoryBarrier2 barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+    barrier.pNext = nullptr;
+    barrier.srcStageMask = src_stage;
+    barrier.dstStageMask = dst_stage;
+    barrier.srcAccessMask = src_access;
+    barrier.dstAccessMask = dst_access;
+    barrier.oldLayout = old_layout;
+    barrier.newLayout = new_layout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    VkImageSubresourceRange imageRange{};
+    imageRange.aspectMask = aspect;
+    imageRange.baseMipLevel = 0;
+    imageRange.levelCount = VK_REMAINING_MIP_LEVELS;
+    imageRange.baseArrayLayer = 0;
+    imageRange.layerCount = 1;
+    barrier.subresourceRange = imageRange;
 
-    // reset cmd buffer
-    VKCHECK(vkResetCommandPool(globals.device.device, globals.cmd_pool, 0));
+    VkDependencyInfo imageDependencyInfo{};
+    imageDependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    imageDependencyInfo.imageMemoryBarrierCount = 1;
+    imageDependencyInfo.pImageMemoryBarriers = &barrier;
+    vkCmdPipelineBarrier2(cmd, &imageDependencyInfo);
+}
 
-    // record cmd buffer
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    beginInfo.pInheritanceInfo = nullptr;
-    VKCHECK(vkBeginCommandBuffer(globals.cmd_buf, &beginInfo));
-
-    { // transition swapchain image to color attachment layout
-        VkImageMemoryBarrier2 colorImageBarrier{};
-        colorImageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
-        colorImageBarrier.pNext = nullptr;
-        colorImageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
-        colorImageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
-        colorImageBarrier.srcAccessMask = 0;
-        colorImageBarrier.dstAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT; // vkCmdRendering load op
-        colorImageBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorImageBarrier.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-        colorImageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        colorImageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        colorImageBarrier.image = globals.swapchain.images[image_index].first;
-        VkImageSubresourceRange colorImageRange{};
-        colorImageRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        colorImageRange.baseMipLevel = 0;
-        colorImageRange.levelCount = 1;
-        colorImageRange.baseArrayLayer = 0;
-        colorImageRange.layerCount = 1;
-        colorImageBarrier.subresourceRange = colorImageRange;
-
-        VkDependencyInfo imageDependencyInfo{};
-        imageDependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
-        imageDependencyInfo.imageMemoryBarrierCount = 1;
-        imageDependencyInfo.pImageMemoryBarriers = &colorImageBarrier;
-        vkCmdPipelineBarrier2(globals.cmd_buf, &imageDependencyInfo);
-    }
-
-    // now begin rendering
-    VkRenderingAttachmentInfo colorAttachment{};
-    colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
-    colorAttachment.pNext = nullptr;
-    colorAttachment.imageView = globals.swapchain.images[image_index].second;
-    colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-    colorAttachment.resolveMode = VK_RESOLVE_MODE_NONE;
-    colorAttachment.resolveImageView = VK_NULL_HANDLE;              // don't care
-    colorAttachment.resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED; // don't care
-    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    colorAttachment.clearValue.color.float32[0] = 1.0f;
-    colorAttachment.clearValue.color.float32[1] = 1.0f;
-    colorAttachment.clearValue.color.float32[2] = 1.0f;
-    colorAttachment.clearValue.color.float32[3] = 1.0f;
-    VkRenderingInfo renderingInfo{};
-    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
-    renderingInfo.pNext = nullptr;
-    renderingInfo.flags = 0;
-    renderingInfo.renderArea = VkRect2D{VkOffset2D{0, 0}, globals.swapchain.extent};
-    renderingInfo.layerCount = 1;
-    renderingInfo.viewMask = 0;
-    renderingInfo.colorAttachmentCount = 1;
-    renderingInfo.pColorAttachments = &colorAttachment;
-    renderingInfo.pDepthAttachment = nullptr;
-    renderingInfo.pStencilAttachment = nullptr;
-    vkCmdBeginRendering(globals.cmd_buf, &renderingInfo);
-
-    // do rendering things here
-
-    vkCmdBindPipeline(globals.cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, globals.pipeline);
-
-    /* 2x2 matrix
-     * [ 0 2 ]
-     * [ 1 3 ]
-     */
-    /* 2D rotation matrix
-     * [ cos -sin ]
-     * [ sin  cos ]
-     */
-    float transform[4];
-    transform[0] = static_cast<float>(cos(current_time));
-    transform[1] = static_cast<float>(sin(current_time));
-    transform[2] = static_cast<float>(sin(current_time)) * -1.0f;
-    transform[3] = static_cast<float>(cos(current_time));
-    vkCmdPushConstants(globals.cmd_buf, globals.pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, PUSH_CONSTANT_SIZE, &transform);
-
-    vkCmdDraw(globals.cmd_buf, 3, 1, 0, 0);
-
-    // finish rendering
-    vkCmdEndRendering(globals.cmd_buf);
-
-    { // make the color attachment presentable
-        VkImageMemoryBarrier2 colorImageBarrier{};
-        colorImageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
-        colorImageBarrier.pNext = nullptr;
-        colorImageBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
-        colorImageBarrier.dstStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT; // semaphore takes care of this
-        colorImageBarrier.srcAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;         // vkCmdRendering store op
-        colorImageBarrier.dstAccessMask = 0;
-        colorImageBarrier.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-        colorImageBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-        colorImageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        colorImageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        colorImageBarrier.image = globals.swapchain.images[image_index].first;
-        VkImageSubresourceRange colorImageRange{};
-        colorImageRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        colorImageRange.baseMipLevel = 0;
-        colorImageRange.levelCount = 1;
-        colorImageRange.baseArrayLayer = 0;
-        colorImageRange.layerCount = 1;
-        colorImageBarrier.subresourceRange = colorImageRange;
-
-        VkDependencyInfo imageDependencyInfo{};
-        imageDependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
-        imageDependencyInfo.imageMemoryBarrierCount = 1;
-        imageDependencyInfo.pImageMemoryBarriers = &colorImageBarrier;
-        vkCmdPipelineBarrier2(globals.cmd_buf, &imageDependencyInfo);
-    }
+static void memoryBarrier(VkCommandBuffer cmd, VkPipelineStageFlags2 src_stage, VkAccessFlags2 src_access, VkPipelineStageFlags2 dst_stage,
+                          VkAccessFlags2 dst_access)
+{
+    VkMemoryBarrier2 barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+    barrier.srcStageMask = src_stage;
+    barrier.srcAccessMask = src_access;
+    barrier.dstStageMask = dst_stage;
+    barrier.dstAccessMask = dst_access;
+    VkDependencyInfo dependency_info{};
+    dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependency_info.memoryBarrierCount = 1;
+    dependency_info.pMemoryBarriers = &barrier;
+    vkCmdPipelineBarrier2(cmd, &dependency_info);
+}
 
-    // command buffer recording is complete
-    VKCHECK(vkEndCommandBuffer(globals.cmd_buf));
+// everything that writes the depth buffer, multisample resolves into it happen in the color attachment output stage
+constexpr VkPipelineStageFlags2 DEPTH_WRITE_STAGES =
+    VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+constexpr VkAccessFlags2 DEPTH_WRITE_ACCESS = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+
+// DrawList pipeline ids
+enum class DrawPipeline : uint32_t {
+    VertexPulling,
+    VertexInput,
+    MeshShading,
+};
+
+// DrawList passes, recorded in this order
+enum class DrawPass : uint32_t {
+    Color,
+};
+
+// Tracks what is bound while a command buffer is recorded so binds that would change nothing are skipped, and counts the rest.
+struct CommandState {
+    VkCommandBuffer cmd = VK_NULL_HANDLE;
+    std::array<VkPipeline, 2> pipelines{};         // per bind point, graphics then compute
+    std::array<VkPipelineLayout, 2> set_layouts{}; // the frame set was last bound with, layouts with other push constants are not compatible
+    VkBuffer index_buffer = VK_NULL_HANDLE;
+    VkBuffer vertex_buffer = VK_NULL_HANDLE;
+    bool depth_mode_set = false; // with extended dynamic state, the depth state of depth_mode is set
+    DepthMode depth_mode = DepthMode::TestAndWrite;
+    DrawCounters counters{};
+};
+
+static void bindPipeline(CommandState& state, VkPipelineBindPoint bind_point, VkPipeline pipeline)
+{
+    VkPipeline& bound = state.pipelines[bind_point == VK_PIPELINE_BIND_POINT_COMPUTE ? 1 : 0];
+    if (bound == pipeline) return;
+    vkCmdBindPipeline(state.cmd, bind_point, pipeline);
+    bound = pipeline;
+    ++state.counters.pipeline_binds;
 }
 
-static void print(const std::string& text)
+// without extended dynamic state the pipeline bound for depth_mode already has it
+static void setDepthMode(CommandState& state, DepthMode depth_mode)
 {
-#ifndef NDEBUG
-    if (WriteConsoleA(GetStdHandle(STD_OUTPUT_HANDLE), text.c_str(), static_cast<DWORD>(text.length()), NULL, NULL) == FALSE)
-        throw Error("Failed to write to console");
-#else
-    (void)text;
-#endif
+    if (!globals.pipelines.extended_dynamic_state) return;
+    if (state.depth_mode_set && state.depth_mode == depth_mode) return;
+    recordDepthMode(state.cmd, depth_mode);
+    state.depth_mode_set = true;
+    state.depth_mode = depth_mode;
+    ++state.counters.depth_state_sets;
 }
 
-[[maybe_unused]] static void printDouble(double d)
+// the frame set's dynamic offset is the same for the whole frame, so only the layout can differ
+static void bindFrameSet(CommandState& state, VkPipelineBindPoint bind_point, VkPipelineLayout layout, uint32_t constants_offset)
 {
-    std::array<char, 64> buf{};
-    snprintf(buf.data(), buf.size(), "%f\n", d);
-    print(buf.data());
+    VkPipelineLayout& bound = state.set_layouts[bind_point == VK_PIPELINE_BIND_POINT_COMPUTE ? 1 : 0];
+    if (bound == layout) return;
+    vkCmdBindDescriptorSets(state.cmd, bind_point, layout, 0, 1, &globals.frame_set, 1, &constants_offset);
+    bound = layout;
+    ++state.counters.descriptor_binds;
 }
 
-[[maybe_unused]] static void printInt64(int64_t i)
+// the scene mesh is the only mesh, so its buffer never needs binding twice
+static void bindMeshBuffers(CommandState& state, bool vertex_input)
 {
-    std::array<char, 64> buf{};
-    snprintf(buf.data(), buf.size(), "%" PRIi64 "\n", i);
-    print(buf.data());
+    const GpuMesh& mesh = globals.scene_mesh;
+    if (state.index_buffer != mesh.buffer.buffer) {
+        vkCmdBindIndexBuffer(state.cmd, mesh.buffer.buffer, mesh.indices_offset, VK_INDEX_TYPE_UINT32);
+        state.index_buffer = mesh.buffer.buffer;
+    }
+    if (vertex_input && state.vertex_buffer != mesh.buffer.buffer) {
+        vkCmdBindVertexBuffers(state.cmd, 0, 1, &mesh.buffer.buffer, &mesh.vertices_offset);
+        state.vertex_buffer = mesh.buffer.buffer;
+    }
 }
 
-static void gameLoop()
+// keeps the triangles' proportions when the render target is not square
+static FrameConstants frameConstants(VkExtent2D extent)
 {
-    try {
+    FrameConstants constants{};
+    const float aspect = static_cast<float>(extent.width) / static_cast<float>(std::max(extent.height, 1u));
+    constants.view_proj[0] = aspect > 1.0f ? 1.0f / aspect : 1.0f;
+    constants.view_proj[5] = aspect < 1.0f ? aspect : 1.0f;
+    constants.view_proj[10] = 0.5f; // z from [-1, 1] to reversed Z's [0, 1], looking down -z so +z is nearest and has depth 1
+    constants.view_proj[14] = 0.5f;
+    constants.view_proj[15] = 1.0f;
+    return constants;
+}
 
-#ifndef NDEBUG
-        // create a console window for debugging
-        //if (AllocConsole() == FALSE) throw Error("AllocConsole() failure from render thread");
-#endif
+// the cluster culling path that will actually be used for the current scene
+static ClusterCulling clusterCullingPath()
+{
+    if (!globals.scene_mesh.has_meshlets) return ClusterCulling::Off;
+    if (globals.cluster_culling == ClusterCulling::MeshShader && globals.pipelines.mesh_shading[0] != VK_NULL_HANDLE) {
+        return ClusterCulling::MeshShader;
+    }
+    if (globals.cluster_culling != ClusterCulling::Off && globals.device.multiDrawIndirect) return ClusterCulling::Compute;
+    return ClusterCulling::Off;
+}
+
+// Meshlets are the only thing tested against the depth pyramid. With MSAA it is built from the depth resolved to the farthest sample.
+static bool occlusionCulling(ClusterCulling cluster_culling)
+{
+    return globals.occlusion_culling && cluster_culling != ClusterCulling::Off && globals.pipelines.depth_pyramid != VK_NULL_HANDLE &&
+           (globals.samples == VK_SAMPLE_COUNT_1_BIT || globals.device.depthResolveMin);
+}
 
-        constexpr int64_t FPS_LIMIT = 240;
-        constexpr auto FRAMETIME_LIMIT = std::chrono::nanoseconds(1'000'000'000LL / FPS_LIMIT);
+// the stages of the meshlet culling shaders that sample the depth pyramid
+static VkPipelineStageFlags2 cullStages()
+{
+    return VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | (globals.device.meshShader ? VK_PIPELINE_STAGE_2_TASK_SHADER_BIT_EXT : VK_PIPELINE_STAGE_2_NONE);
+}
 
-        auto begin_frame = std::chrono::steady_clock::now();
-        auto end_frame = begin_frame + FRAMETIME_LIMIT;
+// every submesh's meshlets for every instance, the most recordMeshletCulling() can write
+static VkDeviceSize meshletDrawCount()
+{
+    VkDeviceSize meshlet_count = 0;
+    for (const SubMesh& submesh : globals.scene_mesh.submeshes) {
+        meshlet_count += submesh.meshlet_count;
+    }
+    return meshlet_count * globals.instance_count;
+}
 
-        while (globals.running) {
+// Writes frame.meshlet_draws, submesh after submesh, in the same order as the draws it replaces.
+// Covers the whole draw list, each batch then draws its own rows of every submesh's commands.
+static void recordMeshletCulling(CommandState& state, const FrameData& frame, uint32_t constants_offset, VkDeviceAddress draw_entities,
+                                 uint32_t draw_count, OcclusionPhase occlusion_phase)
+{
+    const VkCommandBuffer cmd = state.cmd;
+    const GpuMesh& mesh = globals.scene_mesh;
+    bindPipeline(state, VK_PIPELINE_BIND_POINT_COMPUTE, globals.pipelines.meshlet_cull);
+    bindFrameSet(state, VK_PIPELINE_BIND_POINT_COMPUTE, globals.pipelines.meshlet_cull_layout, constants_offset);
 
-            auto last_begin_frame = begin_frame;
-            begin_frame = std::chrono::steady_clock::now();
+    MeshletCullConstants constants{};
+    constants.draw_params = globals.entity_buffer.address;
+    constants.draw_entities = draw_entities;
+    constants.meshlets = mesh.buffer.address + mesh.meshlets_offset;
+    constants.occlusion_phase = occlusion_phase;
+    VkDeviceSize first_command = 0; // the occlusion flags are laid out like the commands
+    const uint32_t max_rows = globals.device.properties.limits.maxComputeWorkGroupCount[1];
+    for (const SubMesh& submesh : mesh.submeshes) {
+        constants.first_meshlet = submesh.first_meshlet;
+        constants.meshlet_count = submesh.meshlet_count;
+        constants.vertex_offset = submesh.vertex_offset;
+        for (uint32_t first = 0; first < draw_count; first += max_rows) {
+            const VkDeviceSize command = first_command + VkDeviceSize{submesh.meshlet_count} * first;
+            constants.commands = frame.meshlet_draws.address + command * DRAW_COMMAND_SIZE;
+            constants.occlusion = occlusion_phase == OcclusionPhase::Off ? 0 : frame.occlusion_flags.address + command * sizeof(uint32_t);
+            constants.first_instance = first;
+            vkCmdPushConstants(cmd, globals.pipelines.meshlet_cull_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+            vkCmdDispatch(cmd, (submesh.meshlet_count + MESHLET_CULL_WORKGROUP_SIZE - 1) / MESHLET_CULL_WORKGROUP_SIZE,
+                          std::min(max_rows, draw_count - first), 1);
+        }
+        first_command += VkDeviceSize{submesh.meshlet_count} * draw_count;
+    }
 
-            [[maybe_unused]] const double dt = std::chrono::duration<double>(begin_frame - last_begin_frame).count();
+    memoryBarrier(cmd, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,
+                  VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT);
+}
 
-            end_frame = begin_frame + FRAMETIME_LIMIT;
+static void recordMeshShaderDraws(CommandState& state, const FrameData& frame, uint32_t constants_offset, VkDeviceAddress draw_entities,
+                                  uint32_t draw_count, const DrawBatch& batch, DepthMode depth_mode, OcclusionPhase occlusion_phase)
+{
+    const GpuMesh& mesh = globals.scene_mesh;
+    bindPipeline(state, VK_PIPELINE_BIND_POINT_GRAPHICS, globals.pipelines.mesh_shading[static_cast<size_t>(depth_mode)]);
+    setDepthMode(state, depth_mode);
+    bindFrameSet(state, VK_PIPELINE_BIND_POINT_GRAPHICS, globals.pipelines.mesh_shading_layout, constants_offset);
+
+    MeshShadingConstants constants{};
+    constants.draw_params = globals.entity_buffer.address;
+    constants.draw_entities = draw_entities;
+    constants.vertices = mesh.buffer.address + mesh.vertices_offset;
+    constants.meshlets = mesh.buffer.address + mesh.meshlets_offset;
+    constants.meshlet_vertices = mesh.buffer.address + mesh.meshlet_vertices_offset;
+    constants.meshlet_triangles = mesh.buffer.address + mesh.meshlet_triangles_offset;
+    constants.occlusion_phase = occlusion_phase;
 
-            // calculate delta time
+    // the smallest maxTaskWorkGroupCount and maxTaskWorkGroupTotalCount the extension allows
+    constexpr uint32_t MAX_TASK_WORKGROUPS = 65535;
+    constexpr uint32_t MAX_TASK_WORKGROUPS_TOTAL = 1u << 22;
+    VkDeviceSize first_flag = 0; // each submesh's occlusion flags cover every draw in the list
+    for (const SubMesh& submesh : mesh.submeshes) {
+        constants.occlusion = occlusion_phase == OcclusionPhase::Off ? 0 : frame.occlusion_flags.address + first_flag * sizeof(uint32_t);
+        first_flag += VkDeviceSize{submesh.meshlet_count} * draw_count;
+        constants.position_scale = submesh.position_scale;
+        constants.first_meshlet = submesh.first_meshlet;
+        constants.meshlet_count = submesh.meshlet_count;
+        constants.vertex_offset = submesh.vertex_offset;
+        const uint32_t columns = (submesh.meshlet_count + TASK_WORKGROUP_SIZE - 1) / TASK_WORKGROUP_SIZE;
+        const uint32_t max_rows = std::min(MAX_TASK_WORKGROUPS, MAX_TASK_WORKGROUPS_TOTAL / columns);
+        for (uint32_t first = 0; first < batch.count; first += max_rows) {
+            constants.first_instance = batch.first + first;
+            vkCmdPushConstants(state.cmd, globals.pipelines.mesh_shading_layout, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT, 0,
+                               sizeof(constants), &constants);
+            vkCmdDrawMeshTasksEXT(state.cmd, columns, std::min(max_rows, batch.count - first), 1);
+            ++state.counters.draws;
+        }
+    }
+}
 
+static float wrapAngle(double angle) { return static_cast<float>(std::fmod(angle, 6.283185307179586)); }
 
-            VkResult res{};
+// every position is within position_scale of the origin on each axis
+static float meshRadius()
+{
+    float position_scale = 0.0f;
+    for (const SubMesh& submesh : globals.scene_mesh.submeshes) {
+        position_scale = std::max(position_scale, submesh.position_scale);
+    }
+    return position_scale * 1.7320508f; // sqrt(3)
+}
 
-            // wait until previous frame's rendering has finished
-            // this fence is signalled when the last frame's command buffer finishes execution.
-            VKCHECK(vkWaitForFences(globals.device.device, 1, &globals.fence, VK_TRUE, UINT64_MAX));
-            VKCHECK(vkResetFences(globals.device.device, 1, &globals.fence));
+// 2 pi over the golden ratio spreads the phases evenly
+static double fieldPhase(uint32_t i) { return std::fmod(3.883222077450933 * i, 6.283185307179586); }
 
-            uint32_t image_index = 0;
-            res =
-                vkAcquireNextImageKHR(globals.device.device, globals.swapchain.swapchain, UINT64_MAX, globals.present_semaphore, VK_NULL_HANDLE, &image_index);
-            if (res != VK_SUCCESS && res != VK_SUBOPTIMAL_KHR) throw Error("Failed to acquire swapchain image");
+// where group entity g sits when it is not drifting, the grid is centred on the origin
+static std::array<float, 2> fieldGroupCentre(uint32_t group)
+{
+    const float half_width = 0.5f * FIELD_SPACING * static_cast<float>(globals.field_side - 1);
+    const float group_offset = 0.5f * static_cast<float>(FIELD_GROUP_SIDE - 1);
+    return {(static_cast<float>((group % globals.field_group_side) * FIELD_GROUP_SIDE) + group_offset) * FIELD_SPACING - half_width,
+            (static_cast<float>((group / globals.field_group_side) * FIELD_GROUP_SIDE) + group_offset) * FIELD_SPACING - half_width};
+}
 
-            recordCommandBuffer(image_index, dt);
+// Group entities first, then the instances as their children, so the instances' ids are contiguous.
+static void createFieldEntities(float radius)
+{
+    EntityStore& store = globals.entities;
+    const uint32_t count = globals.instance_count;
+    globals.field_side = std::max(1u, static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count)))));
+    globals.field_group_side = (globals.field_side + FIELD_GROUP_SIDE - 1) / FIELD_GROUP_SIDE;
+    const uint32_t group_rows = ((count + globals.field_side - 1) / globals.field_side + FIELD_GROUP_SIDE - 1) / FIELD_GROUP_SIDE;
+    const uint32_t group_count = globals.field_group_side * group_rows;
+    const float scale = radius > 0.0f ? FIELD_INSTANCE_RADIUS / radius : 1.0f;
 
-            // submit rendering commands
-            VkSubmitInfo submitInfo{};
-            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-            submitInfo.pNext = nullptr;
-            submitInfo.waitSemaphoreCount = 1;
-            submitInfo.pWaitSemaphores = &globals.present_semaphore;
-            constexpr VkPipelineStageFlags semaphore_wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-            submitInfo.pWaitDstStageMask = &semaphore_wait_stage;
-            submitInfo.commandBufferCount = 1;
-            submitInfo.pCommandBuffers = &globals.cmd_buf;
-            submitInfo.signalSemaphoreCount = 1;
-            submitInfo.pSignalSemaphores = &globals.render_semaphore;
-            VKCHECK(vkQueueSubmit(globals.device.queue, 1, &submitInfo, globals.fence));
+    for (uint32_t group = 0; group < group_count; ++group) {
+        const std::array<float, 2> centre = fieldGroupCentre(group);
+        createEntity(store, ENTITY_NONE, LocalTransform{{centre[0], centre[1], 0.0f}, 0.0f, 1.0f}, ENTITY_NONE, 0, 0.0f);
+        if (group % FIELD_MOVING_GROUP_INTERVAL == 0) globals.animated_entities.push_back(group);
+    }
 
-            // present
-            VkPresentInfoKHR presentInfo{};
-            presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-            presentInfo.pNext = nullptr;
-            presentInfo.waitSemaphoreCount = 1;
-            presentInfo.pWaitSemaphores = &globals.render_semaphore;
-            presentInfo.swapchainCount = 1;
-            presentInfo.pSwapchains = &globals.swapchain.swapchain;
-            presentInfo.pImageIndices = &image_index;
-            presentInfo.pResults = nullptr;
-            res = vkQueuePresentKHR(globals.device.queue, &presentInfo);
-            if (res != VK_SUCCESS && res != VK_SUBOPTIMAL_KHR) throw Error("Failed to present swapchain image");
+    const float group_offset = 0.5f * static_cast<float>(FIELD_GROUP_SIDE - 1);
+    for (uint32_t i = 0; i < count; ++i) {
+        const uint32_t x = i % globals.field_side;
+        const uint32_t y = i / globals.field_side;
+        const uint32_t group = (y / FIELD_GROUP_SIDE) * globals.field_group_side + x / FIELD_GROUP_SIDE;
+        const LocalTransform local{{(static_cast<float>(x % FIELD_GROUP_SIDE) - group_offset) * FIELD_SPACING,
+                                    (static_cast<float>(y % FIELD_GROUP_SIDE) - group_offset) * FIELD_SPACING, 0.0f},
+                                   wrapAngle(fieldPhase(i)), scale};
+        const uint32_t entity = createEntity(store, group, local, 0, 0, radius);
+        globals.renderable_entities.push_back(entity);
+        if (group % FIELD_MOVING_GROUP_INTERVAL == 0) globals.animated_entities.push_back(entity);
+    }
+    globals.first_instance_entity = group_count;
+}
 
-            std::this_thread::sleep_until(end_frame);
+// Sets the local transform of everything that moves, updateEntityTransforms() takes it from there.
+static void animateScene()
+{
+    EntityStore& store = globals.entities;
+    for (uint32_t entity : globals.animated_entities) {
+        LocalTransform local = store.local[entity];
+        if (globals.layout == SceneLayout::Ring) {
+            // spread evenly around the circle
+            local.rotation = wrapAngle(globals.current_time + (6.283185307179586 * entity) / globals.instance_count);
+        }
+        else if (store.mesh[entity] == ENTITY_NONE) {
+            // a moving group drifts around its cells, carrying its instances with it
+            const double angle = 0.5 * globals.current_time + fieldPhase(entity);
+            const std::array<float, 2> centre = fieldGroupCentre(entity);
+            local.translation[0] = centre[0] + FIELD_DRIFT * static_cast<float>(std::cos(angle));
+            local.translation[1] = centre[1] + FIELD_DRIFT * static_cast<float>(std::sin(angle));
         }
+        else {
+            // and its instances spin in place
+            local.rotation = wrapAngle(globals.current_time + fieldPhase(entity - globals.first_instance_entity));
+        }
+        setLocalTransform(store, entity, local);
     }
-    catch (const Error& error) {
-        MessageBoxA(NULL, error.what(), "Application Error!", MB_OK | MB_ICONERROR);
-        abort();
+}
+
+// view_proj is orthographic and only scales x and y so far, so a click is a ray straight down -z from the nearest depth (z = 1)
+static void pickInstance(const FrameConstants& constants)
+{
+    const VkExtent2D extent = globals.swapchain.extent;
+    const float ndc_x = 2.0f * (static_cast<float>(globals.pick_x) + 0.5f) / static_cast<float>(extent.width) - 1.0f;
+    const float ndc_y = 2.0f * (static_cast<float>(globals.pick_y) + 0.5f) / static_cast<float>(extent.height) - 1.0f;
+    const std::array<float, 3> origin{ndc_x / constants.view_proj[0], -ndc_y / constants.view_proj[5], 1.0f}; // the shaders flip y
+    const std::array<float, 3> direction{0.0f, 0.0f, -1.0f};
+
+    uint32_t item = 0;
+    float t = 0.0f;
+    std::array<char, 64> buf{};
+    if (pickBvh(globals.instance_bvh, origin.data(), direction.data(), 2.0f, item, t)) {
+        snprintf(buf.data(), buf.size(), "picked entity %u\n", globals.first_instance_entity + item);
     }
+    else {
+        snprintf(buf.data(), buf.size(), "picked nothing\n");
+    }
+    printDebug(buf.data());
 }
 
-void initApp(HINSTANCE hInstance, HWND hWnd)
+// Refits the instance BVH around whatever moved this frame, then collects the entities whose bounds are in view.
+static void cullFieldInstances(const FrameConstants& constants, ArenaVector<uint32_t>& visible)
 {
+    const EntityStore& store = globals.entities;
+    Bvh& bvh = globals.instance_bvh;
+    const uint32_t first = globals.first_instance_entity;
+    for (uint32_t entity : store.changed) {
+        if (entity >= first) updateBvhItem(bvh, entity - first, store.bounds[entity]);
+    }
+    refitBvh(bvh);
 
-    { // instance creation
-        if (volkInitialize() != VK_SUCCESS) {
-            throw Error("Failed to initialise Volk");
+    if (globals.pick_requested) {
+        pickInstance(constants);
+        globals.pick_requested = false;
+    }
+
+    globals.visible_instances.clear();
+    queryBvh(bvh, frustumFromViewProj(constants.view_proj), globals.visible_instances);
+    size_t visible_count = 0;
+    for (const BvhRange& range : globals.visible_instances) {
+        visible_count += range.count;
+    }
+    visible.reserve(visible_count);
+    for (const BvhRange& range : globals.visible_instances) {
+        for (uint32_t i = range.first; i < range.first + range.count; ++i) {
+            visible.push_back(first + bvh.items[i]);
         }
+    }
+}
 
-        globals.instance = initVulkanInstance();
+// Copies the world transforms updateEntityTransforms() recomputed into the entity buffer, or all of them after uploadAllEntities().
+static VulkanStatus recordEntityUpload(VkCommandBuffer cmd, FrameArena& arena)
+{
+    const EntityStore& store = globals.entities;
+    const EntityRange all{0, static_cast<uint32_t>(store.world.size())};
+    const std::span<const EntityRange> ranges = globals.upload_all_entities ? std::span<const EntityRange>(&all, 1) : store.changed_ranges;
+    globals.upload_all_entities = false;
+    if (ranges.empty() || all.count == 0) return VulkanStatus{};
 
-        volkLoadInstance(globals.instance);
+    VkDeviceSize size = 0;
+    for (const EntityRange& range : ranges) {
+        size += sizeof(WorldTransform) * range.count;
+    }
+    StreamAllocation allocation{};
+    // drawFrame() grew the region to fit every entity, this is out of memory only if that invariant broke
+    if (!streamAllocate(globals.stream, size, allocation)) VKTRY(VK_ERROR_OUT_OF_DEVICE_MEMORY);
 
-        if (volkGetInstanceVersion() < VK_API_VERSION_1_3) {
-            throw Error("Unsupported Vulkan version. Need at least Vulkan 1.3.");
-        }
+    ArenaVector<VkBufferCopy> regions{ArenaAllocator<VkBufferCopy>(arena)};
+    regions.reserve(ranges.size());
+    VkDeviceSize offset = 0;
+    for (const EntityRange& range : ranges) {
+        const VkDeviceSize range_size = sizeof(WorldTransform) * range.count;
+        memcpy(static_cast<std::byte*>(allocation.data) + offset, &store.world[range.first], range_size);
+        regions.push_back(VkBufferCopy{allocation.offset + offset, sizeof(WorldTransform) * range.first, range_size});
+        offset += range_size;
     }
 
-    { // device creation
-        globals.device = createVulkanDevice(globals.instance);
-        volkLoadDevice(globals.device.device);
+    VkPipelineStageFlags2 read_stages = VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    if (globals.device.meshShader) read_stages |= VK_PIPELINE_STAGE_2_TASK_SHADER_BIT_EXT | VK_PIPELINE_STAGE_2_MESH_SHADER_BIT_EXT;
+
+    // earlier frames may still be reading what is overwritten
+    memoryBarrier(cmd, read_stages, 0, VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT);
+    vkCmdCopyBuffer(cmd, globals.stream.buffer, globals.entity_buffer.buffer, static_cast<uint32_t>(regions.size()), regions.data());
+    memoryBarrier(cmd, VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, read_stages, VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+    return VulkanStatus{};
+}
+
+// Every submesh of the batch's draws, as one instanced draw each, the visible meshlets' indirect draws or mesh task draws.
+static void recordBatch(CommandState& state, const FrameData& frame, const DrawBatch& batch, uint32_t constants_offset, VkDeviceAddress draw_entities,
+                        uint32_t draw_count, ClusterCulling cluster_culling, DepthMode depth_mode, OcclusionPhase occlusion_phase)
+{
+    const DrawPipeline pipeline = static_cast<DrawPipeline>(drawKeyPipeline(batch.key));
+    if (pipeline == DrawPipeline::MeshShading) {
+        recordMeshShaderDraws(state, frame, constants_offset, draw_entities, draw_count, batch, depth_mode, occlusion_phase);
+        return;
     }
 
-    { // swapchain creation
-        createVulkanSwapchain(globals.instance, globals.device, hInstance, hWnd, globals.swapchain);
+    const GpuMesh& mesh = globals.scene_mesh;
+    const bool vertex_input = pipeline == DrawPipeline::VertexInput;
+    const size_t mode = static_cast<size_t>(depth_mode);
+    bindPipeline(state, VK_PIPELINE_BIND_POINT_GRAPHICS, vertex_input ? globals.pipelines.vertex_input[mode] : globals.pipelines.vertex_pulling[mode]);
+    setDepthMode(state, depth_mode);
+    bindMeshBuffers(state, vertex_input);
+    bindFrameSet(state, VK_PIPELINE_BIND_POINT_GRAPHICS, globals.pipelines.layout, constants_offset);
+
+    PushConstants push_constants{};
+    push_constants.draw_params = globals.entity_buffer.address;
+    push_constants.draw_entities = draw_entities;
+    push_constants.vertices = mesh.buffer.address + mesh.vertices_offset;
+
+    // the shader finds each draw's entity with gl_InstanceIndex
+    VkDeviceSize meshlet_draws_offset = 0;
+    const uint32_t max_draw_count = globals.device.properties.limits.maxDrawIndirectCount;
+    for (const SubMesh& submesh : mesh.submeshes) {
+        push_constants.position_scale = submesh.position_scale;
+        vkCmdPushConstants(state.cmd, globals.pipelines.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, PUSH_CONSTANT_SIZE, &push_constants);
+        if (cluster_culling == ClusterCulling::Compute) {
+            // culled meshlets are draws with no instances, the submesh's commands hold meshlet_count for each draw in the list
+            const uint32_t command_count = submesh.meshlet_count * batch.count;
+            const VkDeviceSize batch_offset = meshlet_draws_offset + VkDeviceSize{submesh.meshlet_count} * batch.first * DRAW_COMMAND_SIZE;
+            for (uint32_t first = 0; first < command_count; first += max_draw_count) {
+                vkCmdDrawIndexedIndirect(state.cmd, frame.meshlet_draws.buffer, batch_offset + first * DRAW_COMMAND_SIZE,
+                                         std::min(max_draw_count, command_count - first), static_cast<uint32_t>(DRAW_COMMAND_SIZE));
+                ++state.counters.draws;
+            }
+            meshlet_draws_offset += VkDeviceSize{submesh.meshlet_count} * draw_count * DRAW_COMMAND_SIZE;
+        }
+        else {
+            vkCmdDrawIndexed(state.cmd, submesh.index_count, batch.count, submesh.first_index, submesh.vertex_offset, batch.first);
+            ++state.counters.draws;
+        }
     }
+}
 
-    { // create command pool
-        // command buffers in this pool will be reset after they have finished execution.
-        // 2 command buffers will be used.
-        // This allows the next frame's command buffer to be recorded while the previous frame cmd buffer is still being executed
-        VkCommandPoolCreateInfo cmd_pool_info{};
-        cmd_pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-        cmd_pool_info.flags = 0;
-        cmd_pool_info.queueFamilyIndex = 0;
-        VKCHECK(vkCreateCommandPool(globals.device.device, &cmd_pool_info, nullptr, &globals.cmd_pool));
+// The prepass lays down the nearest depth of every pixel, so the color pass only shades the fragments that end up visible.
+// Both passes record the same batches, the meshlets culled for this phase are drawn by each.
+static void recordBatches(CommandState& state, const FrameData& frame, const DrawList& draw_list, uint32_t constants_offset,
+                          VkDeviceAddress draw_entities, ClusterCulling cluster_culling, OcclusionPhase occlusion_phase)
+{
+    const uint32_t draw_count = static_cast<uint32_t>(draw_list.entities.size());
+    if (globals.depth_prepass) {
+        for (const DrawBatch& batch : draw_list.batches) {
+            recordBatch(state, frame, batch, constants_offset, draw_entities, draw_count, cluster_culling, DepthMode::Prepass, occlusion_phase);
+        }
+    }
+    const DepthMode color_depth_mode = globals.depth_prepass ? DepthMode::Equal : DepthMode::TestAndWrite;
+    for (const DrawBatch& batch : draw_list.batches) {
+        recordBatch(state, frame, batch, constants_offset, draw_entities, draw_count, cluster_culling, color_depth_mode, occlusion_phase);
     }
+}
+
+// first clears, otherwise what an earlier rendering drew is loaded. last is the frame's last rendering of the scene, keep_depth
+// keeps the depth buffer for the pyramid. With MSAA the multisampled attachments are drawn to instead, the last rendering resolves
+// the color into color_view and keep_depth resolves the depth into the depth buffer.
+// Only the top left render_extent of the color view and the depth buffer is drawn to.
+static void beginRendering(VkCommandBuffer cmd, VkImageView color_view, VkExtent2D render_extent, bool first, bool last, bool keep_depth)
+{
+    const bool msaa = globals.samples != VK_SAMPLE_COUNT_1_BIT;
+    // a later rendering loads the multisampled attachments, after the last only what was resolved out of them is used
+    const VkAttachmentStoreOp msaa_store = last ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+    const bool resolve_color = msaa && last;
+    const bool resolve_depth = msaa && keep_depth;
 
-    { // create command buffers
-        VkCommandBufferAllocateInfo cmd_buf_info{};
-        cmd_buf_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        cmd_buf_info.commandPool = globals.cmd_pool;
-        cmd_buf_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        cmd_buf_info.commandBufferCount = 1;
-        VKCHECK(vkAllocateCommandBuffers(globals.device.device, &cmd_buf_info, &globals.cmd_buf));
+    VkRenderingAttachmentInfo colorAttachment{};
+    colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    colorAttachment.pNext = nullptr;
+    colorAttachment.imageView = msaa ? globals.msaa_color.view : color_view;
+    colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.resolveMode = resolve_color ? VK_RESOLVE_MODE_AVERAGE_BIT : VK_RESOLVE_MODE_NONE;
+    colorAttachment.resolveImageView = resolve_color ? color_view : VK_NULL_HANDLE;
+    colorAttachment.resolveImageLayout = resolve_color ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+    colorAttachment.loadOp = first ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+    colorAttachment.storeOp = msaa ? msaa_store : VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.clearValue.color.float32[0] = globals.live.clear_color[0];
+    colorAttachment.clearValue.color.float32[1] = globals.live.clear_color[1];
+    colorAttachment.clearValue.color.float32[2] = globals.live.clear_color[2];
+    colorAttachment.clearValue.color.float32[3] = globals.live.clear_color[3];
+    VkRenderingAttachmentInfo depthAttachment{};
+    depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    depthAttachment.pNext = nullptr;
+    depthAttachment.imageView = msaa ? globals.msaa_depth.view : globals.depth_image.view;
+    depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.resolveMode = resolve_depth ? VK_RESOLVE_MODE_MIN_BIT : VK_RESOLVE_MODE_NONE; // reversed Z, the farthest sample
+    depthAttachment.resolveImageView = resolve_depth ? globals.depth_image.view : VK_NULL_HANDLE;
+    depthAttachment.resolveImageLayout = resolve_depth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.loadOp = first ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+    if (msaa) {
+        depthAttachment.storeOp = msaa_store;
+    }
+    else {
+        // otherwise only used within the frame
+        depthAttachment.storeOp = keep_depth || !last ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
     }
+    depthAttachment.clearValue.depthStencil.depth = 0.0f; // reversed Z, 0 is the far plane
+    depthAttachment.clearValue.depthStencil.stencil = 0;
+    VkRenderingInfo renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+    renderingInfo.pNext = nullptr;
+    renderingInfo.flags = 0;
+    renderingInfo.renderArea = VkRect2D{VkOffset2D{0, 0}, render_extent};
+    renderingInfo.layerCount = 1;
+    renderingInfo.viewMask = 0;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachments = &colorAttachment;
+    renderingInfo.pDepthAttachment = &depthAttachment;
+    renderingInfo.pStencilAttachment = nullptr;
+    vkCmdBeginRendering(cmd, &renderingInfo);
+}
 
-    // create the fence and semaphores
-    VkFenceCreateInfo fence_info{};
-    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fence_info.pNext = nullptr;
-    fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT; // for first frame fence must be signalled otherwise app will wait forever
-    VKCHECK(vkCreateFence(globals.device.device, &fence_info, nullptr, &globals.fence));
+// Rebuilds the depth pyramid from the depth buffer as the first occlusion phase left it, between the two renderings.
+static void recordDepthPyramidBuild(CommandState& state, VkExtent2D render_extent)
+{
+    const VkCommandBuffer cmd = state.cmd;
+    const DepthPyramid& pyramid = globals.depth_pyramid;
+    const VkImageAspectFlags depth_aspect = depthFormatAspect(globals.depth_image.format);
+
+    imageBarrier(cmd, globals.depth_image.image, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+                 DEPTH_WRITE_STAGES, DEPTH_WRITE_ACCESS, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, depth_aspect);
+    // the first phase's culling and the last frame's second phase are done reading the old pyramid, and the last build its counter
+    imageBarrier(cmd, pyramid.image.image, globals.depth_pyramid_built ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+                 cullStages(), 0, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT,
+                 VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+    vkCmdFillBuffer(cmd, pyramid.counter.buffer, 0, sizeof(uint32_t), 0);
+    memoryBarrier(cmd, VK_PIPELINE_STAGE_2_CLEAR_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                  VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
 
-    VkSemaphoreCreateInfo semaphore_info{};
-    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-    semaphore_info.pNext = nullptr;
-    semaphore_info.flags = 0;
-    VKCHECK(vkCreateSemaphore(globals.device.device, &semaphore_info, nullptr, &globals.render_semaphore));
-    VKCHECK(vkCreateSemaphore(globals.device.device, &semaphore_info, nullptr, &globals.present_semaphore));
+    // its own set 0, so the frame set has to be bound again afterwards
+    bindPipeline(state, VK_PIPELINE_BIND_POINT_COMPUTE, globals.pipelines.depth_pyramid);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, globals.pipelines.depth_pyramid_layout, 0, 1, &globals.depth_pyramid_set, 0, nullptr);
+    state.set_layouts[1] = VK_NULL_HANDLE;
+    ++state.counters.descriptor_binds;
 
-    globals.pipeline =
-        createPipelineAndLayout(globals.device.device, globals.swapchain.surface_format.format, globals.swapchain.extent, globals.pipeline_layout);
+    const VkExtent2D dispatch = depthPyramidDispatchSize(pyramid);
+    DepthPyramidConstants constants{};
+    constants.counter = pyramid.counter.address;
+    constants.depth_extent[0] = render_extent.width; // the rest of the depth buffer is not drawn to
+    constants.depth_extent[1] = render_extent.height;
+    constants.extent[0] = pyramid.image.extent.width;
+    constants.extent[1] = pyramid.image.extent.height;
+    constants.level_count = pyramid.image.levels;
+    constants.workgroup_count = dispatch.width * dispatch.height;
+    vkCmdPushConstants(cmd, globals.pipelines.depth_pyramid_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+    vkCmdDispatch(cmd, dispatch.width, dispatch.height, 1);
+
+    memoryBarrier(cmd, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, cullStages(), VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+    imageBarrier(cmd, globals.depth_image.image, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                 VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, 0, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+                 VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, depth_aspect);
+    globals.depth_pyramid_built = true;
 }
 
-void startGameLoop()
+// the scaled extent the scene is drawn at this frame, the whole swapchain extent without dynamic resolution
+static VkExtent2D renderExtent()
 {
-    globals.running.store(true);
-    globals.loop_thread = std::make_unique<std::thread>(gameLoop);
+    const VkExtent2D extent = globals.swapchain.extent;
+    if (globals.render_target.image == VK_NULL_HANDLE) return extent;
+    VkExtent2D scaled{};
+    scaledExtent(extent.width, extent.height, globals.resolution.scale, scaled.width, scaled.height);
+    return scaled;
 }
 
-void endLoopAndShutdown()
+// Stretches the drawn part of the render target over the whole swapchain image, which is left in TRANSFER_DST_OPTIMAL.
+static void recordUpscale(VkCommandBuffer cmd, VkImage swapchain_image, VkExtent2D render_extent)
 {
-    globals.running.store(false);
-    globals.loop_thread->join();
+    imageBarrier(cmd, globals.render_target.image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                 VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_2_BLIT_BIT,
+                 VK_ACCESS_2_TRANSFER_READ_BIT);
+    // chains with the semaphore wait like the color attachment barrier it replaces
+    imageBarrier(cmd, swapchain_image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, 0,
+                 VK_PIPELINE_STAGE_2_BLIT_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT);
 
-    vkDeviceWaitIdle(globals.device.device);
+    const VkExtent2D extent = globals.swapchain.extent;
+    VkImageBlit2 region{};
+    region.sType = VK_STRUCTURE_TYPE_IMAGE_BLIT_2;
+    region.srcSubresource = VkImageSubresourceLayers{VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.srcOffsets[1] = VkOffset3D{static_cast<int32_t>(render_extent.width), static_cast<int32_t>(render_extent.height), 1};
+    region.dstSubresource = VkImageSubresourceLayers{VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.dstOffsets[1] = VkOffset3D{static_cast<int32_t>(extent.width), static_cast<int32_t>(extent.height), 1};
+    VkBlitImageInfo2 blit_info{};
+    blit_info.sType = VK_STRUCTURE_TYPE_BLIT_IMAGE_INFO_2;
+    blit_info.srcImage = globals.render_target.image;
+    blit_info.srcImageLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    blit_info.dstImage = swapchain_image;
+    blit_info.dstImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    blit_info.regionCount = 1;
+    blit_info.pRegions = &region;
+    blit_info.filter = globals.upscale_filter;
+    vkCmdBlitImage2(cmd, &blit_info);
+}
 
-    destroyPipelineAndLayout(globals.device.device, globals.pipeline, globals.pipeline_layout);
+// AntiAliasing::PostProcess with a render target that can be sampled
+static bool postProcessing() { return globals.anti_aliasing == AntiAliasing::PostProcess && globals.post_process_sampler != VK_NULL_HANDLE; }
 
-    vkDestroySemaphore(globals.device.device, globals.present_semaphore, nullptr);
-    vkDestroySemaphore(globals.device.device, globals.render_semaphore, nullptr);
-    vkDestroyFence(globals.device.device, globals.fence, nullptr);
-    vkDestroyCommandPool(globals.device.device, globals.cmd_pool, nullptr);
+// Filters the drawn part of the render target into the whole swapchain image, upscaling it as it goes. The swapchain image is left in
+// COLOR_ATTACHMENT_OPTIMAL.
+static void recordPostProcess(VkCommandBuffer cmd, VkImage swapchain_image, VkImageView swapchain_view, VkExtent2D render_extent)
+{
+    imageBarrier(cmd, globals.render_target.image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                 VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+                 VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+    // chains with the semaphore wait like the color attachment barrier it replaces
+    imageBarrier(cmd, swapchain_image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                 0, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
 
-    destroyVulkanSwapchain(globals.instance, globals.device, globals.swapchain);
-    destroyVulkanDevice(globals.device);
-    destroyVulkanInstance(globals.instance);
-}
\ No newline at end of file
+    const VkExtent2D extent = globals.swapchain.extent;
+    VkRenderingAttachmentInfo colorAttachment{};
+    colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    colorAttachment.imageView = swapchain_view;
+    colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.resolveMode = VK_RESOLVE_MODE_NONE;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE; // every pixel is written
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    VkRenderingInfo renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+    renderingInfo.renderArea = VkRect2D{VkOffset2D{0, 0}, extent};
+    renderingInfo.layerCount = 1;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachments = &colorAttachment;
+    vkCmdBeginRendering(cmd, &renderingInfo);
+
+    const VkViewport viewport{0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f};
+    const VkRect2D scissor{VkOffset2D{0, 0}, extent};
+    vkCmdSetViewport(cmd, 0, 1, &viewport);
+    vkCmdSetScissor(cmd, 0, 1, &scissor);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, globals.pipelines.post_process);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, globals.pipelines.post_process_layout, 0, 1, &globals.post_process_set, 0, nullptr);
+    const VkExtent2D target_extent = globals.render_target.extent;
+    PostProcessConstants constants{};
+    constants.uv_scale[0] = static_cast<float>(render_extent.width) / static_cast<float>(target_extent.width);
+    constants.uv_scale[1] = static_cast<float>(render_extent.height) / static_cast<float>(target_extent.height);
+    constants.texel_size[0] = 1.0f / static_cast<float>(target_extent.width);
+    constants.texel_size[1] = 1.0f / static_cast<float>(target_extent.height);
+    vkCmdPushConstants(cmd, globals.pipelines.post_process_layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(constants), &constants);
+    vkCmdDraw(cmd, 3, 1, 0, 0);
+    vkCmdEndRendering(cmd);
+}
+
+static VulkanStatus recordCommandBuffer(FrameData& frame, uint32_t image_index, double dt, bool capture_frame)
+{
+    globals.current_time += dt;
+
+    const VkImage swapchain_image = globals.swapchain.images[image_index].first;
+    const VkCommandBuffer cmd = frame.cmd_buf;
+    const FrameConstants frame_constants = frameConstants(globals.swapchain.extent);
+
+    // move the scene
+    animateScene();
+    updateEntityTransforms(globals.entities, *globals.jobs);
+
+    // what to draw
+    ArenaVector<uint32_t> visible{ArenaAllocator<uint32_t>(frame.arena)};
+    std::span<const uint32_t> visible_entities = globals.renderable_entities;
+    if (globals.layout == SceneLayout::Field && globals.instance_culling) {
+        cullFieldInstances(frame_constants, visible);
+        visible_entities = visible;
+    }
+
+    // sorted by the state each draw needs, so draws sharing it are recorded together as one batch
+    const ClusterCulling cluster_culling = clusterCullingPath();
+    DrawPipeline pipeline = globals.vertex_path == VertexPath::Pulling ? DrawPipeline::VertexPulling : DrawPipeline::VertexInput;
+    if (cluster_culling == ClusterCulling::MeshShader) pipeline = DrawPipeline::MeshShading;
+    DrawList& draw_list = globals.draw_list;
+    clearDrawList(draw_list);
+    addEntityDraws(draw_list, globals.entities, visible_entities, static_cast<uint32_t>(DrawPass::Color), static_cast<uint32_t>(pipeline),
+                   frame_constants.view_proj, *globals.jobs);
+    sortDrawList(draw_list, *globals.jobs);
+    const std::span<const uint32_t> draw_entities = draw_list.entities;
+    const uint32_t draw_count = static_cast<uint32_t>(draw_entities.size());
+
+    // upload it, drawFrame() made sure the stream buffer region is big enough
+    StreamAllocation constants_allocation{};
+    StreamAllocation draws_allocation{};
+    if (!streamAllocate(globals.stream, sizeof(FrameConstants), constants_allocation) ||
+        !streamAllocate(globals.stream, sizeof(uint32_t) * draw_entities.size(), draws_allocation)) {
+        VKTRY(VK_ERROR_OUT_OF_DEVICE_MEMORY);
+    }
+    memcpy(constants_allocation.data, &frame_constants, sizeof(FrameConstants));
+    memcpy(draws_allocation.data, draw_entities.data(), sizeof(uint32_t) * draw_entities.size());
+
+    // reset cmd buffer
+    VKTRY(vkResetCommandPool(globals.device.device, frame.cmd_pool, 0));
+
+    // record cmd buffer
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    beginInfo.pInheritanceInfo = nullptr;
+    VKTRY(vkBeginCommandBuffer(cmd, &beginInfo));
+
+    // before anything below reads a buffer's handle or address, and outside the timestamps so the copies are not counted as rendering
+    defragmentMemory(globals.device, cmd, globals.frame_number, globals.frames_in_flight, DEFRAGMENT_BYTES_PER_FRAME);
+
+    if (frame.timestamps != VK_NULL_HANDLE) vkCmdResetQueryPool(cmd, frame.timestamps, 0, 2);
+    frame.timestamps_written = frame.timestamps != VK_NULL_HANDLE;
+
+    beginDebugLabel(cmd, "entity upload");
+    const VulkanStatus upload_status = recordEntityUpload(cmd, frame.arena);
+    endDebugLabel(cmd);
+    if (!upload_status.ok()) return upload_status;
+
+    CommandState state{};
+    state.cmd = cmd;
+    const uint32_t constants_offset = static_cast<uint32_t>(constants_allocation.offset);
+    // nothing can be culled against a pyramid that has not been built yet, the second phase has nothing to re-test then
+    const bool occlusion = occlusionCulling(cluster_culling);
+    const OcclusionPhase first_phase = occlusion && globals.depth_pyramid_built ? OcclusionPhase::First : OcclusionPhase::Off;
+    if (cluster_culling == ClusterCulling::Compute) {
+        beginDebugLabel(cmd, "meshlet culling");
+        recordMeshletCulling(state, frame, constants_offset, draws_allocation.address, draw_count, first_phase);
+        endDebugLabel(cmd);
+    }
+
+    // Below the full extent the scene is drawn into the render target and upscaled into the swapchain image afterwards. The post
+    // process pass always reads it from the render target, and does the upscale itself.
+    const VkExtent2D render_extent = renderExtent();
+    const VkImageView swapchain_view = globals.swapchain.images[image_index].second;
+    const bool post_process = postProcessing();
+    const bool upscale = render_extent.width != globals.swapchain.extent.width || render_extent.height != globals.swapchain.extent.height;
+    const bool offscreen = post_process || upscale;
+    const VkImage color_image = offscreen ? globals.render_target.image : swapchain_image;
+    const VkImageView color_view = offscreen ? globals.render_target.view : swapchain_view;
+
+    // the same for every pipeline
+    const VkViewport viewport{0.0f, 0.0f, static_cast<float>(render_extent.width), static_cast<float>(render_extent.height), 0.0f, 1.0f};
+    const VkRect2D scissor{VkOffset2D{0, 0}, render_extent};
+    vkCmdSetViewport(cmd, 0, 1, &viewport);
+    vkCmdSetScissor(cmd, 0, 1, &scissor);
+    if (globals.pipelines.extended_dynamic_state) recordRasterState(cmd);
+
+    // transition the color attachment (or resolve target), the render target may still be being read by the last frame
+    imageBarrier(cmd, color_image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                 VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_2_BLIT_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, 0,
+                 VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT); // vkCmdRendering load op
+    // the last frame's depth is not needed, the previous frame's depth tests, resolve and pyramid build must finish before it is cleared
+    imageBarrier(cmd, globals.depth_image.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                 DEPTH_WRITE_STAGES | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, DEPTH_WRITE_ACCESS, DEPTH_WRITE_STAGES,
+                 VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | DEPTH_WRITE_ACCESS, depthFormatAspect(globals.depth_image.format));
+    if (globals.samples != VK_SAMPLE_COUNT_1_BIT) {
+        // what the scene is drawn into, only the last frame's renderings used them
+        imageBarrier(cmd, globals.msaa_color.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                     VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, 0, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                     VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+        imageBarrier(cmd, globals.msaa_depth.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, DEPTH_WRITE_STAGES, 0,
+                     VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+                     VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                     depthFormatAspect(globals.msaa_depth.format));
+    }
+
+    if (frame.timestamps != VK_NULL_HANDLE) vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, frame.timestamps, 0);
+    const bool second_rendering = first_phase == OcclusionPhase::First;
+    beginDebugLabel(cmd, "scene");
+    beginRendering(cmd, color_view, render_extent, true, !second_rendering, occlusion);
+    recordBatches(state, frame, draw_list, constants_offset, draws_allocation.address, cluster_culling, first_phase);
+    vkCmdEndRendering(cmd);
+    endDebugLabel(cmd);
+
+    if (occlusion) {
+        // the pyramid of what the first phase drew, both phases of the next frame test against it too
+        beginDebugLabel(cmd, "depth pyramid");
+        recordDepthPyramidBuild(state, render_extent);
+        endDebugLabel(cmd);
+
+        if (second_rendering) {
+            // the first phase's flags are read and its indirect draws overwritten
+            memoryBarrier(cmd, cullStages() | VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, cullStages(),
+                          VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+            if (cluster_culling == ClusterCulling::Compute) {
+                beginDebugLabel(cmd, "meshlet culling, second phase");
+                recordMeshletCulling(state, frame, constants_offset, draws_allocation.address, draw_count, OcclusionPhase::Second);
+                endDebugLabel(cmd);
+            }
+            // the multisampled depth is loaded as the first phase stored it, the single sampled depth buffer was made ready by the build
+            memoryBarrier(cmd, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+                          VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                          VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
+                              VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+                          VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+                              VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+
+            beginDebugLabel(cmd, "scene, second phase");
+            beginRendering(cmd, color_view, render_extent, false, true, false);
+            recordBatches(state, frame, draw_list, constants_offset, draws_allocation.address, cluster_culling, OcclusionPhase::Second);
+            vkCmdEndRendering(cmd);
+            endDebugLabel(cmd);
+        }
+    }
+    state.counters.batches = static_cast<uint32_t>(draw_list.batches.size());
+    globals.draw_counters = state.counters;
+
+    // where the swapchain image was last written
+    VkImageLayout swapchain_layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    VkPipelineStageFlags2 swapchain_stage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+    VkAccessFlags2 swapchain_access = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+    if (post_process) {
+        beginDebugLabel(cmd, "post process");
+        recordPostProcess(cmd, swapchain_image, swapchain_view, render_extent);
+        endDebugLabel(cmd);
+    }
+    else if (upscale) {
+        beginDebugLabel(cmd, "upscale");
+        recordUpscale(cmd, swapchain_image, render_extent);
+        endDebugLabel(cmd);
+        swapchain_layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        swapchain_stage = VK_PIPELINE_STAGE_2_BLIT_BIT;
+        swapchain_access = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    }
+    if (frame.timestamps != VK_NULL_HANDLE) vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, frame.timestamps, 1);
+
+    // offscreen images are left ready to be copied from, there is nothing to present them
+    const VkImageLayout final_layout = globals.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+    if (capture_frame) {
+        // copy the finished image into a readback buffer, it is read on the CPU once this frame has retired
+        imageBarrier(cmd, swapchain_image, swapchain_layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, swapchain_stage, swapchain_access,
+                     VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_READ_BIT);
+        beginDebugLabel(cmd, "capture");
+        recordCaptureCopy(globals.device, globals.capture, cmd, swapchain_image, globals.swapchain.extent, globals.frame_number);
+        endDebugLabel(cmd);
+        if (final_layout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+            imageBarrier(cmd, swapchain_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, final_layout, VK_PIPELINE_STAGE_2_COPY_BIT, 0,
+                         VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, 0); // semaphore takes care of this
+        }
+    }
+    else {
+        // make the swapchain image presentable (vkCmdRendering store op, resolve or the blit), the semaphore takes care of the dst stage
+        imageBarrier(cmd, swapchain_image, swapchain_layout, final_layout, swapchain_stage, swapchain_access, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                     0);
+    }
+
+    // command buffer recording is complete
+    VKTRY(vkEndCommandBuffer(cmd));
+    return VulkanStatus{};
+}
+
+[[maybe_unused]] static void printDouble(double d)
+{
+    std::array<char, 64> buf{};
+    snprintf(buf.data(), buf.size(), "%f\n", d);
+    printDebug(buf.data());
+}
+
+[[maybe_unused]] static void printInt64(int64_t i)
+{
+    std::array<char, 64> buf{};
+    snprintf(buf.data(), buf.size(), "%" PRIi64 "\n", i);
+    printDebug(buf.data());
+}
+
+// number of frames whose fence has been waited on, valid once the current frame's fence has been
+static uint64_t retiredFrameCount()
+{
+    return globals.frame_number >= globals.frames_in_flight ? globals.frame_number - globals.frames_in_flight + 1 : 0;
+}
+
+// Dynamic resolution draws into this and blits it to the swapchain image, so it is left out if the swapchain images cannot be blitted to.
+// Bilinear filtering if the format allows it. The post process pass samples it instead where the format can be sampled.
+static void createRenderTarget()
+{
+    const VkFormat format = globals.swapchain.surface_format.format;
+    VkFormatProperties properties{};
+    vkGetPhysicalDeviceFormatProperties(globals.device.physicalDevice, format, &properties);
+    const VkFormatFeatureFlags features = properties.optimalTilingFeatures;
+    const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+    if (!(globals.swapchain.image_usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT) || (features & required) != required) return;
+    const bool sampled = (features & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+
+    createImage(globals.device, format, globals.swapchain.extent, 1, VK_SAMPLE_COUNT_1_BIT,
+                VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | (sampled ? VK_IMAGE_USAGE_SAMPLED_BIT : 0),
+                VK_IMAGE_ASPECT_COLOR_BIT, MemoryCategory::RenderTargets, globals.render_target);
+    nameImage(globals.device, globals.render_target, "render target");
+    globals.upscale_filter = (features & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+    if (!sampled) return;
+
+    VkSamplerCreateInfo sampler_info{};
+    sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_info.magFilter = globals.upscale_filter;
+    sampler_info.minFilter = globals.upscale_filter;
+    sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.maxLod = 0.0f;
+    VKCHECK(vkCreateSampler(globals.device.device, &sampler_info, nullptr, &globals.post_process_sampler));
+    nameObject(globals.device.device, VK_OBJECT_TYPE_SAMPLER, globals.post_process_sampler, "post process");
+
+    VkDescriptorImageInfo image_info{};
+    image_info.sampler = globals.post_process_sampler;
+    image_info.imageView = globals.render_target.view;
+    image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = globals.post_process_set;
+    write.dstBinding = 0;
+    write.dstArrayElement = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &image_info;
+    vkUpdateDescriptorSets(globals.device.device, 1, &write, 0, nullptr);
+}
+
+// The scene is drawn into these with MSAA, the size of the swapchain images. Transient, so where the device has lazily allocated
+// memory it is only committed if a rendering stores them, as the first occlusion phase does for the second.
+static void createMsaaTargets()
+{
+    if (globals.samples == VK_SAMPLE_COUNT_1_BIT) return;
+    const VkFormat depth_format = globals.depth_image.format;
+    createImage(globals.device, globals.swapchain.surface_format.format, globals.swapchain.extent, 1, globals.samples,
+                VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT, MemoryCategory::RenderTargets,
+                globals.msaa_color);
+    createImage(globals.device, depth_format, globals.swapchain.extent, 1, globals.samples,
+                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT, depthFormatAspect(depth_format),
+                MemoryCategory::RenderTargets, globals.msaa_depth);
+    nameImage(globals.device, globals.msaa_color, "msaa color");
+    nameImage(globals.device, globals.msaa_depth, "msaa depth");
+}
+
+static void destroyMsaaTargets()
+{
+    destroyImage(globals.device, globals.msaa_color);
+    destroyImage(globals.device, globals.msaa_depth);
+}
+
+// follow the swapchain's extent, the depth pyramid follows the depth buffer
+static void recreateRenderTargets()
+{
+    const VkFormat format = globals.depth_image.format;
+    destroyDepthPyramid(globals.device, globals.depth_pyramid);
+    destroyImage(globals.device, globals.depth_image);
+    destroyImage(globals.device, globals.render_target);
+    vkDestroySampler(globals.device.device, globals.post_process_sampler, nullptr);
+    globals.post_process_sampler = VK_NULL_HANDLE;
+    destroyMsaaTargets();
+    createImage(globals.device, format, globals.swapchain.extent, 1, VK_SAMPLE_COUNT_1_BIT,
+                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, depthFormatAspect(format), MemoryCategory::RenderTargets,
+                globals.depth_image);
+    nameImage(globals.device, globals.depth_image, "depth");
+    createDepthPyramid(globals.device, globals.depth_image, globals.depth_pyramid);
+    writeDepthPyramidDescriptors(globals.device, globals.depth_pyramid, globals.nearest_sampler, globals.depth_pyramid_set, globals.frame_set);
+    globals.depth_pyramid_built = false;
+    createRenderTarget();
+    createMsaaTargets();
+}
+
+static void startPipelineOptimisation()
+{
+    globals.optimise_finished = false;
+    globals.optimise_thread = std::make_unique<std::thread>([] {
+        try {
+            linkOptimisedPipelines(globals.device.device, globals.pipeline_cache, globals.pipelines, globals.optimised_pipelines);
+            globals.optimise_finished = true;
+        }
+        catch (const VulkanError& error) {
+            // the render thread finds out too, and rebuilds the device and these pipelines with it
+            if (error.result == VK_ERROR_DEVICE_LOST) return;
+            showErrorMessage("Application Error!", error.what());
+            abort();
+        }
+        catch (const Error& error) {
+            showErrorMessage("Application Error!", error.what());
+            abort();
+        }
+    });
+}
+
+// At the start of a frame, once its fence has been waited on. Does not allocate.
+static void swapInOptimisedPipelines()
+{
+    if (globals.frame_number == globals.retired_frame + globals.frames_in_flight) {
+        destroyLinkedPipelines(globals.device.device, globals.retired_pipelines);
+        globals.retired_pipelines = LinkedPipelines{};
+    }
+    if (!globals.optimise_finished) return;
+    globals.optimise_thread->join();
+    globals.optimise_thread.reset();
+    globals.optimise_finished = false;
+    globals.optimised_link_ms = globals.optimised_pipelines.link_ms;
+    swapLinkedPipelines(globals.pipelines, globals.optimised_pipelines);
+    globals.retired_pipelines = globals.optimised_pipelines;
+    globals.optimised_pipelines = LinkedPipelines{};
+    globals.retired_frame = globals.frame_number;
+}
+
+// Before the scene pipelines are destroyed, with the device idle
+static void finishPipelineOptimisation()
+{
+    if (globals.optimise_thread) {
+        globals.optimise_thread->join();
+        globals.optimise_thread.reset();
+        destroyLinkedPipelines(globals.device.device, globals.optimised_pipelines);
+    }
+    destroyLinkedPipelines(globals.device.device, globals.retired_pipelines);
+    globals.optimised_pipelines = LinkedPipelines{};
+    globals.retired_pipelines = LinkedPipelines{};
+    globals.optimise_finished = false;
+}
+
+// "frame 0 fence" and so on
+template <typename Handle>
+static void nameFrameObject([[maybe_unused]] uint32_t frame_index, [[maybe_unused]] VkObjectType type, [[maybe_unused]] Handle handle,
+                            [[maybe_unused]] const char* what)
+{
+#if VULKAN_DEBUG
+    std::array<char, 64> name{};
+    snprintf(name.data(), name.size(), "frame %u %s", frame_index, what);
+    nameObject(globals.device.device, type, handle, name.data());
+#endif
+}
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Everything drawn with the current sample count. Only needs the device, the set layouts and the formats, so startup runs it on
+// another thread.
+static void compileScenePipelines(VkFormat color_format, VkFormat depth_format)
+{
+    const bool pipeline_libraries = globals.pipeline_libraries && globals.device.graphicsPipelineLibrary;
+    const auto start = std::chrono::steady_clock::now();
+    createPipelines(globals.device.device, globals.pipeline_cache, globals.frame_set_layout, globals.depth_pyramid_set_layout,
+                    globals.post_process_set_layout, color_format, depth_format, globals.samples, globals.sample_shading, globals.device.meshShader,
+                    globals.extended_dynamic_state, pipeline_libraries, globals.pipelines);
+    globals.pipelines_create_ms = millisecondsSince(start);
+    globals.optimised_link_ms = 0.0;
+}
+
+// Compiles the first pipelines while the caller goes on to create the swapchain and frame resources.
+static void startStartupPipelines(VkFormat color_format)
+{
+    globals.startup_pipelines = std::async(std::launch::async, [color_format] {
+        const auto start = std::chrono::steady_clock::now();
+        size_t cache_bytes = 0;
+        globals.pipeline_cache = createPipelineCache(globals.device, PIPELINE_CACHE_PATH, cache_bytes);
+        globals.startup.pipeline_cache_bytes = cache_bytes;
+        compileScenePipelines(color_format, findDepthFormat(globals.device));
+        globals.startup.pipelines_ms = millisecondsSince(start);
+    });
+}
+
+// Before anything uses globals.pipelines or changes what they are created with. Rethrows whatever startup's pipeline thread threw.
+static void finishStartupPipelines()
+{
+    if (!globals.startup_pipelines.valid()) return;
+    const auto start = std::chrono::steady_clock::now();
+    globals.startup_pipelines.get();
+    globals.startup.pipeline_wait_ms = millisecondsSince(start);
+    if (globals.pipelines.pipeline_libraries) startPipelineOptimisation();
+}
+
+static void recreateScenePipelines()
+{
+    finishStartupPipelines();
+    finishPipelineOptimisation();
+    destroyPipelines(globals.device.device, globals.pipelines);
+    globals.pipelines = Pipelines{};
+    compileScenePipelines(globals.swapchain.surface_format.format, globals.depth_image.format);
+    if (globals.pipelines.pipeline_libraries) startPipelineOptimisation();
+}
+
+// points the frame constants binding at the stream buffer, the region is picked per frame with the dynamic offset
+static void writeFrameDescriptorSet()
+{
+    VkDescriptorBufferInfo buffer_info{};
+    buffer_info.buffer = globals.stream.buffer;
+    buffer_info.offset = 0;
+    buffer_info.range = sizeof(FrameConstants);
+
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = globals.frame_set;
+    write.dstBinding = 0;
+    write.dstArrayElement = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    write.pBufferInfo = &buffer_info;
+    vkUpdateDescriptorSets(globals.device.device, 1, &write, 0, nullptr);
+}
+
+// Rare, only when the scene outgrows the stream buffer, so waiting for the GPU to go idle is fine.
+static void growStreamBuffer(VkDeviceSize region_size)
+{
+    VKCHECK(vkDeviceWaitIdle(globals.device.device));
+
+    const VkDeviceSize new_region_size = std::max(region_size, globals.stream.region_size * 2);
+    destroyStreamBuffer(globals.device, globals.stream);
+    createStreamBuffer(globals.device, new_region_size, globals.frames_in_flight, globals.stream);
+    nameObject(globals.device.device, VK_OBJECT_TYPE_BUFFER, globals.stream.buffer, "stream");
+    writeFrameDescriptorSet();
+}
+
+// Rare, only when a scene has more entities than any before it, so waiting for the GPU to go idle is fine.
+static void growEntityBuffer(VkDeviceSize size)
+{
+    if (size <= globals.entity_buffer.size) return;
+    VKCHECK(vkDeviceWaitIdle(globals.device.device));
+
+    const VkDeviceSize new_size = std::max(size, globals.entity_buffer.size * 2);
+    destroyBuffer(globals.device, globals.entity_buffer);
+    createBuffer(globals.device, new_size,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, MemoryCategory::Entities, globals.entity_buffer);
+    nameBuffer(globals.device, globals.entity_buffer, "entities");
+}
+
+// with the next frame, into a new buffer if the old one is too small
+static void uploadAllEntities()
+{
+    growEntityBuffer(std::max<VkDeviceSize>(sizeof(WorldTransform) * globals.entities.world.size(), sizeof(WorldTransform)));
+    globals.upload_all_entities = true;
+}
+
+static void recreateSwapchain()
+{
+    VKCHECK(vkDeviceWaitIdle(globals.device.device));
+
+    recreateVulkanSwapchain(globals.device, globals.window_extent, globals.swapchain);
+    recreateRenderTargets();
+
+    // present ids of the old swapchain can no longer be waited on
+    globals.latency_sample_count = 0;
+    globals.swapchain_outdated = false;
+}
+
+// Called by the render thread once per frame, never blocks.
+static void drainEvents()
+{
+    Event event{};
+    while (globals.events.pop(event)) {
+        if (globals.replay.file != nullptr) writeReplayEvent(globals.replay, event);
+        if (isInputEvent(event.type)) {
+            // timestamped for latency measurement
+            if (globals.unrendered_input_ns == 0) globals.unrendered_input_ns = event.timestamp_ns;
+            if (event.type == EventType::MouseButtonDown && event.code == 0) {
+                globals.pick_requested = true;
+                globals.pick_x = event.x;
+                globals.pick_y = event.y;
+            }
+            continue;
+        }
+        switch (event.type) {
+            case EventType::Resize:
+                globals.window_extent = VkExtent2D{event.width, event.height};
+                globals.swapchain_outdated = true;
+                break;
+            case EventType::Minimise:
+                globals.minimised = true;
+                break;
+            case EventType::Restore:
+                globals.minimised = false;
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// Input to photon latency runs from the OS event timestamp until the first frame drawn after it is on screen.
+// With VK_KHR_present_wait the present is polled once per frame so a sample can read up to a frame long.
+// Without it the end point is the frame's rendering completing, which leaves out the wait for scanout.
+static void updateInputLatency()
+{
+    const int64_t now_ns = eventTimestampNow();
+    LatencyStats& stats = globals.input_latency;
+
+    uint32_t completed = 0;
+    while (completed < globals.latency_sample_count) {
+        const LatencySample& sample = globals.latency_samples[completed];
+        bool displayed = false;
+        if (globals.device.presentWait) {
+            displayed = vkWaitForPresentKHR(globals.device.device, globals.swapchain.swapchain, sample.present_id, 0) == VK_SUCCESS;
+        }
+        else {
+            displayed = sample.present_id <= retiredFrameCount();
+        }
+        if (!displayed) break; // frames are displayed in order
+
+        const double latency_ms = static_cast<double>(now_ns - sample.input_ns) / 1e6;
+        stats.count += 1;
+        stats.total_ms += latency_ms;
+        stats.max_ms = std::max(stats.max_ms, latency_ms);
+        globals.telemetry.input_latency->observe(latency_ms);
+        ++completed;
+    }
+    for (uint32_t i = completed; i < globals.latency_sample_count; ++i) {
+        globals.latency_samples[i - completed] = globals.latency_samples[i];
+    }
+    globals.latency_sample_count -= completed;
+
+    constexpr int64_t REPORT_INTERVAL_NS = 5'000'000'000;
+    if (stats.count > 0 && now_ns - stats.last_report_ns > REPORT_INTERVAL_NS) {
+        std::array<char, 128> buf{};
+        snprintf(buf.data(), buf.size(), "input to %s latency: mean %.2f ms, max %.2f ms over %" PRIu64 " inputs\n",
+                 globals.device.presentWait ? "photon" : "render", stats.total_ms / static_cast<double>(stats.count), stats.max_ms, stats.count);
+        printDebug(buf.data());
+        stats = LatencyStats{};
+        stats.last_report_ns = now_ns;
+    }
+}
+
+// Once the first frame has been submitted
+static void finishStartup()
+{
+    StartupStats& stats = globals.startup;
+    stats.first_frame_ms = millisecondsSince(globals.startup_begin);
+    std::array<char, 256> buf{};
+    snprintf(buf.data(), buf.size(),
+             "startup: first frame %.1f ms (init %.1f ms: instance %.1f, device %.1f, swapchain %.1f, frame resources %.1f, meshes %.1f), "
+             "pipelines %.1f ms waited for %.1f ms with %" PRIu64 " cached bytes\n",
+             stats.first_frame_ms, stats.init_ms, stats.instance_ms, stats.device_ms, stats.swapchain_ms, stats.frame_resources_ms, stats.mesh_upload_ms,
+             stats.pipelines_ms, stats.pipeline_wait_ms, stats.pipeline_cache_bytes);
+    printDebug(buf.data());
+}
+
+// Waits for the frame that last used this slot, then records, submits and (unless headless) presents the next one.
+// record_ms is the CPU time in milliseconds spent recording the command buffer. Failures are returned for renderFrame() to deal with.
+static VulkanStatus drawFrame(double dt, double& record_ms)
+{
+    VkResult res{};
+
+    FrameData& frame = globals.frames[globals.frame_number % globals.frames_in_flight];
+
+    // fault injection, the device is left idle as a lost one would be
+    if (globals.frame_number == globals.simulated_device_lost_frame) [[unlikely]] {
+        globals.simulated_device_lost_frame = UINT64_MAX;
+        VKTRY(vkDeviceWaitIdle(globals.device.device));
+        VKTRY(VK_ERROR_DEVICE_LOST);
+    }
+
+    // wait until the rendering frames_in_flight frames ago has finished
+    // this fence is signalled when that frame's command buffer finishes execution.
+    VKTRY(vkWaitForFences(globals.device.device, 1, &frame.fence, VK_TRUE, UINT64_MAX));
+    finishStartupPipelines();
+    swapInOptimisedPipelines();
+    if (globals.frame_number % MEMORY_BUDGET_POLL_INTERVAL == 0) updateMemoryBudget(globals.device);
+
+    if (frame.timestamps_written) {
+        std::array<uint64_t, 2> ticks{};
+        if (vkGetQueryPoolResults(globals.device.device, frame.timestamps, 0, 2, sizeof(ticks), ticks.data(), sizeof(uint64_t),
+                                  VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+            const double period_ns = globals.device.properties.limits.timestampPeriod;
+            globals.render_gpu_ms = static_cast<double>(ticks[1] - ticks[0]) * period_ns / 1e6;
+            updateResolutionScale(globals.resolution, globals.dynamic_resolution, globals.render_gpu_ms);
+        }
+    }
+
+    // nothing the GPU reads from that frame's arena or stream buffer region is in use any more
+    frame.arena.reset();
+
+    // enough for every entity to have moved
+    const VkDeviceSize stream_bytes = streamAllocationSize(globals.stream, sizeof(FrameConstants)) +
+                                      streamAllocationSize(globals.stream, sizeof(uint32_t) * globals.renderable_entities.size()) +
+                                      streamAllocationSize(globals.stream, sizeof(WorldTransform) * globals.entities.world.size());
+    if (stream_bytes > globals.stream.region_size) growStreamBuffer(stream_bytes);
+    beginStreamFrame(globals.stream, static_cast<uint32_t>(globals.frame_number % globals.frames_in_flight));
+
+    // only this frame used the buffer, and it has retired
+    const VkDeviceSize meshlet_draws_size = clusterCullingPath() == ClusterCulling::Compute ? meshletDrawCount() * DRAW_COMMAND_SIZE : 0;
+    if (meshlet_draws_size > frame.meshlet_draws.size) {
+        destroyBuffer(globals.device, frame.meshlet_draws);
+        createBuffer(globals.device, std::max(meshlet_draws_size, frame.meshlet_draws.size * 2),
+                     VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, MemoryCategory::Culling, frame.meshlet_draws);
+        nameBuffer(globals.device, frame.meshlet_draws, "meshlet draws");
+    }
+    const VkDeviceSize occlusion_flags_size = occlusionCulling(clusterCullingPath()) ? meshletDrawCount() * sizeof(uint32_t) : 0;
+    if (occlusion_flags_size > frame.occlusion_flags.size) {
+        destroyBuffer(globals.device, frame.occlusion_flags);
+        createBuffer(globals.device, std::max(occlusion_flags_size, frame.occlusion_flags.size * 2),
+                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0,
+                     MemoryCategory::Culling, frame.occlusion_flags);
+        nameBuffer(globals.device, frame.occlusion_flags, "occlusion flags");
+    }
+
+    // retired frames' readbacks can go to the encoder
+    pollCapture(globals.device, globals.capture, retiredFrameCount());
+
+    uint32_t image_index = 0;
+    if (globals.headless) {
+        // offscreen images are simply used in turn
+        image_index = static_cast<uint32_t>(globals.frame_number % globals.swapchain.images.size());
+    }
+    else {
+        updateInputLatency();
+
+        if (globals.swapchain_outdated) recreateSwapchain();
+
+        res = vkAcquireNextImageKHR(globals.device.device, globals.swapchain.swapchain, UINT64_MAX, frame.present_semaphore, VK_NULL_HANDLE,
+                                    &image_index);
+        if (res == VK_ERROR_OUT_OF_DATE_KHR) {
+            // nothing was submitted so the fence is still signalled, try again next frame
+            globals.swapchain_outdated = true;
+            return VulkanStatus{};
+        }
+        VKTRY(res);
+    }
+
+    VKTRY(vkResetFences(globals.device.device, 1, &frame.fence));
+
+    bool capture_frame = false;
+    uint32_t capture_requested = globals.capture_frames_requested.load();
+    if (capture_requested > 0 && captureSlotAvailable(globals.capture)) {
+        capture_frame = true;
+        if (capture_requested != CAPTURE_CONTINUOUS) {
+            globals.capture_frames_requested.compare_exchange_strong(capture_requested, capture_requested - 1);
+        }
+    }
+
+    const auto begin_record = std::chrono::steady_clock::now();
+    const VulkanStatus record_status = recordCommandBuffer(frame, image_index, dt, capture_frame);
+    if (!record_status.ok()) return record_status;
+    record_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin_record).count();
+
+    // submit rendering commands
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = nullptr;
+    submitInfo.waitSemaphoreCount = globals.headless ? 0 : 1;
+    submitInfo.pWaitSemaphores = &frame.present_semaphore;
+    constexpr VkPipelineStageFlags semaphore_wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    submitInfo.pWaitDstStageMask = &semaphore_wait_stage;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &frame.cmd_buf;
+    submitInfo.signalSemaphoreCount = globals.headless ? 0 : 1;
+    submitInfo.pSignalSemaphores = &frame.render_semaphore;
+    VKTRY(vkQueueSubmit(globals.device.queue, 1, &submitInfo, frame.fence));
+    if (globals.frame_number == 0) finishStartup();
+
+    if (globals.headless) {
+        ++globals.frame_number;
+        return VulkanStatus{};
+    }
+
+    // present
+    // the id lets updateInputLatency() find out when this frame is on screen
+    const uint64_t present_id = globals.frame_number + 1;
+    VkPresentIdKHR presentIdInfo{};
+    presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+    presentIdInfo.pNext = nullptr;
+    presentIdInfo.swapchainCount = 1;
+    presentIdInfo.pPresentIds = &present_id;
+    VkPresentInfoKHR presentInfo{};
+    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    presentInfo.pNext = globals.device.presentWait ? &presentIdInfo : nullptr;
+    presentInfo.waitSemaphoreCount = 1;
+    presentInfo.pWaitSemaphores = &frame.render_semaphore;
+    presentInfo.swapchainCount = 1;
+    presentInfo.pSwapchains = &globals.swapchain.swapchain;
+    presentInfo.pImageIndices = &image_index;
+    presentInfo.pResults = nullptr;
+    res = vkQueuePresentKHR(globals.device.queue, &presentInfo);
+    if (res == VK_ERROR_OUT_OF_DATE_KHR || res == VK_SUBOPTIMAL_KHR) {
+        globals.swapchain_outdated = true;
+    }
+    else {
+        // the wait on render_semaphore still happens when the surface has been lost, so the frame can be retried with a new one
+        VKTRY(res);
+    }
+
+    // this frame is the first to reflect any input received since the last one
+    if (globals.unrendered_input_ns != 0) {
+        if (globals.latency_sample_count < globals.latency_samples.size()) {
+            globals.latency_samples[globals.latency_sample_count++] = LatencySample{globals.unrendered_input_ns, present_id};
+        }
+        globals.unrendered_input_ns = 0;
+    }
+
+    ++globals.frame_number;
+    return VulkanStatus{};
+}
+
+#ifndef NDEBUG
+// The render loop should not touch the heap once the first frames have grown the arenas and the swapchain is stable.
+// Reports frames that do (rate limited), and arenas growing past their previous high water mark.
+static void checkFrameAllocations(uint64_t allocations, bool capturing, const FrameArena& arena, size_t previous_arena_high_water)
+{
+    constexpr uint64_t WARMUP_FRAMES = 16;
+    constexpr int64_t REPORT_INTERVAL_NS = 1'000'000'000;
+    static int64_t last_report_ns = 0;
+
+    if (arena.highWaterMark() > previous_arena_high_water && globals.frame_number > WARMUP_FRAMES) {
+        std::array<char, 96> buf{};
+        snprintf(buf.data(), buf.size(), "frame arena high water mark grew to %zu bytes\n", arena.highWaterMark());
+        printDebug(buf.data());
+    }
+
+    if (allocations == 0 || capturing || globals.frame_number <= WARMUP_FRAMES) return;
+    const int64_t now_ns = eventTimestampNow();
+    if (now_ns - last_report_ns < REPORT_INTERVAL_NS) return;
+    last_report_ns = now_ns;
+
+    std::array<char, 96> buf{};
+    snprintf(buf.data(), buf.size(), "frame %" PRIu64 " made %" PRIu64 " heap allocations\n", globals.frame_number, allocations);
+    printDebug(buf.data());
+}
+#endif
+
+// Maps the scene file and starts reading in what the first upload will copy, on another thread while the device is created.
+static void startStartupSceneLoad()
+{
+    if (globals.scene_path.empty()) return;
+    globals.startup_scene = std::async(std::launch::async, [] {
+        const auto start = std::chrono::steady_clock::now();
+        SceneFile& scene = globals.startup_scene_file;
+        openSceneFile(globals.scene_path, scene);
+        const size_t gpu_data_offset = static_cast<size_t>(scene.gpu_data - scene.file.data);
+        prefetchRange(scene.file, gpu_data_offset, static_cast<size_t>(std::min<uint64_t>(scene.gpu_data_size, STAGING_SIZE)));
+        globals.startup.scene_map_ms = millisecondsSince(start);
+    });
+}
+
+// no surface extensions and no swapchain support are requested when headless
+static void createInstanceAndDevice(const std::vector<const char*>& instance_extensions, bool headless)
+{
+    auto start = std::chrono::steady_clock::now();
+    { // instance creation
+        if (volkInitialize() != VK_SUCCESS) {
+            throw Error("Failed to initialise Volk");
+        }
+
+        globals.instance = initVulkanInstance(instance_extensions);
+
+        volkLoadInstance(globals.instance);
+        globals.debug_messenger = createDebugMessenger(globals.instance);
+
+        if (volkGetInstanceVersion() < VK_API_VERSION_1_3) {
+            throw Error("Unsupported Vulkan version. Need at least Vulkan 1.3.");
+        }
+    }
+    globals.startup.instance_ms = millisecondsSince(start);
+
+    start = std::chrono::steady_clock::now();
+    { // device creation
+        globals.device = createVulkanDevice(globals.instance, headless);
+        volkLoadDevice(globals.device.device);
+    }
+    globals.startup.device_ms = millisecondsSince(start);
+
+    globals.headless = headless;
+}
+
+// the set layouts the pipelines are created with, before startup starts compiling them
+static void createSetLayouts()
+{
+    globals.frame_set_layout = createFrameDescriptorSetLayout(globals.device.device, globals.device.meshShader);
+
+    // the depth pyramid is built with a storage image array indexed by level
+    if (globals.device.storageImageArrayDynamicIndexing) {
+        globals.depth_pyramid_set_layout = createDepthPyramidSetLayout(globals.device.device);
+    }
+
+    globals.post_process_set_layout = createPostProcessSetLayout(globals.device.device);
+}
+
+// Command buffers, sync objects, descriptors and render targets, again after the device is lost. The pipelines are being compiled meanwhile.
+static void createFrameResources(const CaptureSettings& capture_settings)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    { // frame capture for screenshots, recordings and golden image tests
+        createCapture(globals.device, globals.swapchain.surface_format.format, globals.swapchain.image_usage, capture_settings, globals.capture);
+    }
+
+    // one set per frame in flight
+    // This allows the next frame's command buffer to be recorded while the previous frame cmd buffer is still being executed
+    for (FrameData& frame : framesInFlight()) {
+        { // create command pool
+            // the pool is reset after its command buffer has finished execution.
+            VkCommandPoolCreateInfo cmd_pool_info{};
+            cmd_pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            cmd_pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            cmd_pool_info.queueFamilyIndex = 0;
+            VKCHECK(vkCreateCommandPool(globals.device.device, &cmd_pool_info, nullptr, &frame.cmd_pool));
+        }
+
+        { // create command buffer
+            VkCommandBufferAllocateInfo cmd_buf_info{};
+            cmd_buf_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            cmd_buf_info.commandPool = frame.cmd_pool;
+            cmd_buf_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            cmd_buf_info.commandBufferCount = 1;
+            VKCHECK(vkAllocateCommandBuffers(globals.device.device, &cmd_buf_info, &frame.cmd_buf));
+        }
+
+        // create the fence and semaphores
+        VkFenceCreateInfo fence_info{};
+        fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fence_info.pNext = nullptr;
+        fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT; // for first frame fence must be signalled otherwise app will wait forever
+        VKCHECK(vkCreateFence(globals.device.device, &fence_info, nullptr, &frame.fence));
+
+        VkSemaphoreCreateInfo semaphore_info{};
+        semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphore_info.pNext = nullptr;
+        semaphore_info.flags = 0;
+        VKCHECK(vkCreateSemaphore(globals.device.device, &semaphore_info, nullptr, &frame.render_semaphore));
+        VKCHECK(vkCreateSemaphore(globals.device.device, &semaphore_info, nullptr, &frame.present_semaphore));
+
+        const uint32_t frame_index = static_cast<uint32_t>(&frame - globals.frames.data());
+        nameFrameObject(frame_index, VK_OBJECT_TYPE_COMMAND_BUFFER, frame.cmd_buf, "commands");
+        nameFrameObject(frame_index, VK_OBJECT_TYPE_FENCE, frame.fence, "fence");
+        nameFrameObject(frame_index, VK_OBJECT_TYPE_SEMAPHORE, frame.render_semaphore, "render semaphore");
+        nameFrameObject(frame_index, VK_OBJECT_TYPE_SEMAPHORE, frame.present_semaphore, "present semaphore");
+
+        // start and end of rendering
+        if (globals.device.properties.limits.timestampComputeAndGraphics) {
+            VkQueryPoolCreateInfo query_pool_info{};
+            query_pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            query_pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            query_pool_info.queryCount = 2;
+            VKCHECK(vkCreateQueryPool(globals.device.device, &query_pool_info, nullptr, &frame.timestamps));
+        }
+    }
+
+    { // per-frame data
+        createStreamBuffer(globals.device, STREAM_REGION_SIZE, globals.frames_in_flight, globals.stream);
+        nameObject(globals.device.device, VK_OBJECT_TYPE_BUFFER, globals.stream.buffer, "stream");
+
+        // the frame set, the depth pyramid build's set and the post process pass's set
+        std::array<VkDescriptorPoolSize, 3> pool_sizes{};
+        pool_sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        pool_sizes[0].descriptorCount = 1;
+        pool_sizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        pool_sizes[1].descriptorCount = 3;
+        pool_sizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        pool_sizes[2].descriptorCount = DEPTH_PYRAMID_MAX_LEVELS;
+        VkDescriptorPoolCreateInfo pool_info{};
+        pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        pool_info.flags = 0;
+        pool_info.maxSets = 3;
+        pool_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
+        pool_info.pPoolSizes = pool_sizes.data();
+        VKCHECK(vkCreateDescriptorPool(globals.device.device, &pool_info, nullptr, &globals.descriptor_pool));
+
+        VkDescriptorSetAllocateInfo set_info{};
+        set_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        set_info.descriptorPool = globals.descriptor_pool;
+        set_info.descriptorSetCount = 1;
+        set_info.pSetLayouts = &globals.frame_set_layout;
+        VKCHECK(vkAllocateDescriptorSets(globals.device.device, &set_info, &globals.frame_set));
+        writeFrameDescriptorSet();
+        if (globals.depth_pyramid_set_layout != VK_NULL_HANDLE) {
+            set_info.pSetLayouts = &globals.depth_pyramid_set_layout;
+            VKCHECK(vkAllocateDescriptorSets(globals.device.device, &set_info, &globals.depth_pyramid_set));
+        }
+        set_info.pSetLayouts = &globals.post_process_set_layout;
+        VKCHECK(vkAllocateDescriptorSets(globals.device.device, &set_info, &globals.post_process_set));
+        nameObject(globals.device.device, VK_OBJECT_TYPE_DESCRIPTOR_SET, globals.frame_set, "frame");
+        nameObject(globals.device.device, VK_OBJECT_TYPE_DESCRIPTOR_SET, globals.depth_pyramid_set, "depth pyramid");
+        nameObject(globals.device.device, VK_OBJECT_TYPE_DESCRIPTOR_SET, globals.post_process_set, "post process");
+    }
+
+    { // depth buffer, and its pyramid for occlusion culling
+        // the frame set's pyramid binding is always written, even when nothing can build it
+        VkSamplerCreateInfo sampler_info{};
+        sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        sampler_info.magFilter = VK_FILTER_NEAREST;
+        sampler_info.minFilter = VK_FILTER_NEAREST;
+        sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        sampler_info.maxLod = VK_LOD_CLAMP_NONE;
+        VKCHECK(vkCreateSampler(globals.device.device, &sampler_info, nullptr, &globals.nearest_sampler));
+        nameObject(globals.device.device, VK_OBJECT_TYPE_SAMPLER, globals.nearest_sampler, "nearest");
+
+        const VkFormat depth_format = findDepthFormat(globals.device);
+        createImage(globals.device, depth_format, globals.swapchain.extent, 1, VK_SAMPLE_COUNT_1_BIT,
+                    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, depthFormatAspect(depth_format), MemoryCategory::RenderTargets,
+                    globals.depth_image);
+        nameImage(globals.device, globals.depth_image, "depth");
+        createDepthPyramid(globals.device, globals.depth_image, globals.depth_pyramid);
+        writeDepthPyramidDescriptors(globals.device, globals.depth_pyramid, globals.nearest_sampler, globals.depth_pyramid_set, globals.frame_set);
+        globals.depth_pyramid_built = false;
+    }
+
+    createRenderTarget();
+    createMsaaTargets();
+    globals.startup.frame_resources_ms = millisecondsSince(start);
+}
+
+// The render thread is not drawing, so the queue is free. After a lost device the scene file is mapped again.
+static void createSceneMesh()
+{
+    const auto start = std::chrono::steady_clock::now();
+    Uploader uploader{};
+    createUploader(globals.device, STAGING_SIZE, uploader);
+    if (globals.scene_path.empty()) {
+        createGpuMesh(globals.device, uploader, createTriangleMesh(), globals.scene_mesh);
+    }
+    else {
+        if (globals.startup_scene.valid()) {
+            globals.startup_scene.get();
+        }
+        else {
+            openSceneFile(globals.scene_path, globals.startup_scene_file);
+        }
+        // everything has been copied into staging memory by the time createGpuMesh() returns
+        createGpuMesh(globals.device, uploader, globals.startup_scene_file, globals.scene_mesh);
+        closeSceneFile(globals.startup_scene_file);
+    }
+    destroyUploader(globals.device, uploader);
+    globals.startup.mesh_upload_ms = millisecondsSince(start);
+}
+
+// Everything after the swapchain, shared by windowed and headless rendering
+static void createRenderer(const CaptureSettings& capture_settings, uint32_t instance_count, uint32_t field_instances)
+{
+    globals.jobs = std::make_unique<JobSystem>(globals.worker_count);
+    createFrameResources(capture_settings);
+    createSceneMesh();
+
+    SceneSettings default_scene{};
+    if (field_instances > 0) {
+        default_scene.instance_count = field_instances;
+        default_scene.layout = SceneLayout::Field;
+    }
+    else {
+        default_scene.instance_count = instance_count;
+        default_scene.cluster_culling = ClusterCulling::MeshShader;
+    }
+    resetScene(default_scene);
+}
+
+// The offscreen images when headless. The pipelines start compiling as soon as the format is known.
+static void createSwapchain()
+{
+    if (globals.headless) {
+        startStartupPipelines(HEADLESS_FORMAT);
+        createOffscreenSwapchain(globals.device, HEADLESS_FORMAT, globals.window_extent, headlessImageCount(), globals.swapchain);
+        return;
+    }
+    const VkSurfaceKHR surface = globals.window->createSurface(globals.instance);
+    startStartupPipelines(chooseSurfaceFormat(globals.device, surface).format);
+    createVulkanSwapchain(globals.device, surface, globals.window_extent, globals.present_mode, globals.swapchain_images, globals.swapchain);
+}
+
+// Everything made from the device, then the device. The instance, the job system and the scene are kept.
+static void destroyDeviceResources()
+{
+    vkDeviceWaitIdle(globals.device.device);
+
+    destroyCapture(globals.device, globals.capture);
+
+    destroyGpuMesh(globals.device, globals.scene_mesh);
+    destroyBuffer(globals.device, globals.entity_buffer);
+    finishStartupPipelines();
+    finishPipelineOptimisation();
+    destroyPipelines(globals.device.device, globals.pipelines);
+    destroyPipelineCache(globals.device, globals.pipeline_cache, PIPELINE_CACHE_PATH);
+    destroyDepthPyramid(globals.device, globals.depth_pyramid);
+    vkDestroySampler(globals.device.device, globals.nearest_sampler, nullptr);
+    destroyImage(globals.device, globals.depth_image);
+    destroyImage(globals.device, globals.render_target);
+    vkDestroySampler(globals.device.device, globals.post_process_sampler, nullptr);
+    destroyMsaaTargets();
+    vkDestroyDescriptorPool(globals.device.device, globals.descriptor_pool, nullptr);
+    vkDestroyDescriptorSetLayout(globals.device.device, globals.post_process_set_layout, nullptr);
+    vkDestroyDescriptorSetLayout(globals.device.device, globals.depth_pyramid_set_layout, nullptr);
+    vkDestroyDescriptorSetLayout(globals.device.device, globals.frame_set_layout, nullptr);
+    destroyStreamBuffer(globals.device, globals.stream);
+
+    for (FrameData& frame : framesInFlight()) {
+        vkDestroySemaphore(globals.device.device, frame.present_semaphore, nullptr);
+        vkDestroySemaphore(globals.device.device, frame.render_semaphore, nullptr);
+        vkDestroyFence(globals.device.device, frame.fence, nullptr);
+        vkDestroyCommandPool(globals.device.device, frame.cmd_pool, nullptr);
+        vkDestroyQueryPool(globals.device.device, frame.timestamps, nullptr);
+        destroyBuffer(globals.device, frame.meshlet_draws);
+        destroyBuffer(globals.device, frame.occlusion_flags);
+    }
+
+    destroyVulkanSwapchain(globals.instance, globals.device, globals.swapchain);
+    destroyVulkanDevice(globals.device);
+}
+
+static void destroyRenderer()
+{
+    destroyDeviceResources();
+    globals.jobs.reset();
+    destroyDebugMessenger(globals.instance, globals.debug_messenger);
+    destroyVulkanInstance(globals.instance);
+}
+
+// After VK_ERROR_SURFACE_LOST_KHR, when the window system has taken the surface away. The device is kept, the pipelines are only
+// compiled again if the new surface wants another format.
+static void recoverLostSurface()
+{
+    const auto start = std::chrono::steady_clock::now();
+    ++globals.recovery.surface_lost;
+    globals.telemetry.surface_lost->add();
+    printDebug("surface lost, creating a new surface and swapchain\n");
+    VKCHECK(vkDeviceWaitIdle(globals.device.device));
+
+    const VkFormat format = globals.swapchain.surface_format.format;
+    destroyVulkanSwapchain(globals.instance, globals.device, globals.swapchain);
+    globals.swapchain = Swapchain{};
+    createVulkanSwapchain(globals.device, globals.window->createSurface(globals.instance), globals.window_extent, globals.present_mode,
+                          globals.swapchain_images, globals.swapchain);
+    recreateRenderTargets();
+    if (globals.swapchain.surface_format.format != format) recreateScenePipelines();
+
+    // present ids of the old swapchain can no longer be waited on
+    globals.latency_sample_count = 0;
+    globals.swapchain_outdated = false;
+    globals.recovery.last_recovery_ms = millisecondsSince(start);
+}
+
+// After VK_ERROR_DEVICE_LOST, from a driver reset, a GPU hang or the GPU being removed. Everything made from the device is made again
+// on a new one, the scene, settings and frame number carry on. Throws if there is no device to be had.
+static void recoverLostDevice()
+{
+    const auto start = std::chrono::steady_clock::now();
+    ++globals.recovery.device_lost;
+    globals.telemetry.device_lost->add();
+    printDebug("device lost, creating a new device\n");
+
+    // rebuilding goes through the startup code, which should not count towards startup's numbers
+    const StartupStats startup = globals.startup;
+    const CaptureSettings capture_settings = globals.capture.settings;
+    try {
+        finishStartupPipelines();
+    }
+    catch (const VulkanError& error) {
+        // the pipeline thread found out first
+        if (error.result != VK_ERROR_DEVICE_LOST) throw;
+    }
+    destroyDeviceResources();
+    // not everything is made again on every device
+    globals.swapchain = Swapchain{};
+    globals.pipelines = Pipelines{};
+    globals.depth_pyramid_set_layout = VK_NULL_HANDLE;
+    globals.depth_pyramid_set = VK_NULL_HANDLE;
+    globals.post_process_sampler = VK_NULL_HANDLE;
+    for (FrameData& frame : framesInFlight()) {
+        frame.timestamps = VK_NULL_HANDLE;
+        frame.timestamps_written = false;
+    }
+
+    globals.device = createVulkanDevice(globals.instance, globals.headless);
+    volkLoadDevice(globals.device.device);
+    createSetLayouts();
+    createSwapchain();
+    createFrameResources(capture_settings);
+    createSceneMesh();
+    uploadAllEntities();
+    finishStartupPipelines();
+
+    globals.latency_sample_count = 0;
+    globals.swapchain_outdated = false;
+    globals.startup = startup;
+    globals.recovery.last_recovery_ms = millisecondsSince(start);
+}
+
+// whatever recovery a failure of drawFrame() or applyLiveSettings() calls for
+static void recover(const VulkanStatus& status)
+{
+    if (status.result == VK_ERROR_DEVICE_LOST) {
+        recoverLostDevice();
+    }
+    else if (status.result == VK_ERROR_SURFACE_LOST_KHR) {
+        recoverLostSurface();
+    }
+    else if (!status.ok()) {
+        // out of memory and the like, there is nothing to recover
+        throwVulkanError(status.result, status.file, status.line, status.function);
+    }
+}
+
+// drawFrame(), then whatever recovery its failure calls for. Returns the CPU time in milliseconds spent recording the frame.
+static double renderFrame(double dt)
+{
+    double record_ms = 0.0;
+    VulkanStatus status{};
+    try {
+        status = drawFrame(dt, record_ms);
+    }
+    catch (const VulkanError& error) {
+        // growing buffers and recreating the swapchain are rare enough to throw
+        if (error.result != VK_ERROR_DEVICE_LOST && error.result != VK_ERROR_SURFACE_LOST_KHR) throw;
+        status.result = error.result;
+    }
+    recover(status);
+    return record_ms;
+}
+
+static void registerTelemetry()
+{
+    AppTelemetry& t = globals.telemetry;
+    t.frames = &telemetryCounter("vulkanapp_frames_total", "Frames rendered");
+    t.frame_interval = &telemetryHistogram("vulkanapp_frame_interval_ms", "Time from the start of one frame to the start of the next");
+    t.record_cpu = &telemetryHistogram("vulkanapp_record_cpu_ms", "CPU time spent recording a frame");
+    t.render_gpu = &telemetryHistogram("vulkanapp_render_gpu_ms", "GPU time between the start and end of rendering, when the queue has timestamps");
+    t.input_latency = &telemetryHistogram("vulkanapp_input_latency_ms", "From an input event to the first frame drawn after it being displayed");
+    t.draws = &telemetryGauge("vulkanapp_draws", "Draw commands in the last frame");
+    t.batches = &telemetryGauge("vulkanapp_batches", "Runs of draws sharing all their state in the last frame");
+    t.pipeline_binds = &telemetryGauge("vulkanapp_pipeline_binds", "Pipeline binds in the last frame");
+    t.resolution_scale = &telemetryGauge("vulkanapp_resolution_scale", "Fraction of the swapchain width the last frame was drawn at");
+    t.memory_allocated = &telemetryGauge("vulkanapp_gpu_memory_allocated_bytes", "Device memory allocated, in every heap");
+    t.memory_used = &telemetryGauge("vulkanapp_gpu_memory_used_bytes", "Device memory used by resources within the allocations");
+    t.memory_budget = &telemetryGauge("vulkanapp_gpu_memory_budget_bytes", "What the process can use of the device local heaps");
+    t.device_lost = &telemetryCounter("vulkanapp_device_lost_total", "Lost devices recovered from");
+    t.surface_lost = &telemetryCounter("vulkanapp_surface_lost_total", "Lost surfaces recovered from");
+}
+
+// After each frame of the game loop. Atomic stores only, the exporter thread formats them.
+static void updateTelemetry(double dt, double record_ms)
+{
+    AppTelemetry& t = globals.telemetry;
+    t.frames->add();
+    t.frame_interval->observe(dt * 1000.0);
+    t.record_cpu->observe(record_ms);
+    if (globals.render_gpu_ms > 0.0) t.render_gpu->observe(globals.render_gpu_ms);
+    t.draws->set(globals.draw_counters.draws);
+    t.batches->set(globals.draw_counters.batches);
+    t.pipeline_binds->set(globals.draw_counters.pipeline_binds);
+    t.resolution_scale->set(currentResolutionScale());
+    // walks the memory blocks, so only as often as the budget is polled
+    if (globals.frame_number % MEMORY_BUDGET_POLL_INTERVAL == 0) {
+        const GpuMemoryStats memory = gpuMemoryStats();
+        t.memory_allocated->set(static_cast<double>(memory.allocated_bytes));
+        t.memory_used->set(static_cast<double>(memory.used_bytes));
+        t.memory_budget->set(static_cast<double>(memory.budget_bytes));
+    }
+}
+
+// At the start of a frame, picks up whatever setLiveSettings() was last called with. A new anti-aliasing tier waits for the device and
+// recreates the pipelines, which can find the device or surface lost as drawFrame() can. Those are recovered from the same way, and the
+// settings applied again on the next frame.
+static void applyLiveSettings()
+{
+    if (!globals.live_changed.exchange(false)) return;
+    LiveSettings settings{};
+    {
+        std::lock_guard lock(globals.live_mutex);
+        settings = globals.pending_live;
+    }
+
+    VulkanStatus status{};
+    try {
+        if (settings.dynamic_resolution_ms != globals.live.dynamic_resolution_ms) {
+            DynamicResolutionSettings dynamic_resolution{};
+            dynamic_resolution.enabled = settings.dynamic_resolution_ms > 0.0;
+            if (dynamic_resolution.enabled) dynamic_resolution.target_gpu_ms = settings.dynamic_resolution_ms;
+            setDynamicResolution(dynamic_resolution);
+        }
+        if (settings.anti_aliasing != globals.live.anti_aliasing) {
+            setAntiAliasing(settings.anti_aliasing);
+        }
+    }
+    catch (const VulkanError& error) {
+        if (error.result != VK_ERROR_DEVICE_LOST && error.result != VK_ERROR_SURFACE_LOST_KHR) throw;
+        status.result = error.result;
+        globals.live_changed = true; // unless newer settings came meanwhile, these are picked up again
+    }
+    if (status.ok()) {
+        if (globals.replay.file != nullptr) writeReplayLiveSettings(globals.replay, settings);
+        globals.live = settings;
+    }
+    recover(status);
+}
+
+static void gameLoop()
+{
+    try {
+
+#ifndef NDEBUG
+        // create a console window for debugging
+        //if (AllocConsole() == FALSE) throw Error("AllocConsole() failure from render thread");
+#endif
+
+        auto begin_frame = std::chrono::steady_clock::now();
+
+        while (globals.running) {
+
+            auto last_begin_frame = begin_frame;
+            begin_frame = std::chrono::steady_clock::now();
+
+            [[maybe_unused]] const double dt = std::chrono::duration<double>(begin_frame - last_begin_frame).count();
+
+            applyLiveSettings();
+            drainEvents();
+
+            // there is nothing to draw to while minimised
+            if (!globals.minimised && globals.window_extent.width > 0 && globals.window_extent.height > 0) {
+                if (globals.replay.file != nullptr) writeReplayFrame(globals.replay, dt);
+#ifndef NDEBUG
+                const uint64_t allocations_before = threadHeapAllocationCount();
+                const bool capturing = globals.capture_frames_requested.load() > 0; // the capture encoder allocates
+                const FrameArena& arena = globals.frames[globals.frame_number % globals.frames_in_flight].arena;
+                const size_t arena_high_water = arena.highWaterMark();
+#endif
+                const double record_ms = renderFrame(dt);
+                updateTelemetry(dt, record_ms);
+#ifndef NDEBUG
+                checkFrameAllocations(threadHeapAllocationCount() - allocations_before, capturing, arena, arena_high_water);
+#endif
+            }
+
+            if (globals.live.fps_limit > 0) {
+                std::this_thread::sleep_until(begin_frame + std::chrono::nanoseconds(1'000'000'000LL / globals.live.fps_limit));
+            }
+        }
+    }
+    catch (const Error& error) {
+        showErrorMessage("Application Error!", error.what());
+        abort();
+    }
+}
+
+const char* presentModeName(PresentMode present_mode)
+{
+    switch (present_mode) {
+        case PresentMode::Mailbox:
+            return "mailbox";
+        case PresentMode::Fifo:
+            return "fifo";
+        case PresentMode::Immediate:
+            return "immediate";
+    }
+    return "fifo";
+}
+
+bool parsePresentMode(const std::string& name, PresentMode& present_mode)
+{
+    for (const PresentMode mode : {PresentMode::Mailbox, PresentMode::Fifo, PresentMode::Immediate}) {
+        if (name == presentModeName(mode)) {
+            present_mode = mode;
+            return true;
+        }
+    }
+    return false;
+}
+
+static VkPresentModeKHR vulkanPresentMode(PresentMode present_mode)
+{
+    switch (present_mode) {
+        case PresentMode::Mailbox:
+            return VK_PRESENT_MODE_MAILBOX_KHR;
+        case PresentMode::Fifo:
+            return VK_PRESENT_MODE_FIFO_KHR;
+        case PresentMode::Immediate:
+            return VK_PRESENT_MODE_IMMEDIATE_KHR;
+    }
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+// Presents to window, or renders offscreen at extent if it is nullptr
+static void initRenderer(const Window* window, VkExtent2D extent, const CaptureSettings& capture_settings, const RendererSettings& settings)
+{
+    globals.scene_path = settings.scene_path;
+    globals.frames_in_flight = std::clamp(settings.frames_in_flight, 1u, MAX_FRAMES_IN_FLIGHT);
+    globals.worker_count = settings.worker_count;
+    globals.present_mode = vulkanPresentMode(settings.present_mode);
+    globals.swapchain_images = settings.swapchain_images;
+    if (settings.simulate_device_lost != 0) globals.simulated_device_lost_frame = settings.simulate_device_lost;
+    registerTelemetry();
+    if (!settings.record_path.empty()) {
+        openReplayWriter(settings.record_path, ReplayHeader{extent.width, extent.height, settings}, globals.replay);
+    }
+
+    globals.startup_begin = std::chrono::steady_clock::now();
+    startStartupSceneLoad();
+    // offscreen images stand in for the swapchain without a window
+    createInstanceAndDevice(window != nullptr ? window->requiredInstanceExtensions() : std::vector<const char*>{}, window == nullptr);
+    globals.window = window;
+    globals.window_extent = extent;
+    createSetLayouts();
+
+    const auto start = std::chrono::steady_clock::now();
+    createSwapchain();
+    globals.startup.swapchain_ms = millisecondsSince(start);
+
+    createRenderer(capture_settings, settings.instance_count, settings.field_instances);
+    globals.startup.init_ms = millisecondsSince(globals.startup_begin);
+}
+
+void initApp(const Window& window, const RendererSettings& settings)
+{
+    const bool headless = window.backend() == WindowBackend::Headless;
+    initRenderer(headless ? nullptr : &window, window.extent(), CaptureSettings{}, settings);
+}
+
+void startGameLoop()
+{
+    globals.running.store(true);
+    globals.loop_thread = std::make_unique<std::thread>(gameLoop);
+}
+
+void setLiveSettings(const LiveSettings& settings)
+{
+    std::lock_guard lock(globals.live_mutex);
+    globals.pending_live = settings;
+    globals.live_changed.store(true);
+}
+
+void requestFrameCapture(uint32_t frame_count) { globals.capture_frames_requested.store(frame_count); }
+
+bool isCapturingFrames() { return globals.capture_frames_requested.load() > 0; }
+
+EventQueue& getEventQueue() { return globals.events; }
+
+void endLoopAndShutdown()
+{
+    globals.running.store(false);
+    globals.loop_thread->join();
+    closeReplayWriter(globals.replay);
+
+    destroyRenderer();
+}
+
+void initHeadless(uint32_t width, uint32_t height, const CaptureSettings& capture_settings, const RendererSettings& settings)
+{
+    initRenderer(nullptr, VkExtent2D{width, height}, capture_settings, settings);
+}
+
+void resizeHeadless(uint32_t width, uint32_t height)
+{
+    VKCHECK(vkDeviceWaitIdle(globals.device.device));
+
+    destroyVulkanSwapchain(globals.instance, globals.device, globals.swapchain);
+    globals.swapchain = Swapchain{};
+    globals.window_extent = VkExtent2D{width, height};
+    createOffscreenSwapchain(globals.device, HEADLESS_FORMAT, VkExtent2D{width, height}, headlessImageCount(), globals.swapchain);
+
+    recreateRenderTargets();
+    globals.swapchain_outdated = false;
+}
+
+void resetScene(const SceneSettings& settings)
+{
+    globals.current_time = 0.0;
+    globals.instance_count = settings.instance_count;
+    globals.layout = settings.layout;
+    globals.vertex_path = settings.vertex_path;
+    globals.cluster_culling = settings.cluster_culling;
+    globals.instance_culling = settings.instance_culling;
+    globals.depth_prepass = settings.depth_prepass;
+    globals.occlusion_culling = settings.occlusion_culling;
+    globals.pick_requested = false;
+
+    EntityStore& store = globals.entities;
+    clearEntities(store);
+    globals.animated_entities.clear();
+    globals.renderable_entities.clear();
+    globals.visible_instances.clear();
+    globals.instance_bvh = Bvh{};
+
+    const float radius = meshRadius();
+    if (settings.layout == SceneLayout::Field) {
+        createFieldEntities(radius);
+    }
+    else {
+        // animateScene() rotates them
+        for (uint32_t i = 0; i < settings.instance_count; ++i) {
+            const uint32_t entity = createEntity(store, ENTITY_NONE, LocalTransform{{0.0f, 0.0f, 0.0f}, 0.0f, 1.0f}, 0, 0, radius);
+            globals.animated_entities.push_back(entity);
+            globals.renderable_entities.push_back(entity);
+        }
+        globals.first_instance_entity = 0;
+    }
+
+    // the first frame uploads every entity, after that only what changed
+    updateEntityTransforms(store, *globals.jobs);
+    uploadAllEntities();
+
+    if (settings.layout == SceneLayout::Field) {
+        buildBvh(globals.instance_bvh, std::span<const Aabb>(store.bounds).subspan(globals.first_instance_entity));
+    }
+}
+
+double drawHeadlessFrame(double dt)
+{
+    applyLiveSettings();
+    drainEvents();
+    // the offscreen images follow a pushed Resize
+    if (globals.swapchain_outdated) resizeHeadless(globals.window_extent.width, globals.window_extent.height);
+    return renderFrame(dt);
+}
+
+void flushFrameCapture()
+{
+    VKCHECK(vkDeviceWaitIdle(globals.device.device));
+    flushCapture(globals.device, globals.capture);
+}
+
+DrawCounters lastFrameDrawCounters() { return globals.draw_counters; }
+
+void setDynamicResolution(const DynamicResolutionSettings& settings)
+{
+    globals.dynamic_resolution = settings;
+    globals.resolution = ResolutionController{};
+    updateResolutionScale(globals.resolution, settings, 0.0);
+}
+
+float currentResolutionScale()
+{
+    const VkExtent2D extent = renderExtent();
+    return static_cast<float>(extent.width) / static_cast<float>(std::max(globals.swapchain.extent.width, 1u));
+}
+
+// the most samples up to requested that color and depth attachments both support
+static VkSampleCountFlagBits supportedSampleCount(uint32_t requested)
+{
+    const VkPhysicalDeviceLimits& limits = globals.device.properties.limits;
+    const VkSampleCountFlags supported = limits.framebufferColorSampleCounts & limits.framebufferDepthSampleCounts;
+    uint32_t samples = requested;
+    while (samples > 1 && !(supported & samples)) samples >>= 1;
+    return static_cast<VkSampleCountFlagBits>(samples);
+}
+
+void simulateDeviceLost() { globals.simulated_device_lost_frame = globals.frame_number; }
+
+void setAntiAliasing(AntiAliasing anti_aliasing)
+{
+    if (anti_aliasing == globals.anti_aliasing) return;
+    finishStartupPipelines();
+    VKCHECK(vkDeviceWaitIdle(globals.device.device));
+
+    uint32_t samples = 1;
+    switch (anti_aliasing) {
+        case AntiAliasing::Msaa2:
+            samples = 2;
+            break;
+        case AntiAliasing::Msaa4:
+        case AntiAliasing::SampleShading4:
+            samples = 4;
+            break;
+        case AntiAliasing::Msaa8:
+            samples = 8;
+            break;
+        case AntiAliasing::Off:
+        case AntiAliasing::PostProcess:
+            break;
+    }
+    globals.anti_aliasing = anti_aliasing;
+    globals.samples = supportedSampleCount(samples);
+    globals.sample_shading =
+        anti_aliasing == AntiAliasing::SampleShading4 && globals.samples != VK_SAMPLE_COUNT_1_BIT && globals.device.sampleRateShading;
+
+    recreateScenePipelines();
+    destroyMsaaTargets();
+    createMsaaTargets();
+}
+
+AntiAliasing currentAntiAliasing()
+{
+    if (globals.sample_shading) return AntiAliasing::SampleShading4;
+    switch (globals.samples) {
+        case VK_SAMPLE_COUNT_2_BIT:
+            return AntiAliasing::Msaa2;
+        case VK_SAMPLE_COUNT_4_BIT:
+            return AntiAliasing::Msaa4;
+        case VK_SAMPLE_COUNT_8_BIT:
+            return AntiAliasing::Msaa8;
+        default:
+            break;
+    }
+    return postProcessing() ? AntiAliasing::PostProcess : AntiAliasing::Off;
+}
+
+const char* antiAliasingName(AntiAliasing anti_aliasing)
+{
+    switch (anti_aliasing) {
+        case AntiAliasing::Off:
+            return "off";
+        case AntiAliasing::PostProcess:
+            return "post";
+        case AntiAliasing::Msaa2:
+            return "msaa2";
+        case AntiAliasing::Msaa4:
+            return "msaa4";
+        case AntiAliasing::Msaa8:
+            return "msaa8";
+        case AntiAliasing::SampleShading4:
+            return "sample_shading4";
+    }
+    return "off";
+}
+
+bool parseAntiAliasing(const std::string& name, AntiAliasing& anti_aliasing)
+{
+    for (const AntiAliasing tier : {AntiAliasing::Off, AntiAliasing::PostProcess, AntiAliasing::Msaa2, AntiAliasing::Msaa4, AntiAliasing::Msaa8,
+                                    AntiAliasing::SampleShading4}) {
+        if (name == antiAliasingName(tier)) {
+            anti_aliasing = tier;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t antiAliasingMemoryBytes() { return globals.msaa_color.memory_size + globals.msaa_depth.memory_size; }
+
+void setExtendedDynamicState(bool enabled)
+{
+    if (enabled == globals.extended_dynamic_state) return;
+    finishStartupPipelines();
+    VKCHECK(vkDeviceWaitIdle(globals.device.device));
+    globals.extended_dynamic_state = enabled;
+    recreateScenePipelines();
+}
+
+void setPipelineLibraries(bool enabled)
+{
+    if (enabled == globals.pipeline_libraries) return;
+    finishStartupPipelines();
+    VKCHECK(vkDeviceWaitIdle(globals.device.device));
+    globals.pipeline_libraries = enabled;
+    recreateScenePipelines();
+}
+
+PipelineStats pipelineStats()
+{
+    finishStartupPipelines();
+    PipelineStats stats{};
+    stats.graphics_pipelines = graphicsPipelineCount(globals.pipelines);
+    stats.create_ms = globals.pipelines_create_ms;
+    stats.libraries = globals.pipelines.pipeline_libraries;
+    stats.library_parts_ms = globals.pipelines.library_parts_ms;
+    stats.fast_link_ms = globals.pipelines.fast_link_ms;
+    stats.optimised_link_ms = globals.optimised_link_ms;
+    return stats;
+}
+
+StartupStats startupStats() { return globals.startup; }
+
+RecoveryStats recoveryStats() { return globals.recovery; }
+
+GpuMemoryStats gpuMemoryStats()
+{
+    const MemoryStats memory = memoryStats(globals.device);
+    GpuMemoryStats stats{};
+    for (uint32_t heap = 0; heap < memory.heap_count; ++heap) {
+        stats.allocated_bytes += memory.heaps[heap].allocated;
+        stats.used_bytes += memory.heaps[heap].used;
+        if (memory.heaps[heap].device_local) {
+            stats.budget_bytes += memory.heaps[heap].budget;
+            stats.usage_bytes += memory.heaps[heap].usage;
+        }
+    }
+    stats.fragmentation = memory.fragmentation;
+    stats.moved_bytes = memory.bytes_moved;
+    return stats;
+}
+
+std::string gpuMemoryStatsJson() { return memoryStatsJson(memoryStats(globals.device)); }
+
+double lastFrameRenderGpuMs() { return globals.render_gpu_ms; }
+
+std::string getDeviceName() { return globals.device.properties.deviceName; }
+
+void shutdownHeadless() { destroyRenderer(); }
@@ -1,7 +1,207 @@
 #pragma once
 
-#include "framework.h"
+#include <cstdint>
 
-void initApp(HINSTANCE hInstance, HWND hWnd);
+#include <array>
+#include <string>
+
+#include "events.h"
+
+// requestFrameCapture() with this count keeps capturing until called again with 0
+constexpr uint32_t CAPTURE_CONTINUOUS = UINT32_MAX;
+
+struct CaptureSettings;
+struct DynamicResolutionSettings;
+class Window;
+
+constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 3;
+
+// The swapchain's present mode, if the surface supports it. FIFO otherwise, which every surface does.
+enum class PresentMode {
+    Mailbox,   // no tearing, frames are replaced while waiting rather than queued
+    Fifo,      // vsync
+    Immediate, // tears, for measuring the renderer without the display in the way
+};
+// "mailbox", "fifo" or "immediate"
+const char* presentModeName(PresentMode present_mode);
+bool parsePresentMode(const std::string& name, PresentMode& present_mode);
+
+// Fixed once the renderer has been created, see config.h for where they come from.
+struct RendererSettings {
+    std::string scene_path{};                        // a .vscene file written by SceneConverter, the built in triangle if empty
+    uint32_t instance_count = 1;                     // in the ring the scene starts with
+    uint32_t field_instances = 0;                    // starts with a SceneLayout::Field of these instead, unless 0
+    uint32_t frames_in_flight = 2;                   // 1 to MAX_FRAMES_IN_FLIGHT, how far the CPU may run ahead of the GPU
+    uint32_t worker_count = 0;                       // job system threads including the render thread, 0 for one per core
+    PresentMode present_mode = PresentMode::Mailbox;
+    uint32_t swapchain_images = 0;                   // 0 for one more than the surface needs, clamped to what it allows
+    std::string record_path{};                       // records the game loop's inputs to this file for --replay, see replay.h, unless empty
+    uint32_t simulate_device_lost = 0;               // drawing this frame number reports the device lost, to test recovering, 0 for never
+
+    bool operator==(const RendererSettings&) const = default;
+};
+
+// Presents to window, or renders offscreen if it is a headless window. The window must outlive the renderer.
+void initApp(const Window& window, const RendererSettings& settings = {});
 void startGameLoop();
-void endLoopAndShutdown();
\ No newline at end of file
+void requestFrameCapture(uint32_t frame_count);
+bool isCapturingFrames();
+// Window events for the render thread. Only the thread that processes window events may push to it.
+EventQueue& getEventQueue();
+void endLoopAndShutdown();
+
+// How the vertex shader gets vertices. Both render the same image, the fixed function path is kept for benchmarking.
+enum class VertexPath {
+    Pulling,       // fetched through a buffer device address
+    FixedFunction, // vertex input attributes
+};
+
+// How meshlets are culled before drawing. Each falls back to the next one down if the device or mesh cannot use it.
+enum class ClusterCulling {
+    MeshShader, // task shaders cull, mesh shaders draw what is left (VK_EXT_mesh_shader)
+    Compute,    // a compute pass writes an indirect draw per meshlet and instance (multiDrawIndirect)
+    Off,        // every submesh is drawn whole
+};
+
+// Where the instances are.
+enum class SceneLayout {
+    Ring,  // on top of each other at the origin, rotated evenly around the circle
+    Field, // a square grid much bigger than the view, in groups of cells that drift together, most of them standing still
+};
+
+struct SceneSettings {
+    uint32_t instance_count = 1;
+    SceneLayout layout = SceneLayout::Ring;
+    VertexPath vertex_path = VertexPath::Pulling;
+    ClusterCulling cluster_culling = ClusterCulling::Off;
+    bool instance_culling = true;  // frustum culls the field's instances against a BVH before building the draw list
+    bool depth_prepass = false;    // draws depth only first, then shades with an equal depth test so each pixel is shaded once
+    bool occlusion_culling = true; // also culls meshlets hidden behind the depth pyramid, only with cluster culling
+};
+
+// Replaces the instances and restarts the animation. Call before startGameLoop(), or between headless frames.
+void resetScene(const SceneSettings& settings);
+
+// Commands in the last frame recorded, after binds that would not have changed anything were skipped.
+struct DrawCounters {
+    uint32_t pipeline_binds = 0;
+    uint32_t descriptor_binds = 0;
+    uint32_t draws = 0;            // draw commands, an indirect draw or mesh task draw is one however many draws it launches
+    uint32_t batches = 0;          // runs of draws sharing all their state, see draw_list.h
+    uint32_t depth_state_sets = 0; // DepthMode changes made with extended dynamic state rather than a pipeline bind
+};
+DrawCounters lastFrameDrawCounters();
+
+// GPU time in milliseconds between the start and end of rendering in the last frame retired, 0 if the queue has no timestamps
+double lastFrameRenderGpuMs();
+
+// Scales the render extent to keep lastFrameRenderGpuMs() near a target, the image is upscaled into the swapchain image.
+// Off by default. Call before startGameLoop(), or between headless frames.
+void setDynamicResolution(const DynamicResolutionSettings& settings);
+// fraction of the swapchain width the next frame is drawn at, 1 if the swapchain images cannot be blitted to
+float currentResolutionScale();
+
+// Anti-aliasing quality tiers, cheapest first. The MSAA tiers fall back to the highest sample count the device supports, and turn
+// occlusion culling off if the device cannot resolve depth to the farthest sample.
+enum class AntiAliasing {
+    Off,
+    PostProcess,    // an FXAA style pass over the finished image, which also does the dynamic resolution upscale
+    Msaa2,          // multisampled color and depth, resolved at the end of rendering
+    Msaa4,
+    Msaa8,
+    SampleShading4, // Msaa4 with the fragment shader run for every sample, Msaa4 without Device::sampleRateShading
+};
+
+// Off by default. Waits for the device to go idle and recreates the pipelines, so not for every frame.
+// Call before startGameLoop(), or between headless frames.
+void setAntiAliasing(AntiAliasing anti_aliasing);
+// the tier actually in use after falling back
+AntiAliasing currentAntiAliasing();
+// "off", "post", "msaa2", "msaa4", "msaa8" or "sample_shading4", for command lines and benchmark results
+const char* antiAliasingName(AntiAliasing anti_aliasing);
+bool parseAntiAliasing(const std::string& name, AntiAliasing& anti_aliasing);
+// Memory of the multisampled attachments, 0 without MSAA. An upper bound where they are lazily allocated and the device only
+// commits what it touches, as tilers do.
+uint64_t antiAliasingMemoryBytes();
+
+// Settings the game loop picks up at the start of its next frame, so they can be changed while it runs.
+struct LiveSettings {
+    uint32_t fps_limit = 240;                                 // 0 for as fast as presenting allows
+    std::array<float, 4> clear_color{1.0f, 1.0f, 1.0f, 1.0f}; // linear RGBA
+    double dynamic_resolution_ms = 0.0;                       // setDynamicResolution() with this target_gpu_ms, 0 turns it off
+    AntiAliasing anti_aliasing = AntiAliasing::Off;           // the device goes idle for a frame when it changes
+};
+// From any thread, the settings last set win if the game loop has not picked up the ones before
+void setLiveSettings(const LiveSettings& settings);
+
+// On by default. With extended dynamic state the depth, cull and topology state is set while recording and the depth modes share
+// pipelines, otherwise each has its own pipeline with the state baked in. Waits for the device to go idle and recreates the pipelines.
+void setExtendedDynamicState(bool enabled);
+
+// On by default, where the device has VK_EXT_graphics_pipeline_library with fast linking. The scene pipelines are fast linked from
+// separately compiled parts, then linked again with link time optimisation on another thread and swapped in when that finishes.
+// Otherwise each is compiled whole. Waits for the device to go idle and recreates the pipelines.
+void setPipelineLibraries(bool enabled);
+
+struct PipelineStats {
+    uint32_t graphics_pipelines = 0; // distinct pipeline objects
+    double create_ms = 0.0;          // CPU time the last createPipelines() took, graphics and compute
+    bool libraries = false;          // the scene pipelines were linked from pipeline library parts
+    double library_parts_ms = 0.0;   // of create_ms, compiling the parts
+    double fast_link_ms = 0.0;       // of create_ms, linking the scene pipelines from them
+    double optimised_link_ms = 0.0;  // the optimised link on its own thread, 0 until it has been swapped in
+};
+PipelineStats pipelineStats();
+
+// Where the time from initApp() or initHeadless() to the first frame went. The scene file is mapped from the start and the pipelines
+// are compiled once the device exists, each on a thread of its own, so those overlap the other phases.
+struct StartupStats {
+    double instance_ms = 0.0;
+    double device_ms = 0.0;
+    double swapchain_ms = 0.0;         // or the offscreen images
+    double frame_resources_ms = 0.0;   // command buffers, sync objects, descriptors and render targets
+    double mesh_upload_ms = 0.0;       // including waiting for the scene file
+    double scene_map_ms = 0.0;         // on its own thread, 0 for the built in triangle
+    double pipelines_ms = 0.0;         // on its own thread, loading the pipeline cache and compiling
+    double pipeline_wait_ms = 0.0;     // the first frame, or whatever needed them first, spent waiting for them
+    uint64_t pipeline_cache_bytes = 0; // saved by the last run and loaded, 0 if the cache was cold
+    double init_ms = 0.0;              // until initApp() or initHeadless() returned
+    double first_frame_ms = 0.0;       // until the first frame was submitted, 0 before then
+};
+StartupStats startupStats();
+
+// Device memory the renderer has allocated. Small buffers share blocks, which are defragmented a few megabytes a frame by moving buffers
+// out of the emptiest block into the others.
+struct GpuMemoryStats {
+    uint64_t allocated_bytes = 0; // VkDeviceMemory objects, in every heap
+    uint64_t used_bytes = 0;      // by resources within them
+    uint64_t budget_bytes = 0;    // of the device local heaps, what VK_EXT_memory_budget says the process can use
+    uint64_t usage_bytes = 0;     // of the device local heaps, by the whole process
+    double fragmentation = 0.0;   // of the free space in shared blocks, 0 while each block's is one range
+    uint64_t moved_bytes = 0;     // by defragmentation since startup
+};
+GpuMemoryStats gpuMemoryStats();
+// every heap and category with the block and fragmentation numbers, as a JSON object
+std::string gpuMemoryStatsJson();
+
+// Driver resets, GPU hangs and window system changes the renderer has survived. A lost device is rebuilt in place with everything made
+// from it, keeping the scene and settings. A lost surface only needs a new surface and swapchain.
+struct RecoveryStats {
+    uint32_t device_lost = 0;
+    uint32_t surface_lost = 0;
+    double last_recovery_ms = 0.0; // rebuilding after the last of either
+};
+RecoveryStats recoveryStats();
+// Fault injection: the next frame waits for the device to go idle and then fails with VK_ERROR_DEVICE_LOST instead of drawing, so the
+// device is rebuilt as after a real loss. From the render thread, or between headless frames.
+void simulateDeviceLost();
+
+// Headless rendering into offscreen images, no window or surface is created.
+// Frames are drawn synchronously on the calling thread. Used by the benchmark suite and replays.
+void initHeadless(uint32_t width, uint32_t height, const CaptureSettings& capture_settings, const RendererSettings& settings = {});
+void resizeHeadless(uint32_t width, uint32_t height);
+// Picks up pushed events and live settings first, as a frame of the game loop does. Returns the CPU time in milliseconds spent recording it.
+double drawHeadlessFrame(double dt);
+void flushFrameCapture(); // waits until every captured frame has been handed to the capture callback
+std::string getDeviceName();
+void shutdownHeadless();
\ No newline at end of file
@@ -0,0 +1,749 @@
+#include "benchmark.h"
+
+#include <cinttypes>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <regex>
+#include <sstream>
+#include <tuple>
+
+#ifdef _WIN32
+#include "framework.h"
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#include "alloc_counter.h"
+#include "app.h"
+#include "dynamic_resolution.h"
+#include "error.h"
+#include "image_file.h"
+#include "json.h"
+#include "spatial_index.h"
+#include "vulkan_capture.h"
+
+struct BenchmarkOptions {
+    std::string golden_dir = "golden";
+    std::string output_path = "benchmark_results.json";
+    std::string memory_output_path = "benchmark_memory.json";
+    std::string baseline_path{};
+    double tolerance = 0.1;
+    bool update_golden = false;
+    uint32_t frames = 300;
+    uint32_t stress_instances = 10000;
+};
+
+struct Scene {
+    std::string name;
+    SceneSettings settings{};
+    bool resize_churn = false;
+    std::string golden_name{}; // compare against another scene's golden image instead of having one of its own
+    DynamicResolutionSettings dynamic_resolution{};
+    AntiAliasing anti_aliasing = AntiAliasing::Off;
+    bool extended_dynamic_state = true;
+    bool pipeline_libraries = true;
+    bool device_lost = false; // simulateDeviceLost() halfway through, rendering must carry on on the rebuilt device
+};
+
+struct SceneResult {
+    std::string name{};
+    uint32_t frames = 0;
+    double frame_ms_mean = 0.0;
+    double frame_ms_p95 = 0.0;
+    double frame_ms_max = 0.0;
+    double record_ms_mean = 0.0;
+    double record_ms_p95 = 0.0;
+    double render_gpu_ms_mean = 0.0; // 0 if the device has no timestamps
+    double peak_memory_growth_mb = 0.0; // most the resident set grew above what it was when the scene started
+    uint64_t heap_allocations = 0;      // made by the render thread in warmed up frames, any fails the scene
+    uint32_t device_lost = 0;           // times the device was rebuilt during the scene, anything but what the scene simulated fails it
+    std::string anti_aliasing{}; // the tier used after any fallback
+    double aa_memory_mb = 0.0;   // multisampled attachments, see antiAliasingMemoryBytes()
+    DrawCounters counters{};     // of the last frame
+    PipelineStats pipelines{};
+    GpuMemoryStats gpu_memory{}; // after the last frame
+    std::string golden{};    // "pass", "fail" or "updated"
+    double golden_mismatch = 0.0;
+    std::vector<std::string> regressions{};
+};
+
+// initHeadless() up to its first frame, named "startup" in the results so a baseline can be compared against
+struct StartupResult {
+    StartupStats stats{};
+    std::vector<std::string> regressions{};
+};
+
+// CPU only, the BVH behind instance culling on its own with no rendering
+struct SpatialResult {
+    std::string name{};
+    uint32_t objects = 0;
+    double build_ms = 0.0;
+    double refit_ms = 0.0; // every object moved
+    double query_ms = 0.0; // a view holding about 1% of the objects
+    double pick_us = 0.0;
+    uint64_t visible = 0;
+    uint32_t picked = 0; // picks that hit something
+    std::vector<std::string> regressions{};
+};
+
+// the frame captured at the end of each scene, written by the capture encoder thread
+struct CapturedImage {
+    std::mutex mutex{};
+    std::vector<uint8_t> rgba{};
+    uint32_t width = 0;
+    uint32_t height = 0;
+};
+
+constexpr uint32_t WIDTH = 768;
+constexpr uint32_t HEIGHT = 768;
+constexpr uint32_t WARMUP_FRAMES = 10;
+constexpr double FIXED_DT = 1.0 / 60.0; // fixed timestep so every run renders exactly the same frames
+
+// sizes cycled through by the resize churn scene
+constexpr std::array<VkExtent2D, 4> CHURN_SIZES{VkExtent2D{1280, 720}, VkExtent2D{640, 480}, VkExtent2D{1024, 1024}, VkExtent2D{WIDTH, HEIGHT}};
+constexpr uint32_t CHURN_INTERVAL = 10; // frames between resizes
+
+// objects in the spatial index benchmarks
+constexpr std::array<uint32_t, 3> SPATIAL_SIZES{10'000, 100'000, 1'000'000};
+constexpr uint32_t SPATIAL_ITERATIONS = 20;
+constexpr uint32_t SPATIAL_PICKS = 1000;
+
+// golden comparison allows small per-channel differences between drivers
+constexpr int PIXEL_TOLERANCE = 3;
+constexpr double MISMATCH_TOLERANCE = 0.001; // fraction of pixels allowed to differ by more than PIXEL_TOLERANCE
+
+bool benchmarkRequested(const std::vector<std::string>& args) { return std::find(args.begin(), args.end(), "--benchmark") != args.end(); }
+
+static BenchmarkOptions parseOptions(const std::vector<std::string>& args)
+{
+    BenchmarkOptions options{};
+    for (size_t i = 0; i < args.size(); ++i) {
+        const std::string& arg = args[i];
+        const auto value = [&]() -> const std::string& {
+            if (i + 1 >= args.size()) throw Error("Missing value for " + arg);
+            return args[++i];
+        };
+        try {
+            if (arg == "--benchmark") continue;
+            else if (arg == "--golden-dir") options.golden_dir = value();
+            else if (arg == "--update-golden") options.update_golden = true;
+            else if (arg == "--output") options.output_path = value();
+            else if (arg == "--memory-output") options.memory_output_path = value();
+            else if (arg == "--baseline") options.baseline_path = value();
+            else if (arg == "--tolerance") options.tolerance = std::stod(value());
+            else if (arg == "--frames") options.frames = static_cast<uint32_t>(std::stoul(value()));
+            else if (arg == "--instances") options.stress_instances = static_cast<uint32_t>(std::stoul(value()));
+            else throw Error("Unknown benchmark option " + arg);
+        }
+        catch (const std::logic_error&) { // std::stoul and friends
+            throw Error("Invalid value for " + arg);
+        }
+    }
+    if (options.frames == 0) throw Error("--frames must be at least 1, the last frame is compared against the golden image");
+    return options;
+}
+
+// since the process started, never falls
+static double peakMemoryMB()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters{};
+    counters.cb = sizeof(counters);
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) == FALSE) return 0.0;
+    return static_cast<double>(counters.PeakWorkingSetSize) / (1024.0 * 1024.0);
+#else
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0.0;
+    return static_cast<double>(usage.ru_maxrss) / 1024.0; // kilobytes on Linux
+#endif
+}
+
+static double residentMemoryMB()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters{};
+    counters.cb = sizeof(counters);
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) == FALSE) return 0.0;
+    return static_cast<double>(counters.WorkingSetSize) / (1024.0 * 1024.0);
+#else
+    // the second field is the resident size in pages
+    std::FILE* statm = std::fopen("/proc/self/statm", "r");
+    if (statm == nullptr) return 0.0;
+    unsigned long long size = 0, resident = 0;
+    const int fields = std::fscanf(statm, "%llu %llu", &size, &resident);
+    std::fclose(statm);
+    if (fields != 2) return 0.0;
+    return static_cast<double>(resident) * static_cast<double>(sysconf(_SC_PAGESIZE)) / (1024.0 * 1024.0);
+#endif
+}
+
+static double megabytes(uint64_t bytes) { return static_cast<double>(bytes) / (1024.0 * 1024.0); }
+
+static double percentile(std::vector<double> values, double p)
+{
+    if (values.empty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    const size_t index = static_cast<size_t>(std::ceil(p * static_cast<double>(values.size()))) - 1;
+    return values[std::min(index, values.size() - 1)];
+}
+
+static double mean(const std::vector<double>& values)
+{
+    if (values.empty()) return 0.0;
+    double sum = 0.0;
+    for (double v : values) sum += v;
+    return sum / static_cast<double>(values.size());
+}
+
+// fraction of pixels that differ by more than PIXEL_TOLERANCE in any channel, or 1.0 if the sizes differ
+static double compareImages(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b)
+{
+    if (a.size() != b.size() || a.empty()) return 1.0;
+    size_t mismatched = 0;
+    for (size_t i = 0; i < a.size(); i += 4) {
+        for (size_t c = 0; c < 3; ++c) {
+            if (std::abs(static_cast<int>(a[i + c]) - static_cast<int>(b[i + c])) > PIXEL_TOLERANCE) {
+                ++mismatched;
+                break;
+            }
+        }
+    }
+    return static_cast<double>(mismatched) / static_cast<double>(a.size() / 4);
+}
+
+static SceneResult runScene(const Scene& scene, const BenchmarkOptions& options, CapturedImage& captured)
+{
+    SceneResult result{};
+    result.name = scene.name;
+    result.frames = options.frames;
+
+    // the process peak only ever grows, so each scene is charged with what it adds to what the scenes before it left resident
+    const double start_memory_mb = residentMemoryMB();
+    double peak_memory_mb = start_memory_mb;
+
+    resizeHeadless(WIDTH, HEIGHT);
+    setDynamicResolution(scene.dynamic_resolution);
+    setAntiAliasing(scene.anti_aliasing);
+    setExtendedDynamicState(scene.extended_dynamic_state);
+    setPipelineLibraries(scene.pipeline_libraries);
+    resetScene(scene.settings);
+
+    for (uint32_t i = 0; i < WARMUP_FRAMES; ++i) {
+        drawHeadlessFrame(FIXED_DT);
+    }
+
+    // nothing captured before this scene's last frame may stand in for it, a capture still pending from the last scene included
+    requestFrameCapture(0);
+    flushFrameCapture();
+    {
+        std::lock_guard lock(captured.mutex);
+        captured.rgba.clear();
+        captured.width = 0;
+        captured.height = 0;
+    }
+
+    std::vector<double> frame_ms{};
+    std::vector<double> record_ms{};
+    std::vector<double> render_gpu_ms{};
+    frame_ms.reserve(options.frames);
+    record_ms.reserve(options.frames);
+    render_gpu_ms.reserve(options.frames);
+    const uint32_t device_lost_before = recoveryStats().device_lost;
+    const uint32_t device_lost_frame = options.frames / 2;
+    for (uint32_t i = 0; i < options.frames; ++i) {
+        const auto begin = std::chrono::steady_clock::now();
+        const bool resized = scene.resize_churn && i % CHURN_INTERVAL == 0;
+        if (resized) {
+            const VkExtent2D size = CHURN_SIZES[(i / CHURN_INTERVAL) % CHURN_SIZES.size()];
+            resizeHeadless(size.width, size.height);
+        }
+        const bool device_lost = scene.device_lost && i == device_lost_frame;
+        if (device_lost) {
+            // the lost frame rebuilds the device instead of drawing, and is drawn again below so the last frame matches the golden image
+            simulateDeviceLost();
+            drawHeadlessFrame(FIXED_DT);
+        }
+        if (i + 1 == options.frames) {
+            requestFrameCapture(1); // the last frame is compared against the golden image
+        }
+        // as in the game loop, frames that capture or follow a resize are not warmed up, nor are those on a new device
+        const bool rebuilt = scene.device_lost && i >= device_lost_frame && i < device_lost_frame + WARMUP_FRAMES;
+        const bool warmed_up = !resized && !rebuilt && i + 1 != options.frames;
+        const uint64_t allocations_before = threadHeapAllocationCount();
+        const double frame_record_ms = drawHeadlessFrame(FIXED_DT);
+        if (warmed_up) result.heap_allocations += threadHeapAllocationCount() - allocations_before;
+        record_ms.push_back(frame_record_ms);
+        render_gpu_ms.push_back(lastFrameRenderGpuMs()); // lags a frame or two behind, the warm up frames cover that
+        frame_ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count());
+        peak_memory_mb = std::max(peak_memory_mb, residentMemoryMB()); // outside the frame time
+    }
+    flushFrameCapture();
+    result.device_lost = recoveryStats().device_lost - device_lost_before;
+
+    result.frame_ms_mean = mean(frame_ms);
+    result.frame_ms_p95 = percentile(frame_ms, 0.95);
+    result.frame_ms_max = frame_ms.empty() ? 0.0 : *std::max_element(frame_ms.begin(), frame_ms.end());
+    result.record_ms_mean = mean(record_ms);
+    result.record_ms_p95 = percentile(record_ms, 0.95);
+    result.render_gpu_ms_mean = mean(render_gpu_ms);
+    result.peak_memory_growth_mb = std::max(peak_memory_mb, residentMemoryMB()) - start_memory_mb;
+    result.anti_aliasing = antiAliasingName(currentAntiAliasing());
+    result.aa_memory_mb = megabytes(antiAliasingMemoryBytes());
+    result.counters = lastFrameDrawCounters();
+    result.pipelines = pipelineStats();
+    result.gpu_memory = gpuMemoryStats();
+
+    { // golden image comparison
+        std::lock_guard lock(captured.mutex);
+        if (captured.rgba.empty()) throw Error("The last frame of " + scene.name + " was not captured, the device could not read it back");
+        const bool shared_golden = !scene.golden_name.empty(); // always compared, it was written by an earlier scene
+        const std::string golden_path = options.golden_dir + "/" + (shared_golden ? scene.golden_name : scene.name) + ".ppm";
+
+        std::vector<uint8_t> golden{};
+        uint32_t golden_width = 0, golden_height = 0;
+        if (options.update_golden && !shared_golden) {
+            if (!writePPM(golden_path, captured.rgba.data(), captured.width, captured.height)) {
+                throw Error("Failed to write golden image " + golden_path);
+            }
+            result.golden = "updated";
+        }
+        else if (!readPPM(golden_path, golden, golden_width, golden_height)) {
+            throw Error("Missing golden image " + golden_path + ", run with --update-golden to create it");
+        }
+        else {
+            result.golden_mismatch = (golden_width == captured.width && golden_height == captured.height) ? compareImages(golden, captured.rgba) : 1.0;
+            if (result.golden_mismatch > MISMATCH_TOLERANCE) {
+                result.golden = "fail";
+                // keep the output around to diff against the golden image
+                writePPM(options.golden_dir + "/" + scene.name + ".actual.ppm", captured.rgba.data(), captured.width, captured.height);
+            }
+            else {
+                result.golden = "pass";
+            }
+        }
+    }
+
+    return result;
+}
+
+// Objects spread over a square like the field scene, with a little depth, moved a short way in a random direction every iteration.
+static SpatialResult runSpatialBenchmark(uint32_t object_count)
+{
+    SpatialResult result{};
+    result.name = "bvh_" + std::to_string(object_count);
+    result.objects = object_count;
+
+    std::mt19937 rng(object_count); // the same objects every run
+    const float half_width = 0.5f * std::sqrt(static_cast<float>(object_count));
+    std::uniform_real_distribution<float> position(-half_width, half_width);
+    std::uniform_real_distribution<float> depth(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> step(-0.05f, 0.05f);
+    constexpr float RADIUS = 0.2f;
+
+    std::vector<Aabb> bounds(object_count);
+    for (Aabb& box : bounds) {
+        const std::array<float, 3> center{position(rng), position(rng), depth(rng)};
+        for (int axis = 0; axis < 3; ++axis) {
+            box.min[axis] = center[axis] - RADIUS;
+            box.max[axis] = center[axis] + RADIUS;
+        }
+    }
+
+    Bvh bvh{};
+    {
+        const auto begin = std::chrono::steady_clock::now();
+        buildBvh(bvh, bounds);
+        result.build_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    }
+
+    // orthographic, looking down -z at a tenth of the width
+    std::array<float, 16> view_proj{};
+    view_proj[0] = 10.0f / half_width;
+    view_proj[5] = 10.0f / half_width;
+    view_proj[10] = -0.5f;
+    view_proj[14] = 0.5f;
+    view_proj[15] = 1.0f;
+    const Frustum frustum = frustumFromViewProj(view_proj.data());
+
+    std::vector<double> refit_ms{};
+    std::vector<double> query_ms{};
+    std::vector<BvhRange> ranges{};
+    for (uint32_t iteration = 0; iteration < SPATIAL_ITERATIONS; ++iteration) {
+        for (Aabb& box : bounds) {
+            const std::array<float, 2> offset{step(rng), step(rng)};
+            for (int axis = 0; axis < 2; ++axis) {
+                box.min[axis] += offset[axis];
+                box.max[axis] += offset[axis];
+            }
+        }
+
+        const auto begin_refit = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < object_count; ++i) {
+            updateBvhItem(bvh, i, bounds[i]);
+        }
+        refitBvh(bvh);
+        const auto begin_query = std::chrono::steady_clock::now();
+        ranges.clear();
+        queryBvh(bvh, frustum, ranges);
+        const auto end = std::chrono::steady_clock::now();
+
+        refit_ms.push_back(std::chrono::duration<double, std::milli>(begin_query - begin_refit).count());
+        query_ms.push_back(std::chrono::duration<double, std::milli>(end - begin_query).count());
+    }
+    result.refit_ms = mean(refit_ms);
+    result.query_ms = mean(query_ms);
+    for (const BvhRange& range : ranges) {
+        result.visible += range.count;
+    }
+
+    // rays straight down through random points, most of which miss
+    std::vector<std::array<float, 3>> origins(SPATIAL_PICKS);
+    for (auto& origin : origins) {
+        origin = {position(rng), position(rng), 2.0f};
+    }
+    const std::array<float, 3> direction{0.0f, 0.0f, -1.0f};
+    const auto begin_pick = std::chrono::steady_clock::now();
+    for (const auto& origin : origins) {
+        uint32_t item = 0;
+        float t = 0.0f;
+        if (pickBvh(bvh, origin.data(), direction.data(), 4.0f, item, t)) ++result.picked;
+    }
+    result.pick_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin_pick).count() / SPATIAL_PICKS;
+
+    return result;
+}
+
+// Reads the numeric fields of each scene back out of a results file written by writeResults(). Not a general JSON parser.
+static std::map<std::string, std::map<std::string, double>> readBaseline(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file) throw Error("Failed to open baseline " + path);
+    std::stringstream buffer{};
+    buffer << file.rdbuf();
+    const std::string text = buffer.str();
+
+    std::map<std::string, std::map<std::string, double>> scenes{};
+    const std::regex name_regex("\"name\": \"([^\"]+)\"");
+    const std::regex number_regex("\"([a-z0-9_]+)\": (-?[0-9.]+(?:[eE][-+]?[0-9]+)?)");
+    for (auto it = std::sregex_iterator(text.begin(), text.end(), name_regex); it != std::sregex_iterator(); ++it) {
+        const size_t begin = static_cast<size_t>(it->position());
+        const size_t end = text.find('}', begin);
+        const std::string block = text.substr(begin, end - begin);
+        auto& values = scenes[(*it)[1].str()];
+        for (auto num = std::sregex_iterator(block.begin(), block.end(), number_regex); num != std::sregex_iterator(); ++num) {
+            values[(*num)[1].str()] = std::stod((*num)[2].str());
+        }
+    }
+    return scenes;
+}
+
+// metrics are (key, value, absolute slack), the slack stops sub-millisecond noise from failing the run
+template <size_t N>
+static void checkMetrics(const std::array<std::tuple<const char*, double, double>, N>& metrics, const std::map<std::string, double>& baseline,
+                         double tolerance, std::vector<std::string>& regressions)
+{
+    for (const auto& [key, value, slack] : metrics) {
+        const auto it = baseline.find(key);
+        if (it == baseline.end()) continue;
+        if (value > it->second * (1.0 + tolerance) + slack) {
+            regressions.emplace_back(key);
+        }
+    }
+}
+
+static void checkRegressions(SceneResult& result, const std::map<std::string, double>& baseline, double tolerance)
+{
+    const std::array<std::tuple<const char*, double, double>, 5> metrics{
+        std::make_tuple("frame_ms_mean", result.frame_ms_mean, 0.05),
+        std::make_tuple("frame_ms_p95", result.frame_ms_p95, 0.1),
+        std::make_tuple("record_ms_mean", result.record_ms_mean, 0.05),
+        std::make_tuple("render_gpu_ms_mean", result.render_gpu_ms_mean, 0.05),
+        std::make_tuple("peak_memory_growth_mb", result.peak_memory_growth_mb, 2.0),
+    };
+    checkMetrics(metrics, baseline, tolerance, result.regressions);
+}
+
+static void checkRegressions(StartupResult& result, const std::map<std::string, double>& baseline, double tolerance)
+{
+    const std::array<std::tuple<const char*, double, double>, 2> metrics{
+        std::make_tuple("init_ms", result.stats.init_ms, 5.0),
+        std::make_tuple("first_frame_ms", result.stats.first_frame_ms, 5.0),
+    };
+    checkMetrics(metrics, baseline, tolerance, result.regressions);
+}
+
+static void checkRegressions(SpatialResult& result, const std::map<std::string, double>& baseline, double tolerance)
+{
+    const std::array<std::tuple<const char*, double, double>, 4> metrics{
+        std::make_tuple("build_ms", result.build_ms, 1.0),
+        std::make_tuple("refit_ms", result.refit_ms, 0.1),
+        std::make_tuple("query_ms", result.query_ms, 0.01),
+        std::make_tuple("pick_us", result.pick_us, 0.5),
+    };
+    checkMetrics(metrics, baseline, tolerance, result.regressions);
+}
+
+static void writeRegressions(std::ofstream& file, const std::vector<std::string>& regressions)
+{
+    file << "      \"regressions\": [";
+    for (size_t j = 0; j < regressions.size(); ++j) {
+        file << (j == 0 ? "\"" : ", \"") << jsonEscape(regressions[j]) << "\"";
+    }
+    file << "]\n";
+}
+
+static void writeResults(const std::string& path, const StartupResult& startup, const RecoveryStats& recovery, const std::vector<SceneResult>& results,
+                         const std::vector<SpatialResult>& spatial_results)
+{
+    std::ofstream file(path);
+    if (!file) throw Error("Failed to write " + path);
+
+    std::array<char, 256> line{};
+    file << "{\n";
+    file << "  \"device\": \"" << jsonEscape(getDeviceName()) << "\",\n";
+    snprintf(line.data(), line.size(), "  \"device_lost\": %u,\n  \"surface_lost\": %u,\n", recovery.device_lost, recovery.surface_lost);
+    file << line.data();
+    // not compared against the baseline, it is whichever scene needed the most
+    snprintf(line.data(), line.size(), "  \"process_peak_memory_mb\": %.2f,\n", peakMemoryMB());
+    file << line.data();
+    { // laid out like a scene so readBaseline() finds it
+        const StartupStats& stats = startup.stats;
+        file << "  \"startup\": [\n";
+        file << "    {\n";
+        file << "      \"name\": \"startup\",\n";
+        snprintf(line.data(), line.size(), "      \"init_ms\": %.3f,\n      \"first_frame_ms\": %.3f,\n", stats.init_ms, stats.first_frame_ms);
+        file << line.data();
+        snprintf(line.data(), line.size(), "      \"instance_ms\": %.3f,\n      \"device_ms\": %.3f,\n      \"swapchain_ms\": %.3f,\n", stats.instance_ms,
+                 stats.device_ms, stats.swapchain_ms);
+        file << line.data();
+        snprintf(line.data(), line.size(), "      \"frame_resources_ms\": %.3f,\n      \"mesh_upload_ms\": %.3f,\n      \"scene_map_ms\": %.3f,\n",
+                 stats.frame_resources_ms, stats.mesh_upload_ms, stats.scene_map_ms);
+        file << line.data();
+        snprintf(line.data(), line.size(), "      \"pipelines_ms\": %.3f,\n      \"pipeline_wait_ms\": %.3f,\n      \"pipeline_cache_kb\": %.1f,\n",
+                 stats.pipelines_ms, stats.pipeline_wait_ms, static_cast<double>(stats.pipeline_cache_bytes) / 1024.0);
+        file << line.data();
+        writeRegressions(file, startup.regressions);
+        file << "    }\n";
+        file << "  ],\n";
+    }
+    file << "  \"scenes\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const SceneResult& r = results[i];
+        file << "    {\n";
+        file << "      \"name\": \"" << jsonEscape(r.name) << "\",\n";
+        snprintf(line.data(), line.size(), "      \"frames\": %u,\n", r.frames);
+        file << line.data();
+        snprintf(line.data(), line.size(), "      \"frame_ms_mean\": %.4f,\n      \"frame_ms_p95\": %.4f,\n      \"frame_ms_max\": %.4f,\n", r.frame_ms_mean,
+                 r.frame_ms_p95, r.frame_ms_max);
+        file << line.data();
+        snprintf(line.data(), line.size(), "      \"record_ms_mean\": %.4f,\n      \"record_ms_p95\": %.4f,\n", r.record_ms_mean, r.record_ms_p95);
+        file << line.data();
+        snprintf(line.data(), line.size(), "      \"render_gpu_ms_mean\": %.4f,\n", r.render_gpu_ms_mean);
+        file << line.data();
+        snprintf(line.data(), line.size(), "      \"peak_memory_growth_mb\": %.2f,\n", r.peak_memory_growth_mb);
+        file << line.data();
+        snprintf(line.data(), line.size(), "      \"heap_allocations\": %" PRIu64 ",\n      \"device_lost\": %u,\n", r.heap_allocations, r.device_lost);
+        file << line.data();
+        file << "      \"anti_aliasing\": \"" << r.anti_aliasing << "\",\n";
+        snprintf(line.data(), line.size(), "      \"aa_memory_mb\": %.2f,\n", r.aa_memory_mb);
+        file << line.data();
+        snprintf(line.data(), line.size(), "      \"pipeline_binds\": %u,\n      \"descriptor_binds\": %u,\n      \"draws\": %u,\n      \"batches\": %u,\n",
+                 r.counters.pipeline_binds, r.counters.descriptor_binds, r.counters.draws, r.counters.batches);
+        file << line.data();
+        snprintf(line.data(), line.size(), "      \"depth_state_sets\": %u,\n      \"graphics_pipelines\": %u,\n      \"pipeline_create_ms\": %.3f,\n",
+                 r.counters.depth_state_sets, r.pipelines.graphics_pipelines, r.pipelines.create_ms);
+        file << line.data();
+        file << "      \"pipeline_libraries\": " << (r.pipelines.libraries ? "true" : "false") << ",\n";
+        snprintf(line.data(), line.size(), "      \"library_parts_ms\": %.3f,\n      \"fast_link_ms\": %.3f,\n      \"optimised_link_ms\": %.3f,\n",
+                 r.pipelines.library_parts_ms, r.pipelines.fast_link_ms, r.pipelines.optimised_link_ms);
+        file << line.data();
+        snprintf(line.data(), line.size(), "      \"gpu_memory_mb\": %.2f,\n      \"gpu_memory_used_mb\": %.2f,\n      \"gpu_budget_mb\": %.2f,\n",
+                 megabytes(r.gpu_memory.allocated_bytes), megabytes(r.gpu_memory.used_bytes), megabytes(r.gpu_memory.budget_bytes));
+        file << line.data();
+        snprintf(line.data(), line.size(), "      \"memory_fragmentation\": %.4f,\n      \"defragment_moved_mb\": %.2f,\n", r.gpu_memory.fragmentation,
+                 megabytes(r.gpu_memory.moved_bytes));
+        file << line.data();
+        snprintf(line.data(), line.size(), "      \"golden_mismatch\": %.6f,\n", r.golden_mismatch);
+        file << line.data();
+        file << "      \"golden\": \"" << r.golden << "\",\n";
+        writeRegressions(file, r.regressions);
+        file << (i + 1 == results.size() ? "    }\n" : "    },\n");
+    }
+    file << "  ],\n";
+    file << "  \"spatial\": [\n";
+    for (size_t i = 0; i < spatial_results.size(); ++i) {
+        const SpatialResult& r = spatial_results[i];
+        file << "    {\n";
+        file << "      \"name\": \"" << jsonEscape(r.name) << "\",\n";
+        snprintf(line.data(), line.size(), "      \"objects\": %u,\n      \"visible\": %" PRIu64 ",\n      \"picked\": %u,\n", r.objects, r.visible,
+                 r.picked);
+        file << line.data();
+        snprintf(line.data(), line.size(), "      \"build_ms\": %.4f,\n      \"refit_ms\": %.4f,\n      \"query_ms\": %.4f,\n      \"pick_us\": %.4f,\n",
+                 r.build_ms, r.refit_ms, r.query_ms, r.pick_us);
+        file << line.data();
+        writeRegressions(file, r.regressions);
+        file << (i + 1 == spatial_results.size() ? "    }\n" : "    },\n");
+    }
+    file << "  ]\n";
+    file << "}\n";
+}
+
+int runBenchmarks(const std::vector<std::string>& args)
+{
+    try {
+        const BenchmarkOptions options = parseOptions(args);
+
+        const std::string stress_name = "stress_" + std::to_string(options.stress_instances);
+        const std::string field_name = "field_" + std::to_string(options.stress_instances);
+        const uint32_t n = options.stress_instances;
+        const std::vector<Scene> scenes{
+            Scene{"triangle"},
+            Scene{stress_name, SceneSettings{n}},
+            // the fixed function vertex input path must draw exactly what vertex pulling does
+            Scene{stress_name + "_vertex_input", SceneSettings{n, SceneLayout::Ring, VertexPath::FixedFunction}, false, stress_name},
+            // meshlet culling must only remove what would not have been visible anyway
+            Scene{stress_name + "_cluster_compute", SceneSettings{n, SceneLayout::Ring, VertexPath::Pulling, ClusterCulling::Compute}, false, stress_name},
+            Scene{stress_name + "_cluster_mesh_shader", SceneSettings{n, SceneLayout::Ring, VertexPath::Pulling, ClusterCulling::MeshShader}, false,
+                  stress_name},
+            // both of the above occlusion cull, these show what that costs or saves
+            Scene{stress_name + "_cluster_compute_no_occlusion",
+                  SceneSettings{n, SceneLayout::Ring, VertexPath::Pulling, ClusterCulling::Compute, true, false, false}, false, stress_name},
+            Scene{stress_name + "_cluster_mesh_shader_no_occlusion",
+                  SceneSettings{n, SceneLayout::Ring, VertexPath::Pulling, ClusterCulling::MeshShader, true, false, false}, false, stress_name},
+            // the depth prepass only changes how many fragments are shaded, compare render_gpu_ms_mean with the scene without it
+            Scene{stress_name + "_depth_prepass", SceneSettings{n, SceneLayout::Ring, VertexPath::Pulling, ClusterCulling::Off, true, true}, false,
+                  stress_name},
+            // and so must instance culling
+            Scene{field_name, SceneSettings{n, SceneLayout::Field}},
+            Scene{field_name + "_unculled", SceneSettings{n, SceneLayout::Field, VertexPath::Pulling, ClusterCulling::Off, false}, false, field_name},
+            Scene{field_name + "_depth_prepass", SceneSettings{n, SceneLayout::Field, VertexPath::Pulling, ClusterCulling::Off, true, true}, false,
+                  field_name},
+            Scene{"resize_churn", SceneSettings{}, true},
+            // a fixed scale, the feedback loop would make the image depend on how fast the device is
+            Scene{stress_name + "_half_resolution", SceneSettings{n}, false, "", DynamicResolutionSettings{true, 0.5f, 0.5f}},
+            // anti-aliasing tiers, compare render_gpu_ms_mean and aa_memory_mb with stress_<n>
+            Scene{stress_name + "_post_aa", SceneSettings{n}, false, "", DynamicResolutionSettings{}, AntiAliasing::PostProcess},
+            Scene{stress_name + "_msaa2", SceneSettings{n}, false, "", DynamicResolutionSettings{}, AntiAliasing::Msaa2},
+            Scene{stress_name + "_msaa4", SceneSettings{n}, false, "", DynamicResolutionSettings{}, AntiAliasing::Msaa4},
+            Scene{stress_name + "_msaa8", SceneSettings{n}, false, "", DynamicResolutionSettings{}, AntiAliasing::Msaa8},
+            Scene{stress_name + "_sample_shading4", SceneSettings{n}, false, "", DynamicResolutionSettings{}, AntiAliasing::SampleShading4},
+            // occlusion culling against the depth resolved out of the multisampled depth
+            Scene{stress_name + "_cluster_mesh_shader_msaa4", SceneSettings{n, SceneLayout::Ring, VertexPath::Pulling, ClusterCulling::MeshShader}, false,
+                  stress_name + "_msaa4", DynamicResolutionSettings{}, AntiAliasing::Msaa4},
+            // every pipeline permutation baked, compare graphics_pipelines, pipeline_create_ms and pipeline_binds with the dynamic state scenes
+            Scene{stress_name + "_static_state", SceneSettings{n}, false, stress_name, DynamicResolutionSettings{}, AntiAliasing::Off, false},
+            Scene{stress_name + "_depth_prepass_static_state",
+                  SceneSettings{n, SceneLayout::Ring, VertexPath::Pulling, ClusterCulling::Off, true, true}, false, stress_name,
+                  DynamicResolutionSettings{}, AntiAliasing::Off, false},
+            // every scene pipeline compiled whole, compare pipeline_create_ms with library_parts_ms and fast_link_ms of the others
+            Scene{stress_name + "_no_pipeline_libraries", SceneSettings{n}, false, stress_name, DynamicResolutionSettings{}, AntiAliasing::Off, true,
+                  false},
+            // the device is lost halfway and rebuilt with everything made from it, the last frame must still match
+            Scene{stress_name + "_device_lost", SceneSettings{n}, false, stress_name, DynamicResolutionSettings{}, AntiAliasing::Off, true, true, true},
+        };
+
+        // a build that does not count would pass every scene's heap allocation check on 0
+        if constexpr (!HEAP_ALLOCATIONS_COUNTED) throw Error("This build does not count heap allocations, build it with VULKANAPP_COUNT_ALLOCATIONS=1");
+
+        std::map<std::string, std::map<std::string, double>> baseline{};
+        if (!options.baseline_path.empty()) {
+            baseline = readBaseline(options.baseline_path);
+        }
+
+        if (options.update_golden) {
+            std::filesystem::create_directories(options.golden_dir);
+        }
+
+        CapturedImage captured{};
+        CaptureSettings capture_settings{};
+        capture_settings.callback = [&captured](const CaptureJob& job) {
+            std::lock_guard lock(captured.mutex);
+            captured.rgba = job.rgba;
+            captured.width = job.extent.width;
+            captured.height = job.extent.height;
+        };
+        initHeadless(WIDTH, HEIGHT, capture_settings);
+        drawHeadlessFrame(FIXED_DT); // ends startup, each scene then starts from a reset
+
+        StartupResult startup{};
+        startup.stats = startupStats();
+        bool passed = true;
+        if (const auto it = baseline.find("startup"); it != baseline.end()) {
+            checkRegressions(startup, it->second, options.tolerance);
+        }
+        if (!startup.regressions.empty()) passed = false;
+        printf("%-20s first frame %8.3f ms  init %8.3f ms  device %8.3f ms  pipelines %8.3f ms (waited %.3f ms, %.1f KB cached)%s\n", "startup",
+               startup.stats.first_frame_ms, startup.stats.init_ms, startup.stats.device_ms, startup.stats.pipelines_ms, startup.stats.pipeline_wait_ms,
+               static_cast<double>(startup.stats.pipeline_cache_bytes) / 1024.0, startup.regressions.empty() ? "" : "  REGRESSED");
+
+        std::vector<SceneResult> results{};
+        uint32_t simulated_device_lost = 0;
+        for (const Scene& scene : scenes) {
+            SceneResult result = runScene(scene, options, captured);
+            if (const auto it = baseline.find(scene.name); it != baseline.end()) {
+                checkRegressions(result, it->second, options.tolerance);
+            }
+            // a scene that simulates a lost device must have rebuilt it exactly once, and then drawn its golden image
+            const uint32_t expected_device_lost = scene.device_lost ? 1 : 0;
+            simulated_device_lost += expected_device_lost;
+            const bool recovered = result.device_lost == expected_device_lost;
+            if (result.golden == "fail" || result.heap_allocations != 0 || !recovered || !result.regressions.empty()) passed = false;
+
+            printf("%-20s frame %8.3f ms (p95 %8.3f)  record %8.3f ms  gpu %8.3f ms  peak +%7.1f MB  aa %s %6.1f MB  draws %6u  pipelines %2u (%.1f ms)"
+                   "  golden %s%s%s%s\n",
+                   result.name.c_str(), result.frame_ms_mean, result.frame_ms_p95, result.record_ms_mean, result.render_gpu_ms_mean,
+                   result.peak_memory_growth_mb, result.anti_aliasing.c_str(), result.aa_memory_mb, result.counters.draws,
+                   result.pipelines.graphics_pipelines, result.pipelines.create_ms, result.golden.c_str(),
+                   result.heap_allocations != 0 ? "  ALLOCATES" : "", recovered ? "" : "  DEVICE LOST", result.regressions.empty() ? "" : "  REGRESSED");
+            results.push_back(std::move(result));
+        }
+
+        // timings across a lost device are not worth comparing, the run goes on but is marked as failed unless the loss was simulated
+        const RecoveryStats recovery = recoveryStats();
+        if (recovery.device_lost > 0 || recovery.surface_lost > 0) {
+            printf("%-20s device lost %u times (%u simulated), surface lost %u times, last rebuild %.3f ms\n", "recovery", recovery.device_lost,
+                   simulated_device_lost, recovery.surface_lost, recovery.last_recovery_ms);
+            if (recovery.device_lost > simulated_device_lost || recovery.surface_lost > 0) passed = false;
+        }
+
+        { // every heap and category as the last scene left them
+            std::ofstream memory_file(options.memory_output_path);
+            if (!memory_file) throw Error("Failed to write " + options.memory_output_path);
+            memory_file << gpuMemoryStatsJson();
+        }
+
+        shutdownHeadless();
+
+        std::vector<SpatialResult> spatial_results{};
+        for (uint32_t object_count : SPATIAL_SIZES) {
+            SpatialResult result = runSpatialBenchmark(object_count);
+            if (const auto it = baseline.find(result.name); it != baseline.end()) {
+                checkRegressions(result, it->second, options.tolerance);
+            }
+            if (!result.regressions.empty()) passed = false;
+
+            printf("%-20s build %8.3f ms  refit %8.3f ms  query %8.3f ms (%" PRIu64 " visible)  pick %8.3f us%s\n", result.name.c_str(), result.build_ms,
+                   result.refit_ms, result.query_ms, result.visible, result.pick_us, result.regressions.empty() ? "" : "  REGRESSED");
+            spatial_results.push_back(std::move(result));
+        }
+
+        writeResults(options.output_path, startup, recovery, results, spatial_results);
+        return passed ? 0 : 1;
+    }
+    catch (const Error& error) {
+        fprintf(stderr, "Benchmark error: %s\n", error.what());
+        return 2;
+    }
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// true if --benchmark is on the command line
+bool benchmarkRequested(const std::vector<std::string>& args);
+
+// Renders every benchmark scene headless, compares the final frame of each against its golden image and writes timings to JSON.
+// Startup, from initHeadless() to its first frame, is timed before the first scene. The spatial index used for instance culling is then
+// timed on its own at 10k, 100k and 1M objects.
+// Returns the process exit code: 0 if everything passed, 1 on a golden image mismatch or performance regression, 2 on error.
+//
+// Options:
+//   --golden-dir <dir>     golden images, default "golden"
+//   --update-golden        overwrite golden images with this run's output
+//   --output <file>        results JSON, default "benchmark_results.json"
+//   --memory-output <file> GPU memory statistics JSON after the last scene, default "benchmark_memory.json"
+//   --baseline <file>      results JSON from an earlier run, metrics that got slower by more than the tolerance fail the run
+//   --tolerance <fraction> allowed slowdown against the baseline, default 0.1
+//   --frames <n>           measured frames per scene, at least 1, default 300
+//   --instances <n>        triangles drawn by the stress and field scenes, default 10000
+int runBenchmarks(const std::vector<std::string>& args);
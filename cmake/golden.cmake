@@ -0,0 +1,18 @@
+# Run by ctest before the benchmark test. On a checkout without golden images, renders them with --update-golden so the benchmark has
+# something to compare against. Commit the images it writes to make later runs compare against them.
+#
+# cmake -DAPP=<VulkanApplication> -DGOLDEN_DIR=<dir> -DARGS="<benchmark options>" -P golden.cmake
+
+if(EXISTS ${GOLDEN_DIR})
+    message(STATUS "Comparing against the golden images in ${GOLDEN_DIR}")
+    return()
+endif()
+
+separate_arguments(args UNIX_COMMAND "${ARGS}")
+message(STATUS "No golden images in ${GOLDEN_DIR}, rendering them")
+execute_process(COMMAND ${APP} --benchmark --update-golden --golden-dir ${GOLDEN_DIR} ${args} RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    # scenes that share another scene's image are still compared, so a mismatch between drawing paths fails here as well
+    file(REMOVE_RECURSE ${GOLDEN_DIR})
+    message(FATAL_ERROR "Rendering the golden images failed with ${result}")
+endif()
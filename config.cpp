@@ -0,0 +1,213 @@
+#include "config.h"
+
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "error.h"
+#include "platform.h"
+
+constexpr const char* DEFAULT_CONFIG_PATH = "VulkanApplication.cfg";
+constexpr const char* ENV_PREFIX = "VULKANAPP_";
+constexpr auto WATCH_INTERVAL = std::chrono::milliseconds(500);
+
+static bool parseUint(const std::string& value, uint32_t& out)
+{
+    const char* end = value.data() + value.size();
+    const auto [ptr, ec] = std::from_chars(value.data(), end, out);
+    return ec == std::errc{} && ptr == end;
+}
+
+static bool parseDouble(const std::string& value, double& out)
+{
+    if (value.empty()) return false;
+    char* end = nullptr;
+    out = std::strtod(value.c_str(), &end);
+    return end == value.c_str() + value.size();
+}
+
+// "r,g,b" or "r,g,b,a", alpha is 1 if it is left out
+static bool parseColor(const std::string& value, std::array<float, 4>& color)
+{
+    std::array<float, 4> parsed{1.0f, 1.0f, 1.0f, 1.0f};
+    size_t count = 0;
+    size_t begin = 0;
+    while (begin <= value.size()) {
+        const size_t comma = std::min(value.find(',', begin), value.size());
+        double channel = 0.0;
+        if (count == parsed.size() || !parseDouble(value.substr(begin, comma - begin), channel)) return false;
+        parsed[count++] = static_cast<float>(channel);
+        begin = comma + 1;
+    }
+    if (count < 3) return false;
+    color = parsed;
+    return true;
+}
+
+struct ConfigKey {
+    const char* name;
+    bool (*parse)(const std::string& value, Config& config);
+};
+
+constexpr std::array<ConfigKey, 17> CONFIG_KEYS{{
+    {"scene", [](const std::string& v, Config& c) { c.renderer.scene_path = v; return true; }},
+    {"instances", [](const std::string& v, Config& c) { return parseUint(v, c.renderer.instance_count) && c.renderer.instance_count > 0; }},
+    {"field", [](const std::string& v, Config& c) { return parseUint(v, c.renderer.field_instances); }},
+    {"window_width", [](const std::string& v, Config& c) { return parseUint(v, c.window_width) && c.window_width > 0; }},
+    {"window_height", [](const std::string& v, Config& c) { return parseUint(v, c.window_height) && c.window_height > 0; }},
+    {"frames_in_flight", [](const std::string& v, Config& c) {
+        return parseUint(v, c.renderer.frames_in_flight) && c.renderer.frames_in_flight >= 1 && c.renderer.frames_in_flight <= MAX_FRAMES_IN_FLIGHT;
+    }},
+    {"workers", [](const std::string& v, Config& c) { return parseUint(v, c.renderer.worker_count); }},
+    {"present_mode", [](const std::string& v, Config& c) { return parsePresentMode(v, c.renderer.present_mode); }},
+    {"swapchain_images", [](const std::string& v, Config& c) { return parseUint(v, c.renderer.swapchain_images); }},
+    {"record", [](const std::string& v, Config& c) { c.renderer.record_path = v; return true; }},
+    {"simulate_device_lost", [](const std::string& v, Config& c) { return parseUint(v, c.renderer.simulate_device_lost); }},
+    {"telemetry", [](const std::string& v, Config& c) { c.telemetry = v; return true; }},
+    {"telemetry_interval", [](const std::string& v, Config& c) { return parseUint(v, c.telemetry_interval_ms) && c.telemetry_interval_ms > 0; }},
+    {"fps_limit", [](const std::string& v, Config& c) { return parseUint(v, c.live.fps_limit); }},
+    {"clear_color", [](const std::string& v, Config& c) { return parseColor(v, c.live.clear_color); }},
+    {"dynamic_resolution", [](const std::string& v, Config& c) {
+        return parseDouble(v, c.live.dynamic_resolution_ms) && c.live.dynamic_resolution_ms >= 0.0;
+    }},
+    {"anti_aliasing", [](const std::string& v, Config& c) { return parseAntiAliasing(v, c.live.anti_aliasing); }},
+}};
+
+// source names where the value came from in the error
+static void setKey(const std::string& source, const std::string& key, const std::string& value, Config& config)
+{
+    for (const ConfigKey& config_key : CONFIG_KEYS) {
+        if (key != config_key.name) continue;
+        if (!config_key.parse(value, config)) throw Error(source + ": invalid value \"" + value + "\" for " + key);
+        return;
+    }
+    throw Error(source + ": unknown key " + key);
+}
+
+static std::string trim(const std::string& text)
+{
+    size_t begin = 0;
+    size_t end = text.size();
+    while (begin < end && std::isspace(static_cast<unsigned char>(text[begin]))) ++begin;
+    while (end > begin && std::isspace(static_cast<unsigned char>(text[end - 1]))) --end;
+    return text.substr(begin, end - begin);
+}
+
+static void readConfigFile(const std::string& path, Config& config)
+{
+    std::ifstream file(path);
+    if (!file) throw Error("Failed to open config file " + path);
+    std::string line{};
+    for (uint32_t line_number = 1; std::getline(file, line); ++line_number) {
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) continue;
+        const std::string source = path + ":" + std::to_string(line_number);
+        const size_t equals = line.find('=');
+        if (equals == std::string::npos) throw Error(source + ": expected key = value");
+        setKey(source, trim(line.substr(0, equals)), trim(line.substr(equals + 1)), config);
+    }
+}
+
+static void readEnvironment(Config& config)
+{
+    for (const ConfigKey& config_key : CONFIG_KEYS) {
+        std::string name = ENV_PREFIX;
+        for (const char* c = config_key.name; *c != '\0'; ++c) name += static_cast<char>(std::toupper(static_cast<unsigned char>(*c)));
+        const char* value = std::getenv(name.c_str());
+        if (value != nullptr) setKey(name, config_key.name, value, config);
+    }
+}
+
+// --frames-in-flight 3 sets frames_in_flight
+static void readCommandLine(const std::vector<std::string>& args, Config& config)
+{
+    for (size_t i = 0; i < args.size(); ++i) {
+        const std::string& arg = args[i];
+        if (arg.size() <= 2 || arg.compare(0, 2, "--") != 0) throw Error("Unexpected argument " + arg);
+        if (i + 1 >= args.size()) throw Error("Missing value for " + arg);
+        const std::string& value = args[++i];
+        if (arg == "--config") continue; // already read
+        std::string key = arg.substr(2);
+        for (char& c : key) {
+            if (c == '-') c = '_';
+        }
+        setKey(arg, key, value, config);
+    }
+}
+
+static std::string configPath(const std::vector<std::string>& args)
+{
+    for (size_t i = 0; i + 1 < args.size(); ++i) {
+        if (args[i] == "--config") return args[i + 1];
+    }
+    const char* env_path = std::getenv("VULKANAPP_CONFIG");
+    if (env_path != nullptr) return env_path;
+    std::error_code ec{};
+    if (std::filesystem::exists(DEFAULT_CONFIG_PATH, ec)) return DEFAULT_CONFIG_PATH;
+    return "";
+}
+
+Config loadConfig(const std::vector<std::string>& args)
+{
+    Config config{};
+    config.path = configPath(args);
+    if (!config.path.empty()) readConfigFile(config.path, config);
+    readEnvironment(config);
+    readCommandLine(args, config);
+    return config;
+}
+
+void startConfigWatcher(ConfigWatcher& watcher, const Config& config, const std::vector<std::string>& args, std::function<void(const Config&)> on_reload)
+{
+    if (config.path.empty()) return;
+    watcher.stop = false;
+    watcher.thread = std::thread([&watcher, config, args, on_reload = std::move(on_reload)]() {
+        std::error_code ec{};
+        auto last_write = std::filesystem::last_write_time(config.path, ec);
+        std::unique_lock lock(watcher.mutex);
+        while (!watcher.stop_cv.wait_for(lock, WATCH_INTERVAL, [&watcher]() { return watcher.stop; })) {
+            const auto write = std::filesystem::last_write_time(config.path, ec);
+            if (ec || write == last_write) continue; // mid save, or unchanged
+            last_write = write;
+
+            lock.unlock();
+            try {
+                const Config reloaded = loadConfig(args);
+                if (reloaded.renderer != config.renderer || reloaded.window_width != config.window_width ||
+                    reloaded.window_height != config.window_height || reloaded.telemetry != config.telemetry ||
+                    reloaded.telemetry_interval_ms != config.telemetry_interval_ms) {
+                    printDebug("config: only the live settings are reloaded, restart for the rest\n");
+                }
+                on_reload(reloaded);
+            }
+            catch (const Error& error) {
+                std::array<char, 512> buf{};
+                snprintf(buf.data(), buf.size(), "config not reloaded: %s\n", error.what());
+                printDebug(buf.data());
+            }
+            lock.lock();
+        }
+    });
+}
+
+void stopConfigWatcher(ConfigWatcher& watcher)
+{
+    if (!watcher.thread.joinable()) return;
+    {
+        std::lock_guard lock(watcher.mutex);
+        watcher.stop = true;
+    }
+    watcher.stop_cv.notify_one();
+    watcher.thread.join();
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "app.h"
+
+// Everything that can be set at startup without rebuilding. Each key comes from, highest precedence first:
+//   the command line      --frames-in-flight 3
+//   the environment       VULKANAPP_FRAMES_IN_FLIGHT=3
+//   the config file       frames_in_flight = 3
+//   the defaults below
+// The file is --config <file>, or VULKANAPP_CONFIG, or VulkanApplication.cfg in the working directory if there is one. It has a key = value
+// per line, blank lines and anything after a # are ignored.
+//
+// Keys:
+//   scene <file>                        .vscene file to draw, the built in triangle if empty
+//   instances <n>                       in the ring the scene starts with, default 1
+//   field <n>                           starts with a field of n instances instead
+//   window_width <n>, window_height <n> default 768
+//   frames_in_flight <n>                1 to MAX_FRAMES_IN_FLIGHT, default 2
+//   workers <n>                         job system threads, default 0 for one per core
+//   present_mode <mode>                 mailbox, fifo or immediate, default mailbox
+//   swapchain_images <n>                default 0 for one more than the surface needs
+//   record <file>                       records the game loop to file for --replay, see replay.h, default empty for not recording
+//   simulate_device_lost <frame>        reports the device lost at that frame to test recovering from it, default 0 for never
+//   telemetry <name>                    shared memory segment the metrics are published to, see telemetry.h, default vulkanapp,
+//                                       empty for none
+//   telemetry_interval <ms>             how often they are published, default 1000
+// and the ones that also reload while running:
+//   fps_limit <n>                       default 240, 0 for none
+//   clear_color <r,g,b[,a]>             default 1,1,1,1
+//   dynamic_resolution <ms>             target GPU time, default 0 for off
+//   anti_aliasing <tier>                see antiAliasingName(), default off
+struct Config {
+    std::string path{}; // of the file the config was read from, empty if there was none
+    RendererSettings renderer{};
+    LiveSettings live{};
+    uint32_t window_width = 768;
+    uint32_t window_height = 768;
+    std::string telemetry = "vulkanapp";
+    uint32_t telemetry_interval_ms = 1000;
+};
+
+// args are the command line without the executable path. Throws an Error naming the source of an unknown key or a bad value.
+Config loadConfig(const std::vector<std::string>& args);
+
+// Watches the file config was loaded from, and calls on_reload on its own thread with the config loaded again after the file changes.
+// The command line and environment still win over the file. A file that no longer loads is reported with printDebug() and skipped.
+// Only the live settings are applied on reload, the rest wait for a restart.
+struct ConfigWatcher {
+    std::thread thread{};
+    std::mutex mutex{};
+    std::condition_variable stop_cv{};
+    bool stop = false;
+};
+// Does nothing if config was not read from a file
+void startConfigWatcher(ConfigWatcher& watcher, const Config& config, const std::vector<std::string>& args, std::function<void(const Config&)> on_reload);
+void stopConfigWatcher(ConfigWatcher& watcher);
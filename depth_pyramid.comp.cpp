@@ -0,0 +1,11 @@
+#include "shaders.h"
+
+#include <cstdint>
+
+#include <span>
+
+namespace {
+#include "depth_pyramid.comp.h" // generated from depth_pyramid.comp, see the project file
+}
+
+const std::span<const uint32_t> spv_depth_pyramid{spv_depth_pyramid_comp};
@@ -0,0 +1,145 @@
+#include "draw_list.h"
+
+#include <algorithm>
+
+#include "entity_store.h"
+#include "job_system.h"
+
+constexpr uint32_t RADIX_BITS = 8;
+constexpr uint32_t RADIX_BUCKETS = 1u << RADIX_BITS;
+constexpr uint32_t RADIX_DIGITS = 64 / RADIX_BITS;
+
+// smaller sorts are not worth splitting between workers
+constexpr uint32_t SORT_MIN_PART = 16384;
+constexpr uint32_t KEYS_PER_BATCH = 4096;
+
+uint64_t drawSortKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth)
+{
+    // reversed Z, nearer is greater, so the nearest draws get the smallest keys
+    const float clamped = std::clamp(depth, 0.0f, 1.0f);
+    const uint64_t quantised = static_cast<uint64_t>((1.0f - clamped) * static_cast<float>(DRAW_KEY_DEPTH_MASK));
+    return (uint64_t{pass & 0xf} << 60) | (uint64_t{pipeline & 0xff} << 52) | (uint64_t{material & 0xffff} << 36) |
+           (uint64_t{mesh & 0xffff} << 20) | quantised;
+}
+
+void clearDrawList(DrawList& list)
+{
+    list.items.clear();
+    list.entities.clear();
+    list.batches.clear();
+}
+
+void addEntityDraws(DrawList& list, const EntityStore& store, std::span<const uint32_t> entities, uint32_t pass, uint32_t pipeline,
+                    const float view_proj[16], JobSystem& jobs)
+{
+    const size_t first = list.items.size();
+    list.items.resize(first + entities.size());
+    DrawItem* items = list.items.data() + first;
+    jobs.parallelFor(static_cast<uint32_t>(entities.size()), KEYS_PER_BATCH, [&](uint32_t begin, uint32_t end, uint32_t) {
+        for (uint32_t i = begin; i < end; ++i) {
+            const uint32_t entity = entities[i];
+            const float* t = store.world[entity].translation;
+            // the entity's origin, w is 1 for every projection used so far
+            const float depth = view_proj[2] * t[0] + view_proj[6] * t[1] + view_proj[10] * t[2] + view_proj[14];
+            items[i] = DrawItem{drawSortKey(pass, pipeline, store.material[entity], store.mesh[entity], depth), entity};
+        }
+    });
+}
+
+static uint32_t digit(uint64_t key, uint32_t pass) { return static_cast<uint32_t>(key >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1); }
+
+// Least significant digit first. Each part of the input keeps its own histogram so the parts scatter in parallel, and bucket offsets
+// are handed out bucket by bucket then part by part, which keeps the sort stable.
+static void radixSort(DrawList& list, JobSystem& jobs)
+{
+    const uint32_t count = static_cast<uint32_t>(list.items.size());
+    const uint32_t parts = std::clamp(count / SORT_MIN_PART, 1u, jobs.workerCount());
+    const uint32_t part_size = (count + parts - 1) / parts;
+    list.sort_scratch.resize(count);
+    list.histograms.resize(size_t{parts} * RADIX_DIGITS);
+
+    DrawItem* src = list.items.data();
+    DrawItem* dst = list.sort_scratch.data();
+    auto histogram = [&list](uint32_t part, uint32_t pass) -> std::array<uint32_t, RADIX_BUCKETS>& {
+        return list.histograms[size_t{part} * RADIX_DIGITS + pass];
+    };
+
+    // every digit at once, the totals show which digits all keys share
+    jobs.parallelFor(parts, 1, [&](uint32_t begin, uint32_t end, uint32_t) {
+        for (uint32_t part = begin; part < end; ++part) {
+            for (uint32_t pass = 0; pass < RADIX_DIGITS; ++pass) {
+                histogram(part, pass).fill(0);
+            }
+            for (uint32_t i = part * part_size; i < std::min(count, (part + 1) * part_size); ++i) {
+                for (uint32_t pass = 0; pass < RADIX_DIGITS; ++pass) {
+                    ++histogram(part, pass)[digit(src[i].key, pass)];
+                }
+            }
+        }
+    });
+
+    bool counted = true; // the histograms match the order of src
+    for (uint32_t pass = 0; pass < RADIX_DIGITS; ++pass) {
+        const uint32_t first_digit = digit(src[0].key, pass);
+        uint32_t shared = 0;
+        for (uint32_t part = 0; part < parts; ++part) {
+            shared += histogram(part, pass)[first_digit];
+        }
+        if (shared == count) continue;
+
+        if (!counted) {
+            jobs.parallelFor(parts, 1, [&](uint32_t begin, uint32_t end, uint32_t) {
+                for (uint32_t part = begin; part < end; ++part) {
+                    std::array<uint32_t, RADIX_BUCKETS>& buckets = histogram(part, pass);
+                    buckets.fill(0);
+                    for (uint32_t i = part * part_size; i < std::min(count, (part + 1) * part_size); ++i) {
+                        ++buckets[digit(src[i].key, pass)];
+                    }
+                }
+            });
+        }
+        counted = false;
+
+        uint32_t offset = 0;
+        for (uint32_t bucket = 0; bucket < RADIX_BUCKETS; ++bucket) {
+            for (uint32_t part = 0; part < parts; ++part) {
+                const uint32_t bucket_count = histogram(part, pass)[bucket];
+                histogram(part, pass)[bucket] = offset;
+                offset += bucket_count;
+            }
+        }
+
+        jobs.parallelFor(parts, 1, [&](uint32_t begin, uint32_t end, uint32_t) {
+            for (uint32_t part = begin; part < end; ++part) {
+                std::array<uint32_t, RADIX_BUCKETS>& offsets = histogram(part, pass);
+                for (uint32_t i = part * part_size; i < std::min(count, (part + 1) * part_size); ++i) {
+                    dst[offsets[digit(src[i].key, pass)]++] = src[i];
+                }
+            }
+        });
+        std::swap(src, dst);
+    }
+
+    // an odd number of passes left the result in the scratch array
+    if (src != list.items.data()) list.items.swap(list.sort_scratch);
+}
+
+void sortDrawList(DrawList& list, JobSystem& jobs)
+{
+    list.entities.clear();
+    list.batches.clear();
+    if (list.items.empty()) return;
+
+    radixSort(list, jobs);
+
+    list.entities.resize(list.items.size());
+    for (uint32_t i = 0; i < list.items.size(); ++i) {
+        const DrawItem& item = list.items[i];
+        list.entities[i] = item.entity;
+        const uint64_t state = item.key & ~DRAW_KEY_DEPTH_MASK;
+        if (list.batches.empty() || list.batches.back().key != state) {
+            list.batches.push_back(DrawBatch{state, i, 0});
+        }
+        ++list.batches.back().count;
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+
+#include <array>
+#include <span>
+#include <vector>
+
+struct EntityStore;
+class JobSystem;
+
+/* 64-bit draw sort key, most significant field first, so sorted draws are grouped by the state they need:
+ * [63:60] pass      recorded in this order
+ * [59:52] pipeline
+ * [51:36] material
+ * [35:20] mesh
+ * [19:0]  depth     front to back within everything else
+ */
+constexpr uint32_t DRAW_KEY_DEPTH_BITS = 20;
+constexpr uint64_t DRAW_KEY_DEPTH_MASK = (uint64_t{1} << DRAW_KEY_DEPTH_BITS) - 1;
+
+// depth is reversed Z, clamped to [0, 1]
+uint64_t drawSortKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth);
+
+inline uint32_t drawKeyPass(uint64_t key) { return static_cast<uint32_t>(key >> 60); }
+inline uint32_t drawKeyPipeline(uint64_t key) { return static_cast<uint32_t>(key >> 52) & 0xff; }
+inline uint32_t drawKeyMaterial(uint64_t key) { return static_cast<uint32_t>(key >> 36) & 0xffff; }
+inline uint32_t drawKeyMesh(uint64_t key) { return static_cast<uint32_t>(key >> 20) & 0xffff; }
+
+struct DrawItem {
+    uint64_t key;
+    uint32_t entity;
+};
+
+// Sorted draws in a row whose keys match apart from depth, recorded as one instanced or multi draw.
+// Their entities are DrawList::entities[first, first + count).
+struct DrawBatch {
+    uint64_t key; // depth bits cleared
+    uint32_t first;
+    uint32_t count;
+};
+
+// Rebuilt every frame, the arrays keep their capacity so this does not allocate once they have grown to fit.
+struct DrawList {
+    std::vector<DrawItem> items{};
+
+    // written by sortDrawList()
+    std::vector<uint32_t> entities{}; // items' entities in sorted order, what the shaders index with the instance index
+    std::vector<DrawBatch> batches{};
+
+    // scratch
+    std::vector<DrawItem> sort_scratch{};
+    std::vector<std::array<uint32_t, 256>> histograms{};
+};
+
+void clearDrawList(DrawList& list);
+
+// Adds a draw for each of entities, keyed by its material and mesh and by its depth under view_proj (column major, reversed Z).
+void addEntityDraws(DrawList& list, const EntityStore& store, std::span<const uint32_t> entities, uint32_t pass, uint32_t pipeline,
+                    const float view_proj[16], JobSystem& jobs);
+
+// Stable radix sort of the items by key, spread over the job system's workers, then merges them into batches.
+// Digits every key shares are skipped, so keys that only differ in a few fields cost little more than one pass over the items.
+void sortDrawList(DrawList& list, JobSystem& jobs);
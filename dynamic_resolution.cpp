@@ -0,0 +1,44 @@
+#include "dynamic_resolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+constexpr double SMOOTHING = 0.2;          // weight of each new measurement
+constexpr double DEADBAND = 0.05;          // fraction of the target either side of it where the scale is kept
+constexpr float MAX_STEP = 0.05f;          // most the scale moves in one frame, the measurements lag a few frames behind
+constexpr float SCALE_QUANTUM = 1.0f / 64; // so the render extent does not change every frame while the scale settles
+
+float updateResolutionScale(ResolutionController& controller, const DynamicResolutionSettings& settings, double gpu_ms)
+{
+    const float min_scale = std::clamp(settings.min_scale, SCALE_QUANTUM, 1.0f);
+    const float max_scale = std::clamp(settings.max_scale, min_scale, 1.0f);
+    if (!settings.enabled || settings.target_gpu_ms <= 0.0) {
+        controller.scale = max_scale;
+        controller.filtered_gpu_ms = 0.0;
+        return controller.scale;
+    }
+
+    // no timestamps, or none retired yet
+    if (gpu_ms > 0.0) {
+        controller.filtered_gpu_ms = controller.filtered_gpu_ms > 0.0 ? controller.filtered_gpu_ms + SMOOTHING * (gpu_ms - controller.filtered_gpu_ms) : gpu_ms;
+    }
+
+    float scale = controller.scale;
+    const double ratio = controller.filtered_gpu_ms / settings.target_gpu_ms;
+    if (controller.filtered_gpu_ms > 0.0 && std::abs(ratio - 1.0) > DEADBAND) {
+        const float ideal = scale * static_cast<float>(std::sqrt(1.0 / ratio));
+        scale = std::clamp(ideal, scale - MAX_STEP, scale + MAX_STEP);
+        scale = std::round(scale / SCALE_QUANTUM) * SCALE_QUANTUM;
+    }
+    controller.scale = std::clamp(scale, min_scale, max_scale);
+    return controller.scale;
+}
+
+void scaledExtent(uint32_t width, uint32_t height, float scale, uint32_t& scaled_width, uint32_t& scaled_height)
+{
+    const auto scaled = [scale](uint32_t size) {
+        return std::clamp(static_cast<uint32_t>(std::lround(static_cast<float>(size) * scale)), 1u, std::max(size, 1u));
+    };
+    scaled_width = scaled(width);
+    scaled_height = scaled(height);
+}
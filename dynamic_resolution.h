@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+struct DynamicResolutionSettings {
+    bool enabled = false;
+    float min_scale = 0.5f; // of the swapchain extent on each axis
+    float max_scale = 1.0f;
+    double target_gpu_ms = 8.0; // the GPU time per frame the scale is steered towards
+};
+
+// Feedback loop from measured GPU frame times to a render scale. GPU time is taken to grow with the pixel count, so with the square
+// of the scale. Measurements are smoothed and times close to the target are left alone, so the scale settles instead of oscillating.
+struct ResolutionController {
+    float scale = 1.0f;
+    double filtered_gpu_ms = 0.0; // 0 until the first measurement
+};
+
+// Call once per retired frame with its GPU time, 0 if there is none. Returns the new scale, clamped to the settings' bounds, max_scale if
+// disabled.
+float updateResolutionScale(ResolutionController& controller, const DynamicResolutionSettings& settings, double gpu_ms);
+
+// at least 1x1, and never more than the full extent
+void scaledExtent(uint32_t width, uint32_t height, float scale, uint32_t& scaled_width, uint32_t& scaled_height);
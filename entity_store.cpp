@@ -0,0 +1,168 @@
+#include "entity_store.h"
+
+#include <cmath>
+
+#include <algorithm>
+
+#include "job_system.h"
+
+// dirty subtrees per job, most are a handful of entities
+constexpr uint32_t SUBTREES_PER_BATCH = 64;
+
+uint32_t createEntity(EntityStore& store, uint32_t parent, const LocalTransform& local, uint32_t mesh, uint32_t material, float radius)
+{
+    const uint32_t entity = static_cast<uint32_t>(store.local.size());
+    store.local.push_back(local);
+    store.world.push_back(WorldTransform{});
+    store.bounds.push_back(emptyAabb());
+    store.radius.push_back(radius);
+    store.mesh.push_back(mesh);
+    store.material.push_back(material);
+    store.parent.push_back(parent);
+    store.first_child.push_back(ENTITY_NONE);
+    store.next_sibling.push_back(ENTITY_NONE);
+    store.dirty.push_back(1);
+    store.dirty_entities.push_back(entity);
+
+    if (parent != ENTITY_NONE) {
+        store.next_sibling[entity] = store.first_child[parent];
+        store.first_child[parent] = entity;
+    }
+    return entity;
+}
+
+void clearEntities(EntityStore& store)
+{
+    // the scratch arrays keep their capacity
+    store.local.clear();
+    store.world.clear();
+    store.bounds.clear();
+    store.radius.clear();
+    store.mesh.clear();
+    store.material.clear();
+    store.parent.clear();
+    store.first_child.clear();
+    store.next_sibling.clear();
+    store.dirty.clear();
+    store.changed.clear();
+    store.changed_ranges.clear();
+    store.dirty_entities.clear();
+}
+
+void setLocalTransform(EntityStore& store, uint32_t entity, const LocalTransform& local)
+{
+    store.local[entity] = local;
+    if (store.dirty[entity]) return;
+    store.dirty[entity] = 1;
+    store.dirty_entities.push_back(entity);
+}
+
+// world = parent * local
+static void updateEntity(EntityStore& store, uint32_t entity)
+{
+    const LocalTransform& local = store.local[entity];
+    const float c = std::cos(local.rotation) * local.scale;
+    const float s = std::sin(local.rotation) * local.scale;
+
+    /* 2x2 matrix
+     * [ 0 2 ]
+     * [ 1 3 ]
+     */
+    WorldTransform& world = store.world[entity];
+    const uint32_t parent = store.parent[entity];
+    if (parent == ENTITY_NONE) {
+        world.transform[0] = c;
+        world.transform[1] = s;
+        world.transform[2] = -s;
+        world.transform[3] = c;
+        world.translation[0] = local.translation[0];
+        world.translation[1] = local.translation[1];
+        world.translation[2] = local.translation[2];
+    }
+    else {
+        const WorldTransform& p = store.world[parent];
+        world.transform[0] = p.transform[0] * c + p.transform[2] * s;
+        world.transform[1] = p.transform[1] * c + p.transform[3] * s;
+        world.transform[2] = p.transform[0] * -s + p.transform[2] * c;
+        world.transform[3] = p.transform[1] * -s + p.transform[3] * c;
+        world.translation[0] = p.transform[0] * local.translation[0] + p.transform[2] * local.translation[1] + p.translation[0];
+        world.translation[1] = p.transform[1] * local.translation[0] + p.transform[3] * local.translation[1] + p.translation[1];
+        world.translation[2] = p.translation[2] + local.translation[2];
+    }
+    world.translation[3] = 0.0f;
+
+    if (store.mesh[entity] == ENTITY_NONE) return;
+    // rotation and uniform scale, so either column's length is the scale
+    const float extent_xy = store.radius[entity] * std::sqrt(world.transform[0] * world.transform[0] + world.transform[1] * world.transform[1]);
+    const float extent_z = store.radius[entity];
+    store.bounds[entity] = Aabb{{world.translation[0] - extent_xy, world.translation[1] - extent_xy, world.translation[2] - extent_z},
+                                {world.translation[0] + extent_xy, world.translation[1] + extent_xy, world.translation[2] + extent_z}};
+}
+
+// depth first without a stack, parents are always updated before their children
+static void updateSubtree(EntityStore& store, uint32_t root, std::vector<uint32_t>& changed)
+{
+    uint32_t entity = root;
+    while (true) {
+        updateEntity(store, entity);
+        changed.push_back(entity);
+
+        if (store.first_child[entity] != ENTITY_NONE) {
+            entity = store.first_child[entity];
+            continue;
+        }
+        while (entity != root && store.next_sibling[entity] == ENTITY_NONE) {
+            entity = store.parent[entity];
+        }
+        if (entity == root) return;
+        entity = store.next_sibling[entity];
+    }
+}
+
+void updateEntityTransforms(EntityStore& store, JobSystem& jobs)
+{
+    store.changed.clear();
+    store.changed_ranges.clear();
+    if (store.dirty_entities.empty()) return;
+
+    // Only dirty entities with no dirty ancestor start an update, the rest are updated as part of their ancestor's subtree.
+    // That leaves subtrees that do not overlap, which is what lets them be updated in parallel.
+    store.update_roots.clear();
+    for (uint32_t entity : store.dirty_entities) {
+        uint32_t ancestor = store.parent[entity];
+        while (ancestor != ENTITY_NONE && !store.dirty[ancestor]) {
+            ancestor = store.parent[ancestor];
+        }
+        if (ancestor == ENTITY_NONE) store.update_roots.push_back(entity);
+    }
+    for (uint32_t entity : store.dirty_entities) {
+        store.dirty[entity] = 0;
+    }
+    store.dirty_entities.clear();
+
+    store.worker_changed.resize(jobs.workerCount());
+    for (std::vector<uint32_t>& changed : store.worker_changed) {
+        changed.clear();
+    }
+    jobs.parallelFor(static_cast<uint32_t>(store.update_roots.size()), SUBTREES_PER_BATCH, [&store](uint32_t begin, uint32_t end, uint32_t worker) {
+        for (uint32_t i = begin; i < end; ++i) {
+            updateSubtree(store, store.update_roots[i], store.worker_changed[worker]);
+        }
+    });
+
+    for (const std::vector<uint32_t>& changed : store.worker_changed) {
+        store.changed.insert(store.changed.end(), changed.begin(), changed.end());
+    }
+    std::sort(store.changed.begin(), store.changed.end());
+
+    for (uint32_t entity : store.changed) {
+        if (!store.changed_ranges.empty()) {
+            EntityRange& last = store.changed_ranges.back();
+            if (entity - (last.first + last.count) <= ENTITY_UPLOAD_GAP) {
+                last.count = entity - last.first + 1;
+                continue;
+            }
+        }
+        store.changed_ranges.push_back(EntityRange{entity, 1});
+    }
+}
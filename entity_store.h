@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+
+#include <vector>
+
+#include "spatial_index.h"
+
+class JobSystem;
+
+constexpr uint32_t ENTITY_NONE = UINT32_MAX;
+
+// relative to the parent
+struct LocalTransform {
+    float translation[3];
+    float rotation; // about z, radians
+    float scale;    // uniform in x and y
+};
+
+// Uploaded to the GPU as is, the same layout as DrawParams in vulkan_pipeline.h. Like the shaders, z is only translated.
+struct WorldTransform {
+    float transform[4];   // 2x2 column major, rotation and scale
+    float translation[4]; // xyz, w is unused padding
+};
+
+struct EntityRange {
+    uint32_t first;
+    uint32_t count;
+};
+
+// Renderable objects, a single archetype stored as one array per component. Entity ids index the arrays and stay valid until
+// clearEntities(). Parents are created before their children, so a parent's id is always lower than its children's.
+struct EntityStore {
+    std::vector<LocalTransform> local{};
+    std::vector<WorldTransform> world{};
+    std::vector<Aabb> bounds{};          // world space, empty for entities without a mesh
+    std::vector<float> radius{};         // bounding sphere of the mesh around its origin
+    std::vector<uint32_t> mesh{};        // ENTITY_NONE for entities that only move their children
+    std::vector<uint32_t> material{};
+    std::vector<uint32_t> parent{};      // ENTITY_NONE for roots
+    std::vector<uint32_t> first_child{}; // children are linked through next_sibling
+    std::vector<uint32_t> next_sibling{};
+    std::vector<uint8_t> dirty{};        // local transform set since the last updateEntityTransforms()
+
+    // written by updateEntityTransforms()
+    std::vector<uint32_t> changed{};           // entities whose world transform was recomputed, ascending
+    std::vector<EntityRange> changed_ranges{}; // the same merged into ranges to upload, see ENTITY_UPLOAD_GAP
+
+    // scratch
+    std::vector<uint32_t> dirty_entities{};
+    std::vector<uint32_t> update_roots{};
+    std::vector<std::vector<uint32_t>> worker_changed{}; // one per job system worker
+};
+
+// Changed ranges this close together are uploaded as one, copying a few unchanged entities is cheaper than another copy region.
+constexpr uint32_t ENTITY_UPLOAD_GAP = 8;
+
+// parent is ENTITY_NONE for a root. The new entity is dirty.
+uint32_t createEntity(EntityStore& store, uint32_t parent, const LocalTransform& local, uint32_t mesh, uint32_t material, float radius);
+void clearEntities(EntityStore& store);
+
+void setLocalTransform(EntityStore& store, uint32_t entity, const LocalTransform& local);
+
+// Recomputes the world transform and bounds of every dirty entity and everything below it, and nothing else. Subtrees are spread
+// over the job system's workers. Does not allocate once the scratch arrays have grown to fit.
+void updateEntityTransforms(EntityStore& store, JobSystem& jobs);
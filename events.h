@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+
+#include <atomic>
+#include <chrono>
+
+#include "spsc_queue.h"
+
+enum class EventType : uint32_t {
+    KeyDown,
+    KeyUp,
+    MouseMove,
+    MouseButtonDown,
+    MouseButtonUp,
+    Resize,
+    Minimise,
+    Restore,
+};
+
+// Sent from the thread that processes window events to the render thread.
+struct Event {
+    EventType type = EventType::KeyDown;
+    uint32_t code = 0;        // platform key code, or mouse button (0 left, 1 right, 2 middle)
+    int32_t x = 0;            // pointer position for mouse events
+    int32_t y = 0;
+    uint32_t width = 0;       // new drawable size for Resize
+    uint32_t height = 0;
+    int64_t timestamp_ns = 0; // steady_clock time at which the event was received from the OS
+};
+
+inline int64_t eventTimestampNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// timestamped now, the other fields are left zero
+inline Event makeEvent(EventType type)
+{
+    Event event{};
+    event.type = type;
+    event.timestamp_ns = eventTimestampNow();
+    return event;
+}
+
+inline bool isInputEvent(EventType type) { return type <= EventType::MouseButtonUp; }
+
+// Pushed to by the thread that processes window events, drained by the render thread once per frame. Neither side blocks.
+// Input events are dropped if the render thread falls more than 256 behind. Resize, Minimise and Restore never are, a lost Restore
+// would stop rendering for good: only the latest size and minimised state are kept, and pop() hands them out before any input.
+class EventQueue {
+public:
+    // producer thread only. Returns false if an input event was dropped.
+    bool push(const Event& event)
+    {
+        switch (event.type) {
+            case EventType::Resize:
+                extent_timestamp_ns.store(event.timestamp_ns, std::memory_order_relaxed); // published by the release below
+                extent.store(uint64_t{event.width} << 32 | event.height, std::memory_order_release);
+                return true;
+            case EventType::Minimise:
+            case EventType::Restore:
+                minimised_timestamp_ns.store(event.timestamp_ns, std::memory_order_relaxed);
+                minimised.store(event.type == EventType::Minimise ? 1 : 0, std::memory_order_release);
+                return true;
+            default:
+                return input.push(event);
+        }
+    }
+
+    // Consumer thread only. A coalesced event keeps the timestamp it was received from the OS with, or that of a newer one of the same
+    // kind pushed while it was being popped, which the next pop() hands out.
+    bool pop(Event& event)
+    {
+        if (const uint64_t size = extent.exchange(UNCHANGED, std::memory_order_acquire); size != UNCHANGED) {
+            event = Event{};
+            event.type = EventType::Resize;
+            event.timestamp_ns = extent_timestamp_ns.load(std::memory_order_relaxed);
+            event.width = static_cast<uint32_t>(size >> 32);
+            event.height = static_cast<uint32_t>(size);
+            return true;
+        }
+        if (const int state = minimised.exchange(-1, std::memory_order_acquire); state != -1) {
+            event = Event{};
+            event.type = state == 1 ? EventType::Minimise : EventType::Restore;
+            event.timestamp_ns = minimised_timestamp_ns.load(std::memory_order_relaxed);
+            return true;
+        }
+        return input.pop(event);
+    }
+
+private:
+    static constexpr uint64_t UNCHANGED = ~uint64_t{0}; // no extent has a width and height of 0xffffffff
+
+    std::atomic<uint64_t> extent = UNCHANGED;        // width in the high half, height in the low half
+    std::atomic<int> minimised = -1;                 // 1 minimised, 0 restored, -1 unchanged since the last pop()
+    std::atomic<int64_t> extent_timestamp_ns = 0;    // of the latest Resize, written before extent
+    std::atomic<int64_t> minimised_timestamp_ns = 0; // of the latest Minimise or Restore, written before minimised
+    SpscQueue<Event, 256> input{};
+};
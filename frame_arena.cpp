@@ -0,0 +1,54 @@
+#include "frame_arena.h"
+
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+
+static size_t alignUp(size_t value, size_t alignment) { return (value + alignment - 1) & ~(alignment - 1); }
+
+FrameArena::FrameArena(size_t initial_capacity)
+{
+    if (initial_capacity > 0) {
+        block = std::make_unique<std::byte[]>(initial_capacity);
+        block_size = initial_capacity;
+    }
+}
+
+void* FrameArena::allocate(size_t size, size_t alignment)
+{
+    // the block is allocated with new[] so is aligned to at least __STDCPP_DEFAULT_NEW_ALIGNMENT__
+    const size_t aligned_offset = alignUp(offset, alignment);
+    if (block && aligned_offset <= block_size && size <= block_size - aligned_offset) {
+        offset = aligned_offset + size;
+        high_water = std::max(high_water, used());
+        return block.get() + aligned_offset;
+    }
+
+    // out of space, this frame's remaining allocations go to the heap
+    overflow_blocks.push_back(std::make_unique<std::byte[]>(size + alignment));
+    overflow_bytes += size + alignment;
+    high_water = std::max(high_water, used());
+    const uintptr_t address = reinterpret_cast<uintptr_t>(overflow_blocks.back().get());
+    return reinterpret_cast<void*>(alignUp(address, alignment));
+}
+
+void FrameArena::reset()
+{
+#ifndef NDEBUG
+    // anything still pointing into the arena reads garbage rather than last frame's data
+    if (block) memset(block.get(), 0xCD, offset);
+#endif
+
+    if (!overflow_blocks.empty()) {
+        // grow so that a frame like this one fits without touching the heap
+        size_t new_size = std::max<size_t>(block_size, 4096);
+        while (new_size < high_water) new_size *= 2;
+        block = std::make_unique<std::byte[]>(new_size);
+        block_size = new_size;
+        overflow_blocks.clear();
+        overflow_bytes = 0;
+    }
+
+    offset = 0;
+}
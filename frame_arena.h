@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <memory>
+#include <new>
+#include <vector>
+
+// Linear (bump) allocator for data that only lives until the end of a frame.
+// Each frame in flight owns one, reset() is called once that frame's fence has been waited on.
+// Running out of space falls back to the heap for the rest of the frame, the next reset() grows the arena to the high water mark
+// so allocations settle down after the first few frames.
+class FrameArena {
+public:
+    explicit FrameArena(size_t initial_capacity = 0);
+
+    // never returns nullptr
+    void* allocate(size_t size, size_t alignment);
+
+    // Frees everything at once. O(1), apart from debug builds which overwrite the freed memory to catch stale pointers.
+    void reset();
+
+    size_t capacity() const { return block_size; }
+    size_t used() const { return offset + overflow_bytes; }
+    size_t highWaterMark() const { return high_water; } // most bytes used in a single frame
+
+private:
+    std::unique_ptr<std::byte[]> block{};
+    size_t block_size = 0;
+    size_t offset = 0;
+
+    std::vector<std::unique_ptr<std::byte[]>> overflow_blocks{};
+    size_t overflow_bytes = 0;
+
+    size_t high_water = 0;
+};
+
+// STL allocator that takes its memory from a FrameArena. Deallocation does nothing, the memory is reclaimed by FrameArena::reset().
+// Containers using it must not outlive the frame.
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(FrameArena& frame_arena) noexcept : arena(&frame_arena) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept : arena(other.arena) {}
+
+    T* allocate(size_t n)
+    {
+        if (n > SIZE_MAX / sizeof(T)) throw std::bad_array_new_length();
+        return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T*, size_t) noexcept {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const noexcept
+    {
+        return arena == other.arena;
+    }
+
+private:
+    template <typename U>
+    friend class ArenaAllocator;
+
+    FrameArena* arena;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
@@ -0,0 +1,11 @@
+#version 450
+
+// One triangle covering the whole viewport, drawn with three vertices and no vertex buffer.
+// uv is 0 to 1 across the viewport, top left first.
+
+layout(location = 0) out vec2 uv;
+
+void main() {
+	uv = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+	gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,11 @@
+#include "shaders.h"
+
+#include <cstdint>
+
+#include <span>
+
+namespace {
+#include "fullscreen.vert.h" // generated from fullscreen.vert, see the project file
+}
+
+const std::span<const uint32_t> spv_fullscreen{spv_fullscreen_vert};
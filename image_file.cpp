@@ -0,0 +1,179 @@
+#include "image_file.h"
+
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <ostream>
+#include <vector>
+
+static const std::array<uint32_t, 256> crc_table = [] {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t n = 0; n < 256; ++n) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; ++k) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        table[n] = c;
+    }
+    return table;
+}();
+
+static uint32_t updateCrc(uint32_t crc, const uint8_t* data, size_t size)
+{
+    for (size_t i = 0; i < size; ++i) {
+        crc = crc_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+static void appendBigEndian(std::vector<uint8_t>& out, uint32_t value)
+{
+    out.push_back(static_cast<uint8_t>(value >> 24));
+    out.push_back(static_cast<uint8_t>(value >> 16));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+static void writeChunk(std::ostream& out, const char type[4], const std::vector<uint8_t>& data)
+{
+    std::vector<uint8_t> header{};
+    appendBigEndian(header, static_cast<uint32_t>(data.size()));
+    header.insert(header.end(), type, type + 4);
+    out.write(reinterpret_cast<const char*>(header.data()), header.size());
+    out.write(reinterpret_cast<const char*>(data.data()), data.size());
+
+    // the crc covers the chunk type and data but not the length
+    uint32_t crc = updateCrc(0xFFFFFFFFu, header.data() + 4, 4);
+    crc = updateCrc(crc, data.data(), data.size()) ^ 0xFFFFFFFFu;
+    std::vector<uint8_t> footer{};
+    appendBigEndian(footer, crc);
+    out.write(reinterpret_cast<const char*>(footer.data()), footer.size());
+}
+
+bool writePNG(const std::string& path, const uint8_t* rgba, uint32_t width, uint32_t height)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file) return false;
+
+    constexpr std::array<uint8_t, 8> signature{0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    file.write(reinterpret_cast<const char*>(signature.data()), signature.size());
+
+    std::vector<uint8_t> ihdr{};
+    appendBigEndian(ihdr, width);
+    appendBigEndian(ihdr, height);
+    ihdr.push_back(8); // bit depth
+    ihdr.push_back(6); // colour type RGBA
+    ihdr.push_back(0); // deflate
+    ihdr.push_back(0); // adaptive filtering
+    ihdr.push_back(0); // no interlace
+    writeChunk(file, "IHDR", ihdr);
+
+    // each scanline is prefixed with filter type 0 (none)
+    const size_t row_size = static_cast<size_t>(width) * 4;
+    std::vector<uint8_t> scanlines((row_size + 1) * height);
+    for (uint32_t y = 0; y < height; ++y) {
+        uint8_t* row = scanlines.data() + (row_size + 1) * y;
+        row[0] = 0;
+        std::copy(rgba + row_size * y, rgba + row_size * (y + 1), row + 1);
+    }
+
+    // zlib stream made of stored (uncompressed) deflate blocks, speed matters more than size here
+    constexpr size_t MAX_BLOCK_SIZE = 65535;
+    std::vector<uint8_t> idat{};
+    idat.reserve(scanlines.size() + (scanlines.size() / MAX_BLOCK_SIZE + 1) * 5 + 6);
+    idat.push_back(0x78);
+    idat.push_back(0x01);
+    size_t offset = 0;
+    do {
+        const size_t block_size = std::min(MAX_BLOCK_SIZE, scanlines.size() - offset);
+        const bool final_block = offset + block_size == scanlines.size();
+        idat.push_back(final_block ? 1 : 0);
+        idat.push_back(static_cast<uint8_t>(block_size));
+        idat.push_back(static_cast<uint8_t>(block_size >> 8));
+        idat.push_back(static_cast<uint8_t>(~block_size));
+        idat.push_back(static_cast<uint8_t>(~block_size >> 8));
+        idat.insert(idat.end(), scanlines.begin() + offset, scanlines.begin() + offset + block_size);
+        offset += block_size;
+    } while (offset < scanlines.size());
+
+    uint32_t adler_a = 1, adler_b = 0;
+    for (uint8_t byte : scanlines) {
+        adler_a = (adler_a + byte) % 65521;
+        adler_b = (adler_b + adler_a) % 65521;
+    }
+    appendBigEndian(idat, (adler_b << 16) | adler_a);
+    writeChunk(file, "IDAT", idat);
+
+    writeChunk(file, "IEND", {});
+
+    return file.good();
+}
+
+bool writePPM(const std::string& path, const uint8_t* rgba, uint32_t width, uint32_t height)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file) return false;
+
+    file << "P6\n" << width << " " << height << "\n255\n";
+    const size_t pixel_count = static_cast<size_t>(width) * height;
+    std::vector<uint8_t> rgb(pixel_count * 3);
+    for (size_t i = 0; i < pixel_count; ++i) {
+        rgb[i * 3 + 0] = rgba[i * 4 + 0];
+        rgb[i * 3 + 1] = rgba[i * 4 + 1];
+        rgb[i * 3 + 2] = rgba[i * 4 + 2];
+    }
+    file.write(reinterpret_cast<const char*>(rgb.data()), rgb.size());
+    return file.good();
+}
+
+bool readPPM(const std::string& path, std::vector<uint8_t>& rgba, uint32_t& width, uint32_t& height)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+
+    std::string magic{};
+    uint32_t max_value = 0;
+    file >> magic >> width >> height >> max_value;
+    if (!file || magic != "P6" || max_value != 255) return false;
+    file.get(); // single whitespace character before the pixel data
+
+    const size_t pixel_count = static_cast<size_t>(width) * height;
+    std::vector<uint8_t> rgb(pixel_count * 3);
+    file.read(reinterpret_cast<char*>(rgb.data()), rgb.size());
+    if (!file) return false;
+
+    rgba.resize(pixel_count * 4);
+    for (size_t i = 0; i < pixel_count; ++i) {
+        rgba[i * 4 + 0] = rgb[i * 3 + 0];
+        rgba[i * 4 + 1] = rgb[i * 3 + 1];
+        rgba[i * 4 + 2] = rgb[i * 3 + 2];
+        rgba[i * 4 + 3] = 255;
+    }
+    return true;
+}
+
+void writeY4MHeader(std::ostream& out, uint32_t width, uint32_t height, uint32_t fps)
+{
+    out << "YUV4MPEG2 W" << width << " H" << height << " F" << fps << ":1 Ip A1:1 C444\n";
+}
+
+void writeY4MFrame(std::ostream& out, const uint8_t* rgba, uint32_t width, uint32_t height)
+{
+    const size_t pixel_count = static_cast<size_t>(width) * height;
+    std::vector<uint8_t> planes(pixel_count * 3);
+    uint8_t* y_plane = planes.data();
+    uint8_t* u_plane = y_plane + pixel_count;
+    uint8_t* v_plane = u_plane + pixel_count;
+    for (size_t i = 0; i < pixel_count; ++i) {
+        const int r = rgba[i * 4 + 0];
+        const int g = rgba[i * 4 + 1];
+        const int b = rgba[i * 4 + 2];
+        y_plane[i] = static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        u_plane[i] = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+        v_plane[i] = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+    }
+    out << "FRAME\n";
+    out.write(reinterpret_cast<const char*>(planes.data()), planes.size());
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// All pixel data passed to these functions is tightly packed 8-bit RGBA.
+
+// Writes an uncompressed (stored deflate blocks) RGBA PNG. Returns false if the file could not be written.
+bool writePNG(const std::string& path, const uint8_t* rgba, uint32_t width, uint32_t height);
+
+// Binary PPM (P6). Alpha is dropped on write and set to 255 on read. Used for golden images as it is trivial to parse.
+bool writePPM(const std::string& path, const uint8_t* rgba, uint32_t width, uint32_t height);
+bool readPPM(const std::string& path, std::vector<uint8_t>& rgba, uint32_t& width, uint32_t& height);
+
+// YUV4MPEG2 stream, 4:4:4 BT.601 limited range. The header is written once followed by any number of frames.
+void writeY4MHeader(std::ostream& out, uint32_t width, uint32_t height, uint32_t fps);
+void writeY4MFrame(std::ostream& out, const uint8_t* rgba, uint32_t width, uint32_t height);
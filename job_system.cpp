@@ -0,0 +1,85 @@
+#include "job_system.h"
+
+#include <algorithm>
+
+// more batches than workers evens out batches that take longer than others
+constexpr uint32_t BATCHES_PER_WORKER = 4;
+
+JobSystem::JobSystem(uint32_t thread_count)
+{
+    if (thread_count == 0) thread_count = std::max(1u, std::thread::hardware_concurrency());
+    threads.reserve(thread_count - 1);
+    for (uint32_t i = 1; i < thread_count; ++i) {
+        threads.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    work_ready.notify_all();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+void JobSystem::run(uint32_t count, uint32_t min_batch, BatchFn fn, void* context)
+{
+    if (count == 0) return;
+
+    const uint32_t target_batches = workerCount() * BATCHES_PER_WORKER;
+    const uint32_t batch = std::max({min_batch, (count + target_batches - 1) / target_batches, 1u});
+
+    // not worth waking anyone for
+    if (threads.empty() || count <= batch) {
+        fn(context, 0, count, 0);
+        return;
+    }
+
+    {
+        std::lock_guard lock(mutex);
+        job_fn = fn;
+        job_context = context;
+        job_count = count;
+        job_batch = batch;
+        next_item.store(0);
+        busy_workers = static_cast<uint32_t>(threads.size());
+        ++generation;
+    }
+    work_ready.notify_all();
+
+    runBatches(0);
+
+    std::unique_lock lock(mutex);
+    work_done.wait(lock, [this] { return busy_workers == 0; });
+}
+
+void JobSystem::runBatches(uint32_t worker)
+{
+    while (true) {
+        const uint32_t begin = next_item.fetch_add(job_batch);
+        if (begin >= job_count) return;
+        job_fn(job_context, begin, std::min(begin + job_batch, job_count), worker);
+    }
+}
+
+void JobSystem::workerLoop(uint32_t worker)
+{
+    uint64_t seen_generation = 0;
+    while (true) {
+        {
+            std::unique_lock lock(mutex);
+            work_ready.wait(lock, [this, seen_generation] { return stopping || generation != seen_generation; });
+            if (stopping) return;
+            seen_generation = generation;
+        }
+
+        runBatches(worker);
+
+        std::lock_guard lock(mutex);
+        if (--busy_workers == 0) work_done.notify_one();
+    }
+}
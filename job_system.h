@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed pool of worker threads for splitting loops across cores.
+// Only one thread may hand out work at a time (the render thread), and it runs batches itself while it waits.
+class JobSystem {
+public:
+    // 0 uses one thread per core, counting the caller
+    explicit JobSystem(uint32_t thread_count = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // including the calling thread
+    uint32_t workerCount() const { return static_cast<uint32_t>(threads.size()) + 1; }
+
+    // Calls fn(begin, end, worker) for batches covering [0, count) and returns once all of them have run.
+    // Batches hold at least min_batch items, worker is in [0, workerCount()) and the caller is worker 0. Does not allocate.
+    template <typename Fn>
+    void parallelFor(uint32_t count, uint32_t min_batch, Fn&& fn)
+    {
+        using Callable = std::remove_reference_t<Fn>;
+        run(count, min_batch, [](void* context, uint32_t begin, uint32_t end, uint32_t worker) { (*static_cast<Callable*>(context))(begin, end, worker); },
+            const_cast<void*>(static_cast<const void*>(&fn)));
+    }
+
+private:
+    using BatchFn = void (*)(void* context, uint32_t begin, uint32_t end, uint32_t worker);
+
+    void run(uint32_t count, uint32_t min_batch, BatchFn fn, void* context);
+    void runBatches(uint32_t worker);
+    void workerLoop(uint32_t worker);
+
+    std::vector<std::thread> threads{};
+
+    std::mutex mutex{};
+    std::condition_variable work_ready{}; // workers wait here for the next parallelFor()
+    std::condition_variable work_done{};  // the caller waits here for the workers to finish
+    uint64_t generation = 0;              // incremented by every parallelFor() that wakes the workers
+    uint32_t busy_workers = 0;
+    bool stopping = false;
+
+    // the current parallelFor(), written before the workers are woken
+    BatchFn job_fn = nullptr;
+    void* job_context = nullptr;
+    uint32_t job_count = 0;
+    uint32_t job_batch = 1;
+    std::atomic<uint32_t> next_item = 0;
+};
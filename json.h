@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdio>
+
+#include <array>
+#include <string>
+#include <string_view>
+
+// text escaped to go between the quotes of a JSON string, for the results files the benchmark and replays write
+inline std::string jsonEscape(std::string_view text)
+{
+    std::string escaped{};
+    escaped.reserve(text.size());
+    for (const char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20) { // control characters, newlines and tabs included
+            std::array<char, 8> code{};
+            snprintf(code.data(), code.size(), "\\u%04x", static_cast<unsigned>(c));
+            escaped += code.data();
+        }
+        else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
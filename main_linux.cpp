@@ -0,0 +1,86 @@
+// Entry point everywhere except Windows, which uses wWinMain in VulkanApplication.cpp
+
+#ifndef _WIN32
+
+#include <csignal>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "app.h"
+#include "benchmark.h"
+#include "config.h"
+#include "error.h"
+#include "platform.h"
+#include "replay.h"
+#include "telemetry.h"
+
+static std::atomic<bool> g_quit_requested = false;
+
+static void onQuitSignal(int) { g_quit_requested.store(true); }
+
+int main(int argc, char* argv[])
+{
+    const std::vector<std::string> args(argv + 1, argv + argc);
+
+    // benchmark mode renders headless and never opens a window
+    if (benchmarkRequested(args)) {
+        return runBenchmarks(args);
+    }
+    // and so does replaying a recording
+    if (replayRequested(args)) {
+        return runReplay(args);
+    }
+
+    // the window system flags take no value, everything else is a config key
+    WindowBackend backend = defaultWindowBackend();
+    std::vector<std::string> config_args{};
+    for (const std::string& arg : args) {
+        if (arg == "--headless") backend = WindowBackend::Headless;
+        else if (arg == "--x11") backend = WindowBackend::XCB;
+        else if (arg == "--wayland") backend = WindowBackend::Wayland;
+        else config_args.push_back(arg);
+    }
+
+    std::unique_ptr<Window> window{};
+    Config config{};
+    TelemetryExporter telemetry{};
+    try {
+        config = loadConfig(config_args);
+        window = createWindow(backend, "VulkanApplication", VkExtent2D{config.window_width, config.window_height});
+        initApp(*window, config.renderer);
+        setLiveSettings(config.live);
+        if (!config.telemetry.empty()) startTelemetryExport(telemetry, config.telemetry, config.telemetry_interval_ms);
+    }
+    catch (const Error& error) {
+        showErrorMessage("Initialisation Error!", error.what());
+        return 1;
+    }
+
+    // a headless window never closes, so it is stopped with Ctrl+C or kill
+    if (backend == WindowBackend::Headless) {
+        std::signal(SIGINT, onQuitSignal);
+        std::signal(SIGTERM, onQuitSignal);
+    }
+
+    // creates a new game loop thread
+    startGameLoop();
+
+    ConfigWatcher config_watcher{};
+    startConfigWatcher(config_watcher, config, config_args, [](const Config& reloaded) { setLiveSettings(reloaded.live); });
+
+    while (!g_quit_requested.load() && window->processEvents(getEventQueue())) {
+    }
+
+    stopConfigWatcher(config_watcher);
+
+    // signals the game loop thread to stop and joins it
+    endLoopAndShutdown();
+    stopTelemetryExport(telemetry);
+
+    return 0;
+}
+
+#endif
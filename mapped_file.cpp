@@ -0,0 +1,101 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#include "framework.h"
+#include <filesystem>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+bool mapFile(const std::string& path, MappedFile& file)
+{
+    const std::filesystem::path native_path(reinterpret_cast<const char8_t*>(path.c_str())); // UTF-8
+    HANDLE file_handle = CreateFileW(native_path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file_handle == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size{};
+    if (GetFileSizeEx(file_handle, &size) == FALSE || size.QuadPart == 0) {
+        CloseHandle(file_handle);
+        return false;
+    }
+
+    HANDLE mapping_handle = CreateFileMappingW(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping_handle == NULL) {
+        CloseHandle(file_handle);
+        return false;
+    }
+
+    const void* data = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+    if (data == nullptr) {
+        CloseHandle(mapping_handle);
+        CloseHandle(file_handle);
+        return false;
+    }
+
+    file.data = static_cast<const std::byte*>(data);
+    file.size = static_cast<size_t>(size.QuadPart);
+    file.file_handle = file_handle;
+    file.mapping_handle = mapping_handle;
+    return true;
+}
+
+void unmapFile(MappedFile& file)
+{
+    if (file.data == nullptr) return;
+    UnmapViewOfFile(file.data);
+    CloseHandle(file.mapping_handle);
+    CloseHandle(file.file_handle);
+    file = MappedFile{};
+}
+
+void prefetchRange(const MappedFile& file, size_t offset, size_t size)
+{
+    WIN32_MEMORY_RANGE_ENTRY range{};
+    range.VirtualAddress = const_cast<std::byte*>(file.data + offset);
+    range.NumberOfBytes = size;
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+#else
+
+bool mapFile(const std::string& path, MappedFile& file)
+{
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps the file open
+    if (data == MAP_FAILED) return false;
+
+    file.data = static_cast<const std::byte*>(data);
+    file.size = static_cast<size_t>(st.st_size);
+    return true;
+}
+
+void unmapFile(MappedFile& file)
+{
+    if (file.data == nullptr) return;
+    munmap(const_cast<std::byte*>(file.data), file.size);
+    file = MappedFile{};
+}
+
+void prefetchRange(const MappedFile& file, size_t offset, size_t size)
+{
+    // madvise needs a page aligned start
+    const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t aligned_offset = offset & ~(page_size - 1);
+    madvise(const_cast<std::byte*>(file.data + aligned_offset), size + (offset - aligned_offset), MADV_WILLNEED);
+}
+
+#endif
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+
+#include <string>
+
+// Read only memory mapping of a whole file
+struct MappedFile {
+    const std::byte* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void* file_handle = nullptr;
+    void* mapping_handle = nullptr;
+#endif
+};
+
+// Returns false if the file could not be opened or is empty
+bool mapFile(const std::string& path, MappedFile& file);
+void unmapFile(MappedFile& file);
+
+// Starts reading the range in from disk without waiting for it, so it is resident by the time it is touched
+void prefetchRange(const MappedFile& file, size_t offset, size_t size);
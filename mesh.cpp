@@ -0,0 +1,187 @@
+#include "mesh.h"
+
+#include <cmath>
+
+#include <algorithm>
+#include <span>
+
+static float signNotZero(float value) { return value >= 0.0f ? 1.0f : -1.0f; }
+
+int16_t quantizeSnorm16(float value) { return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f)); }
+
+std::array<int16_t, 2> encodeOctahedral(const float normal[3])
+{
+    // project onto the octahedron |x| + |y| + |z| = 1, then fold the lower half over the upper one
+    const float l1 = std::abs(normal[0]) + std::abs(normal[1]) + std::abs(normal[2]);
+    float x = normal[0] / l1;
+    float y = normal[1] / l1;
+    if (normal[2] < 0.0f) {
+        const float folded_x = (1.0f - std::abs(y)) * signNotZero(x);
+        const float folded_y = (1.0f - std::abs(x)) * signNotZero(y);
+        x = folded_x;
+        y = folded_y;
+    }
+    return {quantizeSnorm16(x), quantizeSnorm16(y)};
+}
+
+PackedVertex packVertex(const float position[3], float position_scale, const float normal[3], const float color[4])
+{
+    PackedVertex vertex{};
+    for (int i = 0; i < 3; ++i) {
+        vertex.position[i] = quantizeSnorm16(position[i] / position_scale);
+    }
+    vertex.position[3] = 0;
+    const std::array<int16_t, 2> oct = encodeOctahedral(normal);
+    vertex.normal[0] = oct[0];
+    vertex.normal[1] = oct[1];
+    for (int i = 0; i < 4; ++i) {
+        vertex.color[i] = static_cast<uint8_t>(std::lround(std::clamp(color[i], 0.0f, 1.0f) * 255.0f));
+    }
+    return vertex;
+}
+
+float positionScale(const float* positions, size_t vertex_count)
+{
+    float scale = 0.0f;
+    for (size_t i = 0; i < vertex_count * 3; ++i) {
+        scale = std::max(scale, std::abs(positions[i]));
+    }
+    return scale > 0.0f ? scale : 1.0f;
+}
+
+// the position the shaders decode, unpackSnorm2x16() times position_scale
+static std::array<float, 3> unpackPosition(const PackedVertex& vertex, float position_scale)
+{
+    std::array<float, 3> position{};
+    for (int i = 0; i < 3; ++i) {
+        position[i] = std::max(static_cast<float>(vertex.position[i]) / 32767.0f, -1.0f) * position_scale;
+    }
+    return position;
+}
+
+static void finishMeshlet(const MeshData& mesh, Meshlet& meshlet)
+{
+    const std::span<const uint32_t> vertices{mesh.meshlet_vertices.data() + meshlet.first_vertex, meshlet.vertex_count};
+
+    // sphere around the bounding box, not minimal but cheap and never too small
+    std::array<float, 3> min = unpackPosition(mesh.vertices[vertices[0]], mesh.position_scale);
+    std::array<float, 3> max = min;
+    for (uint32_t vertex : vertices) {
+        const std::array<float, 3> p = unpackPosition(mesh.vertices[vertex], mesh.position_scale);
+        for (int i = 0; i < 3; ++i) {
+            min[i] = std::min(min[i], p[i]);
+            max[i] = std::max(max[i], p[i]);
+        }
+    }
+    float radius_squared = 0.0f;
+    for (int i = 0; i < 3; ++i) {
+        meshlet.center[i] = (min[i] + max[i]) * 0.5f;
+    }
+    for (uint32_t vertex : vertices) {
+        const std::array<float, 3> p = unpackPosition(mesh.vertices[vertex], mesh.position_scale);
+        const float d[3] = {p[0] - meshlet.center[0], p[1] - meshlet.center[1], p[2] - meshlet.center[2]};
+        radius_squared = std::max(radius_squared, d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+    }
+    meshlet.radius = std::sqrt(radius_squared);
+
+    // normal cone from the winding the rasteriser culls by, not the vertex normals
+    std::vector<std::array<float, 3>> normals{};
+    normals.reserve(meshlet.triangle_count);
+    float axis[3] = {0.0f, 0.0f, 0.0f};
+    for (uint32_t t = 0; t < meshlet.triangle_count; ++t) {
+        const uint32_t* triangle = &mesh.indices[meshlet.first_index + t * 3];
+        const std::array<float, 3> a = unpackPosition(mesh.vertices[triangle[0]], mesh.position_scale);
+        const std::array<float, 3> b = unpackPosition(mesh.vertices[triangle[1]], mesh.position_scale);
+        const std::array<float, 3> c = unpackPosition(mesh.vertices[triangle[2]], mesh.position_scale);
+        const float e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        const float e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        const float n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+        const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length == 0.0f) continue; // degenerate, never rasterised
+        normals.push_back({n[0] / length, n[1] / length, n[2] / length});
+        for (int i = 0; i < 3; ++i) {
+            axis[i] += normals.back()[i];
+        }
+    }
+    const float axis_length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    float min_dot = axis_length > 0.0f ? 1.0f : -1.0f;
+    for (int i = 0; i < 3; ++i) {
+        meshlet.cone_axis[i] = axis_length > 0.0f ? axis[i] / axis_length : 0.0f;
+    }
+    for (const std::array<float, 3>& n : normals) {
+        min_dot = std::min(min_dot, n[0] * meshlet.cone_axis[0] + n[1] * meshlet.cone_axis[1] + n[2] * meshlet.cone_axis[2]);
+    }
+    // a view direction within 90 degrees minus the half angle of the axis sees only back faces
+    meshlet.cone_cutoff = min_dot <= 0.0f ? 1.0f : std::sqrt(1.0f - min_dot * min_dot);
+}
+
+void buildMeshlets(MeshData& mesh)
+{
+    mesh.meshlets.clear();
+    mesh.meshlet_vertices.clear();
+    mesh.meshlet_triangles.clear();
+    mesh.meshlet_triangles.reserve(mesh.indices.size() / 3);
+
+    constexpr uint8_t NOT_IN_MESHLET = 0xFF;
+    std::vector<uint8_t> local_index(mesh.vertices.size(), NOT_IN_MESHLET);
+
+    Meshlet meshlet{};
+    for (uint32_t first = 0; first + 2 < mesh.indices.size(); first += 3) {
+        const uint32_t* triangle = &mesh.indices[first];
+        uint32_t new_vertices = 0;
+        for (int i = 0; i < 3; ++i) {
+            if (local_index[triangle[i]] == NOT_IN_MESHLET) ++new_vertices;
+        }
+        if (meshlet.vertex_count + new_vertices > MESHLET_MAX_VERTICES || meshlet.triangle_count == MESHLET_MAX_TRIANGLES) {
+            finishMeshlet(mesh, meshlet);
+            mesh.meshlets.push_back(meshlet);
+            for (uint32_t i = 0; i < meshlet.vertex_count; ++i) {
+                local_index[mesh.meshlet_vertices[meshlet.first_vertex + i]] = NOT_IN_MESHLET;
+            }
+            meshlet = Meshlet{};
+        }
+        if (meshlet.triangle_count == 0) {
+            meshlet.first_index = first;
+            meshlet.first_vertex = static_cast<uint32_t>(mesh.meshlet_vertices.size());
+        }
+
+        uint32_t packed = 0;
+        for (int i = 0; i < 3; ++i) {
+            if (local_index[triangle[i]] == NOT_IN_MESHLET) {
+                local_index[triangle[i]] = static_cast<uint8_t>(meshlet.vertex_count++);
+                mesh.meshlet_vertices.push_back(triangle[i]);
+            }
+            packed |= static_cast<uint32_t>(local_index[triangle[i]]) << (i * 8);
+        }
+        mesh.meshlet_triangles.push_back(packed);
+        ++meshlet.triangle_count;
+    }
+    if (meshlet.triangle_count > 0) {
+        finishMeshlet(mesh, meshlet);
+        mesh.meshlets.push_back(meshlet);
+    }
+}
+
+MeshData createTriangleMesh()
+{
+    constexpr float positions[3][3] = {
+        {0.0f, 0.5f, 0.0f},
+        {-0.4330127018922193f, -0.25f, 0.0f},
+        {0.4330127018922193f, -0.25f, 0.0f},
+    };
+    constexpr float colors[3][4] = {
+        {1.0f, 0.0f, 0.0f, 1.0f},
+        {0.0f, 1.0f, 0.0f, 1.0f},
+        {0.0f, 0.0f, 1.0f, 1.0f},
+    };
+    constexpr float normal[3] = {0.0f, 0.0f, 1.0f};
+
+    MeshData mesh{};
+    mesh.position_scale = positionScale(&positions[0][0], 3);
+    for (int i = 0; i < 3; ++i) {
+        mesh.vertices.push_back(packVertex(positions[i], mesh.position_scale, normal, colors[i]));
+    }
+    mesh.indices = {0, 1, 2};
+    buildMeshlets(mesh);
+    return mesh;
+}
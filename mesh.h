@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <vector>
+
+// Vertex format read by the shaders, 16 bytes instead of 40 for float positions, normals and colors.
+// Positions are 16-bit snorm scaled by the mesh's position_scale, normals are octahedral encoded as two 16-bit snorm values.
+struct PackedVertex {
+    int16_t position[4]; // xyz, w is unused padding
+    int16_t normal[2];
+    uint8_t color[4]; // unorm RGBA
+};
+static_assert(sizeof(PackedVertex) == 16, "must match the shaders and the vertex input attributes");
+
+constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// A cluster of up to MESHLET_MAX_TRIANGLES triangles, culled as a whole. Read by the shaders, std430 compatible.
+// Bounds are in mesh space after position_scale has been applied, computed from the quantised positions the GPU sees.
+struct Meshlet {
+    float center[3]; // bounding sphere
+    float radius;
+    float cone_axis[3]; // average facing of the triangles
+    float cone_cutoff;  // sine of the cone's half angle, 1 if the triangles face too many ways to ever cull
+    uint32_t first_index; // its triangles are contiguous in the mesh's index array
+    uint32_t triangle_count;
+    uint32_t first_vertex; // into the meshlet vertex array, for mesh shaders
+    uint32_t vertex_count;
+};
+static_assert(sizeof(Meshlet) == 48, "must match the shaders");
+
+struct MeshData {
+    std::vector<PackedVertex> vertices{};
+    std::vector<uint32_t> indices{};
+    float position_scale = 1.0f; // largest absolute position coordinate
+
+    // filled in by buildMeshlets()
+    std::vector<Meshlet> meshlets{};
+    std::vector<uint32_t> meshlet_vertices{};  // the vertices each meshlet uses, as indices into vertices
+    std::vector<uint32_t> meshlet_triangles{}; // one per triangle, three 8-bit indices into the meshlet's vertices
+};
+
+int16_t quantizeSnorm16(float value);
+
+// normal must be normalised
+std::array<int16_t, 2> encodeOctahedral(const float normal[3]);
+
+PackedVertex packVertex(const float position[3], float position_scale, const float normal[3], const float color[4]);
+
+// smallest position_scale that fits every position
+float positionScale(const float* positions, size_t vertex_count);
+
+// Splits the triangles into meshlets in index order, so reordering indices for locality first gives tighter meshlets.
+void buildMeshlets(MeshData& mesh);
+
+// the single coloured triangle drawn by the demo scene
+MeshData createTriangleMesh();
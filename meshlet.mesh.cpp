@@ -0,0 +1,11 @@
+#include "shaders.h"
+
+#include <cstdint>
+
+#include <span>
+
+namespace {
+#include "meshlet.mesh.h" // generated from meshlet.mesh, see the project file
+}
+
+const std::span<const uint32_t> spv_mesh{spv_meshlet_mesh};
@@ -0,0 +1,11 @@
+#include "shaders.h"
+
+#include <cstdint>
+
+#include <span>
+
+namespace {
+#include "meshlet.task.h" // generated from meshlet.task, see the project file
+}
+
+const std::span<const uint32_t> spv_task{spv_meshlet_task};
@@ -0,0 +1,11 @@
+#include "shaders.h"
+
+#include <cstdint>
+
+#include <span>
+
+namespace {
+#include "meshlet_cull.comp.h" // generated from meshlet_cull.comp, see the project file
+}
+
+const std::span<const uint32_t> spv_meshlet_cull{spv_meshlet_cull_comp};
@@ -0,0 +1,74 @@
+// meshlet culling shared by meshlet_cull.comp and meshlet.task, Meshlet is declared in mesh.h. DrawParams must be declared first.
+
+struct Meshlet {
+	vec4 sphere;  // xyz center, w radius
+	vec4 cone;    // xyz axis, w cutoff
+	uvec4 ranges; // first_index, triangle_count, first_vertex, vertex_count
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer MeshletBuffer {
+	Meshlet meshlets[];
+};
+
+// OcclusionPhase in vulkan_pipeline.h
+const uint OCCLUSION_OFF = 0;
+const uint OCCLUSION_FIRST = 1;
+const uint OCCLUSION_SECOND = 2;
+
+// world space bounding sphere, the transform only rotates and scales xy
+void meshletBounds(Meshlet meshlet, DrawParams draw, out vec3 center, out float radius) {
+	center = vec3(draw.transform * meshlet.sphere.xy, meshlet.sphere.z) + draw.translation.xyz;
+	radius = meshlet.sphere.w * max(max(length(draw.transform[0]), length(draw.transform[1])), 1.0);
+}
+
+// True if the meshlet is outside the view volume or all its triangles face away from the camera.
+// The cone test is only exact for an orthographic view_proj, which is all the renderer has so far.
+bool meshletCulled(Meshlet meshlet, mat4 view_proj, DrawParams draw) {
+	const mat2 transform = draw.transform;
+	vec3 center;
+	float radius;
+	meshletBounds(meshlet, draw, center, radius);
+
+	// clip space planes (Gribb and Hartmann), x and y in [-w, w], z in [0, w]
+	const mat4 m = transpose(view_proj);
+	const vec4 planes[6] = vec4[6](m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[2], m[3] - m[2]);
+	for (int i = 0; i < 6; ++i) {
+		if (dot(planes[i].xyz, center) + planes[i].w < -radius * length(planes[i].xyz)) return true;
+	}
+
+	if (meshlet.cone.w >= 1.0) return false; // faces every way
+
+	// depth is reversed Z, so the view direction is the one it decreases in
+	const vec3 view_dir = -normalize(m[2].xyz);
+	const vec3 axis = normalize(vec3(transform * meshlet.cone.xy, meshlet.cone.z));
+	return dot(view_dir, axis) > meshlet.cone.w;
+}
+
+// True if the meshlet's bounding sphere is behind the depth pyramid everywhere it covers on screen. Depth is reversed Z and each
+// pyramid texel holds the farthest depth under it. Like the cone test this assumes an orthographic view_proj.
+bool meshletOccluded(Meshlet meshlet, mat4 view_proj, DrawParams draw, sampler2D pyramid) {
+	vec3 center;
+	float radius;
+	meshletBounds(meshlet, draw, center, radius);
+
+	const mat4 m = transpose(view_proj);
+	const vec3 clip = vec3(dot(m[0].xyz, center) + m[0].w, dot(m[1].xyz, center) + m[1].w, dot(m[2].xyz, center) + m[2].w);
+	const float nearest = clip.z + radius * length(m[2].xyz);
+	if (nearest >= 1.0) return false; // crosses the near plane
+
+	// the shaders flip y, so screen space y is -clip.y
+	const vec2 screen = vec2(clip.x, -clip.y) * 0.5 + 0.5;
+	const vec2 half_size = 0.5 * radius * vec2(length(m[0].xyz), length(m[1].xyz));
+	const vec2 uv_min = clamp(screen - half_size, 0.0, 1.0);
+	const vec2 uv_max = clamp(screen + half_size, 0.0, 1.0);
+
+	// the finest level where the bounds span at most 2x2 texels
+	const vec2 texels = (uv_max - uv_min) * vec2(textureSize(pyramid, 0));
+	const int level = min(int(ceil(log2(max(max(texels.x, texels.y), 1.0)))), textureQueryLevels(pyramid) - 1);
+	const ivec2 level_size = textureSize(pyramid, level);
+	const ivec2 lo = min(ivec2(uv_min * vec2(level_size)), level_size - 1);
+	const ivec2 hi = min(ivec2(uv_max * vec2(level_size)), level_size - 1);
+	const float farthest = min(min(texelFetch(pyramid, lo, level).x, texelFetch(pyramid, ivec2(hi.x, lo.y), level).x),
+	                           min(texelFetch(pyramid, ivec2(lo.x, hi.y), level).x, texelFetch(pyramid, hi, level).x));
+	return nearest < farthest;
+}
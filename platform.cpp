@@ -0,0 +1,97 @@
+#include "platform.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <chrono>
+#include <thread>
+
+#include "error.h"
+
+namespace {
+
+class HeadlessWindow final : public Window {
+public:
+    explicit HeadlessWindow(VkExtent2D extent) : window_extent(extent) {}
+
+    WindowBackend backend() const override { return WindowBackend::Headless; }
+    std::vector<const char*> requiredInstanceExtensions() const override { return {}; }
+    VkSurfaceKHR createSurface(VkInstance) const override { return VK_NULL_HANDLE; }
+    VkExtent2D extent() const override { return window_extent; }
+
+    // there are no events, the process is stopped by a signal
+    bool processEvents(EventQueue&) override
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        return true;
+    }
+
+private:
+    VkExtent2D window_extent;
+};
+
+} // namespace
+
+WindowBackend defaultWindowBackend()
+{
+#ifdef _WIN32
+    return WindowBackend::Win32;
+#else
+#ifdef VK_USE_PLATFORM_WAYLAND_KHR
+    if (getenv("WAYLAND_DISPLAY") != nullptr) return WindowBackend::Wayland;
+#endif
+#ifdef VK_USE_PLATFORM_XCB_KHR
+    if (getenv("DISPLAY") != nullptr) return WindowBackend::XCB;
+#endif
+    return WindowBackend::Headless;
+#endif
+}
+
+std::unique_ptr<Window> createWindow(WindowBackend backend, [[maybe_unused]] const std::string& title, VkExtent2D extent)
+{
+    switch (backend) {
+        case WindowBackend::Win32:
+            throw Error("Win32 windows are created by wWinMain, use createWin32Window()");
+        case WindowBackend::XCB:
+#ifdef VK_USE_PLATFORM_XCB_KHR
+            return createXcbWindow(title, extent);
+#else
+            throw Error("Built without XCB support");
+#endif
+        case WindowBackend::Wayland:
+#ifdef VK_USE_PLATFORM_WAYLAND_KHR
+            return createWaylandWindow(title, extent);
+#else
+            throw Error("Built without Wayland support");
+#endif
+        case WindowBackend::Headless:
+            return createHeadlessWindow(extent);
+    }
+    throw Error("Unknown window backend");
+}
+
+std::unique_ptr<Window> createHeadlessWindow(VkExtent2D extent) { return std::make_unique<HeadlessWindow>(extent); }
+
+void showErrorMessage(const char* title, const char* message)
+{
+#ifdef _WIN32
+    MessageBoxA(NULL, message, title, MB_OK | MB_ICONERROR);
+#else
+    fprintf(stderr, "%s: %s\n", title, message);
+#endif
+}
+
+void printDebug(const char* text)
+{
+#ifndef NDEBUG
+#ifdef _WIN32
+    if (WriteConsoleA(GetStdHandle(STD_OUTPUT_HANDLE), text, static_cast<DWORD>(strlen(text)), NULL, NULL) == FALSE)
+        throw Error("Failed to write to console");
+#else
+    fputs(text, stdout);
+#endif
+#else
+    (void)text;
+#endif
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "vulkan_headers.h"
+
+#include "events.h"
+
+#ifdef _WIN32
+#include "framework.h"
+#endif
+
+enum class WindowBackend {
+    Win32,
+    XCB,
+    Wayland,
+    Headless, // no window system at all, rendering goes to offscreen images
+};
+
+// A native window that the renderer presents to.
+// Events are processed on the thread that created the window, rendering happens on the game loop thread.
+class Window {
+public:
+    virtual ~Window() = default;
+
+    virtual WindowBackend backend() const = 0;
+
+    // instance extensions needed by createSurface(), empty for headless windows
+    virtual std::vector<const char*> requiredInstanceExtensions() const = 0;
+
+    // The returned surface is owned by the caller. Headless windows return VK_NULL_HANDLE.
+    virtual VkSurfaceKHR createSurface(VkInstance instance) const = 0;
+
+    // size of the drawable area in pixels
+    virtual VkExtent2D extent() const = 0;
+
+    // Blocks until at least one OS event has been handled, input, resize and minimise events are pushed to events. Only input events
+    // can be dropped, see EventQueue.
+    // Returns false once the window has been closed.
+    virtual bool processEvents(EventQueue& events) = 0;
+};
+
+// Wayland if WAYLAND_DISPLAY is set, then X11 if DISPLAY is set, otherwise headless. Always Win32 on Windows.
+WindowBackend defaultWindowBackend();
+
+// Opens a fixed size window. Throws Error if the backend is not compiled in or the display cannot be reached.
+std::unique_ptr<Window> createWindow(WindowBackend backend, const std::string& title, VkExtent2D extent);
+
+#ifdef _WIN32
+// The Win32 window is created by wWinMain as it needs the application's resources (icon, menu, accelerators).
+// The window is not owned and must outlive the returned object.
+std::unique_ptr<Window> createWin32Window(HINSTANCE hInstance, HWND hWnd, HACCEL hAccelTable);
+#endif
+
+#ifdef VK_USE_PLATFORM_XCB_KHR
+std::unique_ptr<Window> createXcbWindow(const std::string& title, VkExtent2D extent);
+#endif
+
+#ifdef VK_USE_PLATFORM_WAYLAND_KHR
+std::unique_ptr<Window> createWaylandWindow(const std::string& title, VkExtent2D extent);
+#endif
+
+std::unique_ptr<Window> createHeadlessWindow(VkExtent2D extent);
+
+// message box on Windows, stderr elsewhere
+void showErrorMessage(const char* title, const char* message);
+
+// debug output, compiled out in release builds. Does not allocate so it can be used from the render loop.
+void printDebug(const char* text);
@@ -0,0 +1,362 @@
+#include "platform.h"
+
+#ifdef VK_USE_PLATFORM_WAYLAND_KHR
+
+#include <cstdint>
+#include <cstring>
+
+#include <unistd.h>
+#include <wayland-client.h>
+
+#include "error.h"
+
+// The parts of xdg-shell (stable, version 1) that are used here.
+// Normally wayland-scanner generates these from xdg-shell.xml, writing them out avoids needing the scanner and protocol files to build.
+namespace {
+
+struct xdg_wm_base;
+struct xdg_surface;
+struct xdg_toplevel;
+
+extern const wl_interface xdg_wm_base_interface;
+extern const wl_interface xdg_surface_interface;
+extern const wl_interface xdg_toplevel_interface;
+
+// argument types, one entry per argument of each message, nullptr for anything that is not an object
+const wl_interface* xdg_types[] = {
+    nullptr,                 // 0: messages without object arguments
+    nullptr,
+    nullptr,
+    nullptr,
+    &xdg_surface_interface,  // 4: xdg_wm_base.get_xdg_surface
+    &wl_surface_interface,
+    &xdg_toplevel_interface, // 6: xdg_surface.get_toplevel
+    &wl_seat_interface,      // 7: xdg_toplevel.show_window_menu, move and resize
+    nullptr,
+    nullptr,
+    nullptr,
+};
+
+const wl_message xdg_wm_base_requests[] = {
+    {"destroy", "", xdg_types + 0},
+    {"create_positioner", "n", xdg_types + 0}, // positioners are only needed for popups
+    {"get_xdg_surface", "no", xdg_types + 4},
+    {"pong", "u", xdg_types + 0},
+};
+const wl_message xdg_wm_base_events[] = {
+    {"ping", "u", xdg_types + 0},
+};
+const wl_interface xdg_wm_base_interface = {"xdg_wm_base", 1, 4, xdg_wm_base_requests, 1, xdg_wm_base_events};
+
+const wl_message xdg_surface_requests[] = {
+    {"destroy", "", xdg_types + 0},
+    {"get_toplevel", "n", xdg_types + 6},
+    {"get_popup", "n?oo", xdg_types + 0},
+    {"set_window_geometry", "iiii", xdg_types + 0},
+    {"ack_configure", "u", xdg_types + 0},
+};
+const wl_message xdg_surface_events[] = {
+    {"configure", "u", xdg_types + 0},
+};
+const wl_interface xdg_surface_interface = {"xdg_surface", 1, 5, xdg_surface_requests, 1, xdg_surface_events};
+
+const wl_message xdg_toplevel_requests[] = {
+    {"destroy", "", xdg_types + 0},
+    {"set_parent", "?o", xdg_types + 0},
+    {"set_title", "s", xdg_types + 0},
+    {"set_app_id", "s", xdg_types + 0},
+    {"show_window_menu", "ouii", xdg_types + 7},
+    {"move", "ou", xdg_types + 7},
+    {"resize", "ouu", xdg_types + 7},
+    {"set_max_size", "ii", xdg_types + 0},
+    {"set_min_size", "ii", xdg_types + 0},
+};
+const wl_message xdg_toplevel_events[] = {
+    {"configure", "iia", xdg_types + 0},
+    {"close", "", xdg_types + 0},
+};
+const wl_interface xdg_toplevel_interface = {"xdg_toplevel", 1, 9, xdg_toplevel_requests, 2, xdg_toplevel_events};
+
+// request opcodes, the index into the request tables above
+constexpr uint32_t XDG_WM_BASE_DESTROY = 0;
+constexpr uint32_t XDG_WM_BASE_GET_XDG_SURFACE = 2;
+constexpr uint32_t XDG_WM_BASE_PONG = 3;
+constexpr uint32_t XDG_SURFACE_DESTROY = 0;
+constexpr uint32_t XDG_SURFACE_GET_TOPLEVEL = 1;
+constexpr uint32_t XDG_SURFACE_ACK_CONFIGURE = 4;
+constexpr uint32_t XDG_TOPLEVEL_DESTROY = 0;
+constexpr uint32_t XDG_TOPLEVEL_SET_TITLE = 2;
+constexpr uint32_t XDG_TOPLEVEL_SET_APP_ID = 3;
+constexpr uint32_t XDG_TOPLEVEL_SET_MAX_SIZE = 7;
+constexpr uint32_t XDG_TOPLEVEL_SET_MIN_SIZE = 8;
+
+struct XdgWmBaseListener {
+    void (*ping)(void* data, xdg_wm_base* wm_base, uint32_t serial);
+};
+struct XdgSurfaceListener {
+    void (*configure)(void* data, xdg_surface* surface, uint32_t serial);
+};
+struct XdgToplevelListener {
+    void (*configure)(void* data, xdg_toplevel* toplevel, int32_t width, int32_t height, wl_array* states);
+    void (*close)(void* data, xdg_toplevel* toplevel);
+};
+
+// from linux/input-event-codes.h
+constexpr uint32_t BTN_LEFT = 0x110;
+constexpr uint32_t BTN_RIGHT = 0x111;
+constexpr uint32_t BTN_MIDDLE = 0x112;
+
+wl_proxy* asProxy(void* object) { return static_cast<wl_proxy*>(object); }
+
+void addListener(void* object, const void* listener, void* data)
+{
+    wl_proxy_add_listener(asProxy(object), reinterpret_cast<void (**)(void)>(const_cast<void*>(listener)), data);
+}
+
+// sends the destroy request and frees the proxy
+void destroyObject(void* object, uint32_t destroy_opcode)
+{
+    if (object == nullptr) return;
+    wl_proxy_marshal(asProxy(object), destroy_opcode);
+    wl_proxy_destroy(asProxy(object));
+}
+
+class WaylandWindow final : public Window {
+public:
+    WaylandWindow(const std::string& title, VkExtent2D extent) : window_extent(extent)
+    {
+        display = wl_display_connect(nullptr);
+        if (display == nullptr) throw Error("Failed to connect to the Wayland display");
+
+        registry = wl_display_get_registry(display);
+        wl_registry_add_listener(registry, &registry_listener, this);
+        wl_display_roundtrip(display);
+        if (compositor == nullptr || wm_base == nullptr) {
+            destroy();
+            throw Error("Wayland compositor does not support xdg-shell");
+        }
+
+        addListener(wm_base, &wm_base_listener, this);
+
+        surface = wl_compositor_create_surface(compositor);
+        shell_surface = reinterpret_cast<xdg_surface*>(
+            wl_proxy_marshal_constructor(asProxy(wm_base), XDG_WM_BASE_GET_XDG_SURFACE, &xdg_surface_interface, nullptr, surface));
+        addListener(shell_surface, &surface_listener, this);
+        toplevel = reinterpret_cast<xdg_toplevel*>(
+            wl_proxy_marshal_constructor(asProxy(shell_surface), XDG_SURFACE_GET_TOPLEVEL, &xdg_toplevel_interface, nullptr));
+        addListener(toplevel, &toplevel_listener, this);
+
+        wl_proxy_marshal(asProxy(toplevel), XDG_TOPLEVEL_SET_TITLE, title.c_str());
+        wl_proxy_marshal(asProxy(toplevel), XDG_TOPLEVEL_SET_APP_ID, "VulkanApplication");
+        // same as the Win32 window, not resizable
+        wl_proxy_marshal(asProxy(toplevel), XDG_TOPLEVEL_SET_MIN_SIZE, static_cast<int32_t>(extent.width), static_cast<int32_t>(extent.height));
+        wl_proxy_marshal(asProxy(toplevel), XDG_TOPLEVEL_SET_MAX_SIZE, static_cast<int32_t>(extent.width), static_cast<int32_t>(extent.height));
+
+        // nothing may be presented to the surface until the first configure has been acknowledged
+        wl_surface_commit(surface);
+        while (!configured) {
+            if (wl_display_dispatch(display) < 0) {
+                destroy();
+                throw Error("Lost the Wayland display connection");
+            }
+        }
+    }
+
+    ~WaylandWindow() override { destroy(); }
+
+    WaylandWindow(const WaylandWindow&) = delete;
+    WaylandWindow& operator=(const WaylandWindow&) = delete;
+
+    WindowBackend backend() const override { return WindowBackend::Wayland; }
+
+    std::vector<const char*> requiredInstanceExtensions() const override
+    {
+        return {VK_KHR_SURFACE_EXTENSION_NAME, VK_KHR_WAYLAND_SURFACE_EXTENSION_NAME};
+    }
+
+    VkSurfaceKHR createSurface(VkInstance instance) const override
+    {
+        VkWaylandSurfaceCreateInfoKHR surfaceInfo{};
+        surfaceInfo.sType = VK_STRUCTURE_TYPE_WAYLAND_SURFACE_CREATE_INFO_KHR;
+        surfaceInfo.display = display;
+        surfaceInfo.surface = surface;
+        VkSurfaceKHR vk_surface = VK_NULL_HANDLE;
+        VKCHECK(vkCreateWaylandSurfaceKHR(instance, &surfaceInfo, nullptr, &vk_surface));
+        return vk_surface;
+    }
+
+    // Wayland surfaces have no size of their own, the swapchain extent decides it
+    VkExtent2D extent() const override { return window_extent; }
+
+    bool processEvents(EventQueue& events) override
+    {
+        // the listeners push to whichever queue is being processed
+        event_queue = &events;
+        if (wl_display_dispatch(display) < 0) open = false;
+        event_queue = nullptr;
+        return open;
+    }
+
+private:
+    void push(const Event& event)
+    {
+        if (event_queue != nullptr) event_queue->push(event);
+    }
+
+    void destroy()
+    {
+        if (keyboard != nullptr) wl_keyboard_destroy(keyboard);
+        if (pointer != nullptr) wl_pointer_destroy(pointer);
+        if (seat != nullptr) wl_seat_destroy(seat);
+        destroyObject(toplevel, XDG_TOPLEVEL_DESTROY);
+        destroyObject(shell_surface, XDG_SURFACE_DESTROY);
+        if (surface != nullptr) wl_surface_destroy(surface);
+        destroyObject(wm_base, XDG_WM_BASE_DESTROY);
+        if (compositor != nullptr) wl_compositor_destroy(compositor);
+        if (registry != nullptr) wl_registry_destroy(registry);
+        if (display != nullptr) wl_display_disconnect(display);
+        keyboard = nullptr;
+        pointer = nullptr;
+        seat = nullptr;
+        toplevel = nullptr;
+        shell_surface = nullptr;
+        surface = nullptr;
+        wm_base = nullptr;
+        compositor = nullptr;
+        registry = nullptr;
+        display = nullptr;
+    }
+
+    static void onGlobal(void* data, wl_registry* global_registry, uint32_t name, const char* interface, uint32_t)
+    {
+        auto* window = static_cast<WaylandWindow*>(data);
+        if (strcmp(interface, wl_compositor_interface.name) == 0) {
+            window->compositor = static_cast<wl_compositor*>(wl_registry_bind(global_registry, name, &wl_compositor_interface, 1));
+        }
+        else if (strcmp(interface, xdg_wm_base_interface.name) == 0) {
+            window->wm_base = static_cast<xdg_wm_base*>(wl_registry_bind(global_registry, name, &xdg_wm_base_interface, 1));
+        }
+        else if (strcmp(interface, wl_seat_interface.name) == 0 && window->seat == nullptr) {
+            // version 1 keeps the listeners below complete whatever version of the protocol headers is installed
+            window->seat = static_cast<wl_seat*>(wl_registry_bind(global_registry, name, &wl_seat_interface, 1));
+            wl_seat_add_listener(window->seat, &seat_listener, window);
+        }
+    }
+
+    static void onGlobalRemove(void*, wl_registry*, uint32_t) {}
+
+    static void onPing(void*, xdg_wm_base* base, uint32_t serial) { wl_proxy_marshal(asProxy(base), XDG_WM_BASE_PONG, serial); }
+
+    static void onSurfaceConfigure(void* data, xdg_surface* configured_surface, uint32_t serial)
+    {
+        wl_proxy_marshal(asProxy(configured_surface), XDG_SURFACE_ACK_CONFIGURE, serial);
+        static_cast<WaylandWindow*>(data)->configured = true;
+    }
+
+    static void onToplevelConfigure(void* data, xdg_toplevel*, int32_t width, int32_t height, wl_array*)
+    {
+        auto* window = static_cast<WaylandWindow*>(data);
+        // zero means the compositor leaves the size up to us
+        if (width > 0 && height > 0 && (static_cast<uint32_t>(width) != window->window_extent.width ||
+                                        static_cast<uint32_t>(height) != window->window_extent.height)) {
+            window->window_extent = VkExtent2D{static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+            Event event = makeEvent(EventType::Resize);
+            event.width = window->window_extent.width;
+            event.height = window->window_extent.height;
+            window->push(event);
+        }
+    }
+
+    static void onToplevelClose(void* data, xdg_toplevel*) { static_cast<WaylandWindow*>(data)->open = false; }
+
+    static void onSeatCapabilities(void* data, wl_seat* capable_seat, uint32_t capabilities)
+    {
+        auto* window = static_cast<WaylandWindow*>(data);
+        if ((capabilities & WL_SEAT_CAPABILITY_KEYBOARD) && window->keyboard == nullptr) {
+            window->keyboard = wl_seat_get_keyboard(capable_seat);
+            wl_keyboard_add_listener(window->keyboard, &keyboard_listener, window);
+        }
+        if ((capabilities & WL_SEAT_CAPABILITY_POINTER) && window->pointer == nullptr) {
+            window->pointer = wl_seat_get_pointer(capable_seat);
+            wl_pointer_add_listener(window->pointer, &pointer_listener, window);
+        }
+    }
+
+    // no keymap is needed, key codes are passed on as they are
+    static void onKeymap(void*, wl_keyboard*, uint32_t, int32_t fd, uint32_t) { close(fd); }
+    static void onKeyboardEnter(void*, wl_keyboard*, uint32_t, wl_surface*, wl_array*) {}
+    static void onKeyboardLeave(void*, wl_keyboard*, uint32_t, wl_surface*) {}
+    static void onKeyboardModifiers(void*, wl_keyboard*, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t) {}
+
+    static void onKey(void* data, wl_keyboard*, uint32_t, uint32_t, uint32_t key, uint32_t state)
+    {
+        Event event = makeEvent(state == WL_KEYBOARD_KEY_STATE_PRESSED ? EventType::KeyDown : EventType::KeyUp);
+        event.code = key;
+        static_cast<WaylandWindow*>(data)->push(event);
+    }
+
+    static void onPointerEnter(void* data, wl_pointer*, uint32_t, wl_surface*, wl_fixed_t x, wl_fixed_t y)
+    {
+        auto* window = static_cast<WaylandWindow*>(data);
+        window->pointer_x = wl_fixed_to_int(x);
+        window->pointer_y = wl_fixed_to_int(y);
+    }
+
+    static void onPointerLeave(void*, wl_pointer*, uint32_t, wl_surface*) {}
+
+    static void onPointerMotion(void* data, wl_pointer*, uint32_t, wl_fixed_t x, wl_fixed_t y)
+    {
+        auto* window = static_cast<WaylandWindow*>(data);
+        window->pointer_x = wl_fixed_to_int(x);
+        window->pointer_y = wl_fixed_to_int(y);
+        Event event = makeEvent(EventType::MouseMove);
+        event.x = window->pointer_x;
+        event.y = window->pointer_y;
+        window->push(event);
+    }
+
+    static void onPointerButton(void* data, wl_pointer*, uint32_t, uint32_t, uint32_t button, uint32_t state)
+    {
+        if (button != BTN_LEFT && button != BTN_RIGHT && button != BTN_MIDDLE) return;
+        auto* window = static_cast<WaylandWindow*>(data);
+        Event event = makeEvent(state == WL_POINTER_BUTTON_STATE_PRESSED ? EventType::MouseButtonDown : EventType::MouseButtonUp);
+        event.code = button - BTN_LEFT;
+        event.x = window->pointer_x;
+        event.y = window->pointer_y;
+        window->push(event);
+    }
+
+    static void onPointerAxis(void*, wl_pointer*, uint32_t, uint32_t, wl_fixed_t) {}
+
+    static constexpr wl_registry_listener registry_listener{onGlobal, onGlobalRemove};
+    static constexpr XdgWmBaseListener wm_base_listener{onPing};
+    static constexpr XdgSurfaceListener surface_listener{onSurfaceConfigure};
+    static constexpr XdgToplevelListener toplevel_listener{onToplevelConfigure, onToplevelClose};
+    // only the version 1 events, later members are left null
+    static constexpr wl_seat_listener seat_listener{onSeatCapabilities};
+    static constexpr wl_keyboard_listener keyboard_listener{onKeymap, onKeyboardEnter, onKeyboardLeave, onKey, onKeyboardModifiers};
+    static constexpr wl_pointer_listener pointer_listener{onPointerEnter, onPointerLeave, onPointerMotion, onPointerButton, onPointerAxis};
+
+    wl_display* display = nullptr;
+    wl_registry* registry = nullptr;
+    wl_compositor* compositor = nullptr;
+    xdg_wm_base* wm_base = nullptr;
+    wl_surface* surface = nullptr;
+    xdg_surface* shell_surface = nullptr;
+    xdg_toplevel* toplevel = nullptr;
+    wl_seat* seat = nullptr;
+    wl_keyboard* keyboard = nullptr;
+    wl_pointer* pointer = nullptr;
+    EventQueue* event_queue = nullptr; // only set inside processEvents()
+    int32_t pointer_x = 0;
+    int32_t pointer_y = 0;
+    VkExtent2D window_extent;
+    bool configured = false;
+    bool open = true;
+};
+
+} // namespace
+
+std::unique_ptr<Window> createWaylandWindow(const std::string& title, VkExtent2D extent) { return std::make_unique<WaylandWindow>(title, extent); }
+
+#endif
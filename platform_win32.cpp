@@ -0,0 +1,126 @@
+#include "platform.h"
+
+#ifdef _WIN32
+
+namespace {
+
+class Win32Window final : public Window {
+public:
+    Win32Window(HINSTANCE hInstance, HWND hWnd, HACCEL hAccelTable) : instance_handle(hInstance), window_handle(hWnd), accelerators(hAccelTable)
+    {
+        last_extent = extent();
+    }
+
+    WindowBackend backend() const override { return WindowBackend::Win32; }
+
+    std::vector<const char*> requiredInstanceExtensions() const override
+    {
+        return {VK_KHR_SURFACE_EXTENSION_NAME, VK_KHR_WIN32_SURFACE_EXTENSION_NAME};
+    }
+
+    VkSurfaceKHR createSurface(VkInstance instance) const override
+    {
+        VkWin32SurfaceCreateInfoKHR surfaceInfo{};
+        surfaceInfo.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
+        surfaceInfo.hinstance = instance_handle;
+        surfaceInfo.hwnd = window_handle;
+        VkSurfaceKHR surface = VK_NULL_HANDLE;
+        VKCHECK(vkCreateWin32SurfaceKHR(instance, &surfaceInfo, nullptr, &surface));
+        return surface;
+    }
+
+    VkExtent2D extent() const override
+    {
+        RECT rect{};
+        GetClientRect(window_handle, &rect);
+        return VkExtent2D{static_cast<uint32_t>(rect.right - rect.left), static_cast<uint32_t>(rect.bottom - rect.top)};
+    }
+
+    // the vulkan context is destroyed by WndProc just before WM_QUIT is posted
+    bool processEvents(EventQueue& events) override
+    {
+        MSG msg{};
+        if (GetMessage(&msg, NULL, 0, 0) <= 0) return false;
+
+        // input messages are posted so they can be picked up here rather than in WndProc
+        pushInputEvent(msg, events);
+
+        if (!TranslateAccelerator(msg.hwnd, accelerators, &msg)) {
+            TranslateMessage(&msg);
+            DispatchMessage(&msg);
+        }
+
+        // WM_SIZE is sent straight to WndProc, so compare against the last known state instead
+        const bool is_minimised = IsIconic(window_handle) != FALSE;
+        if (is_minimised != minimised) {
+            minimised = is_minimised;
+            events.push(makeEvent(minimised ? EventType::Minimise : EventType::Restore));
+        }
+        const VkExtent2D current_extent = extent();
+        if (!minimised && (current_extent.width != last_extent.width || current_extent.height != last_extent.height)) {
+            last_extent = current_extent;
+            Event event = makeEvent(EventType::Resize);
+            event.width = current_extent.width;
+            event.height = current_extent.height;
+            events.push(event);
+        }
+
+        return true;
+    }
+
+private:
+    static void pushInputEvent(const MSG& msg, EventQueue& events)
+    {
+        Event event{};
+        switch (msg.message) {
+            case WM_KEYDOWN:
+            case WM_SYSKEYDOWN:
+                event.type = EventType::KeyDown;
+                event.code = static_cast<uint32_t>(msg.wParam);
+                break;
+            case WM_KEYUP:
+            case WM_SYSKEYUP:
+                event.type = EventType::KeyUp;
+                event.code = static_cast<uint32_t>(msg.wParam);
+                break;
+            case WM_MOUSEMOVE:
+                event.type = EventType::MouseMove;
+                break;
+            case WM_LBUTTONDOWN:
+            case WM_RBUTTONDOWN:
+            case WM_MBUTTONDOWN:
+                event.type = EventType::MouseButtonDown;
+                event.code = msg.message == WM_LBUTTONDOWN ? 0 : (msg.message == WM_RBUTTONDOWN ? 1 : 2);
+                break;
+            case WM_LBUTTONUP:
+            case WM_RBUTTONUP:
+            case WM_MBUTTONUP:
+                event.type = EventType::MouseButtonUp;
+                event.code = msg.message == WM_LBUTTONUP ? 0 : (msg.message == WM_RBUTTONUP ? 1 : 2);
+                break;
+            default:
+                return;
+        }
+        if (event.type == EventType::MouseMove || event.type == EventType::MouseButtonDown || event.type == EventType::MouseButtonUp) {
+            event.x = static_cast<int16_t>(LOWORD(msg.lParam));
+            event.y = static_cast<int16_t>(HIWORD(msg.lParam));
+        }
+        event.timestamp_ns = eventTimestampNow();
+        events.push(event); // dropped if the render thread has fallen behind
+    }
+
+    HINSTANCE instance_handle;
+    HWND window_handle;
+    HACCEL accelerators;
+    VkExtent2D last_extent{};
+    bool minimised = false;
+};
+
+} // namespace
+
+std::unique_ptr<Window> createWin32Window(HINSTANCE hInstance, HWND hWnd, HACCEL hAccelTable)
+{
+    return std::make_unique<Win32Window>(hInstance, hWnd, hAccelTable);
+}
+
+#endif
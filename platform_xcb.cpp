@@ -0,0 +1,182 @@
+#include "platform.h"
+
+#ifdef VK_USE_PLATFORM_XCB_KHR
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include <array>
+
+#include <xcb/xcb.h>
+
+#include "error.h"
+
+namespace {
+
+// WM_SIZE_HINTS as laid out in the ICCCM, avoids a dependency on xcb-icccm for the two fields that are needed
+struct SizeHints {
+    uint32_t flags;
+    int32_t x, y, width, height;
+    int32_t min_width, min_height;
+    int32_t max_width, max_height;
+    int32_t width_inc, height_inc;
+    int32_t min_aspect_num, min_aspect_den;
+    int32_t max_aspect_num, max_aspect_den;
+    int32_t base_width, base_height;
+    uint32_t win_gravity;
+};
+constexpr uint32_t SIZE_HINT_P_MIN_SIZE = 1 << 4;
+constexpr uint32_t SIZE_HINT_P_MAX_SIZE = 1 << 5;
+
+xcb_atom_t internAtom(xcb_connection_t* connection, const char* name)
+{
+    xcb_intern_atom_reply_t* reply = xcb_intern_atom_reply(connection, xcb_intern_atom(connection, 0, static_cast<uint16_t>(strlen(name)), name), nullptr);
+    if (reply == nullptr) throw Error("Failed to intern X11 atom");
+    const xcb_atom_t atom = reply->atom;
+    free(reply);
+    return atom;
+}
+
+class XcbWindow final : public Window {
+public:
+    XcbWindow(const std::string& title, VkExtent2D extent) : window_extent(extent)
+    {
+        connection = xcb_connect(nullptr, nullptr);
+        if (xcb_connection_has_error(connection)) {
+            xcb_disconnect(connection);
+            throw Error("Failed to connect to the X server");
+        }
+
+        xcb_screen_t* screen = xcb_setup_roots_iterator(xcb_get_setup(connection)).data;
+
+        window = xcb_generate_id(connection);
+        const uint32_t value_mask = XCB_CW_BACK_PIXEL | XCB_CW_EVENT_MASK;
+        const std::array<uint32_t, 2> values{screen->black_pixel, XCB_EVENT_MASK_KEY_PRESS | XCB_EVENT_MASK_KEY_RELEASE | XCB_EVENT_MASK_BUTTON_PRESS |
+                                                                       XCB_EVENT_MASK_BUTTON_RELEASE | XCB_EVENT_MASK_POINTER_MOTION |
+                                                                       XCB_EVENT_MASK_STRUCTURE_NOTIFY};
+        xcb_create_window(connection, XCB_COPY_FROM_PARENT, window, screen->root, 0, 0, static_cast<uint16_t>(extent.width),
+                          static_cast<uint16_t>(extent.height), 0, XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual, value_mask, values.data());
+
+        xcb_change_property(connection, XCB_PROP_MODE_REPLACE, window, XCB_ATOM_WM_NAME, XCB_ATOM_STRING, 8, static_cast<uint32_t>(title.size()),
+                            title.c_str());
+
+        // the window manager sends WM_DELETE_WINDOW instead of killing the connection when the close button is pressed
+        const xcb_atom_t wm_protocols = internAtom(connection, "WM_PROTOCOLS");
+        wm_delete_window = internAtom(connection, "WM_DELETE_WINDOW");
+        xcb_change_property(connection, XCB_PROP_MODE_REPLACE, window, wm_protocols, XCB_ATOM_ATOM, 32, 1, &wm_delete_window);
+
+        // same as the Win32 window, not resizable
+        SizeHints hints{};
+        hints.flags = SIZE_HINT_P_MIN_SIZE | SIZE_HINT_P_MAX_SIZE;
+        hints.min_width = hints.max_width = static_cast<int32_t>(extent.width);
+        hints.min_height = hints.max_height = static_cast<int32_t>(extent.height);
+        xcb_change_property(connection, XCB_PROP_MODE_REPLACE, window, XCB_ATOM_WM_NORMAL_HINTS, XCB_ATOM_WM_SIZE_HINTS, 32, sizeof(hints) / 4, &hints);
+
+        xcb_map_window(connection, window);
+        xcb_flush(connection);
+    }
+
+    ~XcbWindow() override
+    {
+        xcb_destroy_window(connection, window);
+        xcb_disconnect(connection);
+    }
+
+    XcbWindow(const XcbWindow&) = delete;
+    XcbWindow& operator=(const XcbWindow&) = delete;
+
+    WindowBackend backend() const override { return WindowBackend::XCB; }
+
+    std::vector<const char*> requiredInstanceExtensions() const override { return {VK_KHR_SURFACE_EXTENSION_NAME, VK_KHR_XCB_SURFACE_EXTENSION_NAME}; }
+
+    VkSurfaceKHR createSurface(VkInstance instance) const override
+    {
+        VkXcbSurfaceCreateInfoKHR surfaceInfo{};
+        surfaceInfo.sType = VK_STRUCTURE_TYPE_XCB_SURFACE_CREATE_INFO_KHR;
+        surfaceInfo.connection = connection;
+        surfaceInfo.window = window;
+        VkSurfaceKHR surface = VK_NULL_HANDLE;
+        VKCHECK(vkCreateXcbSurfaceKHR(instance, &surfaceInfo, nullptr, &surface));
+        return surface;
+    }
+
+    VkExtent2D extent() const override { return window_extent; }
+
+    bool processEvents(EventQueue& events) override
+    {
+        xcb_generic_event_t* event = xcb_wait_for_event(connection);
+        while (event != nullptr) {
+            switch (event->response_type & ~0x80) {
+                case XCB_KEY_PRESS:
+                case XCB_KEY_RELEASE: {
+                    const auto* key = reinterpret_cast<const xcb_key_press_event_t*>(event);
+                    Event key_event = makeEvent((event->response_type & ~0x80) == XCB_KEY_PRESS ? EventType::KeyDown : EventType::KeyUp);
+                    key_event.code = key->detail;
+                    events.push(key_event);
+                } break;
+                case XCB_BUTTON_PRESS:
+                case XCB_BUTTON_RELEASE: {
+                    const auto* button = reinterpret_cast<const xcb_button_press_event_t*>(event);
+                    // 4 to 7 are the scroll wheel
+                    if (button->detail >= 1 && button->detail <= 3) {
+                        Event button_event =
+                            makeEvent((event->response_type & ~0x80) == XCB_BUTTON_PRESS ? EventType::MouseButtonDown : EventType::MouseButtonUp);
+                        button_event.code = button->detail == 1 ? 0 : (button->detail == 3 ? 1 : 2);
+                        button_event.x = button->event_x;
+                        button_event.y = button->event_y;
+                        events.push(button_event);
+                    }
+                } break;
+                case XCB_MOTION_NOTIFY: {
+                    const auto* motion = reinterpret_cast<const xcb_motion_notify_event_t*>(event);
+                    Event motion_event = makeEvent(EventType::MouseMove);
+                    motion_event.x = motion->event_x;
+                    motion_event.y = motion->event_y;
+                    events.push(motion_event);
+                } break;
+                case XCB_CONFIGURE_NOTIFY: {
+                    const auto* configure = reinterpret_cast<const xcb_configure_notify_event_t*>(event);
+                    if (configure->width != window_extent.width || configure->height != window_extent.height) {
+                        window_extent = VkExtent2D{configure->width, configure->height};
+                        Event resize_event = makeEvent(EventType::Resize);
+                        resize_event.width = window_extent.width;
+                        resize_event.height = window_extent.height;
+                        events.push(resize_event);
+                    }
+                } break;
+                // iconified windows are unmapped
+                case XCB_UNMAP_NOTIFY:
+                    events.push(makeEvent(EventType::Minimise));
+                    break;
+                case XCB_MAP_NOTIFY:
+                    events.push(makeEvent(EventType::Restore));
+                    break;
+                case XCB_CLIENT_MESSAGE: {
+                    const auto* message = reinterpret_cast<const xcb_client_message_event_t*>(event);
+                    if (message->data.data32[0] == wm_delete_window) open = false;
+                } break;
+                default:
+                    break;
+            }
+            free(event);
+            event = xcb_poll_for_event(connection);
+        }
+
+        if (xcb_connection_has_error(connection)) open = false;
+        return open;
+    }
+
+private:
+    xcb_connection_t* connection = nullptr;
+    xcb_window_t window = 0;
+    xcb_atom_t wm_delete_window = 0;
+    VkExtent2D window_extent;
+    bool open = true;
+};
+
+} // namespace
+
+std::unique_ptr<Window> createXcbWindow(const std::string& title, VkExtent2D extent) { return std::make_unique<XcbWindow>(title, extent); }
+
+#endif
@@ -0,0 +1,62 @@
+#version 450
+
+// AntiAliasing::PostProcess, an FXAA style filter. Where the luma contrast around a pixel is high enough to be an edge, the pixel
+// is blended with its neighbours along the edge, not across it. Dynamic resolution only draws the top left of the render target,
+// which is stretched over the whole swapchain image here instead of being blitted.
+
+layout(set = 0, binding = 0) uniform sampler2D scene; // bilinear, clamped to the edge
+
+// PostProcessConstants in vulkan_pipeline.h
+layout( push_constant ) uniform Constants {
+	vec2 uv_scale;   // the drawn part of the render target
+	vec2 texel_size; // of the render target
+} constants;
+
+layout(location = 0) in vec2 uv;
+
+layout(location = 0) out vec4 outColor;
+
+const float EDGE_THRESHOLD = 1.0 / 8.0;     // of the brightest neighbour
+const float EDGE_THRESHOLD_MIN = 1.0 / 32.0; // dark areas are left alone
+const float SPAN_MAX = 8.0;                  // texels
+const float REDUCE_MUL = 1.0 / 8.0;
+const float REDUCE_MIN = 1.0 / 128.0;
+
+float luma(vec3 color) { return dot(color, vec3(0.299, 0.587, 0.114)); }
+
+// the drawn part ends before the render target does, what is past it was never written
+vec3 fetch(vec2 p) {
+	const vec2 half_texel = constants.texel_size * 0.5;
+	return texture(scene, clamp(p, half_texel, constants.uv_scale - half_texel)).rgb;
+}
+
+void main() {
+	const vec2 p = uv * constants.uv_scale;
+	const vec2 t = constants.texel_size;
+
+	const vec3 rgb_m = fetch(p);
+	const float luma_m = luma(rgb_m);
+	const float luma_nw = luma(fetch(p + vec2(-1.0, -1.0) * t));
+	const float luma_ne = luma(fetch(p + vec2(1.0, -1.0) * t));
+	const float luma_sw = luma(fetch(p + vec2(-1.0, 1.0) * t));
+	const float luma_se = luma(fetch(p + vec2(1.0, 1.0) * t));
+	const float luma_min = min(luma_m, min(min(luma_nw, luma_ne), min(luma_sw, luma_se)));
+	const float luma_max = max(luma_m, max(max(luma_nw, luma_ne), max(luma_sw, luma_se)));
+
+	if (luma_max - luma_min < max(EDGE_THRESHOLD_MIN, luma_max * EDGE_THRESHOLD)) {
+		outColor = vec4(rgb_m, 1.0);
+		return;
+	}
+
+	// along the edge, perpendicular to the luma gradient
+	vec2 dir = vec2(-((luma_nw + luma_ne) - (luma_sw + luma_se)), (luma_nw + luma_sw) - (luma_ne + luma_se));
+	const float dir_reduce = max((luma_nw + luma_ne + luma_sw + luma_se) * (0.25 * REDUCE_MUL), REDUCE_MIN);
+	const float rcp_dir_min = 1.0 / (min(abs(dir.x), abs(dir.y)) + dir_reduce);
+	dir = clamp(dir * rcp_dir_min, vec2(-SPAN_MAX), vec2(SPAN_MAX)) * t;
+
+	const vec3 rgb_a = 0.5 * (fetch(p + dir * (1.0 / 3.0 - 0.5)) + fetch(p + dir * (2.0 / 3.0 - 0.5)));
+	const vec3 rgb_b = rgb_a * 0.5 + 0.25 * (fetch(p - dir * 0.5) + fetch(p + dir * 0.5));
+	// the wider blend crossed into something else, keep the narrow one
+	const float luma_b = luma(rgb_b);
+	outColor = vec4(luma_b < luma_min || luma_b > luma_max ? rgb_a : rgb_b, 1.0);
+}
@@ -0,0 +1,11 @@
+#include "shaders.h"
+
+#include <cstdint>
+
+#include <span>
+
+namespace {
+#include "post_process.frag.h" // generated from post_process.frag, see the project file
+}
+
+const std::span<const uint32_t> spv_post_process{spv_post_process_frag};
@@ -0,0 +1,311 @@
+#include "replay.h"
+
+#include <cinttypes>
+#include <cmath>
+#include <cstring>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+
+#include "error.h"
+#include "json.h"
+#include "platform.h"
+#include "vulkan_capture.h"
+
+// values are written as they are in memory
+static_assert(std::endian::native == std::endian::little, "replay files are little endian");
+
+template <typename T>
+static void put(std::FILE* file, T value)
+{
+    fwrite(&value, sizeof(T), 1, file);
+}
+
+void openReplayWriter(const std::string& path, const ReplayHeader& header, ReplayWriter& writer)
+{
+    writer.file = std::fopen(path.c_str(), "wb");
+    if (writer.file == nullptr) throw Error("Failed to open " + path + " to record to");
+    writer.frames = 0;
+
+    const RendererSettings& renderer = header.renderer;
+    put(writer.file, REPLAY_MAGIC);
+    put(writer.file, REPLAY_VERSION);
+    put(writer.file, header.width);
+    put(writer.file, header.height);
+    put(writer.file, renderer.instance_count);
+    put(writer.file, renderer.field_instances);
+    put(writer.file, renderer.frames_in_flight);
+    put(writer.file, renderer.worker_count);
+    put(writer.file, static_cast<uint32_t>(renderer.scene_path.size()));
+    fwrite(renderer.scene_path.data(), 1, renderer.scene_path.size(), writer.file);
+}
+
+void writeReplayFrame(ReplayWriter& writer, double dt)
+{
+    put(writer.file, ReplayRecordType::Frame);
+    put(writer.file, dt);
+    ++writer.frames;
+}
+
+void writeReplayEvent(ReplayWriter& writer, const Event& event)
+{
+    put(writer.file, ReplayRecordType::Event);
+    put(writer.file, static_cast<uint8_t>(event.type));
+    put(writer.file, event.code);
+    put(writer.file, event.x);
+    put(writer.file, event.y);
+    put(writer.file, event.width);
+    put(writer.file, event.height);
+}
+
+void writeReplayLiveSettings(ReplayWriter& writer, const LiveSettings& settings)
+{
+    put(writer.file, ReplayRecordType::LiveSettings);
+    put(writer.file, settings.fps_limit);
+    for (const float channel : settings.clear_color) put(writer.file, channel);
+    put(writer.file, settings.dynamic_resolution_ms);
+    put(writer.file, static_cast<uint8_t>(settings.anti_aliasing));
+}
+
+void closeReplayWriter(ReplayWriter& writer)
+{
+    if (writer.file == nullptr) return;
+    const bool failed = std::ferror(writer.file) != 0;
+    if (std::fclose(writer.file) != 0 || failed) {
+        printDebug("replay: the recording could not be written in full\n");
+    }
+    else {
+        std::array<char, 128> buf{};
+        snprintf(buf.data(), buf.size(), "replay: recorded %" PRIu64 " frames\n", writer.frames);
+        printDebug(buf.data());
+    }
+    writer.file = nullptr;
+}
+
+// false if fewer than sizeof(T) bytes are left
+template <typename T>
+static bool get(ReplayReader& reader, T& value)
+{
+    if (reader.file.size - reader.offset < sizeof(T)) return false;
+    std::memcpy(&value, reader.file.data + reader.offset, sizeof(T));
+    reader.offset += sizeof(T);
+    return true;
+}
+
+void openReplayReader(const std::string& path, ReplayReader& reader)
+{
+    if (!mapFile(path, reader.file)) throw Error("Failed to open replay " + path);
+    reader.offset = 0;
+
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    if (!get(reader, magic) || magic != REPLAY_MAGIC) throw Error(path + " is not a replay");
+    if (!get(reader, version)) throw Error(path + " is cut short");
+    if (version != REPLAY_VERSION) throw Error(path + " was recorded by another version, it cannot be replayed");
+
+    ReplayHeader& header = reader.header;
+    uint32_t scene_path_size = 0;
+    if (!get(reader, header.width) || !get(reader, header.height) || !get(reader, header.renderer.instance_count) ||
+        !get(reader, header.renderer.field_instances) || !get(reader, header.renderer.frames_in_flight) || !get(reader, header.renderer.worker_count) ||
+        !get(reader, scene_path_size) || reader.file.size - reader.offset < scene_path_size) {
+        throw Error(path + " is cut short");
+    }
+    header.renderer.scene_path.assign(reinterpret_cast<const char*>(reader.file.data + reader.offset), scene_path_size);
+    reader.offset += scene_path_size;
+    reader.records_offset = reader.offset;
+}
+
+bool readReplayRecord(ReplayReader& reader, ReplayRecord& record)
+{
+    if (reader.offset == reader.file.size) return false;
+
+    bool complete = get(reader, record.type);
+    switch (record.type) {
+        case ReplayRecordType::Frame:
+            complete = complete && get(reader, record.dt);
+            break;
+        case ReplayRecordType::Event: {
+            uint8_t type = 0;
+            complete = complete && get(reader, type) && get(reader, record.event.code) && get(reader, record.event.x) && get(reader, record.event.y) &&
+                       get(reader, record.event.width) && get(reader, record.event.height);
+            if (type > static_cast<uint8_t>(EventType::Restore)) throw Error("Unknown event type in replay");
+            record.event.type = static_cast<EventType>(type);
+        } break;
+        case ReplayRecordType::LiveSettings: {
+            uint8_t anti_aliasing = 0;
+            complete = complete && get(reader, record.live.fps_limit);
+            for (float& channel : record.live.clear_color) complete = complete && get(reader, channel);
+            complete = complete && get(reader, record.live.dynamic_resolution_ms) && get(reader, anti_aliasing);
+            if (anti_aliasing > static_cast<uint8_t>(AntiAliasing::SampleShading4)) throw Error("Unknown anti-aliasing tier in replay");
+            record.live.anti_aliasing = static_cast<AntiAliasing>(anti_aliasing);
+        } break;
+        default:
+            throw Error("Unknown record type in replay");
+    }
+    if (!complete) throw Error("Replay is cut short");
+    return true;
+}
+
+void closeReplayReader(ReplayReader& reader) { unmapFile(reader.file); }
+
+struct ReplayOptions {
+    std::string path{};
+    double timestep_ms = 0.0; // 0 for the recorded dt
+    std::string output_path{};
+};
+
+bool replayRequested(const std::vector<std::string>& args) { return std::find(args.begin(), args.end(), "--replay") != args.end(); }
+
+static ReplayOptions parseOptions(const std::vector<std::string>& args)
+{
+    ReplayOptions options{};
+    for (size_t i = 0; i < args.size(); ++i) {
+        const std::string& arg = args[i];
+        const auto value = [&]() -> const std::string& {
+            if (i + 1 >= args.size()) throw Error("Missing value for " + arg);
+            return args[++i];
+        };
+        try {
+            if (arg == "--replay") options.path = value();
+            else if (arg == "--timestep") options.timestep_ms = std::stod(value());
+            else if (arg == "--output") options.output_path = value();
+            else throw Error("Unknown replay option " + arg);
+        }
+        catch (const std::logic_error&) { // std::stod
+            throw Error("Invalid value for " + arg);
+        }
+    }
+    if (options.timestep_ms < 0.0) throw Error("Invalid value for --timestep");
+    return options;
+}
+
+static double percentile(std::vector<double> values, double p)
+{
+    if (values.empty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    const size_t index = static_cast<size_t>(std::ceil(p * static_cast<double>(values.size()))) - 1;
+    return values[std::min(index, values.size() - 1)];
+}
+
+static double mean(const std::vector<double>& values)
+{
+    if (values.empty()) return 0.0;
+    double sum = 0.0;
+    for (double v : values) sum += v;
+    return sum / static_cast<double>(values.size());
+}
+
+// FNV-1a
+static uint64_t hashPixels(const std::vector<uint8_t>& rgba)
+{
+    uint64_t hash = 0xcbf29ce484222325;
+    for (const uint8_t byte : rgba) hash = (hash ^ byte) * 0x100000001b3;
+    return hash;
+}
+
+static void writeSeries(std::ofstream& file, const char* name, const std::vector<double>& values, bool last)
+{
+    file << "  \"" << name << "\": [";
+    std::array<char, 32> value{};
+    for (size_t i = 0; i < values.size(); ++i) {
+        snprintf(value.data(), value.size(), "%s%.4f", i == 0 ? "" : ", ", values[i]);
+        file << value.data();
+    }
+    file << (last ? "]\n" : "],\n");
+}
+
+int runReplay(const std::vector<std::string>& args)
+{
+    ReplayReader reader{};
+    try {
+        const ReplayOptions options = parseOptions(args);
+        openReplayReader(options.path, reader);
+
+        // the frame to hash is the last one
+        ReplayRecord record{};
+        uint64_t frame_count = 0;
+        while (readReplayRecord(reader, record)) {
+            if (record.type == ReplayRecordType::Frame) ++frame_count;
+        }
+        reader.offset = reader.records_offset;
+
+        struct {
+            std::mutex mutex{};
+            uint64_t hash = 0;
+            bool captured = false;
+        } last_frame;
+        CaptureSettings capture_settings{};
+        capture_settings.callback = [&last_frame](const CaptureJob& job) {
+            std::lock_guard lock(last_frame.mutex);
+            last_frame.hash = hashPixels(job.rgba);
+            last_frame.captured = true;
+        };
+        initHeadless(reader.header.width, reader.header.height, capture_settings, reader.header.renderer);
+
+        std::vector<double> frame_ms{};
+        std::vector<double> record_ms{};
+        std::vector<double> render_gpu_ms{};
+        frame_ms.reserve(frame_count);
+        record_ms.reserve(frame_count);
+        render_gpu_ms.reserve(frame_count);
+        EventQueue& events = getEventQueue();
+        const auto begin_replay = std::chrono::steady_clock::now();
+        auto begin = begin_replay;
+        while (readReplayRecord(reader, record)) {
+            switch (record.type) {
+                case ReplayRecordType::Event:
+                    record.event.timestamp_ns = eventTimestampNow();
+                    if (!events.push(record.event)) throw Error("More input events before a frame than the event queue holds");
+                    break;
+                case ReplayRecordType::LiveSettings:
+                    setLiveSettings(record.live);
+                    break;
+                case ReplayRecordType::Frame: {
+                    if (frame_ms.size() + 1 == frame_count) requestFrameCapture(1);
+                    record_ms.push_back(drawHeadlessFrame(options.timestep_ms > 0.0 ? options.timestep_ms / 1000.0 : record.dt));
+                    render_gpu_ms.push_back(lastFrameRenderGpuMs());
+                    const auto end = std::chrono::steady_clock::now();
+                    frame_ms.push_back(std::chrono::duration<double, std::milli>(end - begin).count());
+                    begin = end;
+                } break;
+            }
+        }
+        flushFrameCapture();
+        const double replay_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin_replay).count();
+        const std::string device_name = getDeviceName();
+        shutdownHeadless();
+        closeReplayReader(reader);
+
+        std::array<char, 32> hash{};
+        snprintf(hash.data(), hash.size(), "%016" PRIx64, last_frame.hash);
+        if (!last_frame.captured) std::strcpy(hash.data(), "none"); // the device could not read back
+
+        printf("%s: %zu frames in %.3f ms on %s\n", options.path.c_str(), frame_ms.size(), replay_ms, device_name.c_str());
+        printf("frame %8.3f ms (p95 %8.3f)  record %8.3f ms (p95 %8.3f)  gpu %8.3f ms  last frame %s\n", mean(frame_ms), percentile(frame_ms, 0.95),
+               mean(record_ms), percentile(record_ms, 0.95), mean(render_gpu_ms), hash.data());
+
+        if (!options.output_path.empty()) {
+            std::ofstream file(options.output_path);
+            if (!file) throw Error("Failed to write " + options.output_path);
+            file << "{\n  \"replay\": \"" << jsonEscape(options.path) << "\",\n  \"device\": \"" << jsonEscape(device_name) << "\",\n";
+            std::array<char, 128> line{};
+            snprintf(line.data(), line.size(), "  \"frames\": %zu,\n  \"replay_ms\": %.4f,\n  \"last_frame_hash\": \"%s\",\n", frame_ms.size(), replay_ms,
+                     hash.data());
+            file << line.data();
+            writeSeries(file, "frame_ms", frame_ms, false);
+            writeSeries(file, "record_ms", record_ms, false);
+            writeSeries(file, "render_gpu_ms", render_gpu_ms, true);
+            file << "}\n";
+        }
+        return 0;
+    }
+    catch (const Error& error) {
+        closeReplayReader(reader);
+        fprintf(stderr, "Replay error: %s\n", error.what());
+        return 2;
+    }
+}
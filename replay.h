@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+
+#include <string>
+#include <vector>
+
+#include "app.h"
+#include "events.h"
+#include "mapped_file.h"
+
+// Record and replay of everything the game loop is driven by, so a run can be repeated exactly and timed again, against another build or
+// on another machine. The scene only depends on what is recorded: the renderer settings it started with, each frame's dt, the window
+// events drained before each frame and the live settings applied. Recording is the record config key, replaying is --replay.
+//
+// The file is little endian: a header, then records each starting with a ReplayRecordType byte. A frame's events and live settings come
+// before the record of the frame itself, which carries its dt.
+//   header         "VRPL", version, width, height, instance count, field instances, frames in flight, workers, scene path length, path
+//   Frame          dt in seconds as a double
+//   Event          EventType as a byte, code, x, y, width, height, the timestamp is not kept
+//   LiveSettings   fps limit, clear color as 4 floats, dynamic resolution ms as a double, AntiAliasing as a byte
+
+constexpr uint32_t REPLAY_MAGIC = 0x4C505256; // "VRPL"
+constexpr uint32_t REPLAY_VERSION = 1;
+
+enum class ReplayRecordType : uint8_t {
+    Frame,
+    Event,
+    LiveSettings,
+};
+
+struct ReplayHeader {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    RendererSettings renderer{}; // only what affects the scene is kept, the presentation settings are left at their defaults
+};
+
+// Writes are buffered, and do not allocate once the first has been made
+struct ReplayWriter {
+    std::FILE* file = nullptr;
+    uint64_t frames = 0;
+};
+
+// Throws an Error if path cannot be written
+void openReplayWriter(const std::string& path, const ReplayHeader& header, ReplayWriter& writer);
+void writeReplayFrame(ReplayWriter& writer, double dt);
+void writeReplayEvent(ReplayWriter& writer, const Event& event);
+void writeReplayLiveSettings(ReplayWriter& writer, const LiveSettings& settings);
+void closeReplayWriter(ReplayWriter& writer);
+
+struct ReplayRecord {
+    ReplayRecordType type = ReplayRecordType::Frame;
+    double dt = 0.0;
+    Event event{};
+    LiveSettings live{};
+};
+
+struct ReplayReader {
+    MappedFile file{};
+    size_t offset = 0;         // of the next record
+    size_t records_offset = 0; // of the first record, set offset back to it to read the records again
+    ReplayHeader header{};
+};
+
+// Throws an Error if path is missing, or is not a replay of this version
+void openReplayReader(const std::string& path, ReplayReader& reader);
+// Returns false at the end of the file. Throws an Error if a record is cut short or of an unknown type.
+bool readReplayRecord(ReplayReader& reader, ReplayRecord& record);
+void closeReplayReader(ReplayReader& reader);
+
+// true if --replay is on the command line
+bool replayRequested(const std::vector<std::string>& args);
+
+// Replays a recording headless, drawing frames back to back as fast as they can be drawn, and prints the frame, recording and GPU times.
+// Returns the process exit code: 0 once the replay has finished, 2 on error.
+//
+// Options:
+//   --replay <file>    the recording
+//   --timestep <ms>    a fixed dt for every frame instead of the recorded ones
+//   --output <file>    the timings of every frame as JSON, for comparing runs
+// The last frame is read back and hashed, so two runs of one recording on the same device can be checked to have drawn the same thing.
+int runReplay(const std::vector<std::string>& args);
@@ -0,0 +1,144 @@
+#include "scene_file.h"
+
+#include "error.h"
+#include "mesh.h"
+
+template <typename T>
+static std::span<const T> sectionSpan(const SceneFile& scene, const SceneSectionHeader& section)
+{
+    return std::span<const T>(reinterpret_cast<const T*>(scene.file.data + section.offset), section.size / sizeof(T));
+}
+
+static void checkSection(const SceneFile& scene, const SceneSectionHeader& section, uint32_t element_size, const std::string& path)
+{
+    if (section.element_size != element_size || section.size % element_size != 0) {
+        throw Error("Scene file " + path + " has a section with an unexpected record size");
+    }
+    if (section.offset % SCENE_SECTION_ALIGNMENT != 0 || section.offset > scene.file.size || section.size > scene.file.size - section.offset) {
+        throw Error("Scene file " + path + " has a section out of bounds");
+    }
+}
+
+// Offset of a section from the start of the GPU data. createGpuMesh() uploads only the GPU data and the shaders read the sections through
+// buffer addresses, so a section reaching past its end would be read out of bounds on the GPU.
+static uint64_t gpuSectionOffset(const SceneFileHeader& header, const SceneSectionHeader& section, const char* what, const std::string& path)
+{
+    if (section.offset < header.gpu_data_offset || section.offset - header.gpu_data_offset > header.gpu_data_size ||
+        section.size > header.gpu_data_size - (section.offset - header.gpu_data_offset)) {
+        throw Error("Scene file " + path + " has " + what + " outside the GPU data");
+    }
+    return section.offset - header.gpu_data_offset;
+}
+
+void openSceneFile(const std::string& path, SceneFile& scene)
+{
+    if (!mapFile(path, scene.file)) {
+        throw Error("Failed to open scene file " + path);
+    }
+
+    try {
+        if (scene.file.size < sizeof(SceneFileHeader)) throw Error("Scene file " + path + " is truncated");
+        const SceneFileHeader* header = reinterpret_cast<const SceneFileHeader*>(scene.file.data);
+        if (header->magic != SCENE_MAGIC) throw Error(path + " is not a scene file");
+        if (header->version != SCENE_VERSION) {
+            throw Error("Scene file " + path + " is version " + std::to_string(header->version) + ", expected " + std::to_string(SCENE_VERSION) +
+                        ". Convert it again.");
+        }
+        if (header->file_size != scene.file.size) throw Error("Scene file " + path + " is truncated");
+        if (header->section_count > (scene.file.size - sizeof(SceneFileHeader)) / sizeof(SceneSectionHeader)) {
+            throw Error("Scene file " + path + " is truncated");
+        }
+        if (header->gpu_data_offset > scene.file.size || header->gpu_data_size > scene.file.size - header->gpu_data_offset) {
+            throw Error("Scene file " + path + " has GPU data out of bounds");
+        }
+        scene.gpu_data = scene.file.data + header->gpu_data_offset;
+        scene.gpu_data_size = header->gpu_data_size;
+
+        uint64_t meshlet_vertex_count = 0;
+        uint64_t meshlet_triangle_count = 0;
+        const SceneSectionHeader* sections = reinterpret_cast<const SceneSectionHeader*>(scene.file.data + sizeof(SceneFileHeader));
+        for (uint32_t i = 0; i < header->section_count; ++i) {
+            const SceneSectionHeader& section = sections[i];
+            switch (section.type) {
+                case SceneSectionType::Meshes:
+                    checkSection(scene, section, sizeof(SceneMesh), path);
+                    scene.meshes = sectionSpan<SceneMesh>(scene, section);
+                    break;
+                case SceneSectionType::Materials:
+                    checkSection(scene, section, sizeof(SceneMaterial), path);
+                    scene.materials = sectionSpan<SceneMaterial>(scene, section);
+                    break;
+                case SceneSectionType::Vertices:
+                    checkSection(scene, section, sizeof(PackedVertex), path);
+                    scene.vertices_offset = gpuSectionOffset(*header, section, "vertices", path);
+                    scene.vertex_count = section.size / sizeof(PackedVertex);
+                    break;
+                case SceneSectionType::Indices:
+                    checkSection(scene, section, sizeof(uint32_t), path);
+                    scene.indices_offset = gpuSectionOffset(*header, section, "indices", path);
+                    scene.index_count = section.size / sizeof(uint32_t);
+                    break;
+                case SceneSectionType::Meshlets:
+                    checkSection(scene, section, sizeof(Meshlet), path);
+                    scene.meshlets_offset = gpuSectionOffset(*header, section, "meshlets", path);
+                    scene.meshlet_count = section.size / sizeof(Meshlet);
+                    break;
+                case SceneSectionType::MeshletVertices:
+                    checkSection(scene, section, sizeof(uint32_t), path);
+                    scene.meshlet_vertices_offset = gpuSectionOffset(*header, section, "meshlet vertices", path);
+                    meshlet_vertex_count = section.size / sizeof(uint32_t);
+                    break;
+                case SceneSectionType::MeshletTriangles:
+                    checkSection(scene, section, sizeof(uint32_t), path);
+                    scene.meshlet_triangles_offset = gpuSectionOffset(*header, section, "meshlet triangles", path);
+                    meshlet_triangle_count = section.size / sizeof(uint32_t);
+                    break;
+                default:
+                    break; // written by a newer converter, not needed here
+            }
+        }
+
+        // the counts are what createGpuMesh() uploads, whatever the sections claim
+        if (scene.vertex_count > (scene.gpu_data_size - scene.vertices_offset) / sizeof(PackedVertex) ||
+            scene.index_count > (scene.gpu_data_size - scene.indices_offset) / sizeof(uint32_t)) {
+            throw Error("Scene file " + path + " has more vertices or indices than its GPU data holds");
+        }
+
+        // there are far fewer meshlets than vertices, so checking every range is cheap
+        if (scene.meshlet_count > 0) {
+            if (meshlet_triangle_count != scene.index_count / 3) throw Error("Scene file " + path + " has meshlet triangles missing");
+            const std::span<const Meshlet> meshlets(reinterpret_cast<const Meshlet*>(scene.gpu_data + scene.meshlets_offset), scene.meshlet_count);
+            for (const Meshlet& meshlet : meshlets) {
+                if (meshlet.vertex_count > MESHLET_MAX_VERTICES || meshlet.triangle_count > MESHLET_MAX_TRIANGLES || meshlet.first_index % 3 != 0 ||
+                    meshlet.first_index > scene.index_count || uint64_t{meshlet.triangle_count} * 3 > scene.index_count - meshlet.first_index ||
+                    meshlet.first_vertex > meshlet_vertex_count || meshlet.vertex_count > meshlet_vertex_count - meshlet.first_vertex) {
+                    throw Error("Scene file " + path + " has a meshlet out of bounds");
+                }
+            }
+        }
+
+        // the indices are only used on the GPU, so only the ranges are checked
+        for (const SceneMesh& mesh : scene.meshes) {
+            if (mesh.first_meshlet > scene.meshlet_count || mesh.meshlet_count > scene.meshlet_count - mesh.first_meshlet) {
+                throw Error("Scene file " + path + " has a mesh with meshlets out of bounds");
+            }
+            if (mesh.first_index > scene.index_count || mesh.index_count > scene.index_count - mesh.first_index ||
+                mesh.first_vertex > scene.vertex_count || mesh.vertex_count > scene.vertex_count - mesh.first_vertex) {
+                throw Error("Scene file " + path + " has a mesh out of bounds");
+            }
+            if (mesh.material >= scene.materials.size() && !scene.materials.empty()) {
+                throw Error("Scene file " + path + " has a mesh with an unknown material");
+            }
+        }
+    }
+    catch (const Error&) {
+        closeSceneFile(scene);
+        throw;
+    }
+}
+
+void closeSceneFile(SceneFile& scene)
+{
+    unmapFile(scene.file);
+    scene = SceneFile{};
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <span>
+#include <string>
+
+#include "mapped_file.h"
+#include "scene_format.h"
+
+// A memory mapped .vscene file, see scene_format.h. The spans point straight into the mapping.
+struct SceneFile {
+    MappedFile file{};
+    std::span<const SceneMesh> meshes{};
+    std::span<const SceneMaterial> materials{};
+
+    // vertex, index and meshlet sections, uploaded as one block
+    const std::byte* gpu_data = nullptr;
+    uint64_t gpu_data_size = 0;
+    uint64_t vertices_offset = 0; // relative to gpu_data
+    uint64_t indices_offset = 0;  // relative to gpu_data
+    uint64_t vertex_count = 0;
+    uint64_t index_count = 0;
+
+    // all 0 if the file has no meshlets
+    uint64_t meshlets_offset = 0;          // relative to gpu_data
+    uint64_t meshlet_vertices_offset = 0;  // relative to gpu_data
+    uint64_t meshlet_triangles_offset = 0; // relative to gpu_data
+    uint64_t meshlet_count = 0;
+};
+
+// Throws Error if the file cannot be mapped, is from a different version or anything in it is out of bounds.
+// Only headers and meshlet ranges are checked, nothing is copied.
+void openSceneFile(const std::string& path, SceneFile& scene);
+void closeSceneFile(SceneFile& scene);
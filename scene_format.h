@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+
+#include <bit>
+
+// Binary scene file (.vscene), written by SceneConverter and memory mapped by the application.
+//
+// Layout: SceneFileHeader, then section_count SectionHeaders, then the sections. Every section starts on a
+// SCENE_SECTION_ALIGNMENT boundary. The vertex, index and meshlet sections come last and are contiguous apart from padding
+// ("GPU data"), so they are uploaded with a single copy into one buffer and keep their offsets relative to gpu_data_offset.
+// Records are stored exactly as they are used, there is no parsing or per-vertex work when loading.
+//
+// Readers skip section types they do not know. Anything else that changes the layout bumps SCENE_VERSION.
+
+static_assert(std::endian::native == std::endian::little, "scene files are little endian and read in place");
+
+constexpr uint32_t SCENE_MAGIC = 0x4E435356; // "VSCN"
+constexpr uint32_t SCENE_VERSION = 1;
+constexpr uint64_t SCENE_SECTION_ALIGNMENT = 256; // at least every device's minStorageBufferOffsetAlignment
+
+enum class SceneSectionType : uint32_t {
+    Meshes = 1,           // SceneMesh
+    Materials = 2,        // SceneMaterial
+    Vertices = 3,         // PackedVertex (mesh.h), GPU data
+    Indices = 4,          // uint32_t relative to the mesh's first_vertex, GPU data
+    Meshlets = 5,         // Meshlet (mesh.h), first_index and first_vertex count from the start of their sections, GPU data
+    MeshletVertices = 6,  // uint32_t relative to the mesh's first_vertex, GPU data
+    MeshletTriangles = 7, // uint32_t holding three 8-bit meshlet vertex indices, one per triangle in Indices, GPU data
+};
+
+struct SceneFileHeader {
+    uint32_t magic = SCENE_MAGIC;
+    uint32_t version = SCENE_VERSION;
+    uint32_t section_count = 0;
+    uint32_t reserved = 0;
+    uint64_t file_size = 0;
+    uint64_t gpu_data_offset = 0;
+    uint64_t gpu_data_size = 0;
+};
+static_assert(sizeof(SceneFileHeader) == 40);
+
+struct SceneSectionHeader {
+    SceneSectionType type{};
+    uint32_t element_size = 0; // size of one record, checked by the reader
+    uint64_t offset = 0;       // from the start of the file
+    uint64_t size = 0;         // in bytes, a multiple of element_size
+};
+static_assert(sizeof(SceneSectionHeader) == 24);
+
+struct SceneMesh {
+    uint32_t first_index = 0;
+    uint32_t index_count = 0;
+    uint32_t first_vertex = 0; // added to every index
+    uint32_t vertex_count = 0;
+    uint32_t first_meshlet = 0;
+    uint32_t meshlet_count = 0; // 0 if the file has no meshlets
+    uint32_t material = 0;
+    float position_scale = 1.0f; // see PackedVertex
+};
+static_assert(sizeof(SceneMesh) == 32);
+
+struct SceneMaterial {
+    float base_color[4]{1.0f, 1.0f, 1.0f, 1.0f}; // linear RGBA, also baked into the vertex colours
+};
+static_assert(sizeof(SceneMaterial) == 16);
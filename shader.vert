@@ -1,25 +1,61 @@
 #version 450
+#extension GL_EXT_buffer_reference : require
 
-const vec2 vertices[] = {
-	vec2(  0.0,                 0.5  ),
-	vec2( -0.4330127018922193, -0.25 ),
-	vec2(  0.4330127018922193, -0.25 )
+// vertex pulling, PackedVertex (see mesh.h) is fetched and decoded here instead of by fixed function vertex input
+
+// written by the CPU every frame into the stream buffer, see vulkan_pipeline.h
+
+layout(set = 0, binding = 0) uniform FrameConstants {
+	mat4 view_proj;
+} frame;
+
+struct DrawParams {
+	mat2 transform;
+	vec4 translation; // xyz
 };
 
-const vec3 colors[] = {
-	vec3(1.0, 0.0, 0.0),
-	vec3(0.0, 1.0, 0.0),
-	vec3(0.0, 0.0, 1.0)
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer DrawParamsBuffer {
+	DrawParams draws[];
+};
+
+// entity id of each draw, written by the CPU every frame into the stream buffer
+layout(buffer_reference, std430, buffer_reference_align = 4) readonly buffer DrawEntityBuffer {
+	uint entities[];
+};
+
+// position xy, position z and padding, octahedral normal (all 16-bit snorm pairs), then unorm8 RGBA color
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer VertexBuffer {
+	uvec4 vertices[];
 };
 
 layout( push_constant ) uniform Constants {
-	mat2 transform;
+	DrawParamsBuffer draw_params;     // world transform of every entity, indexed by entity id
+	DrawEntityBuffer draw_entities; // indexed by firstInstance
+	VertexBuffer vertices;        // indexed by the index buffer
+	float position_scale;
 } constants;
 
 layout(location = 0) out vec3 color;
 
+// the depth prepass and the equal tested color pass must compute exactly the same depth
+invariant gl_Position;
+
+vec3 decodeOctahedral(vec2 e) {
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	const float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
 void main() {
-	gl_Position = vec4(constants.transform * vertices[gl_VertexIndex], 0.0, 1.0);
-	color = colors[gl_VertexIndex];
+	const uvec4 packed_vertex = constants.vertices.vertices[gl_VertexIndex];
+	const vec3 position = vec3(unpackSnorm2x16(packed_vertex.x), unpackSnorm2x16(packed_vertex.y).x) * constants.position_scale;
+	const vec3 normal = decodeOctahedral(unpackSnorm2x16(packed_vertex.z));
+	const vec4 vertex_color = unpackUnorm4x8(packed_vertex.w);
+
+	const DrawParams draw = constants.draw_params.draws[constants.draw_entities.entities[gl_InstanceIndex]];
+	gl_Position = frame.view_proj * vec4(draw.transform * position.xy + draw.translation.xy, position.z + draw.translation.z, 1.0);
+	color = vertex_color.rgb * (0.25 + 0.75 * max(normal.z, 0.0)); // light from the camera
 	gl_Position.y *= -1.0;
 }
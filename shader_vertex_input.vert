@@ -0,0 +1,56 @@
+#version 450
+#extension GL_EXT_buffer_reference : require
+
+// same as shader.vert, but PackedVertex comes from fixed function vertex input
+
+layout(set = 0, binding = 0) uniform FrameConstants {
+	mat4 view_proj;
+} frame;
+
+struct DrawParams {
+	mat2 transform;
+	vec4 translation; // xyz
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer DrawParamsBuffer {
+	DrawParams draws[];
+};
+
+// entity id of each draw, written by the CPU every frame into the stream buffer
+layout(buffer_reference, std430, buffer_reference_align = 4) readonly buffer DrawEntityBuffer {
+	uint entities[];
+};
+
+layout( push_constant ) uniform Constants {
+	DrawParamsBuffer draw_params;     // world transform of every entity, indexed by entity id
+	DrawEntityBuffer draw_entities; // indexed by firstInstance
+	uvec2 unused_vertices; // PushConstants::vertices
+	float position_scale;
+} constants;
+
+layout(location = 0) in vec4 in_position; // VK_FORMAT_R16G16B16A16_SNORM
+layout(location = 1) in vec2 in_normal;   // VK_FORMAT_R16G16_SNORM, octahedral
+layout(location = 2) in vec4 in_color;    // VK_FORMAT_R8G8B8A8_UNORM
+
+layout(location = 0) out vec3 color;
+
+// the depth prepass and the equal tested color pass must compute exactly the same depth
+invariant gl_Position;
+
+vec3 decodeOctahedral(vec2 e) {
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	const float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+
+void main() {
+	const vec3 position = in_position.xyz * constants.position_scale;
+	const vec3 normal = decodeOctahedral(in_normal);
+
+	const DrawParams draw = constants.draw_params.draws[constants.draw_entities.entities[gl_InstanceIndex]];
+	gl_Position = frame.view_proj * vec4(draw.transform * position.xy + draw.translation.xy, position.z + draw.translation.z, 1.0);
+	color = in_color.rgb * (0.25 + 0.75 * max(normal.z, 0.0)); // light from the camera
+	gl_Position.y *= -1.0;
+}
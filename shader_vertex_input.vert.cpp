@@ -0,0 +1,11 @@
+#include "shaders.h"
+
+#include <cstdint>
+
+#include <span>
+
+namespace {
+#include "shader_vertex_input.vert.h" // generated from shader_vertex_input.vert, see the project file
+}
+
+const std::span<const uint32_t> spv_vertex_input{spv_shader_vertex_input_vert};
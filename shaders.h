@@ -2,7 +2,15 @@
 
 #include <cstdint>
 
-#include <array>
+#include <span>
 
-extern const std::array<uint8_t, 1940> spv_vertex;
-extern const std::array<uint8_t, 568> spv_fragment;
\ No newline at end of file
+// SPIR-V compiled from the shader sources by glslangValidator at build time
+extern const std::span<const uint32_t> spv_vertex;
+extern const std::span<const uint32_t> spv_vertex_input;
+extern const std::span<const uint32_t> spv_fragment;
+extern const std::span<const uint32_t> spv_meshlet_cull;
+extern const std::span<const uint32_t> spv_task;
+extern const std::span<const uint32_t> spv_mesh;
+extern const std::span<const uint32_t> spv_depth_pyramid;
+extern const std::span<const uint32_t> spv_fullscreen;
+extern const std::span<const uint32_t> spv_post_process;
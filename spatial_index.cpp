@@ -0,0 +1,471 @@
+#include "spatial_index.h"
+
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SPATIAL_INDEX_SSE 1
+#include <emmintrin.h>
+#else
+#define SPATIAL_INDEX_SSE 0
+#endif
+
+// Median splits keep the tree balanced, so even 2^32 items are at most 17 levels deep and a traversal never has more than
+// three siblings per level waiting.
+constexpr size_t STACK_SIZE = 64;
+
+// refitting everything in one pass beats sorting the dirty nodes once this many have changed
+constexpr size_t FULL_REFIT_FRACTION = 4;
+
+Aabb emptyAabb() { return Aabb{{FLT_MAX, FLT_MAX, FLT_MAX}, {-FLT_MAX, -FLT_MAX, -FLT_MAX}}; }
+
+static void growAabb(Aabb& a, const Aabb& b)
+{
+    for (int i = 0; i < 3; ++i) {
+        a.min[i] = std::min(a.min[i], b.min[i]);
+        a.max[i] = std::max(a.max[i], b.max[i]);
+    }
+}
+
+static void setChildBounds(BvhNode& node, uint32_t slot, const Aabb& box)
+{
+    node.min_x[slot] = box.min[0];
+    node.min_y[slot] = box.min[1];
+    node.min_z[slot] = box.min[2];
+    node.max_x[slot] = box.max[0];
+    node.max_y[slot] = box.max[1];
+    node.max_z[slot] = box.max[2];
+}
+
+static Aabb childBounds(const BvhNode& node, uint32_t slot)
+{
+    return Aabb{{node.min_x[slot], node.min_y[slot], node.min_z[slot]}, {node.max_x[slot], node.max_y[slot], node.max_z[slot]}};
+}
+
+static Aabb nodeBounds(const BvhNode& node)
+{
+    Aabb box = emptyAabb();
+    for (uint32_t slot = 0; slot < BVH_WIDTH; ++slot) {
+        if (node.child[slot] != BVH_EMPTY) growAabb(box, childBounds(node, slot));
+    }
+    return box;
+}
+
+static Aabb leafBounds(const Bvh& bvh, uint32_t first, uint32_t count)
+{
+    Aabb box = emptyAabb();
+    for (uint32_t i = first; i < first + count; ++i) {
+        growAabb(box, bvh.bounds[bvh.items[i]]);
+    }
+    return box;
+}
+
+// sorts items[first, first + count) so the half with the smaller centroids along the widest axis comes first, returns the half's size
+static uint32_t splitItems(Bvh& bvh, const std::vector<float>& centroids, uint32_t first, uint32_t count)
+{
+    std::array<float, 3> lo{FLT_MAX, FLT_MAX, FLT_MAX};
+    std::array<float, 3> hi{-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    for (uint32_t i = first; i < first + count; ++i) {
+        for (uint32_t axis = 0; axis < 3; ++axis) {
+            lo[axis] = std::min(lo[axis], centroids[bvh.items[i] * 3 + axis]);
+            hi[axis] = std::max(hi[axis], centroids[bvh.items[i] * 3 + axis]);
+        }
+    }
+    uint32_t axis = 0;
+    if (hi[1] - lo[1] > hi[axis] - lo[axis]) axis = 1;
+    if (hi[2] - lo[2] > hi[axis] - lo[axis]) axis = 2;
+
+    const uint32_t half = count / 2;
+    const auto begin = bvh.items.begin() + first;
+    std::nth_element(begin, begin + half, begin + count,
+                     [&centroids, axis](uint32_t a, uint32_t b) { return centroids[a * 3 + axis] < centroids[b * 3 + axis]; });
+    return half;
+}
+
+static uint32_t buildNode(Bvh& bvh, const std::vector<float>& centroids, uint32_t first, uint32_t count, uint32_t parent)
+{
+    // keep halving the biggest part until there is one per child or every part fits in a leaf slot
+    std::array<BvhRange, BVH_WIDTH> parts{};
+    parts[0] = BvhRange{first, count};
+    uint32_t part_count = 1;
+    while (part_count < BVH_WIDTH) {
+        uint32_t largest = 0;
+        for (uint32_t i = 1; i < part_count; ++i) {
+            if (parts[i].count > parts[largest].count) largest = i;
+        }
+        if (parts[largest].count <= BVH_LEAF_SIZE) break;
+
+        const BvhRange part = parts[largest];
+        const uint32_t half = splitItems(bvh, centroids, part.first, part.count);
+        std::copy_backward(parts.begin() + largest + 1, parts.begin() + part_count, parts.begin() + part_count + 1);
+        parts[largest] = BvhRange{part.first, half};
+        parts[largest + 1] = BvhRange{part.first + half, part.count - half};
+        ++part_count;
+    }
+
+    const uint32_t index = static_cast<uint32_t>(bvh.nodes.size());
+    {
+        BvhNode node{};
+        node.parent = parent;
+        node.first_item = first;
+        node.item_count = count;
+        for (uint32_t slot = 0; slot < BVH_WIDTH; ++slot) {
+            node.child[slot] = BVH_EMPTY;
+            setChildBounds(node, slot, emptyAabb());
+        }
+        bvh.nodes.push_back(node);
+    }
+
+    // children are built after their parent has been added, bvh.nodes may reallocate so the node is looked up each time
+    for (uint32_t slot = 0; slot < part_count; ++slot) {
+        const BvhRange part = parts[slot];
+        if (part.count <= BVH_LEAF_SIZE) {
+            for (uint32_t i = part.first; i < part.first + part.count; ++i) {
+                bvh.item_node[bvh.items[i]] = index;
+            }
+            BvhNode& node = bvh.nodes[index];
+            node.child[slot] = part.first;
+            node.leaf_count[slot] = part.count;
+            setChildBounds(node, slot, leafBounds(bvh, part.first, part.count));
+        }
+        else {
+            const uint32_t child = buildNode(bvh, centroids, part.first, part.count, index);
+            BvhNode& node = bvh.nodes[index];
+            node.child[slot] = child;
+            node.leaf_count[slot] = 0;
+            setChildBounds(node, slot, nodeBounds(bvh.nodes[child]));
+        }
+    }
+    return index;
+}
+
+void buildBvh(Bvh& bvh, std::span<const Aabb> bounds)
+{
+    const uint32_t count = static_cast<uint32_t>(bounds.size());
+    bvh.nodes.clear();
+    bvh.nodes.reserve(count / 8 + 1);
+    bvh.items.resize(count);
+    std::iota(bvh.items.begin(), bvh.items.end(), 0u);
+    bvh.bounds.assign(bounds.begin(), bounds.end());
+    bvh.item_node.assign(count, 0);
+
+    std::vector<float> centroids(size_t{count} * 3);
+    for (uint32_t i = 0; i < count; ++i) {
+        for (uint32_t axis = 0; axis < 3; ++axis) {
+            centroids[i * 3 + axis] = 0.5f * (bounds[i].min[axis] + bounds[i].max[axis]);
+        }
+    }
+
+    buildNode(bvh, centroids, 0, count, BVH_EMPTY);
+
+    bvh.dirty_nodes.clear();
+    bvh.node_dirty.assign(bvh.nodes.size(), 0);
+}
+
+void updateBvhItem(Bvh& bvh, uint32_t item, const Aabb& bounds)
+{
+    bvh.bounds[item] = bounds;
+    const uint32_t node = bvh.item_node[item];
+    if (bvh.node_dirty[node]) return;
+    bvh.node_dirty[node] = 1;
+    bvh.dirty_nodes.push_back(node);
+}
+
+static void refitNode(Bvh& bvh, uint32_t index)
+{
+    BvhNode& node = bvh.nodes[index];
+    for (uint32_t slot = 0; slot < BVH_WIDTH; ++slot) {
+        if (node.child[slot] == BVH_EMPTY) continue;
+        if (node.leaf_count[slot] > 0) {
+            setChildBounds(node, slot, leafBounds(bvh, node.child[slot], node.leaf_count[slot]));
+        }
+        else {
+            setChildBounds(node, slot, nodeBounds(bvh.nodes[node.child[slot]]));
+        }
+    }
+}
+
+void refitBvh(Bvh& bvh)
+{
+    if (bvh.dirty_nodes.empty()) return;
+
+    if (bvh.dirty_nodes.size() > bvh.nodes.size() / FULL_REFIT_FRACTION) {
+        // children come after their parents
+        for (size_t i = bvh.nodes.size(); i-- > 0;) {
+            refitNode(bvh, static_cast<uint32_t>(i));
+        }
+        std::fill(bvh.node_dirty.begin(), bvh.node_dirty.end(), uint8_t{0});
+        bvh.dirty_nodes.clear();
+        return;
+    }
+
+    // the heap hands out the highest index first, so every dirty child is refitted before its parent
+    std::make_heap(bvh.dirty_nodes.begin(), bvh.dirty_nodes.end());
+    while (!bvh.dirty_nodes.empty()) {
+        std::pop_heap(bvh.dirty_nodes.begin(), bvh.dirty_nodes.end());
+        const uint32_t index = bvh.dirty_nodes.back();
+        bvh.dirty_nodes.pop_back();
+        bvh.node_dirty[index] = 0;
+        refitNode(bvh, index);
+
+        const uint32_t parent = bvh.nodes[index].parent;
+        if (parent != BVH_EMPTY && !bvh.node_dirty[parent]) {
+            bvh.node_dirty[parent] = 1;
+            bvh.dirty_nodes.push_back(parent);
+            std::push_heap(bvh.dirty_nodes.begin(), bvh.dirty_nodes.end());
+        }
+    }
+}
+
+Frustum frustumFromViewProj(const float view_proj[16])
+{
+    // rows of the matrix
+    std::array<std::array<float, 4>, 4> r{};
+    for (int row = 0; row < 4; ++row) {
+        for (int col = 0; col < 4; ++col) {
+            r[row][col] = view_proj[col * 4 + row];
+        }
+    }
+
+    Frustum frustum{};
+    for (int i = 0; i < 4; ++i) {
+        frustum.planes[0][i] = r[3][i] + r[0][i];
+        frustum.planes[1][i] = r[3][i] - r[0][i];
+        frustum.planes[2][i] = r[3][i] + r[1][i];
+        frustum.planes[3][i] = r[3][i] - r[1][i];
+        frustum.planes[4][i] = r[2][i];
+        frustum.planes[5][i] = r[3][i] - r[2][i];
+    }
+    return frustum;
+}
+
+// Bit i of outside is set if child i is entirely outside a plane, bit i of straddling if it is not entirely inside all of them.
+// For each plane the box corner furthest along the normal decides the first, the nearest corner the second.
+static void classifyChildren(const BvhNode& node, const Frustum& frustum, uint32_t& outside, uint32_t& straddling)
+{
+#if SPATIAL_INDEX_SSE
+    const __m128 min_x = _mm_loadu_ps(node.min_x);
+    const __m128 min_y = _mm_loadu_ps(node.min_y);
+    const __m128 min_z = _mm_loadu_ps(node.min_z);
+    const __m128 max_x = _mm_loadu_ps(node.max_x);
+    const __m128 max_y = _mm_loadu_ps(node.max_y);
+    const __m128 max_z = _mm_loadu_ps(node.max_z);
+    const __m128 zero = _mm_setzero_ps();
+    __m128 out = zero;
+    __m128 partial = zero;
+    for (const auto& plane : frustum.planes) {
+        const __m128 nx = _mm_set1_ps(plane[0]);
+        const __m128 ny = _mm_set1_ps(plane[1]);
+        const __m128 nz = _mm_set1_ps(plane[2]);
+        const __m128 d = _mm_set1_ps(plane[3]);
+        const __m128 far_dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, plane[0] >= 0.0f ? max_x : min_x), _mm_mul_ps(ny, plane[1] >= 0.0f ? max_y : min_y)),
+                                           _mm_add_ps(_mm_mul_ps(nz, plane[2] >= 0.0f ? max_z : min_z), d));
+        const __m128 near_dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, plane[0] >= 0.0f ? min_x : max_x), _mm_mul_ps(ny, plane[1] >= 0.0f ? min_y : max_y)),
+                                            _mm_add_ps(_mm_mul_ps(nz, plane[2] >= 0.0f ? min_z : max_z), d));
+        out = _mm_or_ps(out, _mm_cmplt_ps(far_dist, zero));
+        partial = _mm_or_ps(partial, _mm_cmplt_ps(near_dist, zero));
+    }
+    outside = static_cast<uint32_t>(_mm_movemask_ps(out));
+    straddling = static_cast<uint32_t>(_mm_movemask_ps(partial));
+#else
+    outside = 0;
+    straddling = 0;
+    for (uint32_t slot = 0; slot < BVH_WIDTH; ++slot) {
+        for (const auto& plane : frustum.planes) {
+            const float far_dist = plane[0] * (plane[0] >= 0.0f ? node.max_x[slot] : node.min_x[slot]) +
+                                   plane[1] * (plane[1] >= 0.0f ? node.max_y[slot] : node.min_y[slot]) +
+                                   plane[2] * (plane[2] >= 0.0f ? node.max_z[slot] : node.min_z[slot]) + plane[3];
+            const float near_dist = plane[0] * (plane[0] >= 0.0f ? node.min_x[slot] : node.max_x[slot]) +
+                                    plane[1] * (plane[1] >= 0.0f ? node.min_y[slot] : node.max_y[slot]) +
+                                    plane[2] * (plane[2] >= 0.0f ? node.min_z[slot] : node.max_z[slot]) + plane[3];
+            if (far_dist < 0.0f) outside |= 1u << slot;
+            if (near_dist < 0.0f) straddling |= 1u << slot;
+        }
+    }
+#endif
+}
+
+static bool aabbOutside(const Aabb& box, const Frustum& frustum)
+{
+    for (const auto& plane : frustum.planes) {
+        const float far_dist = plane[0] * (plane[0] >= 0.0f ? box.max[0] : box.min[0]) + plane[1] * (plane[1] >= 0.0f ? box.max[1] : box.min[1]) +
+                               plane[2] * (plane[2] >= 0.0f ? box.max[2] : box.min[2]) + plane[3];
+        if (far_dist < 0.0f) return true;
+    }
+    return false;
+}
+
+static void appendRange(std::vector<BvhRange>& ranges, uint32_t first, uint32_t count)
+{
+    if (!ranges.empty() && ranges.back().first + ranges.back().count == first) {
+        ranges.back().count += count;
+    }
+    else {
+        ranges.push_back(BvhRange{first, count});
+    }
+}
+
+void queryBvh(const Bvh& bvh, const Frustum& frustum, std::vector<BvhRange>& ranges)
+{
+    if (bvh.items.empty()) return;
+
+    enum class Task : uint32_t { Visit, Accept, TestItems };
+    struct Entry {
+        Task task;
+        uint32_t first; // node index for Visit
+        uint32_t count;
+    };
+
+    // children are pushed last to first so ranges come out in item order and neighbours merge
+    std::array<Entry, STACK_SIZE> stack{};
+    size_t top = 0;
+    stack[top++] = Entry{Task::Visit, 0, 0};
+    while (top > 0) {
+        const Entry entry = stack[--top];
+        if (entry.task == Task::Accept) {
+            appendRange(ranges, entry.first, entry.count);
+            continue;
+        }
+        if (entry.task == Task::TestItems) {
+            for (uint32_t i = entry.first; i < entry.first + entry.count; ++i) {
+                if (!aabbOutside(bvh.bounds[bvh.items[i]], frustum)) appendRange(ranges, i, 1);
+            }
+            continue;
+        }
+
+        const BvhNode& node = bvh.nodes[entry.first];
+        uint32_t outside = 0, straddling = 0;
+        classifyChildren(node, frustum, outside, straddling);
+        for (uint32_t slot = BVH_WIDTH; slot-- > 0;) {
+            if (node.child[slot] == BVH_EMPTY || (outside & (1u << slot))) continue;
+            assert(top < stack.size());
+            const bool inside = !(straddling & (1u << slot));
+            if (node.leaf_count[slot] > 0) {
+                stack[top++] = Entry{inside ? Task::Accept : Task::TestItems, node.child[slot], node.leaf_count[slot]};
+            }
+            else if (inside) {
+                const BvhNode& child = bvh.nodes[node.child[slot]];
+                stack[top++] = Entry{Task::Accept, child.first_item, child.item_count};
+            }
+            else {
+                stack[top++] = Entry{Task::Visit, node.child[slot], 0};
+            }
+        }
+    }
+}
+
+// slab test, entry is clamped to 0 for rays starting inside the box
+static bool rayAabb(const Aabb& box, const float origin[3], const float inv_direction[3], float max_t, float& entry)
+{
+    float t_near = 0.0f;
+    float t_far = max_t;
+    for (int axis = 0; axis < 3; ++axis) {
+        const float t0 = (box.min[axis] - origin[axis]) * inv_direction[axis];
+        const float t1 = (box.max[axis] - origin[axis]) * inv_direction[axis];
+        t_near = std::max(t_near, std::min(t0, t1));
+        t_far = std::min(t_far, std::max(t0, t1));
+    }
+    entry = t_near;
+    return t_near <= t_far;
+}
+
+// the slab test for all four children, returns a bit per child hit before max_t
+static uint32_t rayChildren(const BvhNode& node, const float origin[3], const float inv_direction[3], float max_t, float entry[BVH_WIDTH])
+{
+#if SPATIAL_INDEX_SSE
+    const __m128 ox = _mm_set1_ps(origin[0]);
+    const __m128 oy = _mm_set1_ps(origin[1]);
+    const __m128 oz = _mm_set1_ps(origin[2]);
+    const __m128 ix = _mm_set1_ps(inv_direction[0]);
+    const __m128 iy = _mm_set1_ps(inv_direction[1]);
+    const __m128 iz = _mm_set1_ps(inv_direction[2]);
+    const __m128 x0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.min_x), ox), ix);
+    const __m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.max_x), ox), ix);
+    const __m128 y0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.min_y), oy), iy);
+    const __m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.max_y), oy), iy);
+    const __m128 z0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.min_z), oz), iz);
+    const __m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.max_z), oz), iz);
+    __m128 t_near = _mm_max_ps(_mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)), _mm_max_ps(_mm_min_ps(z0, z1), _mm_setzero_ps()));
+    __m128 t_far = _mm_min_ps(_mm_min_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)), _mm_min_ps(_mm_max_ps(z0, z1), _mm_set1_ps(max_t)));
+    _mm_storeu_ps(entry, t_near);
+    uint32_t hits = static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(t_near, t_far)));
+#else
+    uint32_t hits = 0;
+    for (uint32_t slot = 0; slot < BVH_WIDTH; ++slot) {
+        if (rayAabb(childBounds(node, slot), origin, inv_direction, max_t, entry[slot])) hits |= 1u << slot;
+    }
+#endif
+    // empty children have inverted bounds, which the slab test does not reliably reject
+    for (uint32_t slot = 0; slot < BVH_WIDTH; ++slot) {
+        if (node.child[slot] == BVH_EMPTY) hits &= ~(1u << slot);
+    }
+    return hits;
+}
+
+bool pickBvh(const Bvh& bvh, const float origin[3], const float direction[3], float max_t, uint32_t& item, float& t)
+{
+    if (bvh.items.empty()) return false;
+
+    // a tiny component instead of zero keeps the slab test free of 0 * infinity
+    std::array<float, 3> inv_direction{};
+    for (int axis = 0; axis < 3; ++axis) {
+        const float d = std::abs(direction[axis]) < 1e-30f ? std::copysign(1e-30f, direction[axis]) : direction[axis];
+        inv_direction[axis] = 1.0f / d;
+    }
+
+    struct Entry {
+        uint32_t node;
+        float entry;
+    };
+    std::array<Entry, STACK_SIZE> stack{};
+    size_t top = 0;
+    stack[top++] = Entry{0, 0.0f};
+
+    bool found = false;
+    float best_t = max_t;
+    while (top > 0) {
+        const Entry entry = stack[--top];
+        if (entry.entry > best_t) continue;
+
+        const BvhNode& node = bvh.nodes[entry.node];
+        std::array<float, BVH_WIDTH> child_entry{};
+        const uint32_t hits = rayChildren(node, origin, inv_direction.data(), best_t, child_entry.data());
+
+        // nodes go on the stack furthest first, so the nearest is searched first and shrinks best_t for the rest
+        std::array<Entry, BVH_WIDTH> children{};
+        uint32_t child_count = 0;
+        for (uint32_t slot = 0; slot < BVH_WIDTH; ++slot) {
+            if (!(hits & (1u << slot))) continue;
+            if (node.leaf_count[slot] > 0) {
+                for (uint32_t i = node.child[slot]; i < node.child[slot] + node.leaf_count[slot]; ++i) {
+                    float item_t = 0.0f;
+                    if (rayAabb(bvh.bounds[bvh.items[i]], origin, inv_direction.data(), best_t, item_t)) {
+                        found = true;
+                        best_t = item_t;
+                        item = bvh.items[i];
+                    }
+                }
+            }
+            else {
+                children[child_count++] = Entry{node.child[slot], child_entry[slot]};
+            }
+        }
+        for (uint32_t i = 1; i < child_count; ++i) { // insertion sort, at most four
+            for (uint32_t j = i; j > 0 && children[j - 1].entry < children[j].entry; --j) {
+                std::swap(children[j - 1], children[j]);
+            }
+        }
+        for (uint32_t i = 0; i < child_count; ++i) {
+            assert(top < stack.size());
+            stack[top++] = children[i];
+        }
+    }
+
+    if (found) t = best_t;
+    return found;
+}
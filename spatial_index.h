@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+
+#include <span>
+#include <vector>
+
+struct Aabb {
+    float min[3];
+    float max[3];
+};
+
+// contains nothing, growing it by another box gives that box
+Aabb emptyAabb();
+
+// A point p is inside if dot(plane.xyz, p) + plane.w >= 0 for all six planes.
+struct Frustum {
+    float planes[6][4];
+};
+
+// Gribb and Hartmann planes of a column major view_proj with Vulkan's [0, 1] depth range, the same ones meshlet_cull.glsl uses.
+Frustum frustumFromViewProj(const float view_proj[16]);
+
+// Bvh::items[first, first + count)
+struct BvhRange {
+    uint32_t first;
+    uint32_t count;
+};
+
+constexpr uint32_t BVH_WIDTH = 4;
+constexpr uint32_t BVH_LEAF_SIZE = 4; // most items in one leaf slot
+constexpr uint32_t BVH_EMPTY = UINT32_MAX;
+
+// Four children with their bounds stored SoA, so one SIMD test covers all of them. A child is either another node or a leaf slot
+// holding up to BVH_LEAF_SIZE items.
+struct BvhNode {
+    float min_x[BVH_WIDTH];
+    float min_y[BVH_WIDTH];
+    float min_z[BVH_WIDTH];
+    float max_x[BVH_WIDTH];
+    float max_y[BVH_WIDTH];
+    float max_z[BVH_WIDTH];
+    uint32_t child[BVH_WIDTH];      // node index, or the first of a leaf slot's Bvh::items, BVH_EMPTY if unused
+    uint32_t leaf_count[BVH_WIDTH]; // items in a leaf slot, 0 for a node
+    uint32_t parent;                // BVH_EMPTY for the root
+    uint32_t first_item;            // the whole subtree is items[first_item, first_item + item_count)
+    uint32_t item_count;
+};
+
+// Bounding volume hierarchy over items identified by their index in the bounds passed to buildBvh().
+// Items that move are updated in place and refitted, which is much cheaper than a rebuild but lets the tree get looser the further
+// they travel from where they were at build time. Rebuild once queries return noticeably more than they should.
+struct Bvh {
+    std::vector<BvhNode> nodes{};      // a parent always comes before its children, nodes[0] is the root
+    std::vector<uint32_t> items{};     // item ids in leaf order, every subtree's items are contiguous
+    std::vector<Aabb> bounds{};        // per item id
+    std::vector<uint32_t> item_node{}; // per item id, the node whose leaf slot holds it
+
+    std::vector<uint32_t> dirty_nodes{}; // nodes with a leaf slot holding an updated item
+    std::vector<uint8_t> node_dirty{};
+};
+
+// O(n log n). Top down, splitting each node's items four ways at the centroid median of the widest axis.
+void buildBvh(Bvh& bvh, std::span<const Aabb> bounds);
+
+// Takes effect at the next refitBvh().
+void updateBvhItem(Bvh& bvh, uint32_t item, const Aabb& bounds);
+
+// Recomputes the bounds of every node above an updated item. Does not allocate once the tree has been refitted a few times.
+void refitBvh(Bvh& bvh);
+
+// Appends the items whose bounds touch the frustum, merging neighbouring ranges. Subtrees entirely inside are appended without
+// being visited. Does not allocate if ranges has the capacity.
+void queryBvh(const Bvh& bvh, const Frustum& frustum, std::vector<BvhRange>& ranges);
+
+// The item whose bounds the ray enters first, at origin + t * direction with t in [0, max_t].
+// Returns false if it misses everything. Exact hits against the item's geometry are left to the caller.
+bool pickBvh(const Bvh& bvh, const float origin[3], const float direction[3], float max_t, uint32_t& item, float& t);
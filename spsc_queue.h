@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+
+#include <array>
+#include <atomic>
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable : 4324) // structure was padded due to alignment specifier, that is the point
+#endif
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread.
+// Capacity must be a power of two. push() fails instead of blocking when the queue is full.
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    // producer thread only
+    bool push(const T& item)
+    {
+        const size_t write_index = tail.load(std::memory_order_relaxed);
+        if (write_index - head_cache == Capacity) {
+            head_cache = head.load(std::memory_order_acquire);
+            if (write_index - head_cache == Capacity) return false;
+        }
+        items[write_index & (Capacity - 1)] = item;
+        tail.store(write_index + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer thread only
+    bool pop(T& item)
+    {
+        const size_t read_index = head.load(std::memory_order_relaxed);
+        if (read_index == tail_cache) {
+            tail_cache = tail.load(std::memory_order_acquire);
+            if (read_index == tail_cache) return false;
+        }
+        item = items[read_index & (Capacity - 1)];
+        head.store(read_index + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    // 64 bytes rather than std::hardware_destructive_interference_size, which GCC warns is not ABI stable
+    static constexpr size_t CACHE_LINE = 64;
+
+    // The indices only ever increase, the slot is the index modulo Capacity.
+    // Each side caches the other side's index so it only reads the other cache line when the queue looks full or empty.
+    alignas(CACHE_LINE) std::atomic<size_t> head = 0; // written by the consumer
+    size_t tail_cache = 0;
+    alignas(CACHE_LINE) std::atomic<size_t> tail = 0; // written by the producer
+    size_t head_cache = 0;
+    alignas(CACHE_LINE) std::array<T, Capacity> items{};
+};
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
@@ -0,0 +1,300 @@
+#include "telemetry.h"
+
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#include "framework.h"
+#else
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "error.h"
+
+enum class MetricType {
+    Counter,
+    Gauge,
+    Histogram,
+};
+
+struct Metric {
+    std::string name{};
+    std::string help{};
+    MetricType type = MetricType::Counter;
+    // only the one of type is used
+    TelemetryCounter counter{};
+    TelemetryGauge gauge{};
+    TelemetryHistogram histogram{};
+};
+
+// a deque so references handed out stay valid as metrics are added
+static std::mutex registry_mutex;
+static std::deque<Metric> registry;
+
+void TelemetryHistogram::observe(double ms)
+{
+    size_t bucket = 0;
+    while (bucket < TELEMETRY_MS_BUCKETS.size() && ms > TELEMETRY_MS_BUCKETS[bucket]) ++bucket;
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(ms, std::memory_order_relaxed);
+}
+
+static Metric& registerMetric(const char* name, const char* help, MetricType type)
+{
+    std::lock_guard lock(registry_mutex);
+    for (Metric& metric : registry) {
+        if (metric.name != name) continue;
+        if (metric.type != type) throw Error(std::string("Telemetry metric ") + name + " registered again as another type");
+        return metric;
+    }
+    Metric& metric = registry.emplace_back();
+    metric.name = name;
+    metric.help = help;
+    metric.type = type;
+    return metric;
+}
+
+TelemetryCounter& telemetryCounter(const char* name, const char* help) { return registerMetric(name, help, MetricType::Counter).counter; }
+
+TelemetryGauge& telemetryGauge(const char* name, const char* help) { return registerMetric(name, help, MetricType::Gauge).gauge; }
+
+TelemetryHistogram& telemetryHistogram(const char* name, const char* help) { return registerMetric(name, help, MetricType::Histogram).histogram; }
+
+std::string telemetryText()
+{
+    std::string text{};
+    std::array<char, 256> line{};
+    std::lock_guard lock(registry_mutex);
+    for (const Metric& metric : registry) {
+        text += "# HELP " + metric.name + " " + metric.help + "\n";
+        switch (metric.type) {
+            case MetricType::Counter:
+                text += "# TYPE " + metric.name + " counter\n";
+                snprintf(line.data(), line.size(), "%s %" PRIu64 "\n", metric.name.c_str(), metric.counter.value.load(std::memory_order_relaxed));
+                text += line.data();
+                break;
+            case MetricType::Gauge:
+                text += "# TYPE " + metric.name + " gauge\n";
+                snprintf(line.data(), line.size(), "%s %.17g\n", metric.name.c_str(), metric.gauge.value.load(std::memory_order_relaxed));
+                text += line.data();
+                break;
+            case MetricType::Histogram: {
+                text += "# TYPE " + metric.name + " histogram\n";
+                // Prometheus buckets count everything up to their bound
+                uint64_t cumulative = 0;
+                for (size_t bucket = 0; bucket < TELEMETRY_MS_BUCKETS.size(); ++bucket) {
+                    cumulative += metric.histogram.buckets[bucket].load(std::memory_order_relaxed);
+                    snprintf(line.data(), line.size(), "%s_bucket{le=\"%g\"} %" PRIu64 "\n", metric.name.c_str(), TELEMETRY_MS_BUCKETS[bucket], cumulative);
+                    text += line.data();
+                }
+                cumulative += metric.histogram.buckets[TELEMETRY_MS_BUCKETS.size()].load(std::memory_order_relaxed);
+                snprintf(line.data(), line.size(), "%s_bucket{le=\"+Inf\"} %" PRIu64 "\n", metric.name.c_str(), cumulative);
+                text += line.data();
+                snprintf(line.data(), line.size(), "%s_sum %.17g\n", metric.name.c_str(), metric.histogram.sum.load(std::memory_order_relaxed));
+                text += line.data();
+                // the buckets were read one at a time, so their total is the count that matches them
+                snprintf(line.data(), line.size(), "%s_count %" PRIu64 "\n", metric.name.c_str(), cumulative);
+                text += line.data();
+            } break;
+        }
+    }
+    return text;
+}
+
+static void publish(TelemetrySegmentHeader& segment, const std::string& text)
+{
+    constexpr size_t capacity = TELEMETRY_SEGMENT_SIZE - sizeof(TelemetrySegmentHeader);
+    const size_t size = std::min(text.size(), capacity);
+    char* data = reinterpret_cast<char*>(&segment + 1);
+
+    const uint64_t sequence = segment.sequence.load(std::memory_order_relaxed);
+    segment.sequence.store(sequence + 1, std::memory_order_relaxed); // odd while writing
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(data, text.data(), size);
+    segment.text_size.store(size, std::memory_order_relaxed);
+    segment.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+// Copies the text if the writer did not rewrite it meanwhile, with a few retries
+static bool readSegment(const TelemetrySegmentHeader& segment, std::string& text)
+{
+    if (segment.magic != TELEMETRY_MAGIC || segment.version != TELEMETRY_VERSION) return false;
+    const char* data = reinterpret_cast<const char*>(&segment + 1);
+    for (int attempt = 0; attempt < 8; ++attempt) {
+        const uint64_t before = segment.sequence.load(std::memory_order_acquire);
+        if (before % 2 == 1) {
+            std::this_thread::yield();
+            continue;
+        }
+        const size_t size = std::min(static_cast<size_t>(segment.text_size.load(std::memory_order_relaxed)),
+                                     TELEMETRY_SEGMENT_SIZE - sizeof(TelemetrySegmentHeader));
+        text.assign(data, size);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (segment.sequence.load(std::memory_order_relaxed) == before) return true;
+    }
+    return false;
+}
+
+#ifdef _WIN32
+
+static std::string segmentName(const std::string& name) { return "Local\\" + name; }
+
+// existed is set if the segment was already there, held open by another process
+static TelemetrySegmentHeader* createSegment(const std::string& name, void*& mapping, bool& existed)
+{
+    HANDLE handle = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, static_cast<DWORD>(TELEMETRY_SEGMENT_SIZE),
+                                       segmentName(name).c_str());
+    if (handle == NULL) return nullptr;
+    existed = GetLastError() == ERROR_ALREADY_EXISTS;
+    void* view = MapViewOfFile(handle, FILE_MAP_WRITE, 0, 0, TELEMETRY_SEGMENT_SIZE);
+    if (view == nullptr) {
+        CloseHandle(handle);
+        return nullptr;
+    }
+    mapping = handle;
+    return static_cast<TelemetrySegmentHeader*>(view);
+}
+
+static void closeSegment(void* mapping, TelemetrySegmentHeader* segment)
+{
+    UnmapViewOfFile(segment);
+    CloseHandle(static_cast<HANDLE>(mapping));
+}
+
+// the segment goes away with the last handle to it
+static void destroySegment(const std::string&, void* mapping, TelemetrySegmentHeader* segment) { closeSegment(mapping, segment); }
+
+static uint64_t processId() { return GetCurrentProcessId(); }
+
+static bool processAlive(uint64_t process_id)
+{
+    HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, static_cast<DWORD>(process_id));
+    if (process == NULL) return GetLastError() == ERROR_ACCESS_DENIED; // there, but not ours to open
+    const bool alive = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+    CloseHandle(process);
+    return alive;
+}
+
+bool readTelemetrySegment(const std::string& name, std::string& text)
+{
+    HANDLE handle = OpenFileMappingA(FILE_MAP_READ, FALSE, segmentName(name).c_str());
+    if (handle == NULL) return false;
+    const void* view = MapViewOfFile(handle, FILE_MAP_READ, 0, 0, TELEMETRY_SEGMENT_SIZE);
+    CloseHandle(handle); // the view keeps the segment
+    if (view == nullptr) return false;
+    const bool read = readSegment(*static_cast<const TelemetrySegmentHeader*>(view), text);
+    UnmapViewOfFile(view);
+    return read;
+}
+
+#else
+
+static std::string segmentName(const std::string& name) { return "/" + name; }
+
+// existed is set if the segment was already there, left behind by a crashed run or in use by another instance
+static TelemetrySegmentHeader* createSegment(const std::string& name, void*& mapping, bool& existed)
+{
+    int fd = shm_open(segmentName(name).c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    existed = fd < 0 && errno == EEXIST;
+    if (existed) fd = shm_open(segmentName(name).c_str(), O_RDWR, 0);
+    if (fd < 0) return nullptr;
+    if (ftruncate(fd, static_cast<off_t>(TELEMETRY_SEGMENT_SIZE)) != 0) {
+        close(fd);
+        return nullptr;
+    }
+    void* view = mmap(nullptr, TELEMETRY_SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps the segment
+    if (view == MAP_FAILED) return nullptr;
+    mapping = view;
+    return static_cast<TelemetrySegmentHeader*>(view);
+}
+
+static void closeSegment(void*, TelemetrySegmentHeader* segment) { munmap(segment, TELEMETRY_SEGMENT_SIZE); }
+
+static void destroySegment(const std::string& name, void* mapping, TelemetrySegmentHeader* segment)
+{
+    closeSegment(mapping, segment);
+    shm_unlink(segmentName(name).c_str());
+}
+
+static uint64_t processId() { return static_cast<uint64_t>(getpid()); }
+
+static bool processAlive(uint64_t process_id) { return kill(static_cast<pid_t>(process_id), 0) == 0 || errno == EPERM; }
+
+bool readTelemetrySegment(const std::string& name, std::string& text)
+{
+    const int fd = shm_open(segmentName(name).c_str(), O_RDONLY, 0);
+    if (fd < 0) return false;
+    void* view = mmap(nullptr, TELEMETRY_SEGMENT_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) return false;
+    const bool read = readSegment(*static_cast<const TelemetrySegmentHeader*>(view), text);
+    munmap(view, TELEMETRY_SEGMENT_SIZE);
+    return read;
+}
+
+#endif
+
+// Another instance publishing to the segment keeps it. One that has not written its process id yet counts as publishing.
+static bool segmentInUse(const TelemetrySegmentHeader& segment)
+{
+    return segment.magic != TELEMETRY_MAGIC || segment.process_id == 0 || (segment.process_id != processId() && processAlive(segment.process_id));
+}
+
+void startTelemetryExport(TelemetryExporter& exporter, const std::string& name, uint32_t interval_ms)
+{
+    std::string segment_name = name;
+    bool existed = false;
+    exporter.segment = createSegment(segment_name, exporter.mapping, existed);
+    if (exporter.segment != nullptr && existed && segmentInUse(*exporter.segment)) {
+        const uint64_t owner = exporter.segment->process_id;
+        closeSegment(exporter.mapping, exporter.segment);
+        segment_name = name + "_" + std::to_string(processId());
+        fprintf(stderr, "Telemetry segment %s is in use by process %" PRIu64 ", publishing to %s instead\n", segmentName(name).c_str(), owner,
+                segmentName(segment_name).c_str());
+        exporter.segment = createSegment(segment_name, exporter.mapping, existed);
+    }
+    if (exporter.segment == nullptr) throw Error("Failed to create the telemetry segment " + segmentName(segment_name));
+    // a fresh segment is zeroed, one left behind by a crashed run is taken over
+    new (exporter.segment) TelemetrySegmentHeader{};
+    exporter.segment->process_id = processId();
+    exporter.name = segment_name;
+
+    exporter.stop = false;
+    exporter.thread = std::thread([&exporter, interval_ms]() {
+        std::unique_lock lock(exporter.mutex);
+        do {
+            lock.unlock();
+            publish(*exporter.segment, telemetryText());
+            lock.lock();
+        } while (!exporter.stop_cv.wait_for(lock, std::chrono::milliseconds(interval_ms), [&exporter]() { return exporter.stop; }));
+    });
+}
+
+void stopTelemetryExport(TelemetryExporter& exporter)
+{
+    if (exporter.segment == nullptr) return;
+    {
+        std::lock_guard lock(exporter.mutex);
+        exporter.stop = true;
+    }
+    exporter.stop_cv.notify_one();
+    exporter.thread.join();
+    destroySegment(exporter.name, exporter.mapping, exporter.segment);
+    exporter.segment = nullptr;
+    exporter.mapping = nullptr;
+}
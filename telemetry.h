@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Metrics the render thread updates every frame, and a thread that publishes them in the Prometheus text format through a named shared
+// memory segment, where StatsViewer (tools/stats_viewer.cpp) or a scraper can read them without the renderer noticing.
+//
+// Updates are relaxed atomics and never lock or allocate, so any thread can make them. Registering a metric locks and allocates, so
+// it is done once up front and the reference kept. Names follow Prometheus conventions: snake_case with a unit suffix.
+
+struct TelemetryCounter {
+    std::atomic<uint64_t> value = 0;
+
+    void add(uint64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+};
+
+struct TelemetryGauge {
+    std::atomic<double> value = 0.0;
+
+    void set(double v) { value.store(v, std::memory_order_relaxed); }
+};
+
+// upper bounds of the histogram buckets, milliseconds from 1/8 of a 240 Hz frame up to stalls
+constexpr std::array<double, 12> TELEMETRY_MS_BUCKETS{0.5, 1.0, 2.0, 3.0, 4.0, 6.0, 8.0, 12.0, 16.7, 33.3, 50.0, 100.0};
+
+struct TelemetryHistogram {
+    std::array<std::atomic<uint64_t>, TELEMETRY_MS_BUCKETS.size() + 1> buckets{}; // not cumulative, the last one has no upper bound
+    std::atomic<double> sum = 0.0;
+
+    void observe(double ms);
+};
+
+// Registering a name again returns the same metric. help is a one line description for the # HELP line.
+TelemetryCounter& telemetryCounter(const char* name, const char* help);
+TelemetryGauge& telemetryGauge(const char* name, const char* help);
+TelemetryHistogram& telemetryHistogram(const char* name, const char* help);
+
+// every registered metric in the Prometheus text exposition format
+std::string telemetryText();
+
+// The segment holds a header and then the text, rewritten every interval. A sequence number that is odd while the text is being written
+// lets readers retry instead of the writer waiting on them.
+constexpr uint32_t TELEMETRY_MAGIC = 0x4D4C4554; // "TELM"
+constexpr uint32_t TELEMETRY_VERSION = 1;
+constexpr size_t TELEMETRY_SEGMENT_SIZE = 256 * 1024;
+
+struct TelemetrySegmentHeader {
+    uint32_t magic = TELEMETRY_MAGIC;
+    uint32_t version = TELEMETRY_VERSION;
+    std::atomic<uint64_t> sequence = 0;
+    std::atomic<uint64_t> text_size = 0;
+    uint64_t process_id = 0;
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the segment's atomics are shared between processes");
+
+struct TelemetryExporter {
+    std::thread thread{};
+    std::mutex mutex{};
+    std::condition_variable stop_cv{};
+    bool stop = false;
+    std::string name{};
+    void* mapping = nullptr; // the platform's handle of the segment
+    TelemetrySegmentHeader* segment = nullptr;
+};
+
+// Creates the segment called name, "/name" with shm_open() or "Local\name" on Windows, and publishes to it every interval_ms.
+// A segment left behind by a run that crashed is taken over. If another running instance publishes to name, this one publishes to
+// name_<process id> instead, says so on stderr and keeps that name in exporter.name. Throws an Error if the segment cannot be created.
+void startTelemetryExport(TelemetryExporter& exporter, const std::string& name, uint32_t interval_ms);
+// Stops publishing and removes the segment
+void stopTelemetryExport(TelemetryExporter& exporter);
+
+// Copies the text out of the segment called name. Returns false if there is no such segment, or if the writer kept
+// rewriting it while it was being read.
+bool readTelemetrySegment(const std::string& name, std::string& text);
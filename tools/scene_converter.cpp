@@ -0,0 +1,349 @@
+// SceneConverter: converts Wavefront OBJ (with MTL materials) to the .vscene format in scene_format.h
+//
+// SceneConverter <input.obj> <output.vscene> [--fit]
+//
+// Faces are split into one mesh per material, polygons are fan triangulated and identical vertices are shared.
+// Each mesh is split into meshlets of at most MESHLET_MAX_VERTICES vertices and MESHLET_MAX_TRIANGLES triangles for cluster culling.
+// Faces without normals get flat normals. --fit centres the model and scales it to fit the [-0.5, 0.5] cube.
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "error.h"
+#include "mesh.h"
+#include "scene_format.h"
+
+namespace {
+
+struct Material {
+    std::string name{};
+    std::array<float, 4> color{1.0f, 1.0f, 1.0f, 1.0f};
+};
+
+struct Corner {
+    int position = -1;
+    int normal = -1; // -1 if the face has no normals
+};
+
+struct Face {
+    std::array<Corner, 3> corners{};
+    uint32_t material = 0;
+};
+
+struct ObjModel {
+    std::vector<std::array<float, 3>> positions{};
+    std::vector<std::array<float, 3>> normals{};
+    std::vector<Material> materials{{}}; // 0 is the default for faces before any usemtl
+    std::vector<Face> faces{};
+};
+
+std::string directoryOf(const std::string& path)
+{
+    const size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? std::string{} : path.substr(0, slash + 1);
+}
+
+// OBJ indices start at 1, negative ones count back from the last element read so far
+int resolveIndex(const std::string& token, size_t count, const std::string& path)
+{
+    const int index = std::stoi(token);
+    const int resolved = index < 0 ? static_cast<int>(count) + index : index - 1;
+    if (index == 0 || resolved < 0 || resolved >= static_cast<int>(count)) throw Error(path + ": index " + token + " out of range");
+    return resolved;
+}
+
+void loadMtl(const std::string& path, ObjModel& model)
+{
+    std::ifstream file(path);
+    if (!file) {
+        fprintf(stderr, "warning: could not open %s, using white materials\n", path.c_str());
+        return;
+    }
+
+    Material* current = nullptr;
+    std::string line{};
+    while (std::getline(file, line)) {
+        std::istringstream stream(line);
+        std::string keyword{};
+        stream >> keyword;
+        if (keyword == "newmtl") {
+            model.materials.push_back(Material{});
+            current = &model.materials.back();
+            stream >> current->name;
+        }
+        else if (keyword == "Kd" && current != nullptr) {
+            stream >> current->color[0] >> current->color[1] >> current->color[2];
+        }
+        else if (keyword == "d" && current != nullptr) {
+            stream >> current->color[3];
+        }
+    }
+}
+
+ObjModel loadObj(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file) throw Error("Failed to open " + path);
+
+    ObjModel model{};
+    uint32_t material = 0;
+    std::string line{};
+    std::vector<Corner> polygon{};
+    while (std::getline(file, line)) {
+        std::istringstream stream(line);
+        std::string keyword{};
+        stream >> keyword;
+        if (keyword == "v") {
+            std::array<float, 3>& p = model.positions.emplace_back();
+            stream >> p[0] >> p[1] >> p[2];
+        }
+        else if (keyword == "vn") {
+            std::array<float, 3>& n = model.normals.emplace_back();
+            stream >> n[0] >> n[1] >> n[2];
+        }
+        else if (keyword == "mtllib") {
+            std::string name{};
+            std::getline(stream >> std::ws, name);
+            loadMtl(directoryOf(path) + name, model);
+        }
+        else if (keyword == "usemtl") {
+            std::string name{};
+            stream >> name;
+            const auto it = std::find_if(model.materials.begin(), model.materials.end(), [&](const Material& m) { return m.name == name; });
+            material = it == model.materials.end() ? 0 : static_cast<uint32_t>(it - model.materials.begin());
+        }
+        else if (keyword == "f") {
+            // v, v/vt, v//vn or v/vt/vn, texture coordinates are ignored
+            polygon.clear();
+            std::string token{};
+            while (stream >> token) {
+                Corner corner{};
+                const size_t first_slash = token.find('/');
+                corner.position = resolveIndex(token.substr(0, first_slash), model.positions.size(), path);
+                if (first_slash != std::string::npos) {
+                    const size_t second_slash = token.find('/', first_slash + 1);
+                    if (second_slash != std::string::npos && second_slash + 1 < token.size()) {
+                        corner.normal = resolveIndex(token.substr(second_slash + 1), model.normals.size(), path);
+                    }
+                }
+                polygon.push_back(corner);
+            }
+            for (size_t i = 2; i < polygon.size(); ++i) {
+                model.faces.push_back(Face{{polygon[0], polygon[i - 1], polygon[i]}, material});
+            }
+        }
+    }
+
+    if (model.faces.empty()) throw Error(path + " has no faces");
+    return model;
+}
+
+void fitToUnitCube(ObjModel& model)
+{
+    std::array<float, 3> min{model.positions[0]};
+    std::array<float, 3> max{model.positions[0]};
+    for (const std::array<float, 3>& p : model.positions) {
+        for (int i = 0; i < 3; ++i) {
+            min[i] = std::min(min[i], p[i]);
+            max[i] = std::max(max[i], p[i]);
+        }
+    }
+    const float extent = std::max({max[0] - min[0], max[1] - min[1], max[2] - min[2]});
+    const float scale = extent > 0.0f ? 1.0f / extent : 1.0f;
+    for (std::array<float, 3>& p : model.positions) {
+        for (int i = 0; i < 3; ++i) {
+            p[i] = (p[i] - (min[i] + max[i]) * 0.5f) * scale;
+        }
+    }
+}
+
+std::array<float, 3> faceNormal(const ObjModel& model, const Face& face)
+{
+    const std::array<float, 3>& a = model.positions[face.corners[0].position];
+    const std::array<float, 3>& b = model.positions[face.corners[1].position];
+    const std::array<float, 3>& c = model.positions[face.corners[2].position];
+    const float e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    const float e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+    std::array<float, 3> n{e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+    const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (length == 0.0f) return {0.0f, 0.0f, 1.0f}; // degenerate
+    return {n[0] / length, n[1] / length, n[2] / length};
+}
+
+std::array<float, 3> normalised(std::array<float, 3> n)
+{
+    const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (length == 0.0f) return {0.0f, 0.0f, 1.0f};
+    return {n[0] / length, n[1] / length, n[2] / length};
+}
+
+struct SceneData {
+    std::vector<SceneMesh> meshes{};
+    std::vector<SceneMaterial> materials{};
+    std::vector<PackedVertex> vertices{};
+    std::vector<uint32_t> indices{};
+    std::vector<Meshlet> meshlets{};
+    std::vector<uint32_t> meshlet_vertices{};
+    std::vector<uint32_t> meshlet_triangles{};
+};
+
+void appendMesh(const MeshData& mesh, uint32_t material, SceneData& scene)
+{
+    SceneMesh scene_mesh{};
+    scene_mesh.first_index = static_cast<uint32_t>(scene.indices.size());
+    scene_mesh.index_count = static_cast<uint32_t>(mesh.indices.size());
+    scene_mesh.first_vertex = static_cast<uint32_t>(scene.vertices.size());
+    scene_mesh.vertex_count = static_cast<uint32_t>(mesh.vertices.size());
+    scene_mesh.first_meshlet = static_cast<uint32_t>(scene.meshlets.size());
+    scene_mesh.meshlet_count = static_cast<uint32_t>(mesh.meshlets.size());
+    scene_mesh.material = material;
+    scene_mesh.position_scale = mesh.position_scale;
+
+    // meshlets index the whole scene's arrays, the values in them stay relative to the mesh like the indices
+    const uint32_t first_meshlet_vertex = static_cast<uint32_t>(scene.meshlet_vertices.size());
+    for (Meshlet meshlet : mesh.meshlets) {
+        meshlet.first_index += scene_mesh.first_index;
+        meshlet.first_vertex += first_meshlet_vertex;
+        scene.meshlets.push_back(meshlet);
+    }
+
+    scene.meshes.push_back(scene_mesh);
+    scene.vertices.insert(scene.vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+    scene.indices.insert(scene.indices.end(), mesh.indices.begin(), mesh.indices.end());
+    scene.meshlet_vertices.insert(scene.meshlet_vertices.end(), mesh.meshlet_vertices.begin(), mesh.meshlet_vertices.end());
+    scene.meshlet_triangles.insert(scene.meshlet_triangles.end(), mesh.meshlet_triangles.begin(), mesh.meshlet_triangles.end());
+}
+
+SceneData buildScene(const ObjModel& model)
+{
+    SceneData scene{};
+    for (const Material& material : model.materials) {
+        SceneMaterial& out = scene.materials.emplace_back();
+        std::copy(material.color.begin(), material.color.end(), out.base_color);
+    }
+
+    // grouped by material so each one is a single draw
+    std::map<uint32_t, std::vector<const Face*>> faces_by_material{};
+    for (const Face& face : model.faces) {
+        faces_by_material[face.material].push_back(&face);
+    }
+
+    for (const auto& [material, faces] : faces_by_material) {
+        MeshData mesh{};
+
+        // vertices are shared when position and normal match, flat shaded faces get their own
+        std::vector<std::array<int, 3>> keys{};
+        std::map<std::array<int, 3>, uint32_t> key_to_vertex{};
+        for (size_t f = 0; f < faces.size(); ++f) {
+            for (const Corner& corner : faces[f]->corners) {
+                const std::array<int, 3> key{corner.position, corner.normal, corner.normal < 0 ? static_cast<int>(f) : -1};
+                const auto [it, inserted] = key_to_vertex.try_emplace(key, static_cast<uint32_t>(keys.size()));
+                if (inserted) keys.push_back(key);
+                mesh.indices.push_back(it->second);
+            }
+        }
+
+        std::vector<float> positions{};
+        positions.reserve(keys.size() * 3);
+        for (const std::array<int, 3>& key : keys) {
+            positions.insert(positions.end(), model.positions[key[0]].begin(), model.positions[key[0]].end());
+        }
+        mesh.position_scale = positionScale(positions.data(), keys.size());
+
+        for (const std::array<int, 3>& key : keys) {
+            const std::array<float, 3> normal = key[1] >= 0 ? normalised(model.normals[key[1]]) : faceNormal(model, *faces[key[2]]);
+            mesh.vertices.push_back(packVertex(model.positions[key[0]].data(), mesh.position_scale, normal.data(), scene.materials[material].base_color));
+        }
+
+        buildMeshlets(mesh);
+        appendMesh(mesh, material, scene);
+    }
+    return scene;
+}
+
+uint64_t alignSection(uint64_t offset) { return (offset + SCENE_SECTION_ALIGNMENT - 1) & ~(SCENE_SECTION_ALIGNMENT - 1); }
+
+void writeScene(const std::string& path, const SceneData& scene)
+{
+    struct Section {
+        SceneSectionType type;
+        uint32_t element_size;
+        const void* data;
+        uint64_t size;
+    };
+    // GPU data sections last
+    const std::array<Section, 7> sections{{
+        {SceneSectionType::Meshes, sizeof(SceneMesh), scene.meshes.data(), sizeof(SceneMesh) * scene.meshes.size()},
+        {SceneSectionType::Materials, sizeof(SceneMaterial), scene.materials.data(), sizeof(SceneMaterial) * scene.materials.size()},
+        {SceneSectionType::Vertices, sizeof(PackedVertex), scene.vertices.data(), sizeof(PackedVertex) * scene.vertices.size()},
+        {SceneSectionType::Indices, sizeof(uint32_t), scene.indices.data(), sizeof(uint32_t) * scene.indices.size()},
+        {SceneSectionType::Meshlets, sizeof(Meshlet), scene.meshlets.data(), sizeof(Meshlet) * scene.meshlets.size()},
+        {SceneSectionType::MeshletVertices, sizeof(uint32_t), scene.meshlet_vertices.data(), sizeof(uint32_t) * scene.meshlet_vertices.size()},
+        {SceneSectionType::MeshletTriangles, sizeof(uint32_t), scene.meshlet_triangles.data(), sizeof(uint32_t) * scene.meshlet_triangles.size()},
+    }};
+    constexpr size_t FIRST_GPU_SECTION = 2;
+
+    SceneFileHeader header{};
+    header.section_count = static_cast<uint32_t>(sections.size());
+    std::vector<SceneSectionHeader> section_headers{};
+    uint64_t offset = sizeof(SceneFileHeader) + sizeof(SceneSectionHeader) * sections.size();
+    for (const Section& section : sections) {
+        offset = alignSection(offset);
+        section_headers.push_back(SceneSectionHeader{section.type, section.element_size, offset, section.size});
+        offset += section.size;
+    }
+    header.file_size = offset;
+    header.gpu_data_offset = section_headers[FIRST_GPU_SECTION].offset;
+    header.gpu_data_size = header.file_size - header.gpu_data_offset;
+
+    std::vector<char> contents(header.file_size, 0);
+    memcpy(contents.data(), &header, sizeof(header));
+    memcpy(contents.data() + sizeof(header), section_headers.data(), sizeof(SceneSectionHeader) * section_headers.size());
+    for (size_t i = 0; i < sections.size(); ++i) {
+        if (sections[i].size > 0) memcpy(contents.data() + section_headers[i].offset, sections[i].data, sections[i].size);
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+    if (!file) throw Error("Failed to write " + path);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    std::vector<std::string> paths{};
+    bool fit = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--fit") == 0) fit = true;
+        else paths.push_back(argv[i]);
+    }
+    if (paths.size() != 2) {
+        fprintf(stderr, "usage: SceneConverter <input.obj> <output.vscene> [--fit]\n");
+        return 2;
+    }
+
+    try {
+        ObjModel model = loadObj(paths[0]);
+        if (fit) fitToUnitCube(model);
+        const SceneData scene = buildScene(model);
+        writeScene(paths[1], scene);
+        printf("%s: %zu meshes, %zu vertices, %zu triangles, %zu meshlets\n", paths[1].c_str(), scene.meshes.size(), scene.vertices.size(),
+               scene.indices.size() / 3, scene.meshlets.size());
+    }
+    catch (const std::exception& e) {
+        fprintf(stderr, "error: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,88 @@
+// StatsViewer: prints the metrics a running VulkanApplication publishes, see telemetry.h
+//
+// StatsViewer [name] [--watch <ms>] [--filter <text>]
+//
+// name is the telemetry config key of the application, "vulkanapp" by default. The metrics are printed once in the Prometheus text format,
+// so they can be redirected into a file a scraper collects. --watch prints them again every ms milliseconds until interrupted, and
+// --filter leaves out the metrics whose names do not contain text. Reading never blocks the application.
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "telemetry.h"
+
+namespace {
+
+struct Options {
+    std::string name = "vulkanapp";
+    uint32_t watch_ms = 0; // 0 to print once
+    std::string filter{};
+};
+
+bool parseOptions(int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--watch" && i + 1 < argc) options.watch_ms = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        else if (arg == "--filter" && i + 1 < argc) options.filter = argv[++i];
+        else if (arg.compare(0, 2, "--") != 0) options.name = arg;
+        else return false;
+    }
+    return true;
+}
+
+// the lines of the metrics whose names contain filter, comments included
+std::string filterText(const std::string& text, const std::string& filter)
+{
+    if (filter.empty()) return text;
+    std::istringstream lines(text);
+    std::string filtered{};
+    std::string line{};
+    while (std::getline(lines, line)) {
+        // "# HELP name ..." and "# TYPE name ..." name the metric third
+        std::string name = line;
+        if (line.compare(0, 2, "# ") == 0) {
+            const size_t begin = line.find(' ', 2);
+            name = begin == std::string::npos ? "" : line.substr(begin + 1, line.find(' ', begin + 1) - begin - 1);
+        }
+        else {
+            name = line.substr(0, line.find_first_of("{ "));
+        }
+        if (name.find(filter) != std::string::npos) filtered += line + "\n";
+    }
+    return filtered;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    Options options{};
+    if (!parseOptions(argc, argv, options)) {
+        fprintf(stderr, "usage: StatsViewer [name] [--watch <ms>] [--filter <text>]\n");
+        return 2;
+    }
+
+    std::string text{};
+    do {
+        if (!readTelemetrySegment(options.name, text)) {
+            fprintf(stderr, "no telemetry published as %s, is the application running with telemetry = %s?\n", options.name.c_str(),
+                    options.name.c_str());
+            if (options.watch_ms == 0) return 1;
+        }
+        else {
+            // clear the terminal between updates
+            if (options.watch_ms > 0) fputs("\x1b[2J\x1b[H", stdout);
+            fputs(filterText(text, options.filter).c_str(), stdout);
+            fflush(stdout);
+        }
+        if (options.watch_ms > 0) std::this_thread::sleep_for(std::chrono::milliseconds(options.watch_ms));
+    } while (options.watch_ms > 0);
+    return 0;
+}
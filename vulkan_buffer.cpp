@@ -0,0 +1,69 @@
+#include "vulkan_buffer.h"
+
+#include "error.h"
+#include "vulkan_debug.h"
+#include "vulkan_device.h"
+
+void createBuffer(const Device& device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags preferred_properties,
+                  VkMemoryPropertyFlags required_properties, MemoryCategory category, Buffer& buffer)
+{
+    // defragmentMemory() copies device local buffers to move them
+    if ((required_properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0) {
+        usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    }
+
+    VkBufferCreateInfo buffer_info{};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = size;
+    buffer_info.usage = usage;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VKCHECK(vkCreateBuffer(device.device, &buffer_info, nullptr, &buffer.buffer));
+
+    VkMemoryRequirements reqs{};
+    vkGetBufferMemoryRequirements(device.device, buffer.buffer, &reqs);
+
+    uint32_t required_type = 0;
+    if (!findMemoryType(device, reqs.memoryTypeBits, required_properties, required_type)) {
+        throw Error("No suitable memory type for buffer");
+    }
+    // over budget the driver would have to evict something from the preferred heap to make room
+    uint32_t memory_type = 0;
+    if (!findMemoryType(device, reqs.memoryTypeBits, preferred_properties | required_properties, memory_type) ||
+        !memoryWithinBudget(device, memory_type, reqs.size)) {
+        memory_type = required_type;
+    }
+
+    buffer.allocation = allocateMemory(device, reqs, memory_type, category, true);
+    VKCHECK(vkBindBufferMemory(device.device, buffer.buffer, buffer.allocation.memory, buffer.allocation.offset));
+    buffer.size = size;
+    buffer.usage = usage;
+    buffer.mapped = buffer.allocation.mapped;
+
+    if (usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
+        VkBufferDeviceAddressInfo address_info{};
+        address_info.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+        address_info.buffer = buffer.buffer;
+        buffer.address = vkGetBufferDeviceAddress(device.device, &address_info);
+    }
+
+    const bool host_visible = (device.memoryProperties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+    if (!host_visible && buffer.allocation.block != UINT32_MAX) registerMovableBuffer(device, buffer);
+}
+
+void destroyBuffer(const Device& device, Buffer& buffer)
+{
+    if (buffer.buffer == VK_NULL_HANDLE) return;
+    // a buffer a move has only just copied into is destroyed by defragmentMemory() once the copy has finished
+    const bool retired = buffer.allocation.block != UINT32_MAX && unregisterMovableBuffer(device, buffer);
+    if (!retired) {
+        vkDestroyBuffer(device.device, buffer.buffer, nullptr);
+        freeMemory(device, buffer.allocation);
+    }
+    buffer = Buffer{};
+}
+
+void nameBuffer(const Device& device, Buffer& buffer, const char* name)
+{
+    buffer.name = name;
+    nameObject(device.device, VK_OBJECT_TYPE_BUFFER, buffer.buffer, name);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "vulkan_headers.h"
+#include "vulkan_memory.h"
+
+struct Device;
+
+// Device local buffers may be moved by defragmentMemory(), which changes buffer, allocation and address. Read them from the Buffer
+// when recording rather than keeping copies across frames.
+struct Buffer {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    MemoryAllocation allocation{};
+    VkDeviceSize size = 0;
+    VkBufferUsageFlags usage = 0;
+    VkDeviceAddress address = 0; // 0 unless usage has VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+    void* mapped = nullptr;      // persistently mapped if the memory is host visible
+    const char* name = nullptr;  // a string literal, given to the buffers defragmentMemory() moves it into
+};
+
+// Uses a memory type with all the preferred property flags if there is one with room in its heap's budget, otherwise one with the
+// required flags. Buffers that do not require host visible memory can be moved, so buffer must stay where it is until destroyBuffer().
+void createBuffer(const Device& device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags preferred_properties,
+                  VkMemoryPropertyFlags required_properties, MemoryCategory category, Buffer& buffer);
+void destroyBuffer(const Device& device, Buffer& buffer);
+
+// Names the buffer in debug builds, see vulkan_debug.h. name must outlive the buffer.
+void nameBuffer(const Device& device, Buffer& buffer, const char* name);
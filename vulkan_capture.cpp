@@ -0,0 +1,301 @@
+#include "vulkan_capture.h"
+
+#include <cinttypes>
+#include <cstdio>
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+
+#include "error.h"
+#include "image_file.h"
+#include "vulkan_device.h"
+
+static std::string framePath(const CaptureSettings& settings, uint64_t frame, const char* extension)
+{
+    std::array<char, 64> suffix{};
+    snprintf(suffix.data(), suffix.size(), "_%06" PRIu64 ".%s", frame, extension);
+    return settings.path_prefix + suffix.data();
+}
+
+static std::string streamPath(const CaptureSettings& settings, VkExtent2D extent, const char* extension)
+{
+    std::array<char, 64> suffix{};
+    snprintf(suffix.data(), suffix.size(), "_%ux%u.%s", extent.width, extent.height, extension);
+    return settings.path_prefix + suffix.data();
+}
+
+// Copies the frame out of its readback buffer, swizzling BGRA to RGBA, and frees the buffer for another frame
+static void copyFromSlot(Capture* capture, CaptureJob& job)
+{
+    if (!capture->free_pixel_buffers.empty()) {
+        job.rgba = std::move(capture->free_pixel_buffers.back());
+        capture->free_pixel_buffers.pop_back();
+    }
+
+    const size_t pixel_count = static_cast<size_t>(job.extent.width) * job.extent.height;
+    job.rgba.resize(pixel_count * 4);
+    const uint8_t* src = static_cast<const uint8_t*>(capture->slots[job.slot].mapped);
+    if (capture->swizzle_bgr) {
+        for (size_t pixel = 0; pixel < pixel_count; ++pixel) {
+            job.rgba[pixel * 4 + 0] = src[pixel * 4 + 2];
+            job.rgba[pixel * 4 + 1] = src[pixel * 4 + 1];
+            job.rgba[pixel * 4 + 2] = src[pixel * 4 + 0];
+            job.rgba[pixel * 4 + 3] = src[pixel * 4 + 3];
+        }
+    }
+    else {
+        std::copy(src, src + pixel_count * 4, job.rgba.begin());
+    }
+
+    std::lock_guard lock(capture->mutex);
+    capture->slots[job.slot].state = CaptureSlotState::Free;
+}
+
+static void encoderThread(Capture* capture)
+{
+    // raw and y4m output is a single stream, reopened if the frame size changes
+    std::ofstream stream{};
+    VkExtent2D stream_extent{};
+
+    while (true) {
+        CaptureJob job{};
+        {
+            std::unique_lock lock(capture->mutex);
+            capture->cv.wait(lock, [capture] { return capture->stop_encoder || !capture->pending_jobs.empty(); });
+            if (capture->pending_jobs.empty()) break; // stop requested and everything has been written
+            job = std::move(capture->pending_jobs.front());
+            capture->pending_jobs.pop_front();
+        }
+        copyFromSlot(capture, job);
+
+        bool written = false;
+        if (capture->settings.callback) {
+            capture->settings.callback(job);
+            written = true;
+        }
+        else {
+            switch (capture->settings.format) {
+                case CaptureFormat::PNG:
+                    written = writePNG(framePath(capture->settings, job.frame, "png"), job.rgba.data(), job.extent.width, job.extent.height);
+                    break;
+                case CaptureFormat::RAW:
+                case CaptureFormat::Y4M: {
+                    const bool y4m = capture->settings.format == CaptureFormat::Y4M;
+                    if (!stream.is_open() || stream_extent.width != job.extent.width || stream_extent.height != job.extent.height) {
+                        stream.close();
+                        stream.open(streamPath(capture->settings, job.extent, y4m ? "y4m" : "rgba"), std::ios::binary);
+                        stream_extent = job.extent;
+                        if (y4m) writeY4MHeader(stream, job.extent.width, job.extent.height, capture->settings.fps);
+                    }
+                    if (y4m) {
+                        writeY4MFrame(stream, job.rgba.data(), job.extent.width, job.extent.height);
+                    }
+                    else {
+                        stream.write(reinterpret_cast<const char*>(job.rgba.data()), job.rgba.size());
+                    }
+                    written = stream.good();
+                } break;
+            }
+        }
+        if (written) {
+            capture->frames_written.fetch_add(1, std::memory_order_relaxed);
+        }
+        else {
+            capture->write_failures.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        {
+            std::lock_guard lock(capture->mutex);
+            capture->free_pixel_buffers.push_back(std::move(job.rgba));
+            --capture->jobs_outstanding;
+        }
+        capture->idle_cv.notify_all();
+    }
+}
+
+static void destroySlot(const Device& device, CaptureSlot& slot)
+{
+    if (slot.buffer == VK_NULL_HANDLE) return;
+    vkDestroyBuffer(device.device, slot.buffer, nullptr);
+    freeMemory(device, slot.allocation);
+    slot = CaptureSlot{};
+}
+
+static void allocateSlot(const Device& device, CaptureSlot& slot, VkDeviceSize size)
+{
+    VkBufferCreateInfo buffer_info{};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = size;
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VKCHECK(vkCreateBuffer(device.device, &buffer_info, nullptr, &slot.buffer));
+
+    VkMemoryRequirements reqs{};
+    vkGetBufferMemoryRequirements(device.device, slot.buffer, &reqs);
+
+    // host cached memory makes reading back much faster than uncached write-combined memory
+    uint32_t memory_type = 0;
+    if (!findMemoryType(device, reqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, memory_type) &&
+        !findMemoryType(device, reqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, memory_type)) {
+        throw Error("No host visible memory type for capture readback");
+    }
+    slot.coherent = (device.memoryProperties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+    slot.allocation = allocateMemory(device, reqs, memory_type, MemoryCategory::Readback, true);
+    VKCHECK(vkBindBufferMemory(device.device, slot.buffer, slot.allocation.memory, slot.allocation.offset));
+    slot.mapped = slot.allocation.mapped;
+    slot.size = size;
+}
+
+void createCapture(const Device& device, VkFormat format, VkImageUsageFlags image_usage, const CaptureSettings& settings, Capture& capture)
+{
+    (void)device;
+
+    capture.settings = settings;
+    capture.slots.resize(settings.slot_count);
+    capture.next_slot = 0;
+
+    // only 8-bit RGBA/BGRA images are supported
+    switch (format) {
+        case VK_FORMAT_B8G8R8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+            capture.swizzle_bgr = true;
+            capture.supported = true;
+            break;
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_R8G8B8A8_UNORM:
+            capture.swizzle_bgr = false;
+            capture.supported = true;
+            break;
+        default:
+            capture.supported = false;
+            break;
+    }
+    if ((image_usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) == 0) {
+        capture.supported = false;
+    }
+
+    capture.stop_encoder = false;
+    capture.encoder = std::thread(encoderThread, &capture);
+}
+
+void destroyCapture(const Device& device, Capture& capture)
+{
+    pollCapture(device, capture, UINT64_MAX);
+
+    {
+        std::lock_guard lock(capture.mutex);
+        capture.stop_encoder = true;
+    }
+    capture.cv.notify_one();
+    if (capture.encoder.joinable()) capture.encoder.join();
+
+    for (CaptureSlot& slot : capture.slots) {
+        destroySlot(device, slot);
+    }
+    capture.slots.clear();
+    capture.free_pixel_buffers.clear();
+}
+
+void flushCapture(const Device& device, Capture& capture)
+{
+    pollCapture(device, capture, UINT64_MAX);
+
+    std::unique_lock lock(capture.mutex);
+    capture.idle_cv.wait(lock, [&capture] { return capture.jobs_outstanding == 0; });
+}
+
+bool captureSlotAvailable(Capture& capture)
+{
+    if (!capture.supported || capture.slots.empty()) return false;
+    std::lock_guard lock(capture.mutex);
+    return capture.slots[capture.next_slot].state == CaptureSlotState::Free;
+}
+
+bool recordCaptureCopy(const Device& device, Capture& capture, VkCommandBuffer cmd, VkImage image, VkExtent2D extent, uint64_t frame)
+{
+    if (!captureSlotAvailable(capture)) {
+        capture.frames_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    CaptureSlot& slot = capture.slots[capture.next_slot];
+    capture.next_slot = (capture.next_slot + 1) % static_cast<uint32_t>(capture.slots.size());
+
+    // the slot is idle so it is safe to reallocate it if the image has grown
+    const VkDeviceSize required_size = static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+    if (slot.size < required_size) {
+        destroySlot(device, slot);
+        allocateSlot(device, slot, required_size);
+    }
+
+    VkBufferImageCopy region{};
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0; // tightly packed
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = VkOffset3D{0, 0, 0};
+    region.imageExtent = VkExtent3D{extent.width, extent.height, 1};
+    vkCmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer, 1, &region);
+
+    // make the copy visible to host reads once the frame's fence has been waited on
+    VkBufferMemoryBarrier2 buffer_barrier{};
+    buffer_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+    buffer_barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    buffer_barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    buffer_barrier.dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT;
+    buffer_barrier.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT;
+    buffer_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    buffer_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    buffer_barrier.buffer = slot.buffer;
+    buffer_barrier.offset = 0;
+    buffer_barrier.size = VK_WHOLE_SIZE;
+    VkDependencyInfo dependency_info{};
+    dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependency_info.bufferMemoryBarrierCount = 1;
+    dependency_info.pBufferMemoryBarriers = &buffer_barrier;
+    vkCmdPipelineBarrier2(cmd, &dependency_info);
+
+    slot.frame = frame;
+    slot.extent = extent;
+    std::lock_guard lock(capture.mutex);
+    slot.state = CaptureSlotState::Copying;
+    return true;
+}
+
+void pollCapture(const Device& device, Capture& capture, uint64_t retired_frame_count)
+{
+    bool queued = false;
+    std::lock_guard lock(capture.mutex);
+    // walk the ring from the oldest slot so stream formats get frames in order
+    for (size_t i = 0; i < capture.slots.size(); ++i) {
+        const uint32_t slot_index = static_cast<uint32_t>((capture.next_slot + i) % capture.slots.size());
+        CaptureSlot& slot = capture.slots[slot_index];
+        if (slot.state != CaptureSlotState::Copying || slot.frame >= retired_frame_count) continue;
+
+        if (!slot.coherent) {
+            VkMappedMemoryRange range{};
+            range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+            // all of it, offsets within a shared block need not be multiples of nonCoherentAtomSize and only readback buffers share it
+            range.memory = slot.allocation.memory;
+            range.offset = 0;
+            range.size = VK_WHOLE_SIZE;
+            VKCHECK(vkInvalidateMappedMemoryRanges(device.device, 1, &range));
+        }
+
+        // the slot stays busy until the encoder has copied the pixels out, so a slow encoder drops frames in recordCaptureCopy()
+        slot.state = CaptureSlotState::Encoding;
+        CaptureJob job{};
+        job.extent = slot.extent;
+        job.frame = slot.frame;
+        job.slot = slot_index;
+        capture.pending_jobs.push_back(std::move(job));
+        ++capture.jobs_outstanding;
+        queued = true;
+    }
+    if (queued) capture.cv.notify_one();
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "vulkan_headers.h"
+#include "vulkan_memory.h"
+
+struct Device;
+
+enum class CaptureFormat {
+    PNG, // one file per frame
+    RAW, // tightly packed RGBA frames appended to a single stream
+    Y4M, // YUV4MPEG2 stream
+};
+
+struct CaptureJob;
+
+struct CaptureSettings {
+    CaptureFormat format = CaptureFormat::PNG;
+    std::function<void(const CaptureJob& job)> callback{}; // if set, frames go here (on the encoder thread) instead of to disk
+    std::string path_prefix = "capture";
+    uint32_t slot_count = 3; // number of readback buffers in the ring
+    uint32_t fps = 60;       // frame rate written into Y4M stream headers
+};
+
+enum class CaptureSlotState {
+    Free,
+    Copying,  // the frame that records the copy has not retired yet
+    Encoding, // handed to the encoder thread, which frees it once it has copied the pixels out
+};
+
+// A readback buffer that a frame is copied into.
+// It is only read on the CPU once the frame that recorded the copy has retired.
+struct CaptureSlot {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    MemoryAllocation allocation{};
+    VkDeviceSize size = 0;
+    void* mapped = nullptr;
+    bool coherent = false;
+    CaptureSlotState state = CaptureSlotState::Free; // guarded by Capture::mutex
+    uint64_t frame = 0;
+    VkExtent2D extent{};
+};
+
+struct CaptureJob {
+    std::vector<uint8_t> rgba{}; // filled from the slot by the encoder thread
+    VkExtent2D extent{};
+    uint64_t frame = 0;
+    uint32_t slot = 0;
+};
+
+struct Capture {
+    CaptureSettings settings{};
+    bool supported = false;   // false if the image format or usage does not allow readback
+    bool swizzle_bgr = false; // swapchain images are usually BGRA
+
+    std::vector<CaptureSlot> slots{};
+    uint32_t next_slot = 0;
+
+    // encoder thread, fed through pending_jobs
+    std::thread encoder{};
+    std::mutex mutex{};
+    std::condition_variable cv{};
+    std::deque<CaptureJob> pending_jobs{};
+    std::vector<std::vector<uint8_t>> free_pixel_buffers{}; // recycled by the encoder, only it touches them
+    bool stop_encoder = false;
+    size_t jobs_outstanding = 0; // queued or being encoded
+    std::condition_variable idle_cv{};
+
+    std::atomic<uint64_t> frames_written = 0;
+    std::atomic<uint64_t> frames_dropped = 0;
+    std::atomic<uint64_t> write_failures = 0;
+};
+
+void createCapture(const Device& device, VkFormat format, VkImageUsageFlags image_usage, const CaptureSettings& settings, Capture& capture);
+
+// Flushes every outstanding readback to the encoder and waits for it to finish. The device must be idle.
+void destroyCapture(const Device& device, Capture& capture);
+
+// Hands every outstanding readback to the encoder and waits until they have all been written. The device must be idle.
+void flushCapture(const Device& device, Capture& capture);
+
+// true if a readback buffer is free to record a copy into this frame
+bool captureSlotAvailable(Capture& capture);
+
+// Records a copy of image (which must be in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) into the next readback buffer.
+// Returns false and counts a dropped frame if no buffer is free.
+bool recordCaptureCopy(const Device& device, Capture& capture, VkCommandBuffer cmd, VkImage image, VkExtent2D extent, uint64_t frame);
+
+// Hands every readback whose frame number is below retired_frame_count to the encoder thread, which copies the pixels out of the
+// readback buffer itself. Never waits on the GPU or the encoder.
+void pollCapture(const Device& device, Capture& capture, uint64_t retired_frame_count);
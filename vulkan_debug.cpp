@@ -0,0 +1,197 @@
+#include "vulkan_debug.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "error.h"
+#include "platform.h"
+
+const char* vulkanResultName(VkResult result)
+{
+    switch (result) {
+        case VK_SUCCESS:
+            return "VK_SUCCESS";
+        case VK_NOT_READY:
+            return "VK_NOT_READY";
+        case VK_TIMEOUT:
+            return "VK_TIMEOUT";
+        case VK_EVENT_SET:
+            return "VK_EVENT_SET";
+        case VK_EVENT_RESET:
+            return "VK_EVENT_RESET";
+        case VK_INCOMPLETE:
+            return "VK_INCOMPLETE";
+        case VK_ERROR_OUT_OF_HOST_MEMORY:
+            return "VK_ERROR_OUT_OF_HOST_MEMORY";
+        case VK_ERROR_OUT_OF_DEVICE_MEMORY:
+            return "VK_ERROR_OUT_OF_DEVICE_MEMORY";
+        case VK_ERROR_INITIALIZATION_FAILED:
+            return "VK_ERROR_INITIALIZATION_FAILED";
+        case VK_ERROR_DEVICE_LOST:
+            return "VK_ERROR_DEVICE_LOST";
+        case VK_ERROR_MEMORY_MAP_FAILED:
+            return "VK_ERROR_MEMORY_MAP_FAILED";
+        case VK_ERROR_LAYER_NOT_PRESENT:
+            return "VK_ERROR_LAYER_NOT_PRESENT";
+        case VK_ERROR_EXTENSION_NOT_PRESENT:
+            return "VK_ERROR_EXTENSION_NOT_PRESENT";
+        case VK_ERROR_FEATURE_NOT_PRESENT:
+            return "VK_ERROR_FEATURE_NOT_PRESENT";
+        case VK_ERROR_INCOMPATIBLE_DRIVER:
+            return "VK_ERROR_INCOMPATIBLE_DRIVER";
+        case VK_ERROR_TOO_MANY_OBJECTS:
+            return "VK_ERROR_TOO_MANY_OBJECTS";
+        case VK_ERROR_FORMAT_NOT_SUPPORTED:
+            return "VK_ERROR_FORMAT_NOT_SUPPORTED";
+        case VK_ERROR_FRAGMENTED_POOL:
+            return "VK_ERROR_FRAGMENTED_POOL";
+        case VK_ERROR_UNKNOWN:
+            return "VK_ERROR_UNKNOWN";
+        case VK_ERROR_OUT_OF_POOL_MEMORY:
+            return "VK_ERROR_OUT_OF_POOL_MEMORY";
+        case VK_ERROR_INVALID_EXTERNAL_HANDLE:
+            return "VK_ERROR_INVALID_EXTERNAL_HANDLE";
+        case VK_ERROR_FRAGMENTATION:
+            return "VK_ERROR_FRAGMENTATION";
+        case VK_ERROR_INVALID_OPAQUE_CAPTURE_ADDRESS:
+            return "VK_ERROR_INVALID_OPAQUE_CAPTURE_ADDRESS";
+        case VK_PIPELINE_COMPILE_REQUIRED:
+            return "VK_PIPELINE_COMPILE_REQUIRED";
+        case VK_ERROR_SURFACE_LOST_KHR:
+            return "VK_ERROR_SURFACE_LOST_KHR";
+        case VK_ERROR_NATIVE_WINDOW_IN_USE_KHR:
+            return "VK_ERROR_NATIVE_WINDOW_IN_USE_KHR";
+        case VK_SUBOPTIMAL_KHR:
+            return "VK_SUBOPTIMAL_KHR";
+        case VK_ERROR_OUT_OF_DATE_KHR:
+            return "VK_ERROR_OUT_OF_DATE_KHR";
+        case VK_ERROR_INCOMPATIBLE_DISPLAY_KHR:
+            return "VK_ERROR_INCOMPATIBLE_DISPLAY_KHR";
+        case VK_ERROR_VALIDATION_FAILED_EXT:
+            return "VK_ERROR_VALIDATION_FAILED_EXT";
+        case VK_ERROR_FULL_SCREEN_EXCLUSIVE_MODE_LOST_EXT:
+            return "VK_ERROR_FULL_SCREEN_EXCLUSIVE_MODE_LOST_EXT";
+        default:
+            return "unknown VkResult";
+    }
+}
+
+void throwVulkanError(VkResult result, const char* file, int line, const char* function)
+{
+    // __FILE__ can be a full path
+    const char* file_name = file;
+    for (const char* c = file; *c != '\0'; ++c) {
+        if (*c == '/' || *c == '\\') file_name = c + 1;
+    }
+    throw VulkanError(result, std::string(vulkanResultName(result)) + " (" + std::to_string(static_cast<int>(result)) + ") in " + function + " at " +
+                                  file_name + ":" + std::to_string(line));
+}
+
+#if VULKAN_DEBUG
+
+static bool debug_utils = false; // VK_EXT_debug_utils was enabled on the instance, set once before any device exists
+
+static bool layerAvailable(const char* name)
+{
+    uint32_t count = 0;
+    if (vkEnumerateInstanceLayerProperties(&count, nullptr) != VK_SUCCESS) return false;
+    std::vector<VkLayerProperties> layers(count);
+    if (vkEnumerateInstanceLayerProperties(&count, layers.data()) != VK_SUCCESS) return false;
+    for (const VkLayerProperties& layer : layers) {
+        if (std::strcmp(layer.layerName, name) == 0) return true;
+    }
+    return false;
+}
+
+// by the loader, or by layer if it is not nullptr
+static bool instanceExtensionAvailable(const char* layer, const char* name)
+{
+    uint32_t count = 0;
+    if (vkEnumerateInstanceExtensionProperties(layer, &count, nullptr) != VK_SUCCESS) return false;
+    std::vector<VkExtensionProperties> extensions(count);
+    if (vkEnumerateInstanceExtensionProperties(layer, &count, extensions.data()) != VK_SUCCESS) return false;
+    for (const VkExtensionProperties& extension : extensions) {
+        if (std::strcmp(extension.extensionName, name) == 0) return true;
+    }
+    return false;
+}
+
+void addDebugLayersAndExtensions(std::vector<const char*>& layers, std::vector<const char*>& extensions)
+{
+    constexpr const char* VALIDATION_LAYER = "VK_LAYER_KHRONOS_validation";
+    const bool validation = layerAvailable(VALIDATION_LAYER);
+    if (validation) {
+        layers.push_back(VALIDATION_LAYER);
+    }
+    else {
+        printDebug("VK_LAYER_KHRONOS_validation is not installed, running without validation\n");
+    }
+
+    debug_utils = instanceExtensionAvailable(nullptr, VK_EXT_DEBUG_UTILS_EXTENSION_NAME) ||
+                  (validation && instanceExtensionAvailable(VALIDATION_LAYER, VK_EXT_DEBUG_UTILS_EXTENSION_NAME));
+    if (debug_utils) extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+}
+
+static VKAPI_ATTR VkBool32 VKAPI_CALL debugMessengerCallback(VkDebugUtilsMessageSeverityFlagBitsEXT severity, VkDebugUtilsMessageTypeFlagsEXT,
+                                                             const VkDebugUtilsMessengerCallbackDataEXT* data, void*)
+{
+    const char* prefix = "validation warning";
+    if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) prefix = "validation error";
+    else if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT) prefix = "validation info";
+
+    // printDebug() does not allocate, so messages are cut short rather than copied into a string
+    std::array<char, 2048> buf{};
+    snprintf(buf.data(), buf.size(), "%s: %s\n", prefix, data->pMessage);
+    printDebug(buf.data());
+    return VK_FALSE; // the call that caused it goes ahead
+}
+
+VkDebugUtilsMessengerEXT createDebugMessenger(VkInstance instance)
+{
+    if (!debug_utils) return VK_NULL_HANDLE;
+    VkDebugUtilsMessengerCreateInfoEXT messenger_info{};
+    messenger_info.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
+    messenger_info.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+    messenger_info.messageType =
+        VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+    messenger_info.pfnUserCallback = debugMessengerCallback;
+    VkDebugUtilsMessengerEXT messenger = VK_NULL_HANDLE;
+    VKCHECK(vkCreateDebugUtilsMessengerEXT(instance, &messenger_info, nullptr, &messenger));
+    return messenger;
+}
+
+void destroyDebugMessenger(VkInstance instance, VkDebugUtilsMessengerEXT messenger)
+{
+    if (messenger != VK_NULL_HANDLE) vkDestroyDebugUtilsMessengerEXT(instance, messenger, nullptr);
+}
+
+void nameObjectHandle(VkDevice device, VkObjectType type, uint64_t handle, const char* name)
+{
+    if (!debug_utils || handle == 0) return;
+    VkDebugUtilsObjectNameInfoEXT name_info{};
+    name_info.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
+    name_info.objectType = type;
+    name_info.objectHandle = handle;
+    name_info.pObjectName = name;
+    VKCHECK(vkSetDebugUtilsObjectNameEXT(device, &name_info));
+}
+
+void beginDebugLabel(VkCommandBuffer cmd, const char* name)
+{
+    if (!debug_utils) return;
+    VkDebugUtilsLabelEXT label{};
+    label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+    label.pLabelName = name;
+    vkCmdBeginDebugUtilsLabelEXT(cmd, &label);
+}
+
+void endDebugLabel(VkCommandBuffer cmd)
+{
+    if (debug_utils) vkCmdEndDebugUtilsLabelEXT(cmd);
+}
+
+#endif
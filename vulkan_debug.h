@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+
+#include <type_traits>
+#include <vector>
+
+#include "vulkan_headers.h"
+
+// VULKAN_DEBUG turns on the validation layer and VK_EXT_debug_utils where they are installed. Validation messages go to printDebug(),
+// objects get names and command buffers get a label around each pass, so GPU captures (RenderDoc, Nsight, RGP) show what is what.
+// It defaults to on in debug builds and off with NDEBUG, where everything below compiles to nothing. Define it to 1 to get the
+// names and labels into an optimised build for profiling.
+#ifndef VULKAN_DEBUG
+#ifdef NDEBUG
+#define VULKAN_DEBUG 0
+#else
+#define VULKAN_DEBUG 1
+#endif
+#endif
+
+#if VULKAN_DEBUG
+
+// Called by initVulkanInstance(). Adds whichever of the validation layer and VK_EXT_debug_utils are installed.
+void addDebugLayersAndExtensions(std::vector<const char*>& layers, std::vector<const char*>& extensions);
+// Once the instance's functions are loaded. VK_NULL_HANDLE without VK_EXT_debug_utils.
+VkDebugUtilsMessengerEXT createDebugMessenger(VkInstance instance);
+void destroyDebugMessenger(VkInstance instance, VkDebugUtilsMessengerEXT messenger);
+
+void nameObjectHandle(VkDevice device, VkObjectType type, uint64_t handle, const char* name);
+// Labels nest, every begin needs an end in the same command buffer
+void beginDebugLabel(VkCommandBuffer cmd, const char* name);
+void endDebugLabel(VkCommandBuffer cmd);
+
+#else
+
+inline void addDebugLayersAndExtensions(std::vector<const char*>&, std::vector<const char*>&) {}
+inline VkDebugUtilsMessengerEXT createDebugMessenger(VkInstance) { return VK_NULL_HANDLE; }
+inline void destroyDebugMessenger(VkInstance, VkDebugUtilsMessengerEXT) {}
+
+inline void nameObjectHandle(VkDevice, VkObjectType, uint64_t, const char*) {}
+inline void beginDebugLabel(VkCommandBuffer, const char*) {}
+inline void endDebugLabel(VkCommandBuffer) {}
+
+#endif
+
+// handle is any Vulkan handle of type, dispatchable or not. The name is copied.
+template <typename Handle>
+inline void nameObject([[maybe_unused]] VkDevice device, [[maybe_unused]] VkObjectType type, [[maybe_unused]] Handle handle,
+                       [[maybe_unused]] const char* name)
+{
+#if VULKAN_DEBUG
+    if constexpr (std::is_pointer_v<Handle>) {
+        nameObjectHandle(device, type, reinterpret_cast<uint64_t>(handle), name);
+    }
+    else {
+        nameObjectHandle(device, type, static_cast<uint64_t>(handle), name);
+    }
+#endif
+}
@@ -0,0 +1,94 @@
+#include "vulkan_depth_pyramid.h"
+
+#include <algorithm>
+#include <array>
+
+#include "error.h"
+#include "vulkan_device.h"
+
+static uint32_t previousPowerOfTwo(uint32_t x)
+{
+    uint32_t power = 1;
+    while (power * 2 <= x) power *= 2;
+    return power;
+}
+
+void createDepthPyramid(const Device& device, const Image& depth_image, DepthPyramid& pyramid)
+{
+    const VkExtent2D extent{previousPowerOfTwo(std::max(depth_image.extent.width, 1u)), previousPowerOfTwo(std::max(depth_image.extent.height, 1u))};
+    uint32_t levels = 1;
+    while ((std::max(extent.width, extent.height) >> levels) > 0 && levels < DEPTH_PYRAMID_MAX_LEVELS) ++levels;
+
+    createImage(device, VK_FORMAT_R32_SFLOAT, extent, levels, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                VK_IMAGE_ASPECT_COLOR_BIT, MemoryCategory::Culling, pyramid.image);
+    nameImage(device, pyramid.image, "depth pyramid");
+    for (uint32_t level = 0; level < DEPTH_PYRAMID_MAX_LEVELS; ++level) {
+        pyramid.level_views[level] = createImageView(device, pyramid.image, VK_IMAGE_ASPECT_COLOR_BIT, std::min(level, levels - 1), 1);
+    }
+    pyramid.depth_view = createImageView(device, depth_image, VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1);
+
+    createBuffer(device, sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, MemoryCategory::Culling, pyramid.counter);
+    nameBuffer(device, pyramid.counter, "depth pyramid counter");
+}
+
+void destroyDepthPyramid(const Device& device, DepthPyramid& pyramid)
+{
+    destroyBuffer(device, pyramid.counter);
+    vkDestroyImageView(device.device, pyramid.depth_view, nullptr);
+    for (VkImageView view : pyramid.level_views) {
+        vkDestroyImageView(device.device, view, nullptr);
+    }
+    destroyImage(device, pyramid.image);
+    pyramid = DepthPyramid{};
+}
+
+void writeDepthPyramidDescriptors(const Device& device, const DepthPyramid& pyramid, VkSampler sampler, VkDescriptorSet build_set,
+                                  VkDescriptorSet frame_set)
+{
+    VkDescriptorImageInfo depth_info{};
+    depth_info.sampler = sampler;
+    depth_info.imageView = pyramid.depth_view;
+    depth_info.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+    std::array<VkDescriptorImageInfo, DEPTH_PYRAMID_MAX_LEVELS> level_infos{};
+    for (uint32_t level = 0; level < DEPTH_PYRAMID_MAX_LEVELS; ++level) {
+        level_infos[level].sampler = VK_NULL_HANDLE;
+        level_infos[level].imageView = pyramid.level_views[level];
+        level_infos[level].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    }
+
+    VkDescriptorImageInfo pyramid_info{};
+    pyramid_info.sampler = sampler;
+    pyramid_info.imageView = pyramid.image.view;
+    pyramid_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    std::array<VkWriteDescriptorSet, 3> writes{};
+    for (VkWriteDescriptorSet& write : writes) {
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstArrayElement = 0;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    }
+    writes[0].dstSet = build_set;
+    writes[0].dstBinding = 0;
+    writes[0].pImageInfo = &depth_info;
+    writes[1].dstSet = build_set;
+    writes[1].dstBinding = 1;
+    writes[1].descriptorCount = DEPTH_PYRAMID_MAX_LEVELS;
+    writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    writes[1].pImageInfo = level_infos.data();
+    writes[2].dstSet = frame_set;
+    writes[2].dstBinding = 1;
+    writes[2].pImageInfo = &pyramid_info;
+
+    // without a build set only the culling shaders' binding is written, they never sample it with occlusion culling off
+    const uint32_t first_write = build_set == VK_NULL_HANDLE ? 2 : 0;
+    vkUpdateDescriptorSets(device.device, static_cast<uint32_t>(writes.size()) - first_write, writes.data() + first_write, 0, nullptr);
+}
+
+VkExtent2D depthPyramidDispatchSize(const DepthPyramid& pyramid)
+{
+    return VkExtent2D{(pyramid.image.extent.width + DEPTH_PYRAMID_TILE - 1) / DEPTH_PYRAMID_TILE,
+                      (pyramid.image.extent.height + DEPTH_PYRAMID_TILE - 1) / DEPTH_PYRAMID_TILE};
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <array>
+
+#include "vulkan_headers.h"
+#include "vulkan_buffer.h"
+#include "vulkan_image.h"
+#include "vulkan_pipeline.h"
+
+struct Device;
+
+// Hierarchical Z for occlusion culling, built from the depth buffer by depth_pyramid.comp. Level 0 is the largest power of two size
+// that fits in the depth buffer, and each texel of each level holds the farthest (smallest, reversed Z) depth of the part of the
+// depth buffer it covers, so anything nearer than that is in front of everything there.
+struct DepthPyramid {
+    Image image{};                                                   // R32_SFLOAT, kept in VK_IMAGE_LAYOUT_GENERAL once built
+    std::array<VkImageView, DEPTH_PYRAMID_MAX_LEVELS> level_views{}; // one level each, the views past the last level repeat it
+    VkImageView depth_view = VK_NULL_HANDLE;                         // the depth aspect alone, combined formats cannot be sampled whole
+    Buffer counter{};                                                // uint32_t, depth_pyramid.comp's finished workgroups
+};
+
+// depth_image needs VK_IMAGE_USAGE_SAMPLED_BIT. The pyramid's contents are undefined until it is first built.
+void createDepthPyramid(const Device& device, const Image& depth_image, DepthPyramid& pyramid);
+void destroyDepthPyramid(const Device& device, DepthPyramid& pyramid);
+
+// Points depth_pyramid.comp's set at the depth buffer and the levels, and binding 1 of the frame set at the whole pyramid.
+// sampler must use nearest filtering, the shaders only use texelFetch().
+void writeDepthPyramidDescriptors(const Device& device, const DepthPyramid& pyramid, VkSampler sampler, VkDescriptorSet build_set,
+                                  VkDescriptorSet frame_set);
+
+// workgroups of one build
+VkExtent2D depthPyramidDispatchSize(const DepthPyramid& pyramid);
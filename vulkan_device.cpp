@@ -1,8 +1,21 @@
 #include "vulkan_device.h"
 
+#include <cstring>
+
 #include <vector>
 
 #include "error.h"
+#include "vulkan_memory.h"
+
+static bool extensionAvailable(const std::vector<VkExtensionProperties>& availableExts, const char* extToFind)
+{
+    for (const auto& ext : availableExts) {
+        if (strcmp(extToFind, ext.extensionName) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
 
 static VkPhysicalDevice getPhysicalDevice(VkInstance instance)
 {
@@ -20,7 +33,7 @@ static VkPhysicalDevice getPhysicalDevice(VkInstance instance)
     return VK_NULL_HANDLE;
 }
 
-Device createVulkanDevice(VkInstance instance)
+Device createVulkanDevice(VkInstance instance, bool headless)
 {
     Device device{};
     device.physicalDevice = getPhysicalDevice(instance);
@@ -36,28 +49,42 @@ Device createVulkanDevice(VkInstance instance)
         VKCHECK(vkEnumerateDeviceExtensionProperties(device.physicalDevice, nullptr, &availableExtCount, availableExts.data()));
     }
 
-    const std::vector<const char*> requiredExtensions{VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+    std::vector<const char*> requiredExtensions{};
+    if (!headless) {
+        requiredExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
 
     { // check for required extensions
-        bool foundExtensions = true;
         for (const char* extToFind : requiredExtensions) {
-            bool extFound = false;
-            for (const auto& ext : availableExts) {
-                if (strcmp(extToFind, ext.extensionName) == 0) {
-                    extFound = true;
-                    break;
-                }
-            }
-            if (!extFound) {
-                foundExtensions = false;
-                break;
-            }
+            if (!extensionAvailable(availableExts, extToFind)) throw Error("Missing required extensions!");
         }
-        if (!foundExtensions) throw Error("Missing required extensions!");
     }
 
-    VkPhysicalDeviceProperties devProps{};
-    vkGetPhysicalDeviceProperties(device.physicalDevice, &devProps);
+    // optional extensions
+    // present wait tells us when a frame has actually been shown, used to measure input to photon latency
+    const bool presentWaitAvailable = !headless && extensionAvailable(availableExts, VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+                                      extensionAvailable(availableExts, VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+    // task and mesh shaders cull meshlets without a separate compute pass
+    const bool meshShaderAvailable = extensionAvailable(availableExts, VK_EXT_MESH_SHADER_EXTENSION_NAME);
+    // pipelines are linked from separately compiled parts instead of each being compiled whole
+    const bool pipelineLibraryAvailable = extensionAvailable(availableExts, VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) &&
+                                          extensionAvailable(availableExts, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+    // how much memory can be used before the driver starts evicting, and what to evict first
+    device.memoryBudget = extensionAvailable(availableExts, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    const bool memoryPriorityAvailable = extensionAvailable(availableExts, VK_EXT_MEMORY_PRIORITY_EXTENSION_NAME);
+
+    VkPhysicalDeviceDepthStencilResolveProperties depthResolveProps{};
+    depthResolveProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DEPTH_STENCIL_RESOLVE_PROPERTIES;
+    VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT pipelineLibraryProps{};
+    pipelineLibraryProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT;
+    pipelineLibraryProps.pNext = &depthResolveProps;
+    VkPhysicalDeviceProperties2 devProps2{};
+    devProps2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    devProps2.pNext = pipelineLibraryAvailable ? static_cast<void*>(&pipelineLibraryProps) : static_cast<void*>(&depthResolveProps);
+    vkGetPhysicalDeviceProperties2(device.physicalDevice, &devProps2);
+    const VkPhysicalDeviceProperties& devProps = devProps2.properties;
+    // reversed Z, the minimum is the farthest
+    device.depthResolveMin = (depthResolveProps.supportedDepthResolveModes & VK_RESOLVE_MODE_MIN_BIT) != 0;
 
     { // check that device supports vulkan 1.3
         if (devProps.apiVersion < VK_API_VERSION_1_3) {
@@ -66,26 +93,54 @@ Device createVulkanDevice(VkInstance instance)
     }
 
     { // check features
+        VkPhysicalDeviceBufferDeviceAddressFeatures bufferDeviceAddressFeatures{};
+        bufferDeviceAddressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
         VkPhysicalDeviceDynamicRenderingFeatures dynamicRenderingFeatures{};
         dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
+        dynamicRenderingFeatures.pNext = &bufferDeviceAddressFeatures;
         VkPhysicalDeviceMemoryPriorityFeaturesEXT memoryPriorityFeatures{};
         memoryPriorityFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PRIORITY_FEATURES_EXT;
         memoryPriorityFeatures.pNext = &dynamicRenderingFeatures;
         VkPhysicalDeviceSynchronization2Features synchronization2Features{};
         synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES;
         synchronization2Features.pNext = &memoryPriorityFeatures;
+        VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+        presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+        presentIdFeatures.pNext = &synchronization2Features;
+        VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+        presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+        presentWaitFeatures.pNext = &presentIdFeatures;
+        VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures{};
+        meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+        meshShaderFeatures.pNext = presentWaitAvailable ? static_cast<void*>(&presentWaitFeatures) : static_cast<void*>(&synchronization2Features);
+        VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT pipelineLibraryFeatures{};
+        pipelineLibraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+        pipelineLibraryFeatures.pNext = meshShaderAvailable ? static_cast<void*>(&meshShaderFeatures) : meshShaderFeatures.pNext;
         VkPhysicalDeviceFeatures2 devFeatures{};
         devFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
-        devFeatures.pNext = &synchronization2Features;
+        devFeatures.pNext = pipelineLibraryAvailable ? static_cast<void*>(&pipelineLibraryFeatures) : pipelineLibraryFeatures.pNext;
         vkGetPhysicalDeviceFeatures2(device.physicalDevice, &devFeatures);
 
-        // we need dynamic_rendering and synchronization2
+        device.presentWait = presentWaitAvailable && presentIdFeatures.presentId == VK_TRUE && presentWaitFeatures.presentWait == VK_TRUE;
+        device.meshShader = meshShaderAvailable && meshShaderFeatures.taskShader == VK_TRUE && meshShaderFeatures.meshShader == VK_TRUE;
+        device.multiDrawIndirect = devFeatures.features.multiDrawIndirect == VK_TRUE;
+        device.storageImageArrayDynamicIndexing = devFeatures.features.shaderStorageImageArrayDynamicIndexing == VK_TRUE;
+        device.sampleRateShading = devFeatures.features.sampleRateShading == VK_TRUE;
+        device.memoryPriority = memoryPriorityAvailable && memoryPriorityFeatures.memoryPriority == VK_TRUE;
+        // without fast linking a linked pipeline costs about as much as a whole one, so the parts would gain nothing
+        device.graphicsPipelineLibrary = pipelineLibraryAvailable && pipelineLibraryFeatures.graphicsPipelineLibrary == VK_TRUE &&
+                                         pipelineLibraryProps.graphicsPipelineLibraryFastLinking == VK_TRUE;
+
+        // we need dynamic_rendering, synchronization2 and bufferDeviceAddress
         if (dynamicRenderingFeatures.dynamicRendering == VK_FALSE) {
             throw Error("Device feature dynamicRendering not available");
         }
         if (synchronization2Features.synchronization2 == VK_FALSE) {
             throw Error("Device feature synchronization2 not available");
         }
+        if (bufferDeviceAddressFeatures.bufferDeviceAddress == VK_FALSE) {
+            throw Error("Device feature bufferDeviceAddress not available");
+        }
     }
 
     // check for required formats here
@@ -102,16 +157,62 @@ Device createVulkanDevice(VkInstance instance)
     queueInfo.pQueuePriorities = &queuePriority;
 
     /* set enabled features */
+    VkPhysicalDeviceBufferDeviceAddressFeatures bufferDeviceAddressFeatures{};
+    bufferDeviceAddressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
+    bufferDeviceAddressFeatures.bufferDeviceAddress = VK_TRUE; // per-draw data is read through pointers into the stream buffer
     VkPhysicalDeviceDynamicRenderingFeatures dynamicRenderingFeatures{};
     dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
+    dynamicRenderingFeatures.pNext = &bufferDeviceAddressFeatures;
     dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+    VkPhysicalDeviceMemoryPriorityFeaturesEXT memoryPriorityFeatures{};
+    memoryPriorityFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PRIORITY_FEATURES_EXT;
+    memoryPriorityFeatures.pNext = &dynamicRenderingFeatures;
+    memoryPriorityFeatures.memoryPriority = VK_TRUE; // vulkan_memory.cpp gives each category of memory a priority
     VkPhysicalDeviceSynchronization2Features synchronization2Features{};
     synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES;
-    synchronization2Features.pNext = &dynamicRenderingFeatures;
+    synchronization2Features.pNext = device.memoryPriority ? static_cast<void*>(&memoryPriorityFeatures) : static_cast<void*>(&dynamicRenderingFeatures);
     synchronization2Features.synchronization2 = VK_TRUE;
+    VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+    presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    presentIdFeatures.pNext = &synchronization2Features;
+    presentIdFeatures.presentId = VK_TRUE;
+    VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+    presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+    presentWaitFeatures.pNext = &presentIdFeatures;
+    presentWaitFeatures.presentWait = VK_TRUE;
+    VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures{};
+    meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+    meshShaderFeatures.pNext = device.presentWait ? static_cast<void*>(&presentWaitFeatures) : static_cast<void*>(&synchronization2Features);
+    meshShaderFeatures.taskShader = VK_TRUE;
+    meshShaderFeatures.meshShader = VK_TRUE;
+    VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT pipelineLibraryFeatures{};
+    pipelineLibraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+    pipelineLibraryFeatures.pNext = device.meshShader ? static_cast<void*>(&meshShaderFeatures) : meshShaderFeatures.pNext;
+    pipelineLibraryFeatures.graphicsPipelineLibrary = VK_TRUE;
     VkPhysicalDeviceFeatures2 featuresToEnable{};
     featuresToEnable.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
-    featuresToEnable.pNext = &synchronization2Features;
+    featuresToEnable.pNext = device.graphicsPipelineLibrary ? static_cast<void*>(&pipelineLibraryFeatures) : pipelineLibraryFeatures.pNext;
+    featuresToEnable.features.multiDrawIndirect = device.multiDrawIndirect ? VK_TRUE : VK_FALSE; // meshlet culling without mesh shaders
+    featuresToEnable.features.shaderStorageImageArrayDynamicIndexing = device.storageImageArrayDynamicIndexing ? VK_TRUE : VK_FALSE; // occlusion culling
+    featuresToEnable.features.sampleRateShading = device.sampleRateShading ? VK_TRUE : VK_FALSE; // AntiAliasing::SampleShading
+
+    if (device.presentWait) {
+        requiredExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+        requiredExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+    }
+    if (device.meshShader) {
+        requiredExtensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+    }
+    if (device.graphicsPipelineLibrary) {
+        requiredExtensions.push_back(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+        requiredExtensions.push_back(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+    }
+    if (device.memoryBudget) {
+        requiredExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+    if (device.memoryPriority) {
+        requiredExtensions.push_back(VK_EXT_MEMORY_PRIORITY_EXTENSION_NAME);
+    }
 
     VkDeviceCreateInfo devInfo{};
     devInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -125,7 +226,26 @@ Device createVulkanDevice(VkInstance instance)
     devInfo.pEnabledFeatures = nullptr;
     VKCHECK(vkCreateDevice(device.physicalDevice, &devInfo, nullptr, &device.device));
     vkGetDeviceQueue(device.device, 0, 0, &device.queue);
+    device.properties = devProps;
+    vkGetPhysicalDeviceMemoryProperties(device.physicalDevice, &device.memoryProperties);
+    device.memory = createMemoryManager(device);
+    updateMemoryBudget(device);
     return device;
 }
 
-void destroyVulkanDevice(const Device& device) { vkDestroyDevice(device.device, nullptr); }
\ No newline at end of file
+void destroyVulkanDevice(const Device& device)
+{
+    destroyMemoryManager(device, device.memory);
+    vkDestroyDevice(device.device, nullptr);
+}
+
+bool findMemoryType(const Device& device, uint32_t typeBits, VkMemoryPropertyFlags properties, uint32_t& typeIndex)
+{
+    for (uint32_t i = 0; i < device.memoryProperties.memoryTypeCount; ++i) {
+        if ((typeBits & (1u << i)) && (device.memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            typeIndex = i;
+            return true;
+        }
+    }
+    return false;
+}
\ No newline at end of file
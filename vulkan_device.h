@@ -2,11 +2,29 @@
 
 #include "vulkan_headers.h"
 
+struct MemoryManager;
+
 struct Device {
 	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
 	VkDevice device = VK_NULL_HANDLE;
 	VkQueue queue = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties properties{};
+	VkPhysicalDeviceMemoryProperties memoryProperties{};
+	bool presentWait = false;                      // VK_KHR_present_id and VK_KHR_present_wait are enabled
+	bool meshShader = false;                       // VK_EXT_mesh_shader is enabled with task shaders
+	bool multiDrawIndirect = false;                // indirect draws with a drawCount above 1
+	bool storageImageArrayDynamicIndexing = false; // depth_pyramid.comp picks the level it writes at run time
+	bool sampleRateShading = false;                // the fragment shader can run per sample instead of per pixel
+	bool depthResolveMin = false;                  // multisampled depth can be resolved to its farthest sample, for the depth pyramid
+	bool graphicsPipelineLibrary = false;          // VK_EXT_graphics_pipeline_library is enabled and links fast
+	bool memoryBudget = false;                     // VK_EXT_memory_budget is enabled
+	bool memoryPriority = false;                   // VK_EXT_memory_priority is enabled
+	MemoryManager* memory = nullptr;               // every allocation goes through it, see vulkan_memory.h
 };
 
-Device createVulkanDevice(VkInstance instance);
-void destroyVulkanDevice(const Device& device);
\ No newline at end of file
+// VK_KHR_swapchain is not required for headless rendering
+Device createVulkanDevice(VkInstance instance, bool headless);
+void destroyVulkanDevice(const Device& device);
+
+// finds a memory type allowed by typeBits that has all the requested property flags
+bool findMemoryType(const Device& device, uint32_t typeBits, VkMemoryPropertyFlags properties, uint32_t& typeIndex);
\ No newline at end of file
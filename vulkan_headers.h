@@ -2,18 +2,68 @@
 
 #include <string>
 
+// window system integration for every platform the headers are available for, see platform.h
+#if defined(_WIN32)
 #define VK_USE_PLATFORM_WIN32_KHR
+#else
+// VULKANAPP_XCB and VULKANAPP_WAYLAND are 0 or 1 when the build chose (the CMake build sets both to what it found and links), otherwise
+// each is built if its header is there
+#ifdef VULKANAPP_XCB
+#if VULKANAPP_XCB
+#define VK_USE_PLATFORM_XCB_KHR
+#endif
+#elif __has_include(<xcb/xcb.h>)
+#define VK_USE_PLATFORM_XCB_KHR
+#endif
+#ifdef VULKANAPP_WAYLAND
+#if VULKANAPP_WAYLAND
+#define VK_USE_PLATFORM_WAYLAND_KHR
+#endif
+#elif __has_include(<wayland-client.h>)
+#define VK_USE_PLATFORM_WAYLAND_KHR
+#endif
+#endif
 #include "Volk/volk.h"
 
 #include "error.h"
 
-inline void checkVulkanError(VkResult errorCode, int lineNo)
+// "VK_ERROR_DEVICE_LOST" and so on, defined in vulkan_debug.cpp
+const char* vulkanResultName(VkResult result);
+
+// What VKCHECK throws, so a lost device or surface can be told apart from other errors and recovered from
+struct VulkanError : Error {
+    VulkanError(VkResult vk_result, const std::string& what) : Error(what), result(vk_result) {}
+    VkResult result;
+};
+
+// Throws a VulkanError naming the result and the function, file and line it came from. Out of line so each VKCHECK is only a compare and a
+// branch that is never taken.
+[[noreturn]] void throwVulkanError(VkResult result, const char* file, int line, const char* function);
+
+inline void checkVulkanError(VkResult result, const char* file, int line, const char* function)
 {
-    if (errorCode != VK_SUCCESS) {
-        const std::string message("VULKAN ERROR ON LINE " + std::to_string(lineNo));
-        throw Error(message.c_str());
+    if (result != VK_SUCCESS) [[unlikely]] {
+        throwVulkanError(result, file, line, function);
     }
 }
 
 #undef VKCHECK
-#define VKCHECK(ErrCode) checkVulkanError(ErrCode, __LINE__)
\ No newline at end of file
+#define VKCHECK(ErrCode) checkVulkanError(ErrCode, __FILE__, __LINE__, __func__)
+
+// The outcome of Vulkan calls on the frame path, where errors are returned rather than thrown so the render loop can rebuild a lost
+// device or surface in place. Success codes such as VK_SUBOPTIMAL_KHR are not failures.
+struct [[nodiscard]] VulkanStatus {
+    VkResult result = VK_SUCCESS;
+    const char* file = nullptr; // where the call that failed was made
+    int line = 0;
+    const char* function = nullptr;
+
+    bool ok() const { return result >= 0; }
+};
+
+// Returns a VulkanStatus from the calling function if ErrCode is an error
+#define VKTRY(ErrCode)                                                                                                                             \
+    do {                                                                                                                                           \
+        const VkResult vktry_result = (ErrCode);                                                                                                   \
+        if (vktry_result < 0) [[unlikely]] return VulkanStatus{vktry_result, __FILE__, __LINE__, __func__};                                        \
+    } while (false)
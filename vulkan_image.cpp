@@ -0,0 +1,100 @@
+#include "vulkan_image.h"
+
+#include <array>
+
+#include "error.h"
+#include "vulkan_debug.h"
+#include "vulkan_device.h"
+
+void createImage(const Device& device, VkFormat format, VkExtent2D extent, uint32_t levels, VkSampleCountFlagBits samples, VkImageUsageFlags usage,
+                 VkImageAspectFlags aspect, MemoryCategory category, Image& image)
+{
+    VkImageCreateInfo image_info{};
+    image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.format = format;
+    image_info.extent = VkExtent3D{extent.width, extent.height, 1};
+    image_info.mipLevels = levels;
+    image_info.arrayLayers = 1;
+    image_info.samples = samples;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.usage = usage;
+    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VKCHECK(vkCreateImage(device.device, &image_info, nullptr, &image.image));
+
+    VkMemoryRequirements reqs{};
+    vkGetImageMemoryRequirements(device.device, image.image, &reqs);
+    uint32_t memory_type = 0;
+    image.lazily_allocated = (usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) &&
+                             findMemoryType(device, reqs.memoryTypeBits, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, memory_type);
+    if (!image.lazily_allocated && !findMemoryType(device, reqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, memory_type)) {
+        throw Error("No device local memory type for image");
+    }
+    image.allocation = allocateMemory(device, reqs, memory_type, category, false);
+    VKCHECK(vkBindImageMemory(device.device, image.image, image.allocation.memory, image.allocation.offset));
+
+    image.format = format;
+    image.extent = extent;
+    image.levels = levels;
+    image.samples = samples;
+    image.memory_size = reqs.size;
+    image.view = createImageView(device, image, aspect, 0, levels);
+}
+
+void destroyImage(const Device& device, Image& image)
+{
+    if (image.image == VK_NULL_HANDLE) return;
+    vkDestroyImageView(device.device, image.view, nullptr);
+    vkDestroyImage(device.device, image.image, nullptr);
+    freeMemory(device, image.allocation);
+    image = Image{};
+}
+
+void nameImage(const Device& device, const Image& image, const char* name)
+{
+    nameObject(device.device, VK_OBJECT_TYPE_IMAGE, image.image, name);
+    nameObject(device.device, VK_OBJECT_TYPE_IMAGE_VIEW, image.view, name);
+}
+
+VkImageView createImageView(const Device& device, const Image& image, VkImageAspectFlags aspect, uint32_t first_level, uint32_t level_count)
+{
+    VkImageViewCreateInfo view_info{};
+    view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_info.image = image.image;
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format = image.format;
+    view_info.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+    view_info.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+    view_info.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+    view_info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+    view_info.subresourceRange.aspectMask = aspect;
+    view_info.subresourceRange.baseMipLevel = first_level;
+    view_info.subresourceRange.levelCount = level_count;
+    view_info.subresourceRange.baseArrayLayer = 0;
+    view_info.subresourceRange.layerCount = 1;
+    VkImageView view = VK_NULL_HANDLE;
+    VKCHECK(vkCreateImageView(device.device, &view_info, nullptr, &view));
+    return view;
+}
+
+VkFormat findDepthFormat(const Device& device)
+{
+    constexpr std::array<VkFormat, 4> candidates{VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_X8_D24_UNORM_PACK32,
+                                                 VK_FORMAT_D24_UNORM_S8_UINT};
+    for (VkFormat format : candidates) {
+        VkFormatProperties properties{};
+        vkGetPhysicalDeviceFormatProperties(device.physicalDevice, format, &properties);
+        constexpr VkFormatFeatureFlags required = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+        if ((properties.optimalTilingFeatures & required) == required) return format;
+    }
+    throw Error("No supported depth attachment format");
+}
+
+VkImageAspectFlags depthFormatAspect(VkFormat format)
+{
+    if (format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT) {
+        return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+    return VK_IMAGE_ASPECT_DEPTH_BIT;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "vulkan_headers.h"
+#include "vulkan_memory.h"
+
+struct Device;
+
+// Device local 2D image with one layer, and a view of all of it.
+struct Image {
+    VkImage image = VK_NULL_HANDLE;
+    VkImageView view = VK_NULL_HANDLE;
+    MemoryAllocation allocation{}; // dedicated
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkExtent2D extent{}; // of level 0
+    uint32_t levels = 0;
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+    VkDeviceSize memory_size = 0;  // allocated for it, only an upper bound if lazily_allocated
+    bool lazily_allocated = false; // transient attachments, the memory may only be committed as far as the device needs it
+};
+
+// Images with VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT get lazily allocated memory where the device has it.
+void createImage(const Device& device, VkFormat format, VkExtent2D extent, uint32_t levels, VkSampleCountFlagBits samples, VkImageUsageFlags usage,
+                 VkImageAspectFlags aspect, MemoryCategory category, Image& image);
+void destroyImage(const Device& device, Image& image);
+// Names the image and its view in debug builds, see vulkan_debug.h
+void nameImage(const Device& device, const Image& image, const char* name);
+
+// Another view of some of the image's levels or aspects, destroyed by the caller.
+VkImageView createImageView(const Device& device, const Image& image, VkImageAspectFlags aspect, uint32_t first_level, uint32_t level_count);
+
+// The first depth format the device can use as an optimally tiled depth attachment that can also be sampled. 32-bit float formats come first because
+// reversed Z relies on float precision being spread towards the far plane, a UNORM format is only used if neither is supported.
+VkFormat findDepthFormat(const Device& device);
+
+// depth, plus stencil for the combined formats findDepthFormat() can return, views and barriers of those must cover both
+VkImageAspectFlags depthFormatAspect(VkFormat format);
@@ -4,10 +4,12 @@
 #include "vulkan_headers.h"
 
 #include "error.h"
+#include "vulkan_debug.h"
 
+#include <string>
 #include <vector>
 
-VkInstance initVulkanInstance()
+VkInstance initVulkanInstance(const std::vector<const char*>& extensions)
 {
     VkApplicationInfo appInfo{};
     appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
@@ -18,8 +20,9 @@ VkInstance initVulkanInstance()
     appInfo.engineVersion = 0;
     appInfo.apiVersion = VK_API_VERSION_1_3;
 
-    const std::vector<const char*> extensions{VK_KHR_SURFACE_EXTENSION_NAME, VK_KHR_WIN32_SURFACE_EXTENSION_NAME};
-    const std::vector<const char*> layers{/*"VK_LAYER_KHRONOS_validation"*/};
+    std::vector<const char*> layers{};
+    std::vector<const char*> enabled_extensions = extensions;
+    addDebugLayersAndExtensions(layers, enabled_extensions); // nothing without VULKAN_DEBUG
 
     VkInstanceCreateInfo instInfo{};
     instInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -28,11 +31,12 @@ VkInstance initVulkanInstance()
     instInfo.pApplicationInfo = &appInfo;
     instInfo.enabledLayerCount = static_cast<uint32_t>(layers.size());
     instInfo.ppEnabledLayerNames = layers.data();
-    instInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
-    instInfo.ppEnabledExtensionNames = extensions.data();
+    instInfo.enabledExtensionCount = static_cast<uint32_t>(enabled_extensions.size());
+    instInfo.ppEnabledExtensionNames = enabled_extensions.data();
     VkInstance instance = VK_NULL_HANDLE;
-    if (vkCreateInstance(&instInfo, nullptr, &instance) != VK_SUCCESS) {
-        throw Error("Failed to created vulkan instance!");
+    const VkResult result = vkCreateInstance(&instInfo, nullptr, &instance);
+    if (result != VK_SUCCESS) {
+        throw Error(std::string("Failed to created vulkan instance! ") + vulkanResultName(result));
     }
 
     return instance;
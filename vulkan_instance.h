@@ -2,5 +2,8 @@
 
 #include "vulkan_headers.h"
 
-VkInstance initVulkanInstance();
+#include <vector>
+
+// extensions are the surface extensions of the window being presented to (see Window::requiredInstanceExtensions), none when headless
+VkInstance initVulkanInstance(const std::vector<const char*>& extensions);
 void destroyVulkanInstance(VkInstance instance);
\ No newline at end of file
@@ -0,0 +1,575 @@
+#include "vulkan_memory.h"
+
+#include <cinttypes>
+#include <cstddef>
+#include <cstdio>
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#include "error.h"
+#include "vulkan_buffer.h"
+#include "vulkan_debug.h"
+#include "vulkan_device.h"
+
+constexpr VkDeviceSize BLOCK_SIZE = VkDeviceSize{32} << 20;
+constexpr VkDeviceSize MAX_SHARED_SIZE = BLOCK_SIZE / 4;
+constexpr uint32_t MAX_MOVES_PER_FRAME = 16;
+constexpr size_t RESERVED_RANGES = 64; // per block, so moves seldom allocate on the render thread
+
+// the render targets are read and written the most per frame, readback and staging memory is barely touched by the GPU
+constexpr std::array<float, MEMORY_CATEGORY_COUNT> CATEGORY_PRIORITIES{0.75f, 0.75f, 0.75f, 1.0f, 0.5f, 0.25f, 0.25f};
+
+struct MemoryRange {
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+};
+
+struct MemoryBlock {
+    VkDeviceMemory memory = VK_NULL_HANDLE; // VK_NULL_HANDLE once freed, the slot is reused so block indices stay valid
+    VkDeviceSize size = 0;
+    VkDeviceSize used = 0;
+    void* mapped = nullptr;
+    uint32_t memory_type = 0;
+    MemoryCategory category = MemoryCategory::Mesh;
+    uint32_t allocations = 0;
+    std::vector<MemoryRange> free_ranges{}; // sorted by offset, neighbouring ranges are merged
+    std::vector<Buffer*> movable{};         // buffers registered by createBuffer(), defragmentMemory() moves them
+    bool evacuating = false;                // being emptied, nothing new is put in it
+};
+
+// A buffer moved from, kept until the frames that could still use it have finished. replacement is what it was moved to.
+struct RetiredBuffer {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    MemoryAllocation allocation{};
+    VkBuffer replacement = VK_NULL_HANDLE;
+    uint64_t frame = 0;
+};
+
+struct MemoryManager {
+    std::mutex mutex{};
+    bool budget = false;
+    bool priority = false;
+    std::vector<MemoryBlock> blocks{};
+    uint32_t dedicated = 0;
+    std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> allocated{};         // per heap
+    std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> used{};              // per heap
+    std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> heap_budget{};       // at the last poll
+    std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> heap_usage{};        // at the last poll
+    std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> allocated_at_poll{}; // so the usage can be estimated between polls
+    std::array<MemoryCategoryStats, MEMORY_CATEGORY_COUNT> categories{};
+    std::vector<RetiredBuffer> retired{};
+    uint32_t evacuating_block = UINT32_MAX;
+    uint64_t moves = 0;
+    VkDeviceSize bytes_moved = 0;
+};
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) { return (value + alignment - 1) & ~(alignment - 1); }
+
+static uint32_t heapIndex(const Device& device, uint32_t memory_type) { return device.memoryProperties.memoryTypes[memory_type].heapIndex; }
+
+const char* memoryCategoryName(MemoryCategory category)
+{
+    switch (category) {
+        case MemoryCategory::Mesh:
+            return "mesh";
+        case MemoryCategory::Entities:
+            return "entities";
+        case MemoryCategory::Culling:
+            return "culling";
+        case MemoryCategory::RenderTargets:
+            return "render_targets";
+        case MemoryCategory::Stream:
+            return "stream";
+        case MemoryCategory::Readback:
+            return "readback";
+        case MemoryCategory::Staging:
+            return "staging";
+    }
+    return "unknown";
+}
+
+MemoryManager* createMemoryManager(const Device& device)
+{
+    MemoryManager* manager = new MemoryManager{};
+    manager->budget = device.memoryBudget;
+    manager->priority = device.memoryPriority;
+    // at most MAX_MOVES_PER_FRAME moves and as many destroyed replacements for each frame in flight
+    manager->retired.reserve(MAX_MOVES_PER_FRAME * 8);
+    return manager;
+}
+
+void destroyMemoryManager(const Device& device, MemoryManager* manager)
+{
+    // the device is idle, whatever moves left behind can go
+    for (const RetiredBuffer& retired : manager->retired) {
+        vkDestroyBuffer(device.device, retired.buffer, nullptr);
+    }
+    for (const MemoryBlock& block : manager->blocks) {
+        if (block.memory != VK_NULL_HANDLE) vkFreeMemory(device.device, block.memory, nullptr);
+    }
+    delete manager;
+}
+
+// the caller holds the lock
+static VkDeviceMemory allocateDeviceMemory(const Device& device, MemoryManager& manager, VkDeviceSize size, uint32_t memory_type,
+                                           MemoryCategory category, bool buffer, void** mapped)
+{
+    // any buffer may be read through device addresses
+    VkMemoryAllocateFlagsInfo alloc_flags{};
+    alloc_flags.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO;
+    alloc_flags.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
+    VkMemoryPriorityAllocateInfoEXT priority_info{};
+    priority_info.sType = VK_STRUCTURE_TYPE_MEMORY_PRIORITY_ALLOCATE_INFO_EXT;
+    priority_info.pNext = buffer ? &alloc_flags : nullptr;
+    priority_info.priority = CATEGORY_PRIORITIES[static_cast<uint32_t>(category)];
+
+    VkMemoryAllocateInfo alloc_info{};
+    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloc_info.pNext = manager.priority ? static_cast<void*>(&priority_info) : priority_info.pNext;
+    alloc_info.allocationSize = size;
+    alloc_info.memoryTypeIndex = memory_type;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VKCHECK(vkAllocateMemory(device.device, &alloc_info, nullptr, &memory));
+    nameObject(device.device, VK_OBJECT_TYPE_DEVICE_MEMORY, memory, memoryCategoryName(category));
+
+    *mapped = nullptr;
+    if (device.memoryProperties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        VKCHECK(vkMapMemory(device.device, memory, 0, VK_WHOLE_SIZE, 0, mapped));
+    }
+    manager.allocated[heapIndex(device, memory_type)] += size;
+    return memory;
+}
+
+// first fit, keeping the free ranges sorted and merged
+static bool allocateFromBlock(MemoryBlock& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset)
+{
+    for (size_t i = 0; i < block.free_ranges.size(); ++i) {
+        const MemoryRange range = block.free_ranges[i];
+        const VkDeviceSize aligned = alignUp(range.offset, alignment);
+        if (aligned + size > range.offset + range.size) continue;
+
+        const MemoryRange before{range.offset, aligned - range.offset};
+        const MemoryRange after{aligned + size, range.offset + range.size - aligned - size};
+        if (before.size > 0 && after.size > 0) {
+            block.free_ranges[i] = before;
+            block.free_ranges.insert(block.free_ranges.begin() + static_cast<ptrdiff_t>(i) + 1, after);
+        }
+        else if (before.size > 0) {
+            block.free_ranges[i] = before;
+        }
+        else if (after.size > 0) {
+            block.free_ranges[i] = after;
+        }
+        else {
+            block.free_ranges.erase(block.free_ranges.begin() + static_cast<ptrdiff_t>(i));
+        }
+        offset = aligned;
+        block.used += size;
+        ++block.allocations;
+        return true;
+    }
+    return false;
+}
+
+static void freeToBlock(MemoryBlock& block, VkDeviceSize offset, VkDeviceSize size)
+{
+    auto next = std::lower_bound(block.free_ranges.begin(), block.free_ranges.end(), offset,
+                                 [](const MemoryRange& range, VkDeviceSize value) { return range.offset < value; });
+    const bool merge_previous = next != block.free_ranges.begin() && std::prev(next)->offset + std::prev(next)->size == offset;
+    const bool merge_next = next != block.free_ranges.end() && offset + size == next->offset;
+    if (merge_previous && merge_next) {
+        std::prev(next)->size += size + next->size;
+        block.free_ranges.erase(next);
+    }
+    else if (merge_previous) {
+        std::prev(next)->size += size;
+    }
+    else if (merge_next) {
+        next->offset = offset;
+        next->size += size;
+    }
+    else {
+        block.free_ranges.insert(next, MemoryRange{offset, size});
+    }
+    block.used -= size;
+    --block.allocations;
+}
+
+// from the blocks of the memory type and category that are not being emptied, the caller holds the lock
+static bool allocateFromBlocks(MemoryManager& manager, const VkMemoryRequirements& reqs, uint32_t memory_type, MemoryCategory category,
+                               MemoryAllocation& allocation)
+{
+    for (uint32_t i = 0; i < manager.blocks.size(); ++i) {
+        MemoryBlock& block = manager.blocks[i];
+        if (block.memory == VK_NULL_HANDLE || block.evacuating || block.memory_type != memory_type || block.category != category) continue;
+        if (block.size - block.used < reqs.size) continue;
+        VkDeviceSize offset = 0;
+        if (!allocateFromBlock(block, reqs.size, reqs.alignment, offset)) continue;
+
+        allocation.memory = block.memory;
+        allocation.offset = offset;
+        allocation.size = reqs.size;
+        allocation.mapped = block.mapped ? static_cast<std::byte*>(block.mapped) + offset : nullptr;
+        allocation.memory_type = memory_type;
+        allocation.block = i;
+        allocation.category = category;
+        return true;
+    }
+    return false;
+}
+
+MemoryAllocation allocateMemory(const Device& device, const VkMemoryRequirements& reqs, uint32_t memory_type, MemoryCategory category, bool buffer)
+{
+    MemoryManager& manager = *device.memory;
+    std::lock_guard lock(manager.mutex);
+
+    MemoryAllocation allocation{};
+    if (buffer && reqs.size <= MAX_SHARED_SIZE) {
+        if (!allocateFromBlocks(manager, reqs, memory_type, category, allocation)) {
+            auto slot = std::find_if(manager.blocks.begin(), manager.blocks.end(), [](const MemoryBlock& block) { return block.memory == VK_NULL_HANDLE; });
+            if (slot == manager.blocks.end()) slot = manager.blocks.emplace(manager.blocks.end());
+            MemoryBlock& block = *slot;
+            block = MemoryBlock{};
+            block.memory = allocateDeviceMemory(device, manager, BLOCK_SIZE, memory_type, category, true, &block.mapped);
+            block.size = BLOCK_SIZE;
+            block.memory_type = memory_type;
+            block.category = category;
+            block.free_ranges.reserve(RESERVED_RANGES);
+            block.free_ranges.push_back(MemoryRange{0, BLOCK_SIZE});
+            block.movable.reserve(RESERVED_RANGES);
+            allocateFromBlocks(manager, reqs, memory_type, category, allocation);
+        }
+    }
+    else {
+        allocation.memory = allocateDeviceMemory(device, manager, reqs.size, memory_type, category, buffer, &allocation.mapped);
+        allocation.size = reqs.size;
+        allocation.memory_type = memory_type;
+        allocation.category = category;
+        ++manager.dedicated;
+    }
+
+    manager.used[heapIndex(device, memory_type)] += allocation.size;
+    MemoryCategoryStats& category_stats = manager.categories[static_cast<uint32_t>(category)];
+    category_stats.bytes += allocation.size;
+    ++category_stats.allocations;
+    return allocation;
+}
+
+// the caller holds the lock
+static void releaseAllocation(const Device& device, MemoryManager& manager, const MemoryAllocation& allocation)
+{
+    const uint32_t heap = heapIndex(device, allocation.memory_type);
+    manager.used[heap] -= allocation.size;
+    MemoryCategoryStats& category_stats = manager.categories[static_cast<uint32_t>(allocation.category)];
+    category_stats.bytes -= allocation.size;
+    --category_stats.allocations;
+
+    if (allocation.block == UINT32_MAX) {
+        // freeing memory unmaps it
+        vkFreeMemory(device.device, allocation.memory, nullptr);
+        manager.allocated[heap] -= allocation.size;
+        --manager.dedicated;
+        return;
+    }
+
+    MemoryBlock& block = manager.blocks[allocation.block];
+    freeToBlock(block, allocation.offset, allocation.size);
+    if (block.allocations == 0) {
+        vkFreeMemory(device.device, block.memory, nullptr);
+        manager.allocated[heap] -= block.size;
+        if (manager.evacuating_block == allocation.block) manager.evacuating_block = UINT32_MAX;
+        block = MemoryBlock{};
+    }
+}
+
+void freeMemory(const Device& device, const MemoryAllocation& allocation)
+{
+    if (allocation.memory == VK_NULL_HANDLE) return;
+    std::lock_guard lock(device.memory->mutex);
+    releaseAllocation(device, *device.memory, allocation);
+}
+
+bool memoryWithinBudget(const Device& device, uint32_t memory_type, VkDeviceSize size)
+{
+    MemoryManager& manager = *device.memory;
+    std::lock_guard lock(manager.mutex);
+    const uint32_t heap = heapIndex(device, memory_type);
+    // what we allocated since the poll is the only change to the usage we know of
+    const VkDeviceSize usage = manager.heap_usage[heap] + manager.allocated[heap] - std::min(manager.allocated[heap], manager.allocated_at_poll[heap]);
+    return usage + size <= manager.heap_budget[heap];
+}
+
+void updateMemoryBudget(const Device& device)
+{
+    MemoryManager& manager = *device.memory;
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_props{};
+    budget_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    VkPhysicalDeviceMemoryProperties2 memory_props{};
+    memory_props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    if (manager.budget) {
+        memory_props.pNext = &budget_props;
+        vkGetPhysicalDeviceMemoryProperties2(device.physicalDevice, &memory_props);
+    }
+
+    std::lock_guard lock(manager.mutex);
+    for (uint32_t heap = 0; heap < device.memoryProperties.memoryHeapCount; ++heap) {
+        if (manager.budget) {
+            manager.heap_budget[heap] = budget_props.heapBudget[heap];
+            manager.heap_usage[heap] = budget_props.heapUsage[heap];
+        }
+        else {
+            manager.heap_budget[heap] = device.memoryProperties.memoryHeaps[heap].size;
+            manager.heap_usage[heap] = manager.allocated[heap];
+        }
+        manager.allocated_at_poll[heap] = manager.allocated[heap];
+    }
+}
+
+void registerMovableBuffer(const Device& device, Buffer& buffer)
+{
+    std::lock_guard lock(device.memory->mutex);
+    device.memory->blocks[buffer.allocation.block].movable.push_back(&buffer);
+}
+
+bool unregisterMovableBuffer(const Device& device, const Buffer& buffer)
+{
+    MemoryManager& manager = *device.memory;
+    std::lock_guard lock(manager.mutex);
+    std::vector<Buffer*>& movable = manager.blocks[buffer.allocation.block].movable;
+    const auto it = std::find(movable.begin(), movable.end(), &buffer);
+    if (it != movable.end()) movable.erase(it);
+
+    const auto move = std::find_if(manager.retired.begin(), manager.retired.end(),
+                                   [&buffer](const RetiredBuffer& retired) { return retired.replacement == buffer.buffer; });
+    if (move == manager.retired.end()) return false;
+    move->replacement = VK_NULL_HANDLE;
+    // the copy into it may not have finished, so it goes when the buffer it was moved from does
+    RetiredBuffer replacement{};
+    replacement.buffer = buffer.buffer;
+    replacement.allocation = buffer.allocation;
+    replacement.frame = move->frame;
+    manager.retired.push_back(replacement);
+    return true;
+}
+
+// The least used block with nothing in it but movable buffers, and that the other blocks of its kind have room for.
+// Blocks at least half full are left alone, moving them would cost more than the space it frees.
+static uint32_t pickBlockToEvacuate(const MemoryManager& manager)
+{
+    uint32_t best = UINT32_MAX;
+    for (uint32_t i = 0; i < manager.blocks.size(); ++i) {
+        const MemoryBlock& block = manager.blocks[i];
+        if (block.memory == VK_NULL_HANDLE || block.evacuating || block.allocations == 0 || block.movable.size() != block.allocations) continue;
+        if (block.used * 2 > block.size) continue;
+        if (best != UINT32_MAX && block.used >= manager.blocks[best].used) continue;
+
+        VkDeviceSize room = 0;
+        for (uint32_t j = 0; j < manager.blocks.size(); ++j) {
+            const MemoryBlock& other = manager.blocks[j];
+            if (j == i || other.memory == VK_NULL_HANDLE || other.evacuating) continue;
+            if (other.memory_type == block.memory_type && other.category == block.category) room += other.size - other.used;
+        }
+        if (room >= block.used) best = i;
+    }
+    return best;
+}
+
+VkDeviceSize defragmentMemory(const Device& device, VkCommandBuffer cmd, uint64_t frame_number, uint32_t frames_in_flight, VkDeviceSize max_bytes)
+{
+    MemoryManager& manager = *device.memory;
+    std::lock_guard lock(manager.mutex);
+
+    // what earlier moves left behind goes once no frame in flight can use it
+    size_t kept = 0;
+    for (const RetiredBuffer& retired : manager.retired) {
+        if (frame_number >= retired.frame + frames_in_flight) {
+            vkDestroyBuffer(device.device, retired.buffer, nullptr);
+            releaseAllocation(device, manager, retired.allocation);
+        }
+        else {
+            manager.retired[kept++] = retired;
+        }
+    }
+    manager.retired.resize(kept);
+
+    if (manager.evacuating_block == UINT32_MAX) {
+        manager.evacuating_block = pickBlockToEvacuate(manager);
+        if (manager.evacuating_block == UINT32_MAX) return 0;
+        manager.blocks[manager.evacuating_block].evacuating = true;
+    }
+    const uint32_t source_index = manager.evacuating_block;
+
+    struct Move {
+        VkBuffer source = VK_NULL_HANDLE;
+        VkBuffer destination = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+    };
+    std::array<Move, MAX_MOVES_PER_FRAME> moves{};
+    uint32_t move_count = 0;
+    VkDeviceSize bytes = 0;
+    while (move_count < MAX_MOVES_PER_FRAME && bytes < max_bytes && !manager.blocks[source_index].movable.empty()) {
+        MemoryBlock& source = manager.blocks[source_index];
+        Buffer& buffer = *source.movable.back();
+
+        VkBufferCreateInfo buffer_info{};
+        buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        buffer_info.size = buffer.size;
+        buffer_info.usage = buffer.usage;
+        buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        VkBuffer destination = VK_NULL_HANDLE;
+        VKCHECK(vkCreateBuffer(device.device, &buffer_info, nullptr, &destination));
+
+        VkMemoryRequirements reqs{};
+        vkGetBufferMemoryRequirements(device.device, destination, &reqs);
+        MemoryAllocation allocation{};
+        if ((reqs.memoryTypeBits & (1u << source.memory_type)) == 0 ||
+            !allocateFromBlocks(manager, reqs, source.memory_type, source.category, allocation)) {
+            // the other blocks are too fragmented after all, what has been moved stays moved
+            vkDestroyBuffer(device.device, destination, nullptr);
+            source.evacuating = false;
+            manager.evacuating_block = UINT32_MAX;
+            break;
+        }
+        VKCHECK(vkBindBufferMemory(device.device, destination, allocation.memory, allocation.offset));
+        if (buffer.name != nullptr) nameObject(device.device, VK_OBJECT_TYPE_BUFFER, destination, buffer.name);
+        manager.used[heapIndex(device, allocation.memory_type)] += allocation.size;
+        MemoryCategoryStats& category_stats = manager.categories[static_cast<uint32_t>(allocation.category)];
+        category_stats.bytes += allocation.size;
+        ++category_stats.allocations;
+
+        moves[move_count++] = Move{buffer.buffer, destination, buffer.size};
+        RetiredBuffer retired{};
+        retired.buffer = buffer.buffer;
+        retired.allocation = buffer.allocation;
+        retired.replacement = destination;
+        retired.frame = frame_number;
+        manager.retired.push_back(retired);
+
+        source.movable.pop_back();
+        buffer.buffer = destination;
+        buffer.allocation = allocation;
+        if (buffer.usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
+            VkBufferDeviceAddressInfo address_info{};
+            address_info.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+            address_info.buffer = destination;
+            buffer.address = vkGetBufferDeviceAddress(device.device, &address_info);
+        }
+        manager.blocks[allocation.block].movable.push_back(&buffer);
+        bytes += buffer.size;
+    }
+    // the block is freed once the buffers moved out of it are
+    if (manager.evacuating_block == source_index && manager.blocks[source_index].movable.empty()) manager.evacuating_block = UINT32_MAX;
+    if (move_count == 0) return 0;
+
+    beginDebugLabel(cmd, "defragment");
+    // earlier submissions may still be writing the buffers, and everything after the copies reads the new ones
+    VkMemoryBarrier2 before_copy{};
+    before_copy.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+    before_copy.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    before_copy.srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT;
+    before_copy.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    before_copy.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
+    VkDependencyInfo dependency_info{};
+    dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependency_info.memoryBarrierCount = 1;
+    dependency_info.pMemoryBarriers = &before_copy;
+    vkCmdPipelineBarrier2(cmd, &dependency_info);
+
+    for (uint32_t i = 0; i < move_count; ++i) {
+        const VkBufferCopy region{0, 0, moves[i].size};
+        vkCmdCopyBuffer(cmd, moves[i].source, moves[i].destination, 1, &region);
+    }
+
+    VkMemoryBarrier2 after_copy{};
+    after_copy.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+    after_copy.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    after_copy.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    after_copy.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    after_copy.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+    dependency_info.pMemoryBarriers = &after_copy;
+    vkCmdPipelineBarrier2(cmd, &dependency_info);
+    endDebugLabel(cmd);
+
+    manager.moves += move_count;
+    manager.bytes_moved += bytes;
+    return bytes;
+}
+
+MemoryStats memoryStats(const Device& device)
+{
+    MemoryManager& manager = *device.memory;
+    std::lock_guard lock(manager.mutex);
+
+    MemoryStats stats{};
+    stats.budget = manager.budget;
+    stats.priority = manager.priority;
+    stats.heap_count = device.memoryProperties.memoryHeapCount;
+    for (uint32_t heap = 0; heap < stats.heap_count; ++heap) {
+        MemoryHeapStats& heap_stats = stats.heaps[heap];
+        heap_stats.device_local = (device.memoryProperties.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+        heap_stats.size = device.memoryProperties.memoryHeaps[heap].size;
+        heap_stats.budget = manager.heap_budget[heap];
+        heap_stats.usage = manager.heap_usage[heap];
+        heap_stats.allocated = manager.allocated[heap];
+        heap_stats.used = manager.used[heap];
+    }
+    stats.categories = manager.categories;
+    stats.dedicated = manager.dedicated;
+
+    VkDeviceSize largest_free_sum = 0;
+    for (const MemoryBlock& block : manager.blocks) {
+        if (block.memory == VK_NULL_HANDLE) continue;
+        ++stats.blocks;
+        stats.block_bytes += block.size;
+        VkDeviceSize largest = 0;
+        for (const MemoryRange& range : block.free_ranges) {
+            stats.free_bytes += range.size;
+            largest = std::max(largest, range.size);
+        }
+        largest_free_sum += largest;
+        stats.largest_free = std::max(stats.largest_free, largest);
+    }
+    if (stats.free_bytes > 0) stats.fragmentation = 1.0 - static_cast<double>(largest_free_sum) / static_cast<double>(stats.free_bytes);
+    stats.moves = manager.moves;
+    stats.bytes_moved = manager.bytes_moved;
+    return stats;
+}
+
+static double megabytes(VkDeviceSize bytes) { return static_cast<double>(bytes) / (1024.0 * 1024.0); }
+
+std::string memoryStatsJson(const MemoryStats& stats)
+{
+    std::string json{};
+    std::array<char, 256> line{};
+    json += "{\n";
+    json += std::string("  \"budget\": ") + (stats.budget ? "true" : "false") + ",\n";
+    json += std::string("  \"priority\": ") + (stats.priority ? "true" : "false") + ",\n";
+    json += "  \"heaps\": [\n";
+    for (uint32_t heap = 0; heap < stats.heap_count; ++heap) {
+        const MemoryHeapStats& h = stats.heaps[heap];
+        snprintf(line.data(), line.size(),
+                 "    {\"device_local\": %s, \"size_mb\": %.2f, \"budget_mb\": %.2f, \"usage_mb\": %.2f, \"allocated_mb\": %.2f, \"used_mb\": %.2f}%s\n",
+                 h.device_local ? "true" : "false", megabytes(h.size), megabytes(h.budget), megabytes(h.usage), megabytes(h.allocated), megabytes(h.used),
+                 heap + 1 < stats.heap_count ? "," : "");
+        json += line.data();
+    }
+    json += "  ],\n";
+    json += "  \"categories\": {\n";
+    for (uint32_t category = 0; category < MEMORY_CATEGORY_COUNT; ++category) {
+        const MemoryCategoryStats& c = stats.categories[category];
+        snprintf(line.data(), line.size(), "    \"%s\": {\"mb\": %.2f, \"allocations\": %u}%s\n", memoryCategoryName(static_cast<MemoryCategory>(category)),
+                 megabytes(c.bytes), c.allocations, category + 1 < MEMORY_CATEGORY_COUNT ? "," : "");
+        json += line.data();
+    }
+    json += "  },\n";
+    snprintf(line.data(), line.size(), "  \"blocks\": %u,\n  \"dedicated\": %u,\n  \"block_mb\": %.2f,\n  \"free_mb\": %.2f,\n  \"largest_free_mb\": %.2f,\n",
+             stats.blocks, stats.dedicated, megabytes(stats.block_bytes), megabytes(stats.free_bytes), megabytes(stats.largest_free));
+    json += line.data();
+    snprintf(line.data(), line.size(), "  \"fragmentation\": %.4f,\n  \"moves\": %" PRIu64 ",\n  \"moved_mb\": %.2f\n", stats.fragmentation, stats.moves,
+             megabytes(stats.bytes_moved));
+    json += line.data();
+    json += "}\n";
+    return json;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+
+#include <array>
+#include <string>
+
+#include "vulkan_headers.h"
+
+struct Buffer;
+struct Device;
+
+// What memory is used for. Each category has blocks of its own, so resources that live for the whole run do not fragment around short
+// lived ones, and a priority of its own, so the driver knows what to keep in device memory once the budget runs out.
+enum class MemoryCategory : uint32_t {
+    Mesh,          // vertices, indices and meshlets
+    Entities,      // per entity draw parameters
+    Culling,       // indirect draws, occlusion flags and the depth pyramid
+    RenderTargets, // colour, depth and offscreen images
+    Stream,        // written by the CPU every frame
+    Readback,      // frame capture
+    Staging,       // uploads
+};
+constexpr uint32_t MEMORY_CATEGORY_COUNT = 7;
+
+// "mesh", "entities", "culling", "render_targets", "stream", "readback" or "staging"
+const char* memoryCategoryName(MemoryCategory category);
+
+// A range of a VkDeviceMemory, either in a block shared with other allocations or dedicated to one resource.
+struct MemoryAllocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;     // resources are bound here
+    VkDeviceSize size = 0;
+    void* mapped = nullptr;      // at offset, host visible memory stays mapped for as long as it is allocated
+    uint32_t memory_type = 0;
+    uint32_t block = UINT32_MAX; // UINT32_MAX for dedicated allocations
+    MemoryCategory category = MemoryCategory::Mesh;
+};
+
+struct MemoryHeapStats {
+    bool device_local = false;
+    VkDeviceSize size = 0;
+    VkDeviceSize budget = 0;    // what the process can use before the driver starts evicting, the heap size without VK_EXT_memory_budget
+    VkDeviceSize usage = 0;     // by the whole process as the driver sees it, allocated without VK_EXT_memory_budget
+    VkDeviceSize allocated = 0; // in VkDeviceMemory objects we made
+    VkDeviceSize used = 0;      // by the allocations within those
+};
+
+struct MemoryCategoryStats {
+    VkDeviceSize bytes = 0;
+    uint32_t allocations = 0;
+};
+
+struct MemoryStats {
+    bool budget = false;   // VK_EXT_memory_budget, otherwise the heap budgets are only their sizes
+    bool priority = false; // VK_EXT_memory_priority, otherwise the categories' priorities are not passed on
+    uint32_t heap_count = 0;
+    std::array<MemoryHeapStats, VK_MAX_MEMORY_HEAPS> heaps{};
+    std::array<MemoryCategoryStats, MEMORY_CATEGORY_COUNT> categories{};
+    uint32_t blocks = 0;
+    uint32_t dedicated = 0; // allocations with a VkDeviceMemory of their own
+    VkDeviceSize block_bytes = 0;
+    VkDeviceSize free_bytes = 0;   // in blocks
+    VkDeviceSize largest_free = 0; // one range in one block
+    double fragmentation = 0.0;    // 0 while each block's free space is one range, towards 1 as it is split into many small ones
+    uint64_t moves = 0;            // buffers defragmentMemory() has moved
+    VkDeviceSize bytes_moved = 0;
+};
+
+struct MemoryManager;
+
+// Called by createVulkanDevice() and destroyVulkanDevice(), everything must have been freed by then.
+MemoryManager* createMemoryManager(const Device& device);
+void destroyMemoryManager(const Device& device, MemoryManager* manager);
+
+// Buffers up to a quarter of a block share blocks with other buffers of the same memory type and category. Bigger buffers and images get
+// dedicated allocations, images would otherwise need bufferImageGranularity between them and their neighbours. Safe to call from any thread.
+MemoryAllocation allocateMemory(const Device& device, const VkMemoryRequirements& reqs, uint32_t memory_type, MemoryCategory category, bool buffer);
+void freeMemory(const Device& device, const MemoryAllocation& allocation);
+
+// false if size more from the memory type's heap would go over its budget
+bool memoryWithinBudget(const Device& device, uint32_t memory_type, VkDeviceSize size);
+
+// Polls VK_EXT_memory_budget. What other processes use changes the budget, so it is polled every so often rather than for every allocation.
+void updateMemoryBudget(const Device& device);
+
+// createBuffer() registers device local buffers in shared blocks so defragmentMemory() can move them. A move writes the new handle,
+// allocation and address into the Buffer, so it must stay where it is until destroyBuffer().
+void registerMovableBuffer(const Device& device, Buffer& buffer);
+// Returns true if the buffer was created by a move that frames in flight may still be copying into. Its destruction is then left to
+// defragmentMemory(), once those frames have finished.
+bool unregisterMovableBuffer(const Device& device, const Buffer& buffer);
+
+// Empties the least used block it can, so it can be freed, by moving up to max_bytes of its buffers into the other blocks of its kind with
+// copies recorded into cmd. Only blocks holding nothing but movable buffers are emptied, a block at a time across as many frames as it takes.
+// cmd must be recorded before anything reads the buffers' handles or addresses for frame_number. The buffers moved from are destroyed
+// frames_in_flight frames later. Returns the bytes moved.
+VkDeviceSize defragmentMemory(const Device& device, VkCommandBuffer cmd, uint64_t frame_number, uint32_t frames_in_flight, VkDeviceSize max_bytes);
+
+MemoryStats memoryStats(const Device& device);
+std::string memoryStatsJson(const MemoryStats& stats);
@@ -0,0 +1,100 @@
+#include "vulkan_mesh.h"
+
+#include <cstring>
+
+#include <algorithm>
+#include <array>
+
+#include "error.h"
+#include "mesh.h"
+#include "scene_file.h"
+#include "vulkan_upload.h"
+
+constexpr VkBufferUsageFlags MESH_BUFFER_USAGE = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+                                                 VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+void createGpuMesh(const Device& device, Uploader& uploader, const MeshData& mesh, GpuMesh& gpu_mesh)
+{
+    // each array starts 16 byte aligned for the shaders' buffer references
+    struct Array {
+        const void* data;
+        VkDeviceSize size;
+        VkDeviceSize* offset;
+    };
+    const std::array<Array, 5> arrays{{
+        {mesh.vertices.data(), sizeof(PackedVertex) * mesh.vertices.size(), &gpu_mesh.vertices_offset},
+        {mesh.indices.data(), sizeof(uint32_t) * mesh.indices.size(), &gpu_mesh.indices_offset},
+        {mesh.meshlets.data(), sizeof(Meshlet) * mesh.meshlets.size(), &gpu_mesh.meshlets_offset},
+        {mesh.meshlet_vertices.data(), sizeof(uint32_t) * mesh.meshlet_vertices.size(), &gpu_mesh.meshlet_vertices_offset},
+        {mesh.meshlet_triangles.data(), sizeof(uint32_t) * mesh.meshlet_triangles.size(), &gpu_mesh.meshlet_triangles_offset},
+    }};
+    VkDeviceSize size = 0;
+    for (const Array& array : arrays) {
+        *array.offset = size;
+        size = (size + array.size + 15) & ~VkDeviceSize{15};
+    }
+
+    createBuffer(device, size, MESH_BUFFER_USAGE, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, MemoryCategory::Mesh, gpu_mesh.buffer);
+    nameBuffer(device, gpu_mesh.buffer, "mesh");
+
+    for (const Array& array : arrays) {
+        if (array.size > 0) uploadToBuffer(device, uploader, gpu_mesh.buffer.buffer, *array.offset, array.data, array.size);
+    }
+
+    SubMesh submesh{};
+    submesh.first_index = 0;
+    submesh.index_count = static_cast<uint32_t>(mesh.indices.size());
+    submesh.vertex_offset = 0;
+    submesh.position_scale = mesh.position_scale;
+    submesh.first_meshlet = 0;
+    submesh.meshlet_count = static_cast<uint32_t>(mesh.meshlets.size());
+    gpu_mesh.submeshes = {submesh};
+    gpu_mesh.has_meshlets = submesh.meshlet_count > 0;
+}
+
+void createGpuMesh(const Device& device, Uploader& uploader, const SceneFile& scene, GpuMesh& gpu_mesh)
+{
+    if (scene.gpu_data_size == 0) throw Error("Scene has no GPU data");
+
+    // the file is laid out so the GPU data goes into the buffer as it is
+    createBuffer(device, scene.gpu_data_size, MESH_BUFFER_USAGE, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, MemoryCategory::Mesh, gpu_mesh.buffer);
+    nameBuffer(device, gpu_mesh.buffer, "scene mesh");
+    gpu_mesh.vertices_offset = scene.vertices_offset;
+    gpu_mesh.indices_offset = scene.indices_offset;
+    gpu_mesh.meshlets_offset = scene.meshlets_offset;
+    gpu_mesh.meshlet_vertices_offset = scene.meshlet_vertices_offset;
+    gpu_mesh.meshlet_triangles_offset = scene.meshlet_triangles_offset;
+
+    const size_t gpu_data_offset = static_cast<size_t>(scene.gpu_data - scene.file.data);
+    prefetchRange(scene.file, gpu_data_offset, static_cast<size_t>(std::min<uint64_t>(scene.gpu_data_size, uploader.chunk_size)));
+    uploadToBuffer(device, uploader, gpu_mesh.buffer.buffer, 0, scene.gpu_data_size, [&](void* staging, VkDeviceSize offset, VkDeviceSize size) {
+        // read ahead the next chunk while this one is copied and uploaded
+        const VkDeviceSize next = offset + size;
+        if (next < scene.gpu_data_size) {
+            prefetchRange(scene.file, gpu_data_offset + static_cast<size_t>(next), static_cast<size_t>(std::min(size, scene.gpu_data_size - next)));
+        }
+        memcpy(staging, scene.gpu_data + offset, static_cast<size_t>(size));
+    });
+
+    gpu_mesh.submeshes.clear();
+    gpu_mesh.submeshes.reserve(scene.meshes.size());
+    gpu_mesh.has_meshlets = !scene.meshes.empty();
+    for (const SceneMesh& mesh : scene.meshes) {
+        SubMesh submesh{};
+        submesh.first_index = mesh.first_index;
+        submesh.index_count = mesh.index_count;
+        submesh.vertex_offset = static_cast<int32_t>(mesh.first_vertex);
+        submesh.position_scale = mesh.position_scale;
+        submesh.first_meshlet = mesh.first_meshlet;
+        submesh.meshlet_count = mesh.meshlet_count;
+        gpu_mesh.submeshes.push_back(submesh);
+        gpu_mesh.has_meshlets = gpu_mesh.has_meshlets && mesh.meshlet_count > 0;
+    }
+}
+
+void destroyGpuMesh(const Device& device, GpuMesh& gpu_mesh)
+{
+    destroyBuffer(device, gpu_mesh.buffer);
+    gpu_mesh = GpuMesh{};
+}
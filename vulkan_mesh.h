@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+
+#include <vector>
+
+#include "vulkan_buffer.h"
+#include "vulkan_headers.h"
+
+struct Device;
+struct MeshData;
+struct SceneFile;
+struct Uploader;
+
+// a range of the shared vertex and index arrays
+struct SubMesh {
+    uint32_t first_index = 0;
+    uint32_t index_count = 0;
+    int32_t vertex_offset = 0; // added to every index
+    float position_scale = 1.0f;
+    uint32_t first_meshlet = 0;
+    uint32_t meshlet_count = 0;
+};
+
+// Vertices, indices and meshlets of any number of meshes share one device local buffer.
+// The vertices are read through buffer.address + vertices_offset by vertex pulling, or bound as a vertex buffer for the fixed function path.
+struct GpuMesh {
+    Buffer buffer{};
+    VkDeviceSize vertices_offset = 0;
+    VkDeviceSize indices_offset = 0;
+    VkDeviceSize meshlets_offset = 0; // Meshlet array, first_index and first_vertex count from the start of the arrays
+    VkDeviceSize meshlet_vertices_offset = 0;
+    VkDeviceSize meshlet_triangles_offset = 0;
+    bool has_meshlets = false; // every submesh has at least one
+    std::vector<SubMesh> submeshes{};
+};
+
+void createGpuMesh(const Device& device, Uploader& uploader, const MeshData& mesh, GpuMesh& gpu_mesh);
+
+// The scene's GPU data is copied from the mapping into staging memory chunk by chunk, with the next chunk prefetched from disk
+// while the current one is copied, so large files never need to be resident all at once.
+void createGpuMesh(const Device& device, Uploader& uploader, const SceneFile& scene, GpuMesh& gpu_mesh);
+
+void destroyGpuMesh(const Device& device, GpuMesh& gpu_mesh);
@@ -1,74 +1,244 @@
 #include "vulkan_pipeline.h"
 
+#include <cstddef>
+#include <cstring>
+
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <fstream>
+#include <span>
+#include <vector>
 
 #include "vulkan_headers.h"
 
+#include "mapped_file.h"
+#include "mesh.h"
 #include "shaders.h"
+#include "vulkan_device.h"
+
+VkDescriptorSetLayout createFrameDescriptorSetLayout(VkDevice device, bool mesh_shading)
+{
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+    if (mesh_shading) bindings[0].stageFlags |= VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+    bindings[0].pImmutableSamplers = nullptr;
+    bindings[1].binding = 1; // depth pyramid
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[1].descriptorCount = 1;
+    bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    if (mesh_shading) bindings[1].stageFlags |= VK_SHADER_STAGE_TASK_BIT_EXT;
+    bindings[1].pImmutableSamplers = nullptr;
+
+    VkDescriptorSetLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.pNext = nullptr;
+    layout_info.flags = 0;
+    layout_info.bindingCount = static_cast<uint32_t>(bindings.size());
+    layout_info.pBindings = bindings.data();
+
+    VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;
+    VKCHECK(vkCreateDescriptorSetLayout(device, &layout_info, nullptr, &set_layout));
+    return set_layout;
+}
+
+VkDescriptorSetLayout createDepthPyramidSetLayout(VkDevice device)
+{
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+    bindings[0].binding = 0; // depth buffer
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[0].pImmutableSamplers = nullptr;
+    bindings[1].binding = 1; // pyramid levels
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[1].descriptorCount = DEPTH_PYRAMID_MAX_LEVELS;
+    bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[1].pImmutableSamplers = nullptr;
+
+    VkDescriptorSetLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.pNext = nullptr;
+    layout_info.flags = 0;
+    layout_info.bindingCount = static_cast<uint32_t>(bindings.size());
+    layout_info.pBindings = bindings.data();
+
+    VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;
+    VKCHECK(vkCreateDescriptorSetLayout(device, &layout_info, nullptr, &set_layout));
+    return set_layout;
+}
 
-VkPipeline createPipelineAndLayout(VkDevice device, VkFormat color_attachment_format, VkExtent2D extent, VkPipelineLayout& layout)
+VkDescriptorSetLayout createPostProcessSetLayout(VkDevice device)
+{
+    VkDescriptorSetLayoutBinding binding{};
+    binding.binding = 0; // render target
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    binding.descriptorCount = 1;
+    binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    binding.pImmutableSamplers = nullptr;
+
+    VkDescriptorSetLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.pNext = nullptr;
+    layout_info.flags = 0;
+    layout_info.bindingCount = 1;
+    layout_info.pBindings = &binding;
+
+    VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;
+    VKCHECK(vkCreateDescriptorSetLayout(device, &layout_info, nullptr, &set_layout));
+    return set_layout;
+}
+
+static VkShaderModule createShaderModule(VkDevice device, std::span<const uint32_t> code)
 {
     VkShaderModuleCreateInfo module_info{};
     module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
     module_info.pNext = nullptr;
     module_info.flags = 0;
+    module_info.codeSize = code.size_bytes();
+    module_info.pCode = code.data();
+    VkShaderModule module = VK_NULL_HANDLE;
+    VKCHECK(vkCreateShaderModule(device, &module_info, nullptr, &module));
+    return module;
+}
+
+static VkPipelineShaderStageCreateInfo shaderStage(VkShaderStageFlagBits stage, VkShaderModule module)
+{
+    VkPipelineShaderStageCreateInfo stage_info{};
+    stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stage_info.pNext = nullptr;
+    stage_info.flags = 0;
+    stage_info.stage = stage;
+    stage_info.module = module;
+    stage_info.pName = "main";
+    stage_info.pSpecializationInfo = nullptr;
+    return stage_info;
+}
+
+static VkPipelineLayout createPipelineLayout(VkDevice device, VkDescriptorSetLayout set_layout, VkShaderStageFlags push_constant_stages,
+                                             uint32_t push_constant_size)
+{
+    VkPushConstantRange push_constant_range{};
+    push_constant_range.offset = 0;
+    push_constant_range.size = push_constant_size;
+    push_constant_range.stageFlags = push_constant_stages;
+
+    VkPipelineLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_info.setLayoutCount = 1;
+    layout_info.pSetLayouts = &set_layout;
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges = &push_constant_range;
+
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    VKCHECK(vkCreatePipelineLayout(device, &layout_info, nullptr, &layout));
+    return layout;
+}
+
+// the same for every scene pipeline, baked in or set by recordRasterState()
+constexpr VkCullModeFlags CULL_MODE = VK_CULL_MODE_BACK_BIT;
+constexpr VkFrontFace FRONT_FACE = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+constexpr VkPrimitiveTopology TOPOLOGY = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+static bool depthWrite(DepthMode depth_mode) { return depth_mode != DepthMode::Equal; }
+
+// or equal so coplanar draws still cover each other in draw order, as they did without a depth buffer
+static VkCompareOp depthCompareOp(DepthMode depth_mode) { return depth_mode == DepthMode::Equal ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_GREATER_OR_EQUAL; }
+
+void recordRasterState(VkCommandBuffer cmd)
+{
+    vkCmdSetCullMode(cmd, CULL_MODE);
+    vkCmdSetFrontFace(cmd, FRONT_FACE);
+    vkCmdSetPrimitiveTopology(cmd, TOPOLOGY);
+}
+
+void recordDepthMode(VkCommandBuffer cmd, DepthMode depth_mode)
+{
+    vkCmdSetDepthTestEnable(cmd, VK_TRUE);
+    vkCmdSetDepthWriteEnable(cmd, depthWrite(depth_mode) ? VK_TRUE : VK_FALSE);
+    vkCmdSetDepthCompareOp(cmd, depthCompareOp(depth_mode));
+}
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
 
-    module_info.codeSize = spv_vertex.size();
-    module_info.pCode = reinterpret_cast<const uint32_t*>(spv_vertex.data());
-    VkShaderModule vertex_module = VK_NULL_HANDLE;
-    VKCHECK(vkCreateShaderModule(device, &module_info, nullptr, &vertex_module));
-
-    module_info.codeSize = spv_fragment.size();
-    module_info.pCode = reinterpret_cast<const uint32_t*>(spv_fragment.data());
-    VkShaderModule fragment_module = VK_NULL_HANDLE;
-    VKCHECK(vkCreateShaderModule(device, &module_info, nullptr, &fragment_module));
-
-    std::array<VkPipelineShaderStageCreateInfo, 2> stage_infos{};
-    stage_infos[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    stage_infos[0].pNext = nullptr;
-    stage_infos[0].flags = 0;
-    stage_infos[0].pName = "main";
-    stage_infos[0].pSpecializationInfo = nullptr;
-    stage_infos[1] = stage_infos[0];
-    stage_infos[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-    stage_infos[0].module = vertex_module;
-    stage_infos[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    stage_infos[1].module = fragment_module;
+// Stages are vertex and fragment, or task, mesh and fragment, which ignore the vertex input and input assembly state.
+// The fragment stage is left out for DepthMode::Prepass, so it must be the last one.
+// fixed_function_vertex_input binds PackedVertex as vertex attributes instead of leaving the vertex shader to fetch it.
+// With extended_dynamic_state depth_mode only matters for whether it is DepthMode::Prepass.
+// A library_part other than 0 creates that VK_EXT_graphics_pipeline_library part instead of a whole pipeline, from only the stages
+// the part has. The state of the other parts is ignored, so the same setup serves every part.
+static VkPipeline createPipeline(VkDevice device, VkPipelineCache cache, VkPipelineLayout layout, std::span<const VkPipelineShaderStageCreateInfo> stage_infos,
+                                 bool fixed_function_vertex_input, VkFormat color_attachment_format, VkFormat depth_attachment_format,
+                                 VkSampleCountFlagBits samples, bool sample_shading, bool extended_dynamic_state, DepthMode depth_mode,
+                                 VkGraphicsPipelineLibraryFlagsEXT library_part = 0)
+{
+    if (depth_mode == DepthMode::Prepass && !stage_infos.empty() && stage_infos.back().stage == VK_SHADER_STAGE_FRAGMENT_BIT) {
+        stage_infos = stage_infos.first(stage_infos.size() - 1);
+    }
+    const bool mesh_stages = std::any_of(stage_infos.begin(), stage_infos.end(),
+                                         [](const VkPipelineShaderStageCreateInfo& stage) { return stage.stage == VK_SHADER_STAGE_MESH_BIT_EXT; });
+
+    VkVertexInputBindingDescription vertex_binding{};
+    vertex_binding.binding = 0;
+    vertex_binding.stride = sizeof(PackedVertex);
+    vertex_binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    std::array<VkVertexInputAttributeDescription, 3> vertex_attributes{};
+    vertex_attributes[0] = VkVertexInputAttributeDescription{0, 0, VK_FORMAT_R16G16B16A16_SNORM, offsetof(PackedVertex, position)};
+    vertex_attributes[1] = VkVertexInputAttributeDescription{1, 0, VK_FORMAT_R16G16_SNORM, offsetof(PackedVertex, normal)};
+    vertex_attributes[2] = VkVertexInputAttributeDescription{2, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(PackedVertex, color)};
 
+    // vertex pulling has no vertex input state at all
     VkPipelineVertexInputStateCreateInfo vertex_input_state{};
     vertex_input_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
     vertex_input_state.pNext = nullptr;
     vertex_input_state.flags = 0;
-    vertex_input_state.vertexBindingDescriptionCount = 0;
-    vertex_input_state.pVertexBindingDescriptions = nullptr;
-    vertex_input_state.vertexAttributeDescriptionCount = 0;
-    vertex_input_state.pVertexAttributeDescriptions = nullptr;
+    if (fixed_function_vertex_input) {
+        vertex_input_state.vertexBindingDescriptionCount = 1;
+        vertex_input_state.pVertexBindingDescriptions = &vertex_binding;
+        vertex_input_state.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertex_attributes.size());
+        vertex_input_state.pVertexAttributeDescriptions = vertex_attributes.data();
+    }
+    else {
+        vertex_input_state.vertexBindingDescriptionCount = 0;
+        vertex_input_state.pVertexBindingDescriptions = nullptr;
+        vertex_input_state.vertexAttributeDescriptionCount = 0;
+        vertex_input_state.pVertexAttributeDescriptions = nullptr;
+    }
 
     VkPipelineInputAssemblyStateCreateInfo input_assembly_state{};
     input_assembly_state.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
     input_assembly_state.pNext = nullptr;
     input_assembly_state.flags = 0;
-    input_assembly_state.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    input_assembly_state.topology = TOPOLOGY;
     input_assembly_state.primitiveRestartEnable = VK_FALSE;
 
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = static_cast<float>(extent.width);
-    viewport.height = static_cast<float>(extent.height);
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-    VkRect2D scissor{};
-    scissor.offset.x = 0;
-    scissor.offset.y = 0;
-    scissor.extent = extent;
-
+    // set when recording, the render extent changes with dynamic resolution
     VkPipelineViewportStateCreateInfo viewport_state{};
     viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewport_state.viewportCount = 1;
-    viewport_state.pViewports = &viewport;
+    viewport_state.pViewports = nullptr;
     viewport_state.scissorCount = 1;
-    viewport_state.pScissors = &scissor;
+    viewport_state.pScissors = nullptr;
+    std::array<VkDynamicState, 8> dynamic_states{VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    uint32_t dynamic_state_count = 2;
+    if (extended_dynamic_state) {
+        for (const VkDynamicState state : {VK_DYNAMIC_STATE_CULL_MODE, VK_DYNAMIC_STATE_FRONT_FACE, VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE,
+                                           VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE, VK_DYNAMIC_STATE_DEPTH_COMPARE_OP}) {
+            dynamic_states[dynamic_state_count++] = state;
+        }
+        // mesh pipelines have no input assembly to make dynamic
+        if (!mesh_stages) dynamic_states[dynamic_state_count++] = VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY;
+    }
+    VkPipelineDynamicStateCreateInfo dynamic_state{};
+    dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_state.dynamicStateCount = dynamic_state_count;
+    dynamic_state.pDynamicStates = dynamic_states.data();
 
     VkPipelineRasterizationStateCreateInfo rasterization_state{};
     rasterization_state.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -76,8 +246,8 @@ VkPipeline createPipelineAndLayout(VkDevice device, VkFormat color_attachment_fo
     rasterization_state.rasterizerDiscardEnable = VK_FALSE; // enabling this will not run the fragment shaders at all
     rasterization_state.polygonMode = VK_POLYGON_MODE_FILL;
     rasterization_state.lineWidth = 1.0f;
-    rasterization_state.cullMode = VK_CULL_MODE_BACK_BIT;
-    rasterization_state.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterization_state.cullMode = CULL_MODE;
+    rasterization_state.frontFace = FRONT_FACE;
     rasterization_state.depthBiasEnable = VK_FALSE;
     rasterization_state.depthBiasConstantFactor = 0.0f; // ignored
     rasterization_state.depthBiasClamp = 0.0f;          // ignored
@@ -89,23 +259,24 @@ VkPipeline createPipelineAndLayout(VkDevice device, VkFormat color_attachment_fo
     rendering_info.viewMask = 0;
     rendering_info.colorAttachmentCount = 1;
     rendering_info.pColorAttachmentFormats = &color_attachment_format;
-    rendering_info.depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+    rendering_info.depthAttachmentFormat = depth_attachment_format;
     rendering_info.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
 
     VkPipelineMultisampleStateCreateInfo multisample_state{};
     multisample_state.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisample_state.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-    multisample_state.sampleShadingEnable = VK_FALSE;
-    multisample_state.minSampleShading = 1.0f;          // ignored
+    multisample_state.rasterizationSamples = samples;
+    // a depth only prepass has no fragment shader to run per sample
+    multisample_state.sampleShadingEnable = sample_shading && depth_mode != DepthMode::Prepass ? VK_TRUE : VK_FALSE;
+    multisample_state.minSampleShading = 1.0f;          // every sample
     multisample_state.pSampleMask = nullptr;            // ignored
     multisample_state.alphaToCoverageEnable = VK_FALSE; // ignored
     multisample_state.alphaToOneEnable = VK_FALSE;      // ignored
 
     VkPipelineDepthStencilStateCreateInfo depth_stencil_state{};
     depth_stencil_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-    depth_stencil_state.depthTestEnable = VK_FALSE;
-    depth_stencil_state.depthWriteEnable = VK_FALSE;
-    depth_stencil_state.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    depth_stencil_state.depthTestEnable = VK_TRUE;
+    depth_stencil_state.depthWriteEnable = depthWrite(depth_mode) ? VK_TRUE : VK_FALSE;
+    depth_stencil_state.depthCompareOp = depthCompareOp(depth_mode);
     depth_stencil_state.depthBoundsTestEnable = VK_FALSE;
     depth_stencil_state.minDepthBounds = 0.0f;
     depth_stencil_state.maxDepthBounds = 1.0f;
@@ -114,7 +285,8 @@ VkPipeline createPipelineAndLayout(VkDevice device, VkFormat color_attachment_fo
     depth_stencil_state.back = {};
 
     VkPipelineColorBlendAttachmentState color_blend_attachment{};
-    color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    color_blend_attachment.colorWriteMask =
+        depth_mode == DepthMode::Prepass ? 0 : VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
     color_blend_attachment.blendEnable = VK_FALSE;
 
     VkPipelineColorBlendStateCreateInfo color_blend_state{};
@@ -128,24 +300,17 @@ VkPipeline createPipelineAndLayout(VkDevice device, VkFormat color_attachment_fo
     color_blend_state.blendConstants[2] = 0.0f; // ignored
     color_blend_state.blendConstants[3] = 0.0f; // ignored
 
-    VkPushConstantRange push_constant_range{};
-    push_constant_range.offset = 0;
-    push_constant_range.size = PUSH_CONSTANT_SIZE;
-    push_constant_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-
-    VkPipelineLayoutCreateInfo layout_info{};
-    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    layout_info.setLayoutCount = 0;
-    layout_info.pSetLayouts = nullptr;
-    layout_info.pushConstantRangeCount = 1;
-    layout_info.pPushConstantRanges = &push_constant_range;
-
-    VKCHECK(vkCreatePipelineLayout(device, &layout_info, nullptr, &layout));
+    // the parts keep what an optimised link needs, see linkOptimisedPipelines()
+    VkGraphicsPipelineLibraryCreateInfoEXT library_info{};
+    library_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+    library_info.pNext = nullptr;
+    library_info.flags = library_part;
+    if (library_part != 0) rendering_info.pNext = &library_info;
 
     VkGraphicsPipelineCreateInfo pl_info{};
     pl_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
     pl_info.pNext = &rendering_info;
-    pl_info.flags = 0;
+    pl_info.flags = library_part != 0 ? VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT : 0;
     pl_info.stageCount = static_cast<uint32_t>(stage_infos.size());
     pl_info.pStages = stage_infos.data();
     pl_info.pVertexInputState = &vertex_input_state;
@@ -156,7 +321,7 @@ VkPipeline createPipelineAndLayout(VkDevice device, VkFormat color_attachment_fo
     pl_info.pMultisampleState = &multisample_state;
     pl_info.pDepthStencilState = &depth_stencil_state;
     pl_info.pColorBlendState = &color_blend_state;
-    pl_info.pDynamicState = nullptr;
+    pl_info.pDynamicState = &dynamic_state;
     pl_info.layout = layout;
     pl_info.renderPass = VK_NULL_HANDLE;
     pl_info.subpass = 0;
@@ -164,15 +329,378 @@ VkPipeline createPipelineAndLayout(VkDevice device, VkFormat color_attachment_fo
     pl_info.basePipelineIndex = -1;
 
     VkPipeline pipeline = VK_NULL_HANDLE;
-    VKCHECK(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pl_info, nullptr, &pipeline));
+    VKCHECK(vkCreateGraphicsPipelines(device, cache, 1, &pl_info, nullptr, &pipeline));
+    return pipeline;
+}
+
+// A scene pipeline from its parts, quick to link unless link_time_optimisation. layout must be the one the parts were created with.
+static VkPipeline linkPipeline(VkDevice device, VkPipelineCache cache, VkPipelineLayout layout, const PipelineParts& parts, bool link_time_optimisation)
+{
+    PipelineParts libraries{};
+    uint32_t library_count = 0;
+    for (const VkPipeline part : parts) {
+        if (part != VK_NULL_HANDLE) libraries[library_count++] = part;
+    }
+    VkPipelineLibraryCreateInfoKHR library_info{};
+    library_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+    library_info.pNext = nullptr;
+    library_info.libraryCount = library_count;
+    library_info.pLibraries = libraries.data();
+
+    VkGraphicsPipelineCreateInfo pl_info{};
+    pl_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pl_info.pNext = &library_info;
+    pl_info.flags = link_time_optimisation ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0;
+    pl_info.layout = layout;
+    pl_info.basePipelineHandle = VK_NULL_HANDLE;
+    pl_info.basePipelineIndex = -1;
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VKCHECK(vkCreateGraphicsPipelines(device, cache, 1, &pl_info, nullptr, &pipeline));
+    return pipeline;
+}
+
+// A fullscreen triangle from fullscreen.vert, no vertex input, depth or blending.
+static VkPipeline createPostProcessPipeline(VkDevice device, VkPipelineCache cache, VkPipelineLayout layout, VkFormat color_attachment_format)
+{
+    const VkShaderModule vertex_module = createShaderModule(device, spv_fullscreen);
+    const VkShaderModule fragment_module = createShaderModule(device, spv_post_process);
+    const std::array<VkPipelineShaderStageCreateInfo, 2> stage_infos{shaderStage(VK_SHADER_STAGE_VERTEX_BIT, vertex_module),
+                                                                     shaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, fragment_module)};
 
+    VkPipelineVertexInputStateCreateInfo vertex_input_state{};
+    vertex_input_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly_state{};
+    input_assembly_state.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    input_assembly_state.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    input_assembly_state.primitiveRestartEnable = VK_FALSE;
+
+    // set when recording, to the swapchain extent
+    VkPipelineViewportStateCreateInfo viewport_state{};
+    viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport_state.viewportCount = 1;
+    viewport_state.scissorCount = 1;
+    const std::array<VkDynamicState, 2> dynamic_states{VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamic_state{};
+    dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_state.dynamicStateCount = static_cast<uint32_t>(dynamic_states.size());
+    dynamic_state.pDynamicStates = dynamic_states.data();
+
+    VkPipelineRasterizationStateCreateInfo rasterization_state{};
+    rasterization_state.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterization_state.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterization_state.lineWidth = 1.0f;
+    rasterization_state.cullMode = VK_CULL_MODE_NONE;
+    rasterization_state.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+    VkPipelineRenderingCreateInfo rendering_info{};
+    rendering_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    rendering_info.colorAttachmentCount = 1;
+    rendering_info.pColorAttachmentFormats = &color_attachment_format;
+    rendering_info.depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+    rendering_info.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+
+    VkPipelineMultisampleStateCreateInfo multisample_state{};
+    multisample_state.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisample_state.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineColorBlendAttachmentState color_blend_attachment{};
+    color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    color_blend_attachment.blendEnable = VK_FALSE;
+    VkPipelineColorBlendStateCreateInfo color_blend_state{};
+    color_blend_state.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    color_blend_state.attachmentCount = 1;
+    color_blend_state.pAttachments = &color_blend_attachment;
+
+    VkGraphicsPipelineCreateInfo pl_info{};
+    pl_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pl_info.pNext = &rendering_info;
+    pl_info.stageCount = static_cast<uint32_t>(stage_infos.size());
+    pl_info.pStages = stage_infos.data();
+    pl_info.pVertexInputState = &vertex_input_state;
+    pl_info.pInputAssemblyState = &input_assembly_state;
+    pl_info.pViewportState = &viewport_state;
+    pl_info.pRasterizationState = &rasterization_state;
+    pl_info.pMultisampleState = &multisample_state;
+    pl_info.pDepthStencilState = nullptr; // no depth attachment
+    pl_info.pColorBlendState = &color_blend_state;
+    pl_info.pDynamicState = &dynamic_state;
+    pl_info.layout = layout;
+    pl_info.basePipelineIndex = -1;
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VKCHECK(vkCreateGraphicsPipelines(device, cache, 1, &pl_info, nullptr, &pipeline));
     vkDestroyShaderModule(device, fragment_module, nullptr);
     vkDestroyShaderModule(device, vertex_module, nullptr);
+    return pipeline;
+}
 
+// one shader, no vertex or fragment state
+static VkPipeline createComputePipeline(VkDevice device, VkPipelineCache cache, VkPipelineLayout layout, std::span<const uint32_t> code)
+{
+    const VkShaderModule module = createShaderModule(device, code);
+    VkComputePipelineCreateInfo compute_info{};
+    compute_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    compute_info.stage = shaderStage(VK_SHADER_STAGE_COMPUTE_BIT, module);
+    compute_info.layout = layout;
+    compute_info.basePipelineHandle = VK_NULL_HANDLE;
+    compute_info.basePipelineIndex = -1;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VKCHECK(vkCreateComputePipelines(device, cache, 1, &compute_info, nullptr, &pipeline));
+    vkDestroyShaderModule(device, module, nullptr);
     return pipeline;
 }
 
-void destroyPipelineAndLayout(VkDevice device, VkPipeline pipeline, VkPipelineLayout layout) {
-    vkDestroyPipeline(device, pipeline, nullptr);
-    vkDestroyPipelineLayout(device, layout, nullptr);
+// One pipeline per DepthMode, except that with extended dynamic state Equal is the TestAndWrite pipeline with other depth state.
+template <typename CreateFn>
+static void createDepthModePipelines(bool extended_dynamic_state, std::array<VkPipeline, DEPTH_MODE_COUNT>& pipelines, CreateFn create)
+{
+    for (size_t mode = 0; mode < DEPTH_MODE_COUNT; ++mode) {
+        const DepthMode depth_mode = static_cast<DepthMode>(mode);
+        if (extended_dynamic_state && depth_mode == DepthMode::Equal) {
+            pipelines[mode] = pipelines[static_cast<size_t>(DepthMode::TestAndWrite)];
+        }
+        else {
+            pipelines[mode] = create(depth_mode);
+        }
+    }
+}
+
+void createPipelines(VkDevice device, VkPipelineCache cache, VkDescriptorSetLayout set_layout, VkDescriptorSetLayout depth_pyramid_set_layout,
+                     VkDescriptorSetLayout post_process_set_layout, VkFormat color_attachment_format, VkFormat depth_attachment_format,
+                     VkSampleCountFlagBits samples, bool sample_shading, bool mesh_shading, bool extended_dynamic_state, bool pipeline_libraries,
+                     Pipelines& pipelines)
+{
+    pipelines.extended_dynamic_state = extended_dynamic_state;
+    pipelines.pipeline_libraries = pipeline_libraries;
+    pipelines.layout = createPipelineLayout(device, set_layout, VK_SHADER_STAGE_VERTEX_BIT, PUSH_CONSTANT_SIZE);
+
+    auto create_part = [&](VkGraphicsPipelineLibraryFlagsEXT part, VkPipelineLayout layout, std::span<const VkPipelineShaderStageCreateInfo> stages,
+                           bool fixed_function_vertex_input, DepthMode depth_mode) {
+        const auto start = std::chrono::steady_clock::now();
+        const VkPipeline library = createPipeline(device, cache, layout, stages, fixed_function_vertex_input, color_attachment_format, depth_attachment_format,
+                                                  samples, sample_shading, extended_dynamic_state, depth_mode, part);
+        pipelines.library_parts_ms += millisecondsSince(start);
+        pipelines.library_parts.push_back(library);
+        return library;
+    };
+    // the fragment shader parts of the pipelines with one layout, the prepass has no fragment shader but still a fragment part
+    auto create_fragment_parts = [&](VkPipelineLayout layout, const VkPipelineShaderStageCreateInfo& fragment_stage) {
+        std::array<VkPipeline, DEPTH_MODE_COUNT> parts{};
+        createDepthModePipelines(extended_dynamic_state, parts, [&](DepthMode depth_mode) {
+            return create_part(VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT, layout, std::span(&fragment_stage, 1), false, depth_mode);
+        });
+        return parts;
+    };
+    // color, and the prepass' output without color writes
+    std::array<VkPipeline, 2> output_parts{};
+    if (pipeline_libraries) {
+        output_parts[0] = create_part(VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT, pipelines.layout, {}, false, DepthMode::TestAndWrite);
+        output_parts[1] = create_part(VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT, pipelines.layout, {}, false, DepthMode::Prepass);
+    }
+    // One kind of scene pipeline in every DepthMode. Compiled whole, or its stages are compiled into a pre-rasterization part and it
+    // is fast linked from that and the shared parts. The fragment stage is the last of stages.
+    auto create_kind = [&](VkPipelineLayout layout, std::span<const VkPipelineShaderStageCreateInfo> stages, bool fixed_function_vertex_input,
+                           VkPipeline vertex_input_part, const std::array<VkPipeline, DEPTH_MODE_COUNT>& fragment_parts,
+                           std::array<PipelineParts, DEPTH_MODE_COUNT>& kind_parts, std::array<VkPipeline, DEPTH_MODE_COUNT>& kind_pipelines) {
+        if (!pipeline_libraries) {
+            createDepthModePipelines(extended_dynamic_state, kind_pipelines, [&](DepthMode depth_mode) {
+                return createPipeline(device, cache, layout, stages, fixed_function_vertex_input, color_attachment_format, depth_attachment_format, samples,
+                                      sample_shading, extended_dynamic_state, depth_mode);
+            });
+            return;
+        }
+        const VkPipeline pre_rasterization = create_part(VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT, layout,
+                                                         stages.first(stages.size() - 1), false, DepthMode::TestAndWrite);
+        for (size_t mode = 0; mode < DEPTH_MODE_COUNT; ++mode) {
+            const VkPipeline output_part = output_parts[static_cast<DepthMode>(mode) == DepthMode::Prepass ? 1 : 0];
+            kind_parts[mode] = PipelineParts{vertex_input_part, pre_rasterization, fragment_parts[mode], output_part};
+        }
+        createDepthModePipelines(extended_dynamic_state, kind_pipelines, [&](DepthMode depth_mode) {
+            const auto start = std::chrono::steady_clock::now();
+            const VkPipeline pipeline = linkPipeline(device, cache, layout, kind_parts[static_cast<size_t>(depth_mode)], false);
+            pipelines.fast_link_ms += millisecondsSince(start);
+            return pipeline;
+        });
+    };
+
+    const VkShaderModule pulling_module = createShaderModule(device, spv_vertex);
+    const VkShaderModule vertex_input_module = createShaderModule(device, spv_vertex_input);
+    const VkShaderModule fragment_module = createShaderModule(device, spv_fragment);
+
+    const std::array<VkPipelineShaderStageCreateInfo, 2> pulling_stages{shaderStage(VK_SHADER_STAGE_VERTEX_BIT, pulling_module),
+                                                                        shaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, fragment_module)};
+    const std::array<VkPipelineShaderStageCreateInfo, 2> vertex_input_stages{shaderStage(VK_SHADER_STAGE_VERTEX_BIT, vertex_input_module),
+                                                                             shaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, fragment_module)};
+    std::array<VkPipeline, DEPTH_MODE_COUNT> fragment_parts{};
+    VkPipeline pulling_input_part = VK_NULL_HANDLE;
+    VkPipeline fixed_function_input_part = VK_NULL_HANDLE;
+    if (pipeline_libraries) {
+        fragment_parts = create_fragment_parts(pipelines.layout, pulling_stages[1]);
+        pulling_input_part = create_part(VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT, pipelines.layout, {}, false, DepthMode::TestAndWrite);
+        fixed_function_input_part =
+            create_part(VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT, pipelines.layout, {}, true, DepthMode::TestAndWrite);
+    }
+    create_kind(pipelines.layout, pulling_stages, false, pulling_input_part, fragment_parts, pipelines.vertex_pulling_parts, pipelines.vertex_pulling);
+    create_kind(pipelines.layout, vertex_input_stages, true, fixed_function_input_part, fragment_parts, pipelines.vertex_input_parts,
+                pipelines.vertex_input);
+
+    { // meshlet culling in a compute pass, for devices without mesh shaders
+        pipelines.meshlet_cull_layout = createPipelineLayout(device, set_layout, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(MeshletCullConstants));
+        pipelines.meshlet_cull = createComputePipeline(device, cache, pipelines.meshlet_cull_layout, spv_meshlet_cull);
+    }
+
+    if (depth_pyramid_set_layout != VK_NULL_HANDLE) {
+        pipelines.depth_pyramid_layout = createPipelineLayout(device, depth_pyramid_set_layout, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(DepthPyramidConstants));
+        pipelines.depth_pyramid = createComputePipeline(device, cache, pipelines.depth_pyramid_layout, spv_depth_pyramid);
+    }
+
+    if (post_process_set_layout != VK_NULL_HANDLE) {
+        pipelines.post_process_layout = createPipelineLayout(device, post_process_set_layout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(PostProcessConstants));
+        pipelines.post_process = createPostProcessPipeline(device, cache, pipelines.post_process_layout, color_attachment_format);
+    }
+
+    if (mesh_shading) {
+        pipelines.mesh_shading_layout =
+            createPipelineLayout(device, set_layout, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT, sizeof(MeshShadingConstants));
+        const VkShaderModule task_module = createShaderModule(device, spv_task);
+        const VkShaderModule mesh_module = createShaderModule(device, spv_mesh);
+        const std::array<VkPipelineShaderStageCreateInfo, 3> mesh_stages{shaderStage(VK_SHADER_STAGE_TASK_BIT_EXT, task_module),
+                                                                         shaderStage(VK_SHADER_STAGE_MESH_BIT_EXT, mesh_module),
+                                                                         shaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, fragment_module)};
+        // the fragment shader parts above were created with the other layout
+        std::array<VkPipeline, DEPTH_MODE_COUNT> mesh_fragment_parts{};
+        if (pipeline_libraries) mesh_fragment_parts = create_fragment_parts(pipelines.mesh_shading_layout, mesh_stages[2]);
+        create_kind(pipelines.mesh_shading_layout, mesh_stages, false, VK_NULL_HANDLE, mesh_fragment_parts, pipelines.mesh_shading_parts,
+                    pipelines.mesh_shading);
+        vkDestroyShaderModule(device, mesh_module, nullptr);
+        vkDestroyShaderModule(device, task_module, nullptr);
+    }
+
+    vkDestroyShaderModule(device, fragment_module, nullptr);
+    vkDestroyShaderModule(device, vertex_input_module, nullptr);
+    vkDestroyShaderModule(device, pulling_module, nullptr);
+}
+
+// Whether data starts with the header the driver writes for this device. Data from another driver version or GPU would be ignored
+// by the driver at best, so it is not handed over.
+static bool pipelineCacheMatches(const Device& device, const MappedFile& data)
+{
+    VkPipelineCacheHeaderVersionOne header{};
+    if (data.size < sizeof(header)) return false;
+    std::memcpy(&header, data.data, sizeof(header));
+    return header.headerSize >= sizeof(header) && header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == device.properties.vendorID && header.deviceID == device.properties.deviceID &&
+           std::memcmp(header.pipelineCacheUUID, device.properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+VkPipelineCache createPipelineCache(const Device& device, const std::string& path, size_t& loaded_bytes)
+{
+    MappedFile data{};
+    const bool mapped = !path.empty() && mapFile(path, data);
+    const bool matches = mapped && pipelineCacheMatches(device, data);
+    loaded_bytes = matches ? data.size : 0;
+
+    VkPipelineCacheCreateInfo cache_info{};
+    cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cache_info.flags = 0; // internally synchronised, the optimised link thread creates pipelines through it too
+    cache_info.initialDataSize = loaded_bytes;
+    cache_info.pInitialData = matches ? data.data : nullptr;
+    VkPipelineCache cache = VK_NULL_HANDLE;
+    const VkResult result = vkCreatePipelineCache(device.device, &cache_info, nullptr, &cache);
+    if (mapped) unmapFile(data);
+    VKCHECK(result);
+    return cache;
+}
+
+void destroyPipelineCache(const Device& device, VkPipelineCache cache, const std::string& path)
+{
+    size_t size = 0;
+    if (!path.empty() && vkGetPipelineCacheData(device.device, cache, &size, nullptr) == VK_SUCCESS && size > 0) {
+        std::vector<char> data(size);
+        if (vkGetPipelineCacheData(device.device, cache, &size, data.data()) == VK_SUCCESS) {
+            std::ofstream file(path, std::ios::binary);
+            if (file) file.write(data.data(), static_cast<std::streamsize>(size));
+        }
+    }
+    vkDestroyPipelineCache(device.device, cache, nullptr);
+}
+
+// the entries of a DepthMode array that are not repeats of an earlier one
+static bool distinctPipeline(const std::array<VkPipeline, DEPTH_MODE_COUNT>& pipelines, size_t mode)
+{
+    if (pipelines[mode] == VK_NULL_HANDLE) return false;
+    for (size_t earlier = 0; earlier < mode; ++earlier) {
+        if (pipelines[earlier] == pipelines[mode]) return false;
+    }
+    return true;
+}
+
+void destroyPipelines(VkDevice device, const Pipelines& pipelines)
+{
+    for (size_t mode = 0; mode < DEPTH_MODE_COUNT; ++mode) {
+        if (distinctPipeline(pipelines.mesh_shading, mode)) vkDestroyPipeline(device, pipelines.mesh_shading[mode], nullptr);
+        if (distinctPipeline(pipelines.vertex_input, mode)) vkDestroyPipeline(device, pipelines.vertex_input[mode], nullptr);
+        if (distinctPipeline(pipelines.vertex_pulling, mode)) vkDestroyPipeline(device, pipelines.vertex_pulling[mode], nullptr);
+    }
+    for (const VkPipeline part : pipelines.library_parts) {
+        vkDestroyPipeline(device, part, nullptr);
+    }
+    vkDestroyPipelineLayout(device, pipelines.mesh_shading_layout, nullptr);
+    vkDestroyPipeline(device, pipelines.post_process, nullptr);
+    vkDestroyPipelineLayout(device, pipelines.post_process_layout, nullptr);
+    vkDestroyPipeline(device, pipelines.depth_pyramid, nullptr);
+    vkDestroyPipelineLayout(device, pipelines.depth_pyramid_layout, nullptr);
+    vkDestroyPipeline(device, pipelines.meshlet_cull, nullptr);
+    vkDestroyPipelineLayout(device, pipelines.meshlet_cull_layout, nullptr);
+    vkDestroyPipelineLayout(device, pipelines.layout, nullptr);
+}
+
+uint32_t graphicsPipelineCount(const Pipelines& pipelines)
+{
+    uint32_t count = pipelines.post_process != VK_NULL_HANDLE ? 1 : 0;
+    for (size_t mode = 0; mode < DEPTH_MODE_COUNT; ++mode) {
+        count += distinctPipeline(pipelines.vertex_pulling, mode) + distinctPipeline(pipelines.vertex_input, mode) +
+                 distinctPipeline(pipelines.mesh_shading, mode);
+    }
+    return count;
+}
+
+void linkOptimisedPipelines(VkDevice device, VkPipelineCache cache, const Pipelines& pipelines, LinkedPipelines& linked)
+{
+    const auto start = std::chrono::steady_clock::now();
+    auto link_kind = [&](VkPipelineLayout layout, const std::array<PipelineParts, DEPTH_MODE_COUNT>& parts,
+                         const std::array<VkPipeline, DEPTH_MODE_COUNT>& fast_linked, std::array<VkPipeline, DEPTH_MODE_COUNT>& optimised) {
+        for (size_t mode = 0; mode < DEPTH_MODE_COUNT; ++mode) {
+            if (distinctPipeline(fast_linked, mode)) {
+                optimised[mode] = linkPipeline(device, cache, layout, parts[mode], true);
+            }
+            else {
+                // shared like the fast linked ones
+                const auto earlier = std::find(fast_linked.begin(), fast_linked.end(), fast_linked[mode]);
+                optimised[mode] = optimised[static_cast<size_t>(earlier - fast_linked.begin())];
+            }
+        }
+    };
+    link_kind(pipelines.layout, pipelines.vertex_pulling_parts, pipelines.vertex_pulling, linked.vertex_pulling);
+    link_kind(pipelines.layout, pipelines.vertex_input_parts, pipelines.vertex_input, linked.vertex_input);
+    link_kind(pipelines.mesh_shading_layout, pipelines.mesh_shading_parts, pipelines.mesh_shading, linked.mesh_shading);
+    linked.link_ms = millisecondsSince(start);
+}
+
+void swapLinkedPipelines(Pipelines& pipelines, LinkedPipelines& linked)
+{
+    std::swap(pipelines.vertex_pulling, linked.vertex_pulling);
+    std::swap(pipelines.vertex_input, linked.vertex_input);
+    std::swap(pipelines.mesh_shading, linked.mesh_shading);
+}
+
+void destroyLinkedPipelines(VkDevice device, const LinkedPipelines& linked)
+{
+    for (size_t mode = 0; mode < DEPTH_MODE_COUNT; ++mode) {
+        if (distinctPipeline(linked.mesh_shading, mode)) vkDestroyPipeline(device, linked.mesh_shading[mode], nullptr);
+        if (distinctPipeline(linked.vertex_input, mode)) vkDestroyPipeline(device, linked.vertex_input[mode], nullptr);
+        if (distinctPipeline(linked.vertex_pulling, mode)) vkDestroyPipeline(device, linked.vertex_pulling[mode], nullptr);
+    }
 }
\ No newline at end of file
@@ -1,9 +1,198 @@
 #pragma once
 
+#include <cstddef>
+
+#include <array>
+#include <string>
+#include <vector>
+
 #include "vulkan_headers.h"
 
-constexpr uint32_t PUSH_CONSTANT_SIZE = 16;
+struct Device;
+
+// shader interface, must match the shaders
+
+// set 0 binding 0, uniform buffer with a dynamic offset into the stream buffer
+struct FrameConstants {
+    float view_proj[16]; // column major
+};
+
+// set 0 binding 1 is the depth pyramid (vulkan_depth_pyramid.h), sampled by the meshlet culling shaders
+
+// Occlusion culling runs each meshlet culling shader twice a frame. The first phase culls against the depth pyramid built during
+// the previous frame and records what it found occluded, the second re-tests only those against the pyramid of what the first drew.
+enum class OcclusionPhase : uint32_t {
+    Off,
+    First,
+    Second,
+};
+
+// The world transform of an entity (WorldTransform in entity_store.h), read through a buffer device address and indexed by entity id.
+// Each draw finds its entity through a uint32_t array of entity ids, indexed by the draw's firstInstance.
+struct DrawParams {
+    float transform[4];   // 2x2 column major
+    float translation[4]; // xyz, w is unused padding
+};
+
+struct PushConstants {
+    VkDeviceAddress draw_params;
+    VkDeviceAddress draw_entities;
+    VkDeviceAddress vertices; // PackedVertex array, only read by vertex pulling
+    float position_scale;
+    float padding;
+};
+
+constexpr uint32_t PUSH_CONSTANT_SIZE = sizeof(PushConstants);
+
+// VkDrawIndexedIndirectCommand
+constexpr VkDeviceSize DRAW_COMMAND_SIZE = 20;
+
+// meshlet_cull.comp, one dispatch per submesh
+struct MeshletCullConstants {
+    VkDeviceAddress draw_params;
+    VkDeviceAddress draw_entities;
+    VkDeviceAddress meshlets; // Meshlet array (mesh.h)
+    VkDeviceAddress commands;  // meshlet_count draw commands per instance, written from first_instance on
+    VkDeviceAddress occlusion; // one uint32_t per command, set by the first phase for the meshlets it found occluded
+    uint32_t first_meshlet;
+    uint32_t meshlet_count;
+    uint32_t first_instance; // of this dispatch, each workgroup row is one instance
+    int32_t vertex_offset;
+    OcclusionPhase occlusion_phase;
+    uint32_t padding;
+};
+
+// meshlet.task and meshlet.mesh, one draw per submesh
+struct MeshShadingConstants {
+    VkDeviceAddress draw_params;
+    VkDeviceAddress draw_entities;
+    VkDeviceAddress vertices;
+    VkDeviceAddress meshlets;
+    VkDeviceAddress meshlet_vertices;
+    VkDeviceAddress meshlet_triangles;
+    VkDeviceAddress occlusion; // meshlet_count uint32_t per draw, as in MeshletCullConstants
+    float position_scale;
+    uint32_t first_meshlet;
+    uint32_t meshlet_count;
+    uint32_t first_instance;
+    int32_t vertex_offset;
+    OcclusionPhase occlusion_phase;
+};
+
+// depth_pyramid.comp, one dispatch builds every level
+struct DepthPyramidConstants {
+    VkDeviceAddress counter; // uint32_t, zeroed before the dispatch
+    uint32_t depth_extent[2];
+    uint32_t extent[2]; // of level 0
+    uint32_t level_count;
+    uint32_t workgroup_count;
+};
+
+// post_process.frag, one fullscreen triangle over the swapchain image samples the render target
+struct PostProcessConstants {
+    float uv_scale[2];   // the drawn part of the render target, in its texture coordinates
+    float texel_size[2]; // 1 / the render target's extent
+};
+
+constexpr uint32_t MESHLET_CULL_WORKGROUP_SIZE = 64; // meshlets per meshlet_cull.comp workgroup
+constexpr uint32_t TASK_WORKGROUP_SIZE = 32;         // meshlets per meshlet.task workgroup
+constexpr uint32_t DEPTH_PYRAMID_TILE = 32;          // level 0 texels square per depth_pyramid.comp workgroup
+constexpr uint32_t DEPTH_PYRAMID_MAX_LEVELS = 16;    // the size of depth_pyramid.comp's image array
+
+// How a graphics pipeline uses the depth buffer. Depth is reversed Z: cleared to 0, nearer fragments have greater depth.
+enum class DepthMode {
+    TestAndWrite, // no prepass, the nearest fragment so far wins
+    Prepass,      // depth only, no fragment shader and no color writes
+    Equal,        // color after a prepass, only the fragment that set each pixel's depth is shaded
+};
+constexpr size_t DEPTH_MODE_COUNT = 3;
+
+// The VK_EXT_graphics_pipeline_library parts a scene pipeline is linked from: vertex input, pre-rasterization shaders, fragment
+// shader and fragment output. Mesh shading pipelines have no vertex input part.
+using PipelineParts = std::array<VkPipeline, 4>;
+
+// The graphics pipelines draw the same PackedVertex meshes and share a layout, each comes in every DepthMode.
+// With extended dynamic state (core in Vulkan 1.3) cull mode, front face, topology and the depth test, write and compare op are set
+// while recording, so TestAndWrite and Equal are the same pipeline and only the depth only prepass needs one of its own.
+// The meshlet pipelines are alternatives that cull clusters first, see ClusterCulling in app.h.
+struct Pipelines {
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    std::array<VkPipeline, DEPTH_MODE_COUNT> vertex_pulling{}; // no vertex input state, vertices are fetched through PushConstants::vertices
+    std::array<VkPipeline, DEPTH_MODE_COUNT> vertex_input{};   // fixed function vertex input from binding 0, kept to compare against
+
+    VkPipelineLayout meshlet_cull_layout = VK_NULL_HANDLE;
+    VkPipeline meshlet_cull = VK_NULL_HANDLE; // compute, writes indirect draws for either graphics pipeline above
+    VkPipelineLayout mesh_shading_layout = VK_NULL_HANDLE;
+    std::array<VkPipeline, DEPTH_MODE_COUNT> mesh_shading{}; // task and mesh shaders, VK_NULL_HANDLE without VK_EXT_mesh_shader
+
+    VkPipelineLayout depth_pyramid_layout = VK_NULL_HANDLE;
+    VkPipeline depth_pyramid = VK_NULL_HANDLE; // compute, builds the depth pyramid occlusion culling tests against
+
+    VkPipelineLayout post_process_layout = VK_NULL_HANDLE;
+    VkPipeline post_process = VK_NULL_HANDLE; // AntiAliasing::PostProcess, single sampled and without depth
+
+    bool extended_dynamic_state = false; // the scene pipelines need recordRasterState() and recordDepthMode()
+
+    // With pipeline libraries the scene pipelines are fast linked from parts, each compiled once and shared by every pipeline that
+    // uses it. The parts are kept for linkOptimisedPipelines().
+    bool pipeline_libraries = false;
+    std::vector<VkPipeline> library_parts{};
+    std::array<PipelineParts, DEPTH_MODE_COUNT> vertex_pulling_parts{};
+    std::array<PipelineParts, DEPTH_MODE_COUNT> vertex_input_parts{};
+    std::array<PipelineParts, DEPTH_MODE_COUNT> mesh_shading_parts{};
+    double library_parts_ms = 0.0; // compiling the parts
+    double fast_link_ms = 0.0;     // linking the scene pipelines from them
+};
+
+// Scene pipelines linked again from Pipelines' parts with link time optimisation. Slower to link than the fast linked ones, but as
+// fast to draw with as pipelines compiled whole.
+struct LinkedPipelines {
+    std::array<VkPipeline, DEPTH_MODE_COUNT> vertex_pulling{};
+    std::array<VkPipeline, DEPTH_MODE_COUNT> vertex_input{};
+    std::array<VkPipeline, DEPTH_MODE_COUNT> mesh_shading{};
+    double link_ms = 0.0;
+};
+
+// mesh_shading adds the task and mesh stages, only allowed if Device::meshShader is set
+VkDescriptorSetLayout createFrameDescriptorSetLayout(VkDevice device, bool mesh_shading);
+
+// depth_pyramid.comp's set, the depth buffer and a storage image for each level
+VkDescriptorSetLayout createDepthPyramidSetLayout(VkDevice device);
+
+// post_process.frag's set, the render target
+VkDescriptorSetLayout createPostProcessSetLayout(VkDevice device);
+
+// Starts with the data destroyPipelineCache() saved to path on an earlier run, if the same driver and device saved it, so pipelines
+// already compiled then are not compiled again. loaded_bytes is what was taken from the file, 0 for an empty cache.
+VkPipelineCache createPipelineCache(const Device& device, const std::string& path, size_t& loaded_bytes);
+// Saves the cache to path for the next run, nothing is saved if path is empty or cannot be written.
+void destroyPipelineCache(const Device& device, VkPipelineCache cache, const std::string& path);
+
+// The depth pyramid pipeline is only created if depth_pyramid_set_layout is not VK_NULL_HANDLE.
+// The graphics pipelines' viewport and scissor are dynamic state, so they do not depend on the render extent.
+// The scene pipelines draw with samples per pixel, sample_shading runs their fragment shader per sample and needs
+// Device::sampleRateShading. The post process pipeline is always single sampled.
+// extended_dynamic_state leaves the scene pipelines' raster and depth state to be set while recording, otherwise it is baked in.
+// pipeline_libraries fast links the scene pipelines from parts instead of compiling each whole, only allowed if
+// Device::graphicsPipelineLibrary is set. Every pipeline and part goes through cache, which may be VK_NULL_HANDLE.
+void createPipelines(VkDevice device, VkPipelineCache cache, VkDescriptorSetLayout set_layout, VkDescriptorSetLayout depth_pyramid_set_layout,
+                     VkDescriptorSetLayout post_process_set_layout, VkFormat color_attachment_format, VkFormat depth_attachment_format,
+                     VkSampleCountFlagBits samples, bool sample_shading, bool mesh_shading, bool extended_dynamic_state, bool pipeline_libraries,
+                     Pipelines& pipelines);
+
+void destroyPipelines(VkDevice device, const Pipelines& pipelines);
+
+// Needs Pipelines::pipeline_libraries. Only reads pipelines, so it can run on another thread while they are drawn with.
+void linkOptimisedPipelines(VkDevice device, VkPipelineCache cache, const Pipelines& pipelines, LinkedPipelines& linked);
+// Exchanges the scene pipelines for linked's, leaving linked with the ones that were in use
+void swapLinkedPipelines(Pipelines& pipelines, LinkedPipelines& linked);
+void destroyLinkedPipelines(VkDevice device, const LinkedPipelines& linked);
 
-VkPipeline createPipelineAndLayout(VkDevice device, VkFormat color_attachment_format, VkExtent2D extent, VkPipelineLayout& layout);
+// distinct graphics pipeline objects, shared DepthMode entries count once
+uint32_t graphicsPipelineCount(const Pipelines& pipelines);
 
-void destroyPipelineAndLayout(VkDevice device, VkPipeline pipeline, VkPipelineLayout layout);
\ No newline at end of file
+// With Pipelines::extended_dynamic_state, the cull mode, front face and topology every scene pipeline draws with. Once per command
+// buffer, before the first draw.
+void recordRasterState(VkCommandBuffer cmd);
+// With Pipelines::extended_dynamic_state, the depth state of depth_mode. Pipelines that have it dynamic keep it across binds.
+void recordDepthMode(VkCommandBuffer cmd, DepthMode depth_mode);
@@ -0,0 +1,77 @@
+#include "vulkan_stream_buffer.h"
+
+#include <algorithm>
+
+#include "error.h"
+#include "vulkan_device.h"
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) { return (value + alignment - 1) & ~(alignment - 1); }
+
+void createStreamBuffer(const Device& device, VkDeviceSize region_size, uint32_t region_count, StreamBuffer& stream)
+{
+    const VkPhysicalDeviceLimits& limits = device.properties.limits;
+    // 16 for the std430 buffer references in the shaders, the limits are powers of two
+    stream.alignment = std::max({limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment, VkDeviceSize{16}});
+    stream.region_size = alignUp(region_size, stream.alignment);
+    stream.region_count = region_count;
+    stream.region = 0;
+    stream.offset = 0;
+
+    VkBufferCreateInfo buffer_info{};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = stream.region_size * region_count;
+    buffer_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+                        VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VKCHECK(vkCreateBuffer(device.device, &buffer_info, nullptr, &stream.buffer));
+
+    VkMemoryRequirements reqs{};
+    vkGetBufferMemoryRequirements(device.device, stream.buffer, &reqs);
+
+    // device local host visible memory (resizable BAR or integrated GPUs) saves the shaders reading over PCIe
+    uint32_t memory_type = 0;
+    if (!findMemoryType(device, reqs.memoryTypeBits,
+                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, memory_type) &&
+        !findMemoryType(device, reqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, memory_type)) {
+        throw Error("No host coherent memory type for the stream buffer");
+    }
+
+    stream.allocation = allocateMemory(device, reqs, memory_type, MemoryCategory::Stream, true);
+    VKCHECK(vkBindBufferMemory(device.device, stream.buffer, stream.allocation.memory, stream.allocation.offset));
+    stream.mapped = static_cast<std::byte*>(stream.allocation.mapped);
+
+    VkBufferDeviceAddressInfo address_info{};
+    address_info.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+    address_info.buffer = stream.buffer;
+    stream.address = vkGetBufferDeviceAddress(device.device, &address_info);
+}
+
+void destroyStreamBuffer(const Device& device, StreamBuffer& stream)
+{
+    if (stream.buffer == VK_NULL_HANDLE) return;
+    vkDestroyBuffer(device.device, stream.buffer, nullptr);
+    freeMemory(device, stream.allocation);
+    stream = StreamBuffer{};
+}
+
+void beginStreamFrame(StreamBuffer& stream, uint32_t region)
+{
+    stream.region = region % stream.region_count;
+    stream.offset = 0;
+}
+
+VkDeviceSize streamAllocationSize(const StreamBuffer& stream, VkDeviceSize size) { return alignUp(size, stream.alignment); }
+
+bool streamAllocate(StreamBuffer& stream, VkDeviceSize size, StreamAllocation& allocation)
+{
+    const VkDeviceSize aligned_size = streamAllocationSize(stream, size);
+    if (aligned_size > stream.region_size - stream.offset) return false;
+
+    const VkDeviceSize offset = stream.region * stream.region_size + stream.offset;
+    stream.offset += aligned_size;
+
+    allocation.data = stream.mapped + offset;
+    allocation.offset = offset;
+    allocation.address = stream.address + offset;
+    return true;
+}
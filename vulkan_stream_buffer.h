@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "vulkan_headers.h"
+#include "vulkan_memory.h"
+
+struct Device;
+
+// Persistently mapped, host coherent buffer for data the CPU writes every frame (frame constants, draw lists, changes copied into device local buffers).
+// It is split into one region per frame in flight. beginStreamFrame() must only be called for a region once the fence of the
+// frame that last used it has been waited on, so the CPU never overwrites anything the GPU may still be reading.
+struct StreamBuffer {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    MemoryAllocation allocation{};
+    std::byte* mapped = nullptr;
+    VkDeviceAddress address = 0;
+
+    VkDeviceSize region_size = 0;
+    uint32_t region_count = 0;
+    VkDeviceSize alignment = 0; // meets minUniformBufferOffsetAlignment and minStorageBufferOffsetAlignment
+
+    uint32_t region = 0;     // being written this frame
+    VkDeviceSize offset = 0; // within the region
+};
+
+struct StreamAllocation {
+    void* data = nullptr;
+    VkDeviceSize offset = 0;     // from the start of the buffer, for dynamic offsets
+    VkDeviceAddress address = 0; // for buffer device address access
+};
+
+// Memory is allocated once here, never per frame.
+void createStreamBuffer(const Device& device, VkDeviceSize region_size, uint32_t region_count, StreamBuffer& stream);
+void destroyStreamBuffer(const Device& device, StreamBuffer& stream);
+
+void beginStreamFrame(StreamBuffer& stream, uint32_t region);
+
+// space size takes up in a region once aligned
+VkDeviceSize streamAllocationSize(const StreamBuffer& stream, VkDeviceSize size);
+
+// Returns false if the current region is full. The memory is write only, it is usually uncached.
+bool streamAllocate(StreamBuffer& stream, VkDeviceSize size, StreamAllocation& allocation);
@@ -1,76 +1,90 @@
 #include "vulkan_swapchain.h"
 
+#include <algorithm>
 #include <vector>
 
 #include "error.h"
 #include "vulkan_device.h"
 
-void createVulkanSwapchain(VkInstance instance, const Device& device, HINSTANCE hInstance, HWND hWnd, Swapchain& swapchain)
+static VkImageView createImageView(const Device& device, VkImage image, VkFormat format)
 {
-    VkWin32SurfaceCreateInfoKHR surfaceInfo{};
-    surfaceInfo.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
-    surfaceInfo.hinstance = hInstance;
-    surfaceInfo.hwnd = hWnd;
-    VKCHECK(vkCreateWin32SurfaceKHR(instance, &surfaceInfo, nullptr, &swapchain.surface));
-    VkBool32 surface_supported = VK_FALSE;
-    VKCHECK(vkGetPhysicalDeviceSurfaceSupportKHR(device.physicalDevice, 0, swapchain.surface, &surface_supported));
-    if (surface_supported != VK_TRUE) {
-        throw Error("Surface is unsupported!");
-    }
-    uint32_t surface_format_count = 0;
-    VKCHECK(vkGetPhysicalDeviceSurfaceFormatsKHR(device.physicalDevice, swapchain.surface, &surface_format_count, nullptr));
-    if (surface_format_count == 0) {
-        throw Error("No surface formats found!");
-    }
-    std::vector<VkSurfaceFormatKHR> surface_formats(surface_format_count);
-    VKCHECK(vkGetPhysicalDeviceSurfaceFormatsKHR(device.physicalDevice, swapchain.surface, &surface_format_count, surface_formats.data()));
-
-    swapchain.surface_format = surface_formats[0];
-    for (VkSurfaceFormatKHR format : surface_formats) {
-        if (format.format == VK_FORMAT_B8G8R8A8_SRGB &&
-            format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
-            swapchain.surface_format = format; // prefer using srgb non linear colors
-        }
-    }
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.pNext = nullptr;
+    viewInfo.flags = 0;
+    viewInfo.image = image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+    viewInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+    viewInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+    viewInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+    VkImageView imageView = VK_NULL_HANDLE;
+    VKCHECK(vkCreateImageView(device.device, &viewInfo, nullptr, &imageView));
+    return imageView;
+}
 
+// creates the swapchain and its image views for swapchain.surface and swapchain.surface_format
+static void createSwapchainImages(const Device& device, VkExtent2D window_extent, VkSwapchainKHR old_swapchain, Swapchain& swapchain)
+{
     VkSurfaceCapabilitiesKHR surface_caps{};
     VKCHECK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device.physicalDevice, swapchain.surface, &surface_caps));
 
     swapchain.extent = surface_caps.currentExtent;
+    if (surface_caps.currentExtent.width == UINT32_MAX) {
+        // the surface size is determined by the swapchain
+        swapchain.extent.width = std::clamp(window_extent.width, surface_caps.minImageExtent.width, surface_caps.maxImageExtent.width);
+        swapchain.extent.height = std::clamp(window_extent.height, surface_caps.minImageExtent.height, surface_caps.maxImageExtent.height);
+    }
 
     /* get min image count */
-    uint32_t min_image_count = surface_caps.minImageCount + 1;
+    uint32_t min_image_count = swapchain.preferred_image_count > 0 ? swapchain.preferred_image_count : surface_caps.minImageCount + 1;
+    min_image_count = std::max(min_image_count, surface_caps.minImageCount);
     if (surface_caps.maxImageCount > 0 && min_image_count > surface_caps.maxImageCount) {
         min_image_count = surface_caps.maxImageCount;
     }
 
-    // use mailbox if supported
+    // use the preferred present mode if supported, FIFO always is
     uint32_t num_present_modes = 0;
     VKCHECK(vkGetPhysicalDeviceSurfacePresentModesKHR(device.physicalDevice, swapchain.surface, &num_present_modes, nullptr));
     std::vector<VkPresentModeKHR> available_present_modes(num_present_modes);
     VKCHECK(vkGetPhysicalDeviceSurfacePresentModesKHR(device.physicalDevice, swapchain.surface, &num_present_modes, available_present_modes.data()));
-    VkPresentModeKHR chosen_present_mode = VK_PRESENT_MODE_FIFO_KHR;
+    swapchain.present_mode = VK_PRESENT_MODE_FIFO_KHR;
     for (VkPresentModeKHR mode : available_present_modes) {
-        if (mode == VK_PRESENT_MODE_MAILBOX_KHR) {
-            chosen_present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+        if (mode == swapchain.preferred_present_mode) {
+            swapchain.present_mode = mode;
         }
     }
 
+    // the images are copied from when frames are captured, and blitted to by dynamic resolution, if the surface allows it
+    swapchain.image_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    if (surface_caps.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) {
+        swapchain.image_usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
+    if (surface_caps.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) {
+        swapchain.image_usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    }
+
     VkSwapchainCreateInfoKHR sc_info{};
     sc_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
     sc_info.surface = swapchain.surface;
     sc_info.minImageCount = min_image_count;
     sc_info.imageFormat = swapchain.surface_format.format;
     sc_info.imageColorSpace = swapchain.surface_format.colorSpace;
-    sc_info.imageExtent = surface_caps.currentExtent;
+    sc_info.imageExtent = swapchain.extent;
     sc_info.imageArrayLayers = 1;
-    sc_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    sc_info.imageUsage = swapchain.image_usage;
     sc_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
     sc_info.preTransform = surface_caps.currentTransform;
     sc_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-    sc_info.presentMode = chosen_present_mode;
+    sc_info.presentMode = swapchain.present_mode;
     sc_info.clipped = VK_TRUE;
-    sc_info.oldSwapchain = VK_NULL_HANDLE;
+    sc_info.oldSwapchain = old_swapchain;
     VKCHECK(vkCreateSwapchainKHR(device.device, &sc_info, nullptr, &swapchain.swapchain));
 
     uint32_t swapchainImageCount = 0;
@@ -78,27 +92,94 @@ void createVulkanSwapchain(VkInstance instance, const Device& device, HINSTANCE
     std::vector<VkImage> swapchainImages(swapchainImageCount);
     VKCHECK(vkGetSwapchainImagesKHR(device.device, swapchain.swapchain, &swapchainImageCount, swapchainImages.data()));
 
-    for (size_t i = 0; i < swapchainImages.size(); ++i) {
-        // create image view
-        VkImageViewCreateInfo viewInfo{};
-        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-        viewInfo.pNext = nullptr;
-        viewInfo.flags = 0;
-        viewInfo.image = swapchainImages[i];
-        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-        viewInfo.format = sc_info.imageFormat;
-        viewInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-        viewInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-        viewInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-        viewInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        viewInfo.subresourceRange.baseMipLevel = 0;
-        viewInfo.subresourceRange.levelCount = 1;
-        viewInfo.subresourceRange.baseArrayLayer = 0;
-        viewInfo.subresourceRange.layerCount = 1;
-        VkImageView imageView = VK_NULL_HANDLE;
-        VKCHECK(vkCreateImageView(device.device, &viewInfo, nullptr, &imageView));
-        swapchain.images.emplace_back(std::make_pair(swapchainImages[i], imageView));
+    for (VkImage image : swapchainImages) {
+        swapchain.images.emplace_back(std::make_pair(image, createImageView(device, image, sc_info.imageFormat)));
+    }
+}
+
+
+VkSurfaceFormatKHR chooseSurfaceFormat(const Device& device, VkSurfaceKHR surface)
+{
+    uint32_t surface_format_count = 0;
+    VKCHECK(vkGetPhysicalDeviceSurfaceFormatsKHR(device.physicalDevice, surface, &surface_format_count, nullptr));
+    if (surface_format_count == 0) {
+        throw Error("No surface formats found!");
+    }
+    std::vector<VkSurfaceFormatKHR> surface_formats(surface_format_count);
+    VKCHECK(vkGetPhysicalDeviceSurfaceFormatsKHR(device.physicalDevice, surface, &surface_format_count, surface_formats.data()));
+
+    VkSurfaceFormatKHR chosen = surface_formats[0];
+    for (VkSurfaceFormatKHR format : surface_formats) {
+        if (format.format == VK_FORMAT_B8G8R8A8_SRGB &&
+            format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
+            chosen = format; // prefer using srgb non linear colors
+        }
+    }
+    return chosen;
+}
+
+void createVulkanSwapchain(const Device& device, VkSurfaceKHR surface, VkExtent2D window_extent, VkPresentModeKHR present_mode, uint32_t image_count,
+                           Swapchain& swapchain)
+{
+    swapchain.surface = surface;
+    swapchain.preferred_present_mode = present_mode;
+    swapchain.preferred_image_count = image_count;
+    VkBool32 surface_supported = VK_FALSE;
+    VKCHECK(vkGetPhysicalDeviceSurfaceSupportKHR(device.physicalDevice, 0, swapchain.surface, &surface_supported));
+    if (surface_supported != VK_TRUE) {
+        throw Error("Surface is unsupported!");
+    }
+    swapchain.surface_format = chooseSurfaceFormat(device, swapchain.surface);
+
+    createSwapchainImages(device, window_extent, VK_NULL_HANDLE, swapchain);
+}
+
+void recreateVulkanSwapchain(const Device& device, VkExtent2D window_extent, Swapchain& swapchain)
+{
+    for (auto [image, view] : swapchain.images) {
+        vkDestroyImageView(device.device, view, nullptr);
+    }
+    swapchain.images.clear();
+
+    const VkSwapchainKHR old_swapchain = swapchain.swapchain;
+    createSwapchainImages(device, window_extent, old_swapchain, swapchain);
+    vkDestroySwapchainKHR(device.device, old_swapchain, nullptr);
+}
+
+void createOffscreenSwapchain(const Device& device, VkFormat format, VkExtent2D extent, uint32_t image_count, Swapchain& swapchain)
+{
+    swapchain.surface_format.format = format;
+    swapchain.surface_format.colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+    swapchain.extent = extent;
+    swapchain.image_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+    for (uint32_t i = 0; i < image_count; ++i) {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = format;
+        imageInfo.extent = VkExtent3D{extent.width, extent.height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = swapchain.image_usage;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkImage image = VK_NULL_HANDLE;
+        VKCHECK(vkCreateImage(device.device, &imageInfo, nullptr, &image));
+
+        VkMemoryRequirements reqs{};
+        vkGetImageMemoryRequirements(device.device, image, &reqs);
+        uint32_t memoryType = 0;
+        if (!findMemoryType(device, reqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, memoryType)) {
+            throw Error("No device local memory type for offscreen images");
+        }
+        const MemoryAllocation memory = allocateMemory(device, reqs, memoryType, MemoryCategory::RenderTargets, false);
+        VKCHECK(vkBindImageMemory(device.device, image, memory.memory, memory.offset));
+
+        swapchain.offscreen_memory.push_back(memory);
+        swapchain.images.emplace_back(std::make_pair(image, createImageView(device, image, format)));
     }
 }
 
@@ -107,6 +188,13 @@ void destroyVulkanSwapchain(VkInstance instance, const Device& device, const Swa
     for (auto [image, view] : swapchain.images) {
         vkDestroyImageView(device.device, view, nullptr);
     }
-    vkDestroySwapchainKHR(device.device, swapchain.swapchain, nullptr);
-    vkDestroySurfaceKHR(instance, swapchain.surface, nullptr);
+    if (!swapchain.offscreen_memory.empty()) {
+        for (size_t i = 0; i < swapchain.images.size(); ++i) {
+            vkDestroyImage(device.device, swapchain.images[i].first, nullptr);
+            freeMemory(device, swapchain.offscreen_memory[i]);
+        }
+    }
+    // the swapchain functions are not loaded at all for headless instances
+    if (swapchain.swapchain != VK_NULL_HANDLE) vkDestroySwapchainKHR(device.device, swapchain.swapchain, nullptr);
+    if (swapchain.surface != VK_NULL_HANDLE) vkDestroySurfaceKHR(instance, swapchain.surface, nullptr);
 }
@@ -3,9 +3,8 @@
 #include <vector>
 #include <tuple>
 
-#include "framework.h"
-
 #include "vulkan_headers.h"
+#include "vulkan_memory.h"
 
 struct Device;
 
@@ -15,7 +14,24 @@ struct Swapchain {
     std::vector<std::pair<VkImage, VkImageView>> images{};
     VkSurfaceFormatKHR surface_format{};
     VkExtent2D extent{};
+    VkImageUsageFlags image_usage = 0;
+    VkPresentModeKHR preferred_present_mode = VK_PRESENT_MODE_FIFO_KHR;
+    VkPresentModeKHR present_mode = VK_PRESENT_MODE_FIFO_KHR; // preferred_present_mode if the surface supports it
+    uint32_t preferred_image_count = 0;                        // 0 for one more than the surface's minimum
+    std::vector<MemoryAllocation> offscreen_memory{}; // only used when there is no surface
 };
 
-void createVulkanSwapchain(VkInstance instance, const Device& device, HINSTANCE hInstance, HWND hWnd, Swapchain& swapchain);
+// The format createVulkanSwapchain() will pick for surface, B8G8R8A8_SRGB if it is supported
+VkSurfaceFormatKHR chooseSurfaceFormat(const Device& device, VkSurfaceKHR surface);
+// Takes ownership of surface. window_extent is used when the surface leaves the size up to the swapchain (Wayland).
+// FIFO is used if the surface does not support present_mode, and image_count is clamped to what it allows.
+void createVulkanSwapchain(const Device& device, VkSurfaceKHR surface, VkExtent2D window_extent, VkPresentModeKHR present_mode, uint32_t image_count,
+                           Swapchain& swapchain);
+// After a resize or VK_ERROR_OUT_OF_DATE_KHR. Keeps the surface, format, present mode and image count, the images must no longer be in use.
+void recreateVulkanSwapchain(const Device& device, VkExtent2D window_extent, Swapchain& swapchain);
+// Headless stand-in for a swapchain. The images are owned by the application and are never presented,
+// swapchain.swapchain and swapchain.surface stay VK_NULL_HANDLE.
+void createOffscreenSwapchain(const Device& device, VkFormat format, VkExtent2D extent, uint32_t image_count, Swapchain& swapchain);
+
+// destroys either kind of swapchain
 void destroyVulkanSwapchain(VkInstance instance, const Device& device, const Swapchain& swapchain);
\ No newline at end of file
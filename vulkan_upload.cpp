@@ -0,0 +1,111 @@
+#include "vulkan_upload.h"
+
+#include <cstddef>
+#include <cstring>
+
+#include <algorithm>
+
+#include "error.h"
+#include "vulkan_device.h"
+
+void createUploader(const Device& device, VkDeviceSize staging_size, Uploader& uploader)
+{
+    uploader.chunk_size = staging_size / 2;
+    createBuffer(device, uploader.chunk_size * 2, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 0,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryCategory::Staging, uploader.staging);
+
+    VkCommandPoolCreateInfo cmd_pool_info{};
+    cmd_pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    cmd_pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    cmd_pool_info.queueFamilyIndex = 0;
+    VKCHECK(vkCreateCommandPool(device.device, &cmd_pool_info, nullptr, &uploader.cmd_pool));
+
+    VkCommandBufferAllocateInfo cmd_buf_info{};
+    cmd_buf_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cmd_buf_info.commandPool = uploader.cmd_pool;
+    cmd_buf_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmd_buf_info.commandBufferCount = static_cast<uint32_t>(uploader.cmd_bufs.size());
+    VKCHECK(vkAllocateCommandBuffers(device.device, &cmd_buf_info, uploader.cmd_bufs.data()));
+
+    VkFenceCreateInfo fence_info{};
+    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    for (VkFence& fence : uploader.fences) {
+        VKCHECK(vkCreateFence(device.device, &fence_info, nullptr, &fence));
+    }
+    uploader.next_chunk = 0;
+}
+
+void destroyUploader(const Device& device, Uploader& uploader)
+{
+    if (uploader.cmd_pool == VK_NULL_HANDLE) return;
+    finishUploads(device, uploader);
+    for (VkFence fence : uploader.fences) {
+        vkDestroyFence(device.device, fence, nullptr);
+    }
+    vkDestroyCommandPool(device.device, uploader.cmd_pool, nullptr);
+    destroyBuffer(device, uploader.staging);
+    uploader = Uploader{};
+}
+
+void uploadToBuffer(const Device& device, Uploader& uploader, VkBuffer dst, VkDeviceSize dst_offset, VkDeviceSize size, const UploadFill& fill)
+{
+    for (VkDeviceSize offset = 0; offset < size; offset += uploader.chunk_size) {
+        const VkDeviceSize chunk_size = std::min(uploader.chunk_size, size - offset);
+        const uint32_t chunk = uploader.next_chunk;
+        uploader.next_chunk = (chunk + 1) % static_cast<uint32_t>(uploader.fences.size());
+
+        // this half of the staging buffer is free once its last copy has finished
+        VKCHECK(vkWaitForFences(device.device, 1, &uploader.fences[chunk], VK_TRUE, UINT64_MAX));
+        VKCHECK(vkResetFences(device.device, 1, &uploader.fences[chunk]));
+
+        const VkDeviceSize staging_offset = chunk * uploader.chunk_size;
+        fill(static_cast<std::byte*>(uploader.staging.mapped) + staging_offset, offset, chunk_size);
+
+        const VkCommandBuffer cmd = uploader.cmd_bufs[chunk];
+        VKCHECK(vkResetCommandBuffer(cmd, 0));
+        VkCommandBufferBeginInfo begin_info{};
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        VKCHECK(vkBeginCommandBuffer(cmd, &begin_info));
+
+        VkBufferCopy region{};
+        region.srcOffset = staging_offset;
+        region.dstOffset = dst_offset + offset;
+        region.size = chunk_size;
+        vkCmdCopyBuffer(cmd, uploader.staging.buffer, dst, 1, &region);
+
+        // later submissions may read the data at any stage
+        VkMemoryBarrier2 barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+        barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+        barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+        barrier.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        barrier.dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT;
+        VkDependencyInfo dependency_info{};
+        dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        dependency_info.memoryBarrierCount = 1;
+        dependency_info.pMemoryBarriers = &barrier;
+        vkCmdPipelineBarrier2(cmd, &dependency_info);
+
+        VKCHECK(vkEndCommandBuffer(cmd));
+
+        VkSubmitInfo submit_info{};
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &cmd;
+        VKCHECK(vkQueueSubmit(device.queue, 1, &submit_info, uploader.fences[chunk]));
+    }
+}
+
+void uploadToBuffer(const Device& device, Uploader& uploader, VkBuffer dst, VkDeviceSize dst_offset, const void* data, VkDeviceSize size)
+{
+    uploadToBuffer(device, uploader, dst, dst_offset, size, [data](void* staging, VkDeviceSize offset, VkDeviceSize chunk_size) {
+        memcpy(staging, static_cast<const std::byte*>(data) + offset, chunk_size);
+    });
+}
+
+void finishUploads(const Device& device, Uploader& uploader)
+{
+    VKCHECK(vkWaitForFences(device.device, static_cast<uint32_t>(uploader.fences.size()), uploader.fences.data(), VK_TRUE, UINT64_MAX));
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <array>
+#include <functional>
+
+#include "vulkan_buffer.h"
+#include "vulkan_headers.h"
+
+struct Device;
+
+// Copies data into device local buffers through a host visible staging buffer.
+// Only used while loading. It submits to the device's queue, so it must not be used while the render thread is running.
+struct Uploader {
+    Buffer staging{}; // split in two so one chunk can be filled while the copy of the previous one runs
+    VkDeviceSize chunk_size = 0;
+    VkCommandPool cmd_pool = VK_NULL_HANDLE;
+    std::array<VkCommandBuffer, 2> cmd_bufs{};
+    std::array<VkFence, 2> fences{};
+    uint32_t next_chunk = 0;
+};
+
+// Writes size bytes to staging, the part of the upload starting offset bytes in.
+using UploadFill = std::function<void(void* staging, VkDeviceSize offset, VkDeviceSize size)>;
+
+void createUploader(const Device& device, VkDeviceSize staging_size, Uploader& uploader);
+// waits for outstanding copies
+void destroyUploader(const Device& device, Uploader& uploader);
+
+// Splits the upload into staging buffer sized chunks, fill is called once per chunk.
+// Returns once the last chunk has been submitted. Queue submission order makes the data visible to anything submitted afterwards.
+void uploadToBuffer(const Device& device, Uploader& uploader, VkBuffer dst, VkDeviceSize dst_offset, VkDeviceSize size, const UploadFill& fill);
+void uploadToBuffer(const Device& device, Uploader& uploader, VkBuffer dst, VkDeviceSize dst_offset, const void* data, VkDeviceSize size);
+
+// waits until every submitted copy has finished
+void finishUploads(const Device& device, Uploader& uploader);